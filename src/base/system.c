@@ -1,5 +1,8 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE /* recvmmsg/sendmmsg */
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -30,6 +33,9 @@
 	#include <fcntl.h>
 	#include <pthread.h>
 	#include <arpa/inet.h>
+	#if !defined(__3DS__)
+		#include <sys/mman.h>
+	#endif
 
 	#include <dirent.h>
 
@@ -66,6 +72,7 @@
 	#include <process.h>
 	#include <shellapi.h>
 	#include <wincrypt.h>
+	#include <io.h>
 #else
 	#error NOT IMPLEMENTED
 #endif
@@ -344,6 +351,8 @@ IOHANDLE io_open(const char *filename, int flags)
 		return (IOHANDLE)fopen(filename, "rb");
 	if(flags == IOFLAG_WRITE)
 		return (IOHANDLE)fopen(filename, "wb");
+	if(flags == IOFLAG_APPEND)
+		return (IOHANDLE)fopen(filename, "ab");
 	return 0x0;
 }
 
@@ -420,6 +429,51 @@ int io_flush(IOHANDLE io)
 	return 0;
 }
 
+void *io_map(IOHANDLE io, unsigned *size)
+{
+	long int length = io_length(io);
+	*size = 0;
+	if(length <= 0)
+		return 0;
+
+#if defined(CONF_FAMILY_UNIX) && !defined(__3DS__)
+	{
+		void *data = mmap(0, (size_t)length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fileno((FILE*)io), 0);
+		if(data == MAP_FAILED)
+			return 0;
+		*size = (unsigned)length;
+		return data;
+	}
+#elif defined(CONF_FAMILY_WINDOWS)
+	{
+		HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)io));
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		void *data;
+		if(!mapping)
+			return 0;
+		data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+		if(!data)
+			return 0;
+		*size = (unsigned)length;
+		return data;
+	}
+#else
+	return 0;
+#endif
+}
+
+void io_unmap(void *data, unsigned size)
+{
+	if(!data)
+		return;
+#if defined(CONF_FAMILY_UNIX) && !defined(__3DS__)
+	munmap(data, size);
+#elif defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#endif
+}
+
 void *thread_init(void (*threadfunc)(void *), void *u)
 {
 #if defined(CONF_FAMILY_UNIX)
@@ -1264,6 +1318,134 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize)
 #endif /* FUZZING */
 }
 
+static int net_udp_recv_batch_single(NETSOCKET sock, NETUDPPACKET *packets, int num)
+{
+	int i;
+	for(i = 0; i < num; i++)
+	{
+		int bytes = net_udp_recv(sock, &packets[i].addr, packets[i].data, packets[i].size);
+		if(bytes <= 0)
+			return i ? i : bytes;
+		packets[i].size = bytes;
+	}
+	return num;
+}
+
+#if defined(CONF_FAMILY_UNIX) && defined(__linux__) && !defined(FUZZING)
+	#define NET_UDP_MMSG
+#endif
+
+#define NET_UDP_BATCH_MAX 64
+
+int net_udp_recv_batch(NETSOCKET sock, NETUDPPACKET *packets, int num)
+{
+#if defined(NET_UDP_MMSG)
+	struct mmsghdr msgs[NET_UDP_BATCH_MAX];
+	struct iovec iovs[NET_UDP_BATCH_MAX];
+	struct sockaddr_in addrs[NET_UDP_BATCH_MAX];
+	int i, received;
+
+	if(sock.ipv4sock < 0)
+		return net_udp_recv_batch_single(sock, packets, num);
+
+	if(num > NET_UDP_BATCH_MAX)
+		num = NET_UDP_BATCH_MAX;
+	mem_zero(msgs, sizeof(msgs[0])*num);
+	for(i = 0; i < num; i++)
+	{
+		iovs[i].iov_base = packets[i].data;
+		iovs[i].iov_len = packets[i].size;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+	}
+
+	received = recvmmsg(sock.ipv4sock, msgs, num, MSG_DONTWAIT, NULL);
+	if(received <= 0)
+	{
+#if defined(WEBSOCKETS)
+		/* websocket packets only come through the single packet path */
+		if(sock.web_ipv4sock >= 0)
+			return net_udp_recv_batch_single(sock, packets, num);
+#endif
+		if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		return received;
+	}
+
+	for(i = 0; i < received; i++)
+	{
+		sockaddr_to_netaddr((struct sockaddr *)&addrs[i], &packets[i].addr);
+		packets[i].size = msgs[i].msg_len;
+		network_stats.recv_bytes += msgs[i].msg_len;
+		network_stats.recv_packets++;
+	}
+	return received;
+#else
+	return net_udp_recv_batch_single(sock, packets, num);
+#endif
+}
+
+int net_udp_send_batch(NETSOCKET sock, const NETUDPPACKET *packets, int num)
+{
+	int sent = 0;
+#if defined(NET_UDP_MMSG)
+	struct mmsghdr msgs[NET_UDP_BATCH_MAX];
+	struct iovec iovs[NET_UDP_BATCH_MAX];
+	struct sockaddr_in addrs[NET_UDP_BATCH_MAX];
+
+	while(sent < num)
+	{
+		int count = 0, i, result;
+
+		/* collect the following plain ipv4 packets, everything else takes the normal path */
+		while(sent+count < num && count < NET_UDP_BATCH_MAX && sock.ipv4sock >= 0 &&
+			packets[sent+count].addr.type == NETTYPE_IPV4)
+		{
+			const NETUDPPACKET *p = &packets[sent+count];
+			netaddr_to_sockaddr_in(&p->addr, &addrs[count]);
+			iovs[count].iov_base = p->data;
+			iovs[count].iov_len = p->size;
+			mem_zero(&msgs[count], sizeof(msgs[count]));
+			msgs[count].msg_hdr.msg_iov = &iovs[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			msgs[count].msg_hdr.msg_name = &addrs[count];
+			msgs[count].msg_hdr.msg_namelen = sizeof(addrs[count]);
+			count++;
+		}
+
+		if(count == 0)
+		{
+			net_udp_send(sock, &packets[sent].addr, packets[sent].data, packets[sent].size);
+			sent++;
+			continue;
+		}
+
+		result = sendmmsg(sock.ipv4sock, msgs, count, 0);
+		if(result <= 0)
+		{
+			/* send them one by one, this drops them the same way sendto would */
+			for(i = 0; i < count; i++)
+				net_udp_send(sock, &packets[sent+i].addr, packets[sent+i].data, packets[sent+i].size);
+			sent += count;
+			continue;
+		}
+
+		for(i = 0; i < result; i++)
+		{
+			network_stats.sent_bytes += packets[sent+i].size;
+			network_stats.sent_packets++;
+		}
+		sent += result;
+	}
+#else
+	for(; sent < num; sent++)
+		net_udp_send(sock, &packets[sent].addr, packets[sent].data, packets[sent].size);
+#endif
+	return sent;
+}
+
 int net_udp_close(NETSOCKET sock)
 {
 	return priv_net_close_all_sockets(sock);
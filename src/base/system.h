@@ -184,6 +184,7 @@ enum {
 	IOFLAG_READ = 1,
 	IOFLAG_WRITE = 2,
 	IOFLAG_RANDOM = 4,
+	IOFLAG_APPEND = 8,
 
 	IOSEEK_START = 0,
 	IOSEEK_CUR = 1,
@@ -198,7 +199,7 @@ typedef struct IOINTERNAL *IOHANDLE;
 
 	Parameters:
 		filename - File to open.
-		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM.
+		flags - A set of flags. IOFLAG_READ, IOFLAG_WRITE, IOFLAG_RANDOM, IOFLAG_APPEND.
 
 	Returns:
 		Returns a handle to the file on success and 0 on failure.
@@ -322,6 +323,38 @@ int io_close(IOHANDLE io);
 */
 int io_flush(IOHANDLE io);
 
+/*
+	Function: io_map
+		Maps the whole file into memory. The mapping is copy on write,
+		changes to it never reach the file. The file can be closed
+		while the mapping is in use.
+
+	Remarks:
+		The mapping isn't a copy. Pages that weren't written to show
+		later changes of the file, and reading past the end of a file
+		that was truncated crashes (SIGBUS). Only keep a mapping while
+		nothing can change the file.
+
+	Parameters:
+		io - Handle to the file.
+		size - Receives the size of the mapping.
+
+	Returns:
+		Returns a pointer to the mapped file or 0 if the file could not
+		be mapped or the platform doesn't support mapping files.
+*/
+void *io_map(IOHANDLE io, unsigned *size);
+
+/*
+	Function: io_unmap
+		Releases a mapping returned by <io_map>.
+
+	Parameters:
+		data - Pointer returned by <io_map>.
+		size - Size of the mapping.
+*/
+void io_unmap(void *data, unsigned size);
+
 
 /*
 	Function: io_stdin
@@ -612,6 +645,47 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 */
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *data, int maxsize);
 
+typedef struct
+{
+	NETADDR addr;
+	void *data;
+	int size;
+} NETUDPPACKET;
+
+/*
+	Function: net_udp_recv_batch
+		Recives several packets over an UDP socket with as few system
+		calls as possible. Uses recvmmsg where it is available and
+		falls back to <net_udp_recv> elsewhere.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to fill. data and size have to be set to the
+			buffer and its size, size is set to the bytes recived.
+		num - Number of packets.
+
+	Returns:
+		The number of packets recived, 0 if there was nothing to
+		recive. Returns -1 on error.
+*/
+int net_udp_recv_batch(NETSOCKET sock, NETUDPPACKET *packets, int num);
+
+/*
+	Function: net_udp_send_batch
+		Sends several packets over an UDP socket with as few system
+		calls as possible. Uses sendmmsg where it is available and
+		falls back to <net_udp_send> elsewhere.
+
+	Parameters:
+		sock - Socket to use.
+		packets - Packets to send.
+		num - Number of packets.
+
+	Returns:
+		The number of packets sent.
+*/
+int net_udp_send_batch(NETSOCKET sock, const NETUDPPACKET *packets, int num);
+
 /*
 	Function: net_udp_close
 		Closes an UDP socket.
@@ -258,9 +258,9 @@ void CSmoothTime::Update(CGraph *pGraph, int64 Target, int TimeLeft, int AdjustD
 
 CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta)
 {
-	m_DemoRecorder[0] = CDemoRecorder(&m_SnapshotDelta);
-	m_DemoRecorder[1] = CDemoRecorder(&m_SnapshotDelta);
-	m_DemoRecorder[2] = CDemoRecorder(&m_SnapshotDelta);
+	m_DemoRecorder[0].Init(&m_SnapshotDelta);
+	m_DemoRecorder[1].Init(&m_SnapshotDelta);
+	m_DemoRecorder[2].Init(&m_SnapshotDelta);
 
 	m_pEditor = 0;
 	m_pInput = 0;
@@ -335,8 +335,9 @@ CClient::CClient() : m_DemoPlayer(&m_SnapshotDelta)
 	m_aServerAddressStr[0] = 0;
 
 	mem_zero(m_aSnapshots, sizeof(m_aSnapshots));
-	m_SnapshotStorage[0].Init();
-	m_SnapshotStorage[1].Init();
+	// only the snapshots since the last delta base are kept
+	m_SnapshotStorage[0].Init(4);
+	m_SnapshotStorage[1].Init(4);
 	m_ReceivedSnapshots[0] = 0;
 	m_ReceivedSnapshots[1] = 0;
 
@@ -888,19 +889,19 @@ void CClient::SnapInvalidateItem(int SnapID, int Index)
 
 void *CClient::SnapFindItem(int SnapID, int Type, int ID)
 {
-	// TODO: linear search. should be fixed.
-	int i;
-
-	if(!m_aSnapshots[g_Config.m_ClDummy][SnapID])
+	CSnapshotStorage::CHolder *pHolder = m_aSnapshots[g_Config.m_ClDummy][SnapID];
+	if(!pHolder)
 		return 0x0;
 
-	for(i = 0; i < m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pSnap->NumItems(); i++)
-	{
-		CSnapshotItem *pItem = m_aSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItem(i);
-		if(pItem->Type() == Type && pItem->ID() == ID)
-			return (void *)pItem->Data();
-	}
-	return 0x0;
+	// the alternative snapshot has the same layout, but items might have been invalidated
+	int Key = (Type<<16)|ID;
+	int Index = pHolder->GetItemIndex(Key);
+	if(Index == -1)
+		return 0x0;
+	CSnapshotItem *pItem = pHolder->m_pAltSnap->GetItem(Index);
+	if(pItem->Key() != Key)
+		return 0x0;
+	return (void *)pItem->Data();
 }
 
 int CClient::SnapNumItems(int SnapID)
@@ -2225,6 +2226,7 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 
 	mem_copy(m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap, pData, Size);
+	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pIndex->Build(m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap);
 
 	GameClient()->OnNewSnapshot();
 }
@@ -3050,11 +3052,15 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_CURRENT][0];
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_CURRENT][1];
+	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pIndex = (CSnapshotKeyIndex *)m_aDemorecSnapshotIndex[SNAP_CURRENT];
+	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pIndex->Build(m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap);
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_SnapSize = 0;
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_Tick = -1;
 
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_PREV][0];
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pAltSnap = (CSnapshot *)m_aDemorecSnapshotData[SNAP_PREV][1];
+	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pIndex = (CSnapshotKeyIndex *)m_aDemorecSnapshotIndex[SNAP_PREV];
+	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pIndex->Build(m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pSnap);
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_SnapSize = 0;
 	m_aSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_Tick = -1;
 
@@ -166,6 +166,7 @@ class CClient : public IClient, public CDemoPlayer::IListner
 
 	class CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
 	char *m_aDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
+	int m_aDemorecSnapshotIndex[NUM_SNAPSHOT_TYPES][CSnapshotKeyIndex::MAX_MEMSIZE/sizeof(int)];
 
 	class CSnapshotDelta m_SnapshotDelta;
 
@@ -174,7 +174,8 @@ protected:
 public:
 	virtual void OnInit() = 0;
 	virtual void OnConsoleInit() = 0;
-	virtual void OnMapChange(char *pNewMapName, int MapNameSize) = 0;
+	// runs on the map load worker, may only work on files and not on the game state
+	virtual void OnMapChange(const char *pMapName, char *pNewMapName, int MapNameSize) = 0;
 	virtual void OnShutdown() = 0;
 
 	virtual void OnTick() = 0;
@@ -25,10 +25,15 @@
 #include <engine/shared/snapshot.h>
 #include <engine/shared/fifoconsole.h>
 
+#include <game/mapitems.h>
+
+#include <base/tl/threading.h>
+
 #include <mastersrv/mastersrv.h>
 
 // DDRace
 #include <string.h>
+#include <zlib.h>
 #include <vector>
 #include <engine/shared/linereader.h>
 #include <game/server/gamecontext.h>
@@ -295,8 +300,15 @@ void CServer::CClient::Reset()
 CServer::CServer()
 {
 	for(int i = 0; i < MAX_CLIENTS; i++)
-		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
-	m_aDemoRecorder[MAX_CLIENTS] = CDemoRecorder(&m_SnapshotDelta, false);
+		m_aDemoRecorder[i].Init(&m_SnapshotDelta, true);
+	m_aDemoRecorder[MAX_CLIENTS].Init(&m_SnapshotDelta, false);
+	for(int i = 0; i < MAX_CLIENTS+1; i++)
+	{
+		m_aDemoRecorder[i].SetJobPool(&m_DemoWriterPool);
+
+		// for antiping: if the projectile netobjects contains extra data, this is removed and the original content restored before recording demo
+		m_aDemoRecorder[i].SetSnapshotFilter(SnapshotRemoveExtraInfo);
+	}
 
 	m_TickSpeed = SERVER_TICK_SPEED;
 
@@ -307,6 +319,8 @@ CServer::CServer()
 
 	m_pCurrentMapData = 0;
 	m_CurrentMapSize = 0;
+	m_MapLoad.m_Active = false;
+	m_MapLoad.m_pData = 0;
 
 	m_MapReload = 0;
 	m_ReloadedWhenEmpty = false;
@@ -321,6 +335,11 @@ CServer::CServer()
 	m_ServerInfoNumRequests = 0;
 	m_ServerInfoHighLoad = false;
 
+	m_NumSnapJobs = 0;
+	m_NextSnapJob = 0;
+	m_NumSnapWorkers = 0;
+	mem_zero(m_aSnapTimeHistogram, sizeof(m_aSnapTimeHistogram));
+
 	Init();
 }
 
@@ -448,7 +467,7 @@ int CServer::Init()
 		m_aClients[i].m_aName[0] = 0;
 		m_aClients[i].m_aClan[0] = 0;
 		m_aClients[i].m_Country = -1;
-		m_aClients[i].m_Snapshots.Init();
+		m_aClients[i].m_Snapshots.Init(SERVER_TICK_SPEED*3); // purged after 3 seconds when not acked
 		m_aClients[i].m_Traffic = 0;
 		m_aClients[i].m_TrafficSince = 0;
 	}
@@ -620,8 +639,49 @@ int CServer::SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System)
 	return 0;
 }
 
+void CServer::VerifySharedSnapshot(int ClientID, const CSnapshot *pSnap, int SnapSize)
+{
+	// build the same snapshot again with every entity snapping itself
+	char aData[CSnapshot::MAX_SIZE];
+	g_Config.m_SvSharedSnap = 0;
+	m_SnapshotBuilder.Init();
+	GameServer()->OnSnap(ClientID);
+	int Size = m_SnapshotBuilder.Finish(aData);
+	g_Config.m_SvSharedSnap = 1;
+
+	if(Size != SnapSize || mem_comp(aData, pSnap, Size) != 0)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "shared snapshot mismatch for ClientID=%d tick=%d size=%d expected=%d", ClientID, Tick(), SnapSize, Size);
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
+int CServer::SnapWorkerThread(void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	char aDeltaData[CSnapshot::MAX_SIZE];
+
+	while(1)
+	{
+		unsigned Index = atomic_inc(&pThis->m_NextSnapJob)-1;
+		if(Index >= (unsigned)pThis->m_NumSnapJobs)
+			break;
+
+		// CreateDelta only reads the static item sizes, so the workers can share m_SnapshotDelta
+		CSnapJob *pJob = &pThis->m_aSnapJobs[Index];
+		int DeltaSize = pThis->m_SnapshotDelta.CreateDelta(pJob->m_pFrom, pJob->m_pTo, aDeltaData, pJob->m_pFromIndex, pJob->m_pToIndex);
+		pJob->m_CompSize = DeltaSize ? CVariableInt::Compress(aDeltaData, DeltaSize, pJob->m_aCompData) : 0;
+		sync_barrier();
+		pJob->m_Done = 1;
+	}
+	return 0;
+}
+
 void CServer::DoSnapshot()
 {
+	int64 SnapStart = time_get();
+
 	GameServer()->OnPreSnap();
 
 	// create snapshot for demo recording
@@ -635,15 +695,16 @@ void CServer::DoSnapshot()
 		GameServer()->OnSnap(-1);
 		SnapshotSize = m_SnapshotBuilder.Finish(aData);
 
-		// for antiping: if the projectile netobjects contains extra data, this is removed and the original content restored before recording demo
-		unsigned char aExtraInfoRemoved[CSnapshot::MAX_SIZE];
-		mem_copy(aExtraInfoRemoved, aData, SnapshotSize);
-		SnapshotRemoveExtraInfo(aExtraInfoRemoved);
-		// write snapshot
-		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aExtraInfoRemoved, SnapshotSize);
+		// write snapshot, the recorder removes the extra info on its own copy
+		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
+	// workers from the last snapshot might still be queued, none may pick up a job that is being built
+	m_SnapWorkerGroup.Wait();
+	m_NextSnapJob = 0;
+
 	// create snapshots for all clients
+	m_NumSnapJobs = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// client must be ingame to recive snapshots
@@ -661,15 +722,10 @@ void CServer::DoSnapshot()
 		{
 			char aData[CSnapshot::MAX_SIZE];
 			CSnapshot *pData = (CSnapshot*)aData;	// Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
 			int SnapshotSize;
-			int Crc;
 			static CSnapshot EmptySnap;
 			CSnapshot *pDeltashot = &EmptySnap;
-			int DeltashotSize;
 			int DeltaTick = -1;
-			int DeltaSize;
 
 			m_SnapshotBuilder.Init();
 
@@ -678,17 +734,8 @@ void CServer::DoSnapshot()
 			// finish snapshot
 			SnapshotSize = m_SnapshotBuilder.Finish(pData);
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// for antiping: if the projectile netobjects contains extra data, this is removed and the original content restored before recording demo
-				unsigned char aExtraInfoRemoved[CSnapshot::MAX_SIZE];
-				mem_copy(aExtraInfoRemoved, aData, SnapshotSize);
-				SnapshotRemoveExtraInfo(aExtraInfoRemoved);
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aExtraInfoRemoved, SnapshotSize);
-			}
-
-			Crc = pData->Crc();
+			if(g_Config.m_SvSharedSnap && g_Config.m_SvSharedSnapVerify)
+				VerifySharedSnapshot(i, pData, SnapshotSize);
 
 			// remove old snapshos
 			// keep 3 seconds worth of snapshots
@@ -697,13 +744,26 @@ void CServer::DoSnapshot()
 			// save it the snapshot
 			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
 
+			// write snapshot, the recorder reuses the key index of the stored snapshot
+			// and removes the extra info on its own copy
+			if(m_aDemoRecorder[i].IsRecording())
+			{
+				CSnapshotStorage::CHolder *pHolder = m_aClients[i].m_Snapshots.m_pLast;
+				m_aDemoRecorder[i].RecordSnapshot(Tick(), pHolder->m_pSnap, SnapshotSize, pHolder->m_pIndex);
+			}
+
 			// find snapshot that we can preform delta against
 			EmptySnap.Clear();
 
+			const CSnapshotKeyIndex *pDeltashotIndex = 0;
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
+				CSnapshotStorage::CHolder *pDeltaHolder = m_aClients[i].m_Snapshots.GetHolder(m_aClients[i].m_LastAckedSnapshot);
+				if(pDeltaHolder)
+				{
+					pDeltashot = pDeltaHolder->m_pSnap;
+					pDeltashotIndex = pDeltaHolder->m_pIndex;
 					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				}
 				else
 				{
 					// no acked package found, force client to recover rate
@@ -712,59 +772,98 @@ void CServer::DoSnapshot()
 				}
 			}
 
-			// create delta
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			// the delta and compression are done later, possibly by the snapshot workers
+			CSnapJob *pJob = &m_aSnapJobs[m_NumSnapJobs++];
+			pJob->m_ClientID = i;
+			pJob->m_pFrom = pDeltashot;
+			pJob->m_pTo = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			pJob->m_pFromIndex = pDeltashotIndex;
+			pJob->m_pToIndex = m_aClients[i].m_Snapshots.m_pLast->m_pIndex;
+			pJob->m_DeltaTick = DeltaTick;
+			pJob->m_Crc = pData->Crc();
+			pJob->m_Done = 0;
+		}
+	}
+
+	// create deltas and compress them, spread over the workers if there are any
+	if(m_NumSnapJobs)
+	{
+		sync_barrier();
+		if(m_NumSnapJobs > 1)
+			for(int w = 0; w < m_NumSnapWorkers; w++)
+				m_SnapJobPool.Add(&m_aSnapWorkerJobs[w], SnapWorkerThread, this, &m_SnapWorkerGroup);
+		SnapWorkerThread(this);
+	}
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+	// send the snapshots in client order, the packets leave in as few send calls as possible
+	CNetBase::BeginSendBatch();
+	for(int j = 0; j < m_NumSnapJobs; j++)
+	{
+		CSnapJob *pJob = &m_aSnapJobs[j];
+		while(!pJob->m_Done)
+			thread_yield();
+		sync_barrier();
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData);
-				NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+		int i = pJob->m_ClientID;
+		int DeltaTick = pJob->m_DeltaTick;
+		int Crc = pJob->m_Crc;
 
-				for(int n = 0, Left = SnapshotSize; Left; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+		if(pJob->m_CompSize)
+		{
+			const char *pCompData = pJob->m_aCompData;
+			int SnapshotSize = pJob->m_CompSize;
+			const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+			int NumPackets;
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick-DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n*MaxSize], Chunk);
-						SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
-					}
-				}
-			}
-			else
+			NumPackets = (SnapshotSize+MaxSize-1)/MaxSize;
+
+			for(int n = 0, Left = SnapshotSize; Left; n++)
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick-DeltaTick);
-				SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				int Chunk = Left < MaxSize ? Left : MaxSize;
+				Left -= Chunk;
+
+				if(NumPackets == 1)
+				{
+					CMsgPacker Msg(NETMSG_SNAPSINGLE);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick-DeltaTick);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n*MaxSize], Chunk);
+					SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				}
+				else
+				{
+					CMsgPacker Msg(NETMSG_SNAP);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick-DeltaTick);
+					Msg.AddInt(NumPackets);
+					Msg.AddInt(n);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n*MaxSize], Chunk);
+					SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+				}
 			}
 		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAPEMPTY);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick-DeltaTick);
+			SendMsgEx(&Msg, MSGFLAG_FLUSH, i, true);
+		}
 	}
+	CNetBase::EndSendBatch();
 
 	GameServer()->OnPostSnap();
+
+	// put the snapshot time into its histogram bucket, bucket n holds times below 2^n microseconds
+	int64 SnapTime = (time_get()-SnapStart)*1000000/time_freq();
+	int Bucket = 0;
+	while(Bucket < NUM_SNAPTIME_BUCKETS-1 && SnapTime >= (1<<Bucket))
+		Bucket++;
+	m_aSnapTimeHistogram[Bucket]++;
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -1536,26 +1635,113 @@ char *CServer::GetMapName()
 	return pMapShortName;
 }
 
-int CServer::LoadMap(const char *pMapName)
+int CServer::MapLoadThread(void *pUser)
 {
-	//DATAFILE *df;
-	char aBuf[512];
-	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
-	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
+	CMapLoad *pLoad = (CMapLoad *)pUser;
+	CServer *pThis = pLoad->m_pServer;
 
-	/*df = datafile_load(buf);
-	if(!df)
-		return 0;*/
+	// the game may put the map settings into a temporary copy
+	char aMapPath[sizeof(pLoad->m_aPath)];
+	str_copy(aMapPath, pLoad->m_aPath, sizeof(aMapPath));
+	pThis->GameServer()->OnMapChange(pLoad->m_aName, pLoad->m_aPath, sizeof(pLoad->m_aPath));
+	bool TempFile = str_comp(pLoad->m_aPath, aMapPath) != 0;
 
-	// check for valid standard map
-	if(!m_MapChecker.ReadAndValidateMap(Storage(), aBuf, IStorage::TYPE_ALL))
+	// read the whole file once, the crc, the map checker, the datafile and the map download
+	// all work on this buffer. it is a copy, the file may be replaced while the map runs
+	unsigned ReadSize = 0;
+	IOHANDLE File = pThis->Storage()->OpenFile(pLoad->m_aPath, IOFLAG_READ, IStorage::TYPE_ALL);
+	if(File)
+	{
+		pLoad->m_Size = (unsigned)io_length(File);
+		pLoad->m_pData = (unsigned char *)mem_alloc(max(pLoad->m_Size, 1u), 1);
+		ReadSize = io_read(File, pLoad->m_pData, pLoad->m_Size);
+		io_close(File);
+	}
+
+	// nothing reads the temporary copy again, not even when the load is discarded
+	if(TempFile)
+		pThis->Storage()->RemoveFile(pLoad->m_aPath, IStorage::TYPE_SAVE);
+	if(!File || ReadSize != pLoad->m_Size)
+		return -1;
+
+	pLoad->m_Crc = crc32(0, pLoad->m_pData, pLoad->m_Size);
+	pLoad->m_Valid = pThis->m_MapChecker.ValidateMap(pLoad->m_aPath, pLoad->m_Crc, pLoad->m_Size);
+	if(!pLoad->m_Valid || !pLoad->m_Reader.OpenMem(pLoad->m_pData, pLoad->m_Size, pLoad->m_Crc))
+		return -1;
+
+	// decompress the layers the game needs right away
+	int Start, Num;
+	pLoad->m_Reader.GetType(MAPITEMTYPE_LAYER, &Start, &Num);
+	for(int i = 0; i < Num; i++)
+	{
+		CMapItemLayer *pLayer = (CMapItemLayer *)pLoad->m_Reader.GetItem(Start+i, 0, 0);
+		if(pLayer->m_Type != LAYERTYPE_TILES)
+			continue;
+
+		CMapItemLayerTilemap *pTilemap = (CMapItemLayerTilemap *)pLayer;
+		if(pTilemap->m_Flags&TILESLAYERFLAG_GAME)
+			pLoad->m_Reader.GetData(pTilemap->m_Data);
+
+		// older versions keep the ddrace data indices at fixed offsets, see CLayers::Init
+		const int aFlags[] = {TILESLAYERFLAG_TELE, TILESLAYERFLAG_SPEEDUP, TILESLAYERFLAG_FRONT, TILESLAYERFLAG_SWITCH, TILESLAYERFLAG_TUNE};
+		const int aIndices[] = {pTilemap->m_Tele, pTilemap->m_Speedup, pTilemap->m_Front, pTilemap->m_Switch, pTilemap->m_Tune};
+		for(int f = 0; f < 5; f++)
+		{
+			if(!(pTilemap->m_Flags&aFlags[f]))
+				continue;
+			int Index = pTilemap->m_Version <= 2 ? ((const int *)pTilemap)[15+f] : aIndices[f];
+			if(Index >= 0 && Index < pLoad->m_Reader.NumData())
+				pLoad->m_Reader.GetData(Index);
+		}
+	}
+	return 0;
+}
+
+void CServer::StartMapLoad(const char *pMapName, bool Reload)
+{
+	CMapLoad *pLoad = &m_MapLoad;
+	dbg_assert(!pLoad->m_Active, "map load still active");
+
+	pLoad->m_pServer = this;
+	pLoad->m_Active = true;
+	pLoad->m_Reload = Reload;
+	pLoad->m_pData = 0;
+	pLoad->m_Size = 0;
+	pLoad->m_Crc = 0;
+	pLoad->m_Valid = true;
+	str_copy(pLoad->m_aName, pMapName, sizeof(pLoad->m_aName));
+	str_format(pLoad->m_aPath, sizeof(pLoad->m_aPath), "maps/%s.map", pMapName);
+	m_MapLoadPool.Add(&pLoad->m_Job, MapLoadThread, pLoad, &m_MapLoadGroup);
+}
+
+void CServer::DiscardMapLoad()
+{
+	CMapLoad *pLoad = &m_MapLoad;
+	pLoad->m_Reader.Close();
+	if(pLoad->m_pData)
+		mem_free(pLoad->m_pData);
+	pLoad->m_pData = 0;
+	pLoad->m_Active = false;
+}
+
+int CServer::FinishMapLoad()
+{
+	CMapLoad *pLoad = &m_MapLoad;
+	sync_barrier();
+
+	if(!pLoad->m_Valid)
 	{
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mapchecker", "invalid standard map");
+		DiscardMapLoad();
 		return 0;
 	}
-
-	if(!m_pMap->Load(aBuf))
+	if(pLoad->m_Job.Result() != 0)
+	{
+		DiscardMapLoad();
 		return 0;
+	}
+
+	m_pMap->LoadOpened(&pLoad->m_Reader);
 
 	// stop recording when we change map
 	for(int i = 0; i < MAX_CLIENTS+1; i++)
@@ -1577,22 +1763,18 @@ int CServer::LoadMap(const char *pMapName)
 	// get the crc of the map
 	m_CurrentMapCrc = m_pMap->Crc();
 	char aBufMsg[256];
-	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", aBuf, m_CurrentMapCrc);
+	str_format(aBufMsg, sizeof(aBufMsg), "%s crc is %08x", pLoad->m_aPath, m_CurrentMapCrc);
 	Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "server", aBufMsg);
 
-	str_copy(m_aCurrentMap, pMapName, sizeof(m_aCurrentMap));
-	//map_set(df);
+	str_copy(m_aCurrentMap, pLoad->m_aName, sizeof(m_aCurrentMap));
 
-	// load complete map into memory for download
-	{
-		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_CurrentMapSize = (unsigned int)io_length(File);
-		if(m_pCurrentMapData)
-			mem_free(m_pCurrentMapData);
-		m_pCurrentMapData = (unsigned char *)mem_alloc(m_CurrentMapSize, 1);
-		io_read(File, m_pCurrentMapData, m_CurrentMapSize);
-		io_close(File);
-	}
+	// the map keeps reading from this buffer, it is also what clients download
+	if(m_pCurrentMapData)
+		mem_free(m_pCurrentMapData);
+	m_pCurrentMapData = pLoad->m_pData;
+	m_CurrentMapSize = pLoad->m_Size;
+	pLoad->m_pData = 0;
+	pLoad->m_Active = false;
 
 	for(int i=0; i<MAX_CLIENTS; i++)
 		m_aPrevStates[i] = m_aClients[i].m_State;
@@ -1600,6 +1782,53 @@ int CServer::LoadMap(const char *pMapName)
 	return 1;
 }
 
+int CServer::LoadMap(const char *pMapName)
+{
+	if(m_MapLoad.m_Active)
+	{
+		m_MapLoadGroup.Wait();
+		DiscardMapLoad();
+	}
+
+	StartMapLoad(pMapName, false);
+	m_MapLoadGroup.Wait();
+	return FinishMapLoad();
+}
+
+int CServer::PollMapChange()
+{
+	CMapLoad *pLoad = &m_MapLoad;
+	bool Change = str_comp(g_Config.m_SvMap, m_aCurrentMap) != 0;
+	if(!Change && !m_MapReload && !(pLoad->m_Active && pLoad->m_Reload))
+		return 0;
+
+	if(pLoad->m_Active)
+	{
+		// keep ticking the old map until the worker is done
+		if(pLoad->m_Job.Status() != CJob::STATE_DONE)
+			return 0;
+
+		if(!m_MapReload && str_comp(pLoad->m_aName, g_Config.m_SvMap) == 0 && (Change || pLoad->m_Reload))
+		{
+			if(FinishMapLoad())
+				return 1;
+
+			char aBuf[256];
+			str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", g_Config.m_SvMap);
+			Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+			str_copy(g_Config.m_SvMap, m_aCurrentMap, sizeof(g_Config.m_SvMap));
+			return 0;
+		}
+
+		// outdated or for another map
+		DiscardMapLoad();
+	}
+
+	StartMapLoad(g_Config.m_SvMap, m_MapReload);
+	m_MapReload = 0;
+	return 0;
+}
+
 void CServer::InitRegister(CNetServer *pNetServer, IEngineMasterServer *pMasterServer, IConsole *pConsole)
 {
 	m_Register.Init(pNetServer, pMasterServer, pConsole);
@@ -1610,7 +1839,10 @@ int CServer::Run()
 	//
 	m_PrintCBIndex = Console()->RegisterPrintCallback(g_Config.m_ConsoleOutputLevel, SendRconLineAuthed, this);
 
+	m_DemoWriterPool.Init(1);
+
 	// load map
+	m_MapLoadPool.Init(1);
 	if(!LoadMap(g_Config.m_SvMap))
 	{
 		dbg_msg("server", "failed to load map. mapname='%s'", g_Config.m_SvMap);
@@ -1642,6 +1874,9 @@ int CServer::Run()
 
 	m_Econ.Init(Console(), &m_ServerBan);
 
+	m_NumSnapWorkers = min(g_Config.m_SvSnapWorkers, (int)MAX_SNAP_WORKERS);
+	m_SnapJobPool.Init(m_NumSnapWorkers);
+
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "server name is '%s'", g_Config.m_SvName);
 	Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
@@ -1683,40 +1918,28 @@ int CServer::Run()
 			int64 t = time_get();
 			int NewTicks = 0;
 
-			// load new map TODO: don't poll this
-			if(str_comp(g_Config.m_SvMap, m_aCurrentMap) != 0 || m_MapReload)
+			// swap in a new map once it is loaded
+			if(PollMapChange())
 			{
-				m_MapReload = 0;
+				// new map loaded
+				GameServer()->OnShutdown();
 
-				// load map
-				if(LoadMap(g_Config.m_SvMap))
+				for(int c = 0; c < MAX_CLIENTS; c++)
 				{
-					// new map loaded
-					GameServer()->OnShutdown();
-
-					for(int c = 0; c < MAX_CLIENTS; c++)
-					{
-						if(m_aClients[c].m_State <= CClient::STATE_AUTH)
-							continue;
-
-						SendMap(c);
-						m_aClients[c].Reset();
-						m_aClients[c].m_State = CClient::STATE_CONNECTING;
-					}
+					if(m_aClients[c].m_State <= CClient::STATE_AUTH)
+						continue;
 
-					m_GameStartTime = time_get();
-					m_CurrentGameTick = 0;
-					m_ServerInfoFirstRequest = 0;
-					Kernel()->ReregisterInterface(GameServer());
-					GameServer()->OnInit();
-					UpdateServerInfo();
-				}
-				else
-				{
-					str_format(aBuf, sizeof(aBuf), "failed to load map. mapname='%s'", g_Config.m_SvMap);
-					Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
-					str_copy(g_Config.m_SvMap, m_aCurrentMap, sizeof(g_Config.m_SvMap));
+					SendMap(c);
+					m_aClients[c].Reset();
+					m_aClients[c].m_State = CClient::STATE_CONNECTING;
 				}
+
+				m_GameStartTime = time_get();
+				m_CurrentGameTick = 0;
+				m_ServerInfoFirstRequest = 0;
+				Kernel()->ReregisterInterface(GameServer());
+				GameServer()->OnInit();
+				UpdateServerInfo();
 			}
 
 			while(t > TickStartTime(m_CurrentGameTick+1))
@@ -1809,6 +2032,12 @@ int CServer::Run()
 	GameServer()->OnShutdown();
 	m_pMap->Unload();
 
+	if(m_MapLoad.m_Active)
+	{
+		m_MapLoadGroup.Wait();
+		DiscardMapLoad();
+	}
+
 	if(m_pCurrentMapData)
 		mem_free(m_pCurrentMapData);
 	return 0;
@@ -1866,6 +2095,45 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSnapHistogram(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	char aBuf[128];
+
+	int Total = 0;
+	for(int i = 0; i < NUM_SNAPTIME_BUCKETS; i++)
+		Total += pThis->m_aSnapTimeHistogram[i];
+
+	str_format(aBuf, sizeof(aBuf), "%d snapshots, %d workers", Total, pThis->m_NumSnapWorkers);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+	for(int i = 0; i < NUM_SNAPTIME_BUCKETS; i++)
+	{
+		if(!pThis->m_aSnapTimeHistogram[i])
+			continue;
+		if(i == NUM_SNAPTIME_BUCKETS-1)
+			str_format(aBuf, sizeof(aBuf), "  >= %6d us: %d", 1<<(i-1), pThis->m_aSnapTimeHistogram[i]);
+		else
+			str_format(aBuf, sizeof(aBuf), "  <  %6d us: %d", 1<<i, pThis->m_aSnapTimeHistogram[i]);
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+
+	mem_zero(pThis->m_aSnapTimeHistogram, sizeof(pThis->m_aSnapTimeHistogram));
+
+	// snapshot storage allocations since the clients connected
+	int ArenaAllocs = 0, HeapAllocs = 0, ArenaResizes = 0, ArenaSize = 0;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		const CSnapshotStorage::CStats *pStats = pThis->m_aClients[i].m_Snapshots.Stats();
+		ArenaAllocs += pStats->m_ArenaAllocs;
+		HeapAllocs += pStats->m_HeapAllocs;
+		ArenaResizes += pStats->m_ArenaResizes;
+		ArenaSize += pStats->m_ArenaSize;
+	}
+	str_format(aBuf, sizeof(aBuf), "storage: arena_allocs=%d heap_allocs=%d arena_resizes=%d arena_kb=%d", ArenaAllocs, HeapAllocs, ArenaResizes, ArenaSize/1024);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 void CServer::ConShutdown(IConsole::IResult *pResult, void *pUser)
 {
 	((CServer *)pUser)->m_RunServer = 0;
@@ -1963,6 +2231,27 @@ void CServer::ConMapReload(IConsole::IResult *pResult, void *pUser)
 	((CServer *)pUser)->m_MapReload = 1;
 }
 
+void CServer::ConPrefetchMap(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	CMapLoad *pLoad = &pThis->m_MapLoad;
+	const char *pMapName = pResult->GetString(0);
+
+	if(pLoad->m_Active)
+	{
+		if(str_comp(pLoad->m_aName, pMapName) == 0)
+			return;
+		if(pLoad->m_Job.Status() != CJob::STATE_DONE)
+		{
+			pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "another map is still loading");
+			return;
+		}
+		pThis->DiscardMapLoad();
+	}
+
+	pThis->StartMapLoad(pMapName, false);
+}
+
 void CServer::ConLogout(IConsole::IResult *pResult, void *pUser)
 {
 	CServer *pServer = (CServer *)pUser;
@@ -2105,6 +2394,7 @@ void CServer::RegisterCommands()
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "", CFGFLAG_SERVER, ConStatus, this, "List players");
+	Console()->Register("snap_histogram", "", CFGFLAG_SERVER, ConSnapHistogram, this, "Show how long the snapshot creation took (and reset it) and the snapshot storage allocations");
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 
@@ -2112,6 +2402,7 @@ void CServer::RegisterCommands()
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
 
 	Console()->Register("reload", "", CFGFLAG_SERVER, ConMapReload, this, "Reload the map");
+	Console()->Register("prefetch_map", "s[map]", CFGFLAG_SERVER, ConPrefetchMap, this, "Load a map in the background so a change to it is instant");
 
 	Console()->Chain("sv_name", ConchainSpecialInfoupdate, this);
 	Console()->Chain("password", ConchainSpecialInfoupdate, this);
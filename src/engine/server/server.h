@@ -6,6 +6,7 @@
 #include <engine/server.h>
 
 #include <engine/map.h>
+#include <engine/shared/datafile.h>
 #include <engine/shared/demo.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
@@ -15,6 +16,7 @@
 #include <base/math.h>
 #include <engine/shared/mapchecker.h>
 #include <engine/shared/econ.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 
 class CSnapIDPool
@@ -88,6 +90,9 @@ public:
 		AUTHED_ADMIN,
 
 		MAX_RCONCMD_SEND=16,
+
+		MAX_SNAP_WORKERS=16,
+		NUM_SNAPTIME_BUCKETS=16,
 	};
 
 	class CClient
@@ -149,6 +154,35 @@ public:
 	CClient m_aClients[MAX_CLIENTS];
 	int IdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
+	// a snapshot that still has to be delta compressed for one client
+	class CSnapJob
+	{
+	public:
+		int m_ClientID;
+		CSnapshot *m_pFrom;
+		CSnapshot *m_pTo;
+		const CSnapshotKeyIndex *m_pFromIndex; // key indices of the stored snapshots, 0 for the empty one
+		const CSnapshotKeyIndex *m_pToIndex;
+		int m_DeltaTick;
+		int m_Crc;
+
+		volatile int m_Done;
+		int m_CompSize;
+		char m_aCompData[CSnapshot::MAX_SIZE];
+	};
+
+	CSnapJob m_aSnapJobs[MAX_CLIENTS];
+	int m_NumSnapJobs;
+	volatile unsigned m_NextSnapJob;
+
+	// the tick waits for these jobs, a map load or demo write on the same workers would stall it
+	CJobGroup m_SnapWorkerGroup; // before the pool, it has to outlive the workers
+	CJobPool m_SnapJobPool;
+	CJob m_aSnapWorkerJobs[MAX_SNAP_WORKERS];
+	int m_NumSnapWorkers;
+
+	int m_aSnapTimeHistogram[NUM_SNAPTIME_BUCKETS];
+
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
 	CSnapIDPool m_IDPool;
@@ -175,9 +209,33 @@ public:
 	unsigned char *m_pCurrentMapData;
 	unsigned int m_CurrentMapSize;
 
+	// map changes are read, checked and decompressed on a worker thread
+	// and swapped in at the start of a tick
+	struct CMapLoad
+	{
+		CServer *m_pServer;
+		CJob m_Job;
+		bool m_Active; // queued or finished, result not taken yet
+		bool m_Reload;
+		char m_aName[64];
+		char m_aPath[512];
+
+		// results
+		unsigned char *m_pData;
+		unsigned m_Size;
+		unsigned m_Crc;
+		bool m_Valid;
+		CDataFileReader m_Reader;
+	};
+	// own worker, demo Stop on the tick thread waits for the writer and must not wait for a load
+	CJobGroup m_MapLoadGroup;
+	CJobPool m_MapLoadPool;
+	CMapLoad m_MapLoad;
+
 	int m_GeneratedRconPassword;
 
 	CDemoRecorder m_aDemoRecorder[MAX_CLIENTS+1];
+	CJobPool m_DemoWriterPool; // one worker compresses and writes all demos, so the writes stay in order
 	CRegister m_Register;
 	CMapChecker m_MapChecker;
 
@@ -222,6 +280,8 @@ public:
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
 	int SendMsgEx(CMsgPacker *pMsg, int Flags, int ClientID, bool System);
 
+	void VerifySharedSnapshot(int ClientID, const CSnapshot *pSnap, int SnapSize);
+	static int SnapWorkerThread(void *pUser);
 	void DoSnapshot();
 
 	static int NewClientCallback(int ClientID, void *pUser);
@@ -250,6 +310,12 @@ public:
 	char *GetMapName();
 	int LoadMap(const char *pMapName);
 
+	static int MapLoadThread(void *pUser);
+	void StartMapLoad(const char *pMapName, bool Reload);
+	void DiscardMapLoad();
+	int FinishMapLoad();
+	int PollMapChange();
+
 	void SaveDemo(int ClientID, float Time);
 	void StartRecord(int ClientID);
 	void StopRecord(int ClientID);
@@ -262,10 +328,12 @@ public:
 	static void ConRescue(IConsole::IResult *pResult, void *pUser);
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapHistogram(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
+	static void ConPrefetchMap(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConchainSpecialInfoupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 	static void ConchainMaxclientsperipUpdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
@@ -65,6 +65,27 @@ long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_)
 	const unsigned char *pSrc = (unsigned char *)pSrc_;
 	const unsigned char *pEnd = pSrc + Size;
 	int *pDst = (int *)pDst_;
+
+	// most of a snapshot delta are ints that fit into one byte. check 4 bytes at
+	// once for extend bits and unpack them without branches if there are none
+	while(pEnd - pSrc >= 4)
+	{
+		unsigned Word = pSrc[0] | (pSrc[1]<<8) | (pSrc[2]<<16) | ((unsigned)pSrc[3]<<24);
+		if(Word&0x80808080)
+		{
+			pSrc = CVariableInt::Unpack(pSrc, pDst);
+			pDst++;
+			continue;
+		}
+
+		pDst[0] = (pSrc[0]&0x3F) ^ -((pSrc[0]>>6)&1);
+		pDst[1] = (pSrc[1]&0x3F) ^ -((pSrc[1]>>6)&1);
+		pDst[2] = (pSrc[2]&0x3F) ^ -((pSrc[2]>>6)&1);
+		pDst[3] = (pSrc[3]&0x3F) ^ -((pSrc[3]>>6)&1);
+		pSrc += 4;
+		pDst += 4;
+	}
+
 	while(pSrc < pEnd)
 	{
 		pSrc = CVariableInt::Unpack(pSrc, pDst);
@@ -78,6 +99,27 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_)
 	int *pSrc = (int *)pSrc_;
 	unsigned char *pDst = (unsigned char *)pDst_;
 	Size /= 4;
+
+	// 4 ints in -64..63 at once, they are one byte each: sign and 6 bits
+	while(Size >= 4)
+	{
+		if(((pSrc[0]+64u) | (pSrc[1]+64u) | (pSrc[2]+64u) | (pSrc[3]+64u)) >= 128u)
+		{
+			pDst = CVariableInt::Pack(pDst, *pSrc);
+			Size--;
+			pSrc++;
+			continue;
+		}
+
+		pDst[0] = ((pSrc[0]>>25)&0x40) | ((pSrc[0]^(pSrc[0]>>31))&0x3F);
+		pDst[1] = ((pSrc[1]>>25)&0x40) | ((pSrc[1]^(pSrc[1]>>31))&0x3F);
+		pDst[2] = ((pSrc[2]>>25)&0x40) | ((pSrc[2]^(pSrc[2]>>31))&0x3F);
+		pDst[3] = ((pSrc[3]>>25)&0x40) | ((pSrc[3]^(pSrc[3]>>31))&0x3F);
+		pDst += 4;
+		pSrc += 4;
+		Size -= 4;
+	}
+
 	while(Size)
 	{
 		pDst = CVariableInt::Pack(pDst, *pSrc);
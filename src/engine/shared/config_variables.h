@@ -150,8 +150,13 @@ MACRO_CONFIG_INT(SvVanillaAntiSpoof, sv_vanilla_antispoof, 1, 0, 1, CFGFLAG_SERV
 
 MACRO_CONFIG_INT(SvPlayerDemoRecord, sv_player_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos for each player")
 MACRO_CONFIG_INT(SvDemoChat, sv_demo_chat, 0, 0, 1, CFGFLAG_SERVER, "Record chat for demos")
+MACRO_CONFIG_INT(DemoKeyframeInterval, demo_keyframe_interval, 5, 1, 60, CFGFLAG_SAVE|CFGFLAG_CLIENT|CFGFLAG_SERVER, "Seconds between two keyframes in recorded demos, smaller values make seeking faster and demos bigger")
+MACRO_CONFIG_INT(DemoWriteBuffer, demo_write_buffer, 256, 0, 16384, CFGFLAG_SAVE|CFGFLAG_SERVER, "Size of the buffer in KB that server demos are written from in the background (0 = write while recording)")
 MACRO_CONFIG_INT(SvServerInfoPerSecond, sv_server_info_per_second, 50, 1, 1000, CFGFLAG_SERVER, "Maximum number of complete server info responses that are sent out per second")
 MACRO_CONFIG_INT(SvVanConnPerSecond, sv_van_conn_per_second, 10, 1, 1000, CFGFLAG_SERVER, "Antispoof specific ratelimit")
+MACRO_CONFIG_INT(SvSharedSnap, sv_shared_snap, 1, 0, 1, CFGFLAG_SERVER, "Build client independent snapshot items once per tick and only filter them per client")
+MACRO_CONFIG_INT(SvSnapWorkers, sv_snap_workers, 2, 0, 16, CFGFLAG_SERVER, "Number of threads that help creating the snapshot deltas (0 = tick thread only, needs restart)")
+MACRO_CONFIG_INT(SvSharedSnapVerify, sv_shared_snap_verify, 0, 0, 1, CFGFLAG_SERVER, "Debug: rebuild every client snapshot without shared items and report differences (slow)")
 
 MACRO_CONFIG_STR(EcBindaddr, ec_bindaddr, 128, "localhost", CFGFLAG_ECON, "Address to bind the external console to. Anything but 'localhost' is dangerous")
 MACRO_CONFIG_INT(EcPort, ec_port, 0, 0, 0, CFGFLAG_ECON, "Port to use for the external console")
@@ -225,6 +230,10 @@ MACRO_CONFIG_INT(SvSqlCreateTables, sv_sql_create_tables, 1, 0, 1, CFGFLAG_SERVE
 MACRO_CONFIG_STR(SvSqlDatabase, sv_sql_database, 16, "teeworlds", CFGFLAG_SERVER, "SQL Database name")
 MACRO_CONFIG_STR(SvSqlServerName, sv_sql_servername, 5, "UNK", CFGFLAG_SERVER, "SQL Server name that is inserted into record table")
 MACRO_CONFIG_STR(SvSqlPrefix, sv_sql_prefix, 16, "record", CFGFLAG_SERVER, "SQL Database table prefix")
+MACRO_CONFIG_INT(SvSqlConnections, sv_sql_connections, 2, 1, 8, CFGFLAG_SERVER, "Number of SQL connections, each one with its own worker thread")
+MACRO_CONFIG_INT(SvSqlWriteDelay, sv_sql_write_delay, 1000, 0, 10000, CFGFLAG_SERVER, "Milliseconds finishes are collected before they are written to the database together, a read like /rank writes them right away")
+MACRO_CONFIG_INT(SvSqlConnectTimeout, sv_sql_connect_timeout, 3, 1, 60, CFGFLAG_SERVER, "Seconds to wait for the SQL server when connecting")
+MACRO_CONFIG_INT(SvSqlMaxQueue, sv_sql_max_queue, 256, 16, 4096, CFGFLAG_SERVER, "Maximum number of waiting SQL requests, more are dropped (finishes and saves are always queued)")
 MACRO_CONFIG_INT(SvSaveGames, sv_savegames, 1, 0, 1, CFGFLAG_SERVER, "Enables savegames (/save and /load)")
 MACRO_CONFIG_INT(SvSaveGamesDelay, sv_savegames_delay, 60, 0, 10000, CFGFLAG_SERVER, "Delay in seconds for loading a savegame")
 #endif
@@ -12,6 +12,7 @@ class CConsole : public IConsole
 	{
 	public:
 		CCommand *m_pNext;
+		CCommand *m_pNextHash;
 		int m_Flags;
 		bool m_Temp;
 		FCommandCallback m_pfnCallback;
@@ -37,6 +38,14 @@ class CConsole : public IConsole
 	const char *m_paStrokeStr[2];
 	CCommand *m_pFirstCommand;
 
+	enum
+	{
+		COMMAND_HASH_SIZE=1024,
+	};
+
+	// the commands by the case insensitive hash of their name, each chain in the order of the sorted list
+	CCommand *m_apCommandHash[COMMAND_HASH_SIZE];
+
 	class CExecFile
 	{
 	public:
@@ -175,7 +184,10 @@ class CConsole : public IConsole
 		}
 	} m_ExecutionQueue;
 
+	static unsigned CommandHash(const char *pName);
 	void AddCommandSorted(CCommand *pCommand);
+	void AddCommandHash(CCommand *pCommand);
+	void RemoveCommandHash(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 public:
@@ -55,9 +55,162 @@ struct CDatafileInfo
 	char *m_pDataStart;
 };
 
+// bump allocator for data blocks read from memory, freed blocks are reused by later ones
+struct CDatafileArenaChunk
+{
+	CDatafileArenaChunk *m_pPrev;
+	unsigned m_Size;
+	unsigned m_Used;
+};
+
+struct CDatafileArenaFree
+{
+	CDatafileArenaFree *m_pNext;
+	unsigned m_Size;
+};
+
+struct CDatafileArena
+{
+	CDatafileArenaChunk *m_pTop;
+	CDatafileArenaFree *m_pFree;
+};
+
+enum
+{
+	ARENA_HEADER_SIZE=32,
+	ARENA_CHUNK_SIZE=256*1024,
+	ARENA_MIN_SPLIT=64,
+};
+
+static char *ArenaData(CDatafileArenaChunk *pChunk)
+{
+	return (char *)pChunk + ARENA_HEADER_SIZE;
+}
+
+static unsigned ArenaAlign(unsigned Size)
+{
+	// every block can hold a free list entry
+	return max((Size+15)&~15u, (unsigned)sizeof(CDatafileArenaFree));
+}
+
+static void ArenaPushFree(CDatafileArena *pArena, char *pData, unsigned Size)
+{
+	CDatafileArenaFree *pFree = (CDatafileArenaFree *)pData;
+	pFree->m_pNext = pArena->m_pFree;
+	pFree->m_Size = Size;
+	pArena->m_pFree = pFree;
+}
+
+static char *ArenaAlloc(CDatafileArena *pArena, unsigned Size)
+{
+	Size = ArenaAlign(Size);
+
+	// first fit from the freed blocks, what is left of a bigger one stays free
+	for(CDatafileArenaFree **ppFree = &pArena->m_pFree; *ppFree; ppFree = &(*ppFree)->m_pNext)
+	{
+		CDatafileArenaFree *pFree = *ppFree;
+		if(pFree->m_Size < Size)
+			continue;
+		*ppFree = pFree->m_pNext;
+		if(pFree->m_Size-Size >= ARENA_MIN_SPLIT)
+			ArenaPushFree(pArena, (char *)pFree+Size, pFree->m_Size-Size);
+		return (char *)pFree;
+	}
+
+	CDatafileArenaChunk *pTop = pArena->m_pTop;
+	if(pTop && pTop->m_Size-pTop->m_Used >= Size)
+	{
+		char *pData = ArenaData(pTop)+pTop->m_Used;
+		pTop->m_Used += Size;
+		return pData;
+	}
+
+	CDatafileArenaChunk *pChunk = (CDatafileArenaChunk *)mem_alloc(ARENA_HEADER_SIZE+max(Size, (unsigned)ARENA_CHUNK_SIZE), 16);
+	pChunk->m_Size = max(Size, (unsigned)ARENA_CHUNK_SIZE);
+	pChunk->m_Used = Size;
+	if(pTop && Size >= ARENA_CHUNK_SIZE)
+	{
+		// big blocks get their own chunk below the top one, so the top one keeps filling up
+		pChunk->m_pPrev = pTop->m_pPrev;
+		pTop->m_pPrev = pChunk;
+	}
+	else
+	{
+		pChunk->m_pPrev = pTop;
+		pArena->m_pTop = pChunk;
+	}
+	return ArenaData(pChunk);
+}
+
+static void ArenaFree(CDatafileArena *pArena, char *pData, unsigned Size)
+{
+	Size = ArenaAlign(Size);
+	for(CDatafileArenaChunk **ppChunk = &pArena->m_pTop; *ppChunk; ppChunk = &(*ppChunk)->m_pPrev)
+	{
+		CDatafileArenaChunk *pChunk = *ppChunk;
+		if(pData < ArenaData(pChunk) || pData >= ArenaData(pChunk)+pChunk->m_Size)
+			continue;
+
+		if(pData+Size != ArenaData(pChunk)+pChunk->m_Used)
+		{
+			ArenaPushFree(pArena, pData, Size);
+			return;
+		}
+
+		// the last block of a chunk shrinks it, together with the free blocks that end up at its end
+		pChunk->m_Used -= Size;
+		for(CDatafileArenaFree **ppFree = &pArena->m_pFree; *ppFree && pChunk->m_Used;)
+		{
+			CDatafileArenaFree *pFree = *ppFree;
+			if((char *)pFree+pFree->m_Size == ArenaData(pChunk)+pChunk->m_Used)
+			{
+				*ppFree = pFree->m_pNext;
+				pChunk->m_Used -= pFree->m_Size;
+				ppFree = &pArena->m_pFree;
+			}
+			else
+				ppFree = &pFree->m_pNext;
+		}
+		if(pChunk->m_Used == 0 && pChunk != pArena->m_pTop)
+		{
+			*ppChunk = pChunk->m_pPrev;
+			mem_free(pChunk);
+		}
+		return;
+	}
+}
+
+static void ArenaDestroy(CDatafileArena *pArena)
+{
+	while(pArena->m_pTop)
+	{
+		CDatafileArenaChunk *pPrev = pArena->m_pTop->m_pPrev;
+		mem_free(pArena->m_pTop);
+		pArena->m_pTop = pPrev;
+	}
+	pArena->m_pFree = 0;
+}
+
+struct CItemSlot
+{
+	int m_Type;
+	int m_ID;
+	int m_Index;
+};
+
 struct CDatafile
 {
 	IOHANDLE m_File;
+	unsigned char *m_pFileData; // set instead of m_File when opened from memory
+	unsigned m_FileSize;
+	CDatafileArena m_Arena;
+
+	// open addressing tables, slots hold index+1 of the item type or item
+	int *m_pTypeHash;
+	struct CItemSlot *m_pItemHash;
+	unsigned m_TypeHashMask;
+	unsigned m_ItemHashMask;
+
 	unsigned m_Crc;
 	CDatafileInfo m_Info;
 	CDatafileHeader m_Header;
@@ -79,7 +232,16 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 
 	// take the CRC of the file and store it
+	// a mapping saves copying the file, it is dropped right away since the file can change while it is open
 	unsigned Crc = 0;
+	unsigned MapSize;
+	void *pMap = io_map(File, &MapSize);
+	if(pMap)
+	{
+		Crc = crc32(0, (const Bytef *)pMap, MapSize); // ignore_convention
+		io_unmap(pMap, MapSize);
+	}
+	else
 	{
 		enum
 		{
@@ -99,10 +261,79 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		io_seek(File, 0, IOSEEK_START);
 	}
 
+	if(!OpenImpl(File, 0, 0, Crc))
+	{
+		io_close(File);
+		return false;
+	}
 
+	dbg_msg("datafile", "loading done. datafile='%s'", pFilename);
+	return true;
+}
+
+bool CDataFileReader::OpenMem(const void *pData, unsigned Size, unsigned Crc)
+{
+	// the memory stays untouched, tables are copied and data blocks go to the arena
+	return OpenImpl(0, (unsigned char *)pData, Size, Crc);
+}
+
+// reads from the file or the memory the datafile is opened from
+static unsigned DatafileRead(IOHANDLE File, const unsigned char *pFileData, unsigned FileSize, unsigned Offset, void *pBuffer, unsigned Size)
+{
+	if(!pFileData)
+	{
+		io_seek(File, Offset, IOSEEK_START);
+		return io_read(File, pBuffer, Size);
+	}
+
+	if(Offset >= FileSize)
+		return 0;
+	if(Size > FileSize-Offset)
+		Size = FileSize-Offset;
+	mem_copy(pBuffer, pFileData+Offset, Size);
+	return Size;
+}
+
+// the writer puts the items of each type in one block, together the blocks cover the item table exactly once.
+// the item index relies on that, overlapping ranges would overfill it
+static bool ValidItemTypes(const CDatafileItemType *pTypes, int NumTypes, int NumItems)
+{
+	if(NumTypes < 0 || NumItems < 0)
+		return false;
+
+	char *pUsed = (char *)mem_alloc(max(NumItems, 1), 1);
+	mem_zero(pUsed, max(NumItems, 1));
+	int Total = 0;
+	bool Valid = true;
+	for(int i = 0; i < NumTypes && Valid; i++)
+	{
+		int Start = pTypes[i].m_Start;
+		int Num = pTypes[i].m_Num;
+		if(Start < 0 || Num < 0 || Start > NumItems || Num > NumItems-Start)
+		{
+			Valid = false;
+			break;
+		}
+		for(int k = Start; k < Start+Num; k++)
+		{
+			if(pUsed[k])
+			{
+				Valid = false;
+				break;
+			}
+			pUsed[k] = 1;
+		}
+		Total += Num;
+	}
+	mem_free(pUsed);
+	return Valid && Total == NumItems;
+}
+
+bool CDataFileReader::OpenImpl(IOHANDLE File, unsigned char *pFileData, unsigned FileSize, unsigned Crc)
+{
 	// TODO: change this header
 	CDatafileHeader Header;
-	if (sizeof(Header) != io_read(File, &Header, sizeof(Header)))
+	if (sizeof(Header) != DatafileRead(File, pFileData, FileSize, 0, &Header, sizeof(Header)))
 	{
 		dbg_msg("datafile", "couldn't load header");
 		return 0;
@@ -143,16 +374,21 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_ppDataPtrs = (char**)(pTmpDataFile+1);
 	pTmpDataFile->m_pData = (char *)(pTmpDataFile+1)+Header.m_NumRawData*sizeof(char *);
 	pTmpDataFile->m_File = File;
+	pTmpDataFile->m_pFileData = pFileData;
+	pTmpDataFile->m_FileSize = FileSize;
+	pTmpDataFile->m_Arena.m_pTop = 0;
+	pTmpDataFile->m_Arena.m_pFree = 0;
+	pTmpDataFile->m_pTypeHash = 0;
+	pTmpDataFile->m_pItemHash = 0;
 	pTmpDataFile->m_Crc = Crc;
 
 	// clear the data pointers
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData*sizeof(void*));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	unsigned ReadSize = DatafileRead(File, pFileData, FileSize, sizeof(CDatafileHeader), pTmpDataFile->m_pData, Size);
 	if(ReadSize != Size)
 	{
-		io_close(pTmpDataFile->m_File);
 		mem_free(pTmpDataFile);
 		pTmpDataFile = 0;
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
@@ -185,7 +421,16 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		m_pDataFile->m_Info.m_pItemStart = (char *)&m_pDataFile->m_Info.m_pDataOffsets[m_pDataFile->m_Header.m_NumRawData];
 	m_pDataFile->m_Info.m_pDataStart = m_pDataFile->m_Info.m_pItemStart + m_pDataFile->m_Header.m_ItemSize;
 
-	dbg_msg("datafile", "loading done. datafile='%s'", pFilename);
+	if(!ValidItemTypes(m_pDataFile->m_Info.m_pItemTypes, m_pDataFile->m_Header.m_NumItemTypes, m_pDataFile->m_Header.m_NumItems))
+	{
+		dbg_msg("datafile", "invalid item types. num_types=%d num_items=%d", m_pDataFile->m_Header.m_NumItemTypes, m_pDataFile->m_Header.m_NumItems);
+		// the caller owns the file on failure
+		m_pDataFile->m_File = 0;
+		Close();
+		return false;
+	}
+
+	BuildIndex();
 
 	if(DEBUG)
 	{
@@ -291,8 +536,35 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 #if defined(CONF_ARCH_ENDIAN_BIG)
 		int SwapSize = DataSize;
 #endif
+		unsigned Offset = m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index];
+
+		if(m_pDataFile->m_pFileData)
+		{
+			// read straight from memory, don't go past its end
+			const unsigned char *pSrc = m_pDataFile->m_pFileData+Offset;
+			int Available = Offset < m_pDataFile->m_FileSize ? m_pDataFile->m_FileSize-Offset : 0;
+
+			if(m_pDataFile->m_Header.m_Version == 4)
+			{
+				// inflate into the arena
+				unsigned long UncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
+				unsigned long s = UncompressedSize;
 
-		if(m_pDataFile->m_Header.m_Version == 4)
+				dbg_msg("datafile", "loading data index=%d size=%d uncompressed=%d", Index, DataSize, UncompressedSize);
+				m_pDataFile->m_ppDataPtrs[Index] = ArenaAlloc(&m_pDataFile->m_Arena, UncompressedSize);
+				uncompress((Bytef*)m_pDataFile->m_ppDataPtrs[Index], &s, (const Bytef*)pSrc, min(DataSize, Available)); // ignore_convention
+#if defined(CONF_ARCH_ENDIAN_BIG)
+				SwapSize = s;
+#endif
+			}
+			else
+			{
+				dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
+				m_pDataFile->m_ppDataPtrs[Index] = ArenaAlloc(&m_pDataFile->m_Arena, DataSize);
+				DatafileRead(0, m_pDataFile->m_pFileData, m_pDataFile->m_FileSize, Offset, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			}
+		}
+		else if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
 			void *pTemp = (char *)mem_alloc(DataSize, 1);
@@ -303,8 +575,7 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(UncompressedSize, 1);
 
 			// read the compressed data
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, pTemp, DataSize);
+			DatafileRead(m_pDataFile->m_File, 0, 0, Offset, pTemp, DataSize);
 
 			// decompress the data, TODO: check for errors
 			s = UncompressedSize;
@@ -321,8 +592,7 @@ void *CDataFileReader::GetDataImpl(int Index, int Swap)
 			// load the data
 			dbg_msg("datafile", "loading data index=%d size=%d", Index, DataSize);
 			m_pDataFile->m_ppDataPtrs[Index] = (char *)mem_alloc(DataSize, 1);
-			io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset+m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START);
-			io_read(m_pDataFile->m_File, m_pDataFile->m_ppDataPtrs[Index], DataSize);
+			DatafileRead(m_pDataFile->m_File, 0, 0, Offset, m_pDataFile->m_ppDataPtrs[Index], DataSize);
 		}
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
@@ -349,8 +619,14 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0)
 		return;
 
-	//
-	mem_free(m_pDataFile->m_ppDataPtrs[Index]);
+	char *pData = m_pDataFile->m_ppDataPtrs[Index];
+	if(m_pDataFile->m_pFileData)
+	{
+		if(pData)
+			ArenaFree(&m_pDataFile->m_Arena, pData, m_pDataFile->m_Header.m_Version == 4 ? GetUncompressedDataSize(Index) : GetDataSize(Index));
+	}
+	else
+		mem_free(pData);
 	m_pDataFile->m_ppDataPtrs[Index] = 0x0;
 }
 
@@ -374,6 +650,92 @@ void *CDataFileReader::GetItem(int Index, int *pType, int *pID)
 	return (void *)(i+1);
 }
 
+static unsigned HashSize(int Num)
+{
+	unsigned Size = 16;
+	while(Size < (unsigned)Num*2)
+		Size <<= 1;
+	return Size;
+}
+
+static unsigned HashKey(unsigned Key)
+{
+	Key ^= Key>>16;
+	Key *= 0x45d9f3b;
+	Key ^= Key>>16;
+	return Key;
+}
+
+void CDataFileReader::BuildIndex()
+{
+	int NumTypes = max(m_pDataFile->m_Header.m_NumItemTypes, 0);
+	int NumItems = max(m_pDataFile->m_Header.m_NumItems, 0);
+	unsigned TypeHashSize = HashSize(NumTypes);
+	unsigned ItemHashSize = HashSize(NumItems);
+
+	m_pDataFile->m_pTypeHash = (int *)mem_alloc(TypeHashSize*sizeof(int)+ItemHashSize*sizeof(CItemSlot), 1);
+	m_pDataFile->m_pItemHash = (CItemSlot *)(m_pDataFile->m_pTypeHash+TypeHashSize);
+	m_pDataFile->m_TypeHashMask = TypeHashSize-1;
+	m_pDataFile->m_ItemHashMask = ItemHashSize-1;
+	mem_zero(m_pDataFile->m_pTypeHash, TypeHashSize*sizeof(int)+ItemHashSize*sizeof(CItemSlot));
+
+	// the first entry wins, like the linear search did
+	for(int i = 0; i < NumTypes; i++)
+	{
+		int Type = m_pDataFile->m_Info.m_pItemTypes[i].m_Type;
+		unsigned Slot = HashKey(Type)&m_pDataFile->m_TypeHashMask;
+		while(m_pDataFile->m_pTypeHash[Slot] && m_pDataFile->m_Info.m_pItemTypes[m_pDataFile->m_pTypeHash[Slot]-1].m_Type != Type)
+			Slot = (Slot+1)&m_pDataFile->m_TypeHashMask;
+		if(!m_pDataFile->m_pTypeHash[Slot])
+			m_pDataFile->m_pTypeHash[Slot] = i+1;
+	}
+
+	// items are only found through the range of their type, index exactly those
+	for(int i = 0; i < NumTypes; i++)
+	{
+		if(m_pDataFile->m_pTypeHash[FindTypeSlot(m_pDataFile->m_Info.m_pItemTypes[i].m_Type)] != i+1)
+			continue;
+
+		int Type = m_pDataFile->m_Info.m_pItemTypes[i].m_Type;
+		int Start = m_pDataFile->m_Info.m_pItemTypes[i].m_Start;
+		int Num = m_pDataFile->m_Info.m_pItemTypes[i].m_Num;
+		for(int k = Start; k < Start+Num && k < NumItems; k++)
+		{
+			if(k < 0)
+				continue;
+			int ID;
+			GetItem(k, 0, &ID);
+			CItemSlot *pSlot = FindItemSlot(Type, ID);
+			if(!pSlot->m_Index)
+			{
+				pSlot->m_Type = Type;
+				pSlot->m_ID = ID;
+				pSlot->m_Index = k+1;
+			}
+		}
+	}
+}
+
+CItemSlot *CDataFileReader::FindItemSlot(int Type, int ID)
+{
+	unsigned Slot = HashKey((unsigned)Type*31+ID)&m_pDataFile->m_ItemHashMask;
+	CItemSlot *pSlot = &m_pDataFile->m_pItemHash[Slot];
+	while(pSlot->m_Index && (pSlot->m_Type != Type || pSlot->m_ID != ID))
+	{
+		Slot = (Slot+1)&m_pDataFile->m_ItemHashMask;
+		pSlot = &m_pDataFile->m_pItemHash[Slot];
+	}
+	return pSlot;
+}
+
+unsigned CDataFileReader::FindTypeSlot(int Type)
+{
+	unsigned Slot = HashKey(Type)&m_pDataFile->m_TypeHashMask;
+	while(m_pDataFile->m_pTypeHash[Slot] && m_pDataFile->m_Info.m_pItemTypes[m_pDataFile->m_pTypeHash[Slot]-1].m_Type != Type)
+		Slot = (Slot+1)&m_pDataFile->m_TypeHashMask;
+	return Slot;
+}
+
 void CDataFileReader::GetType(int Type, int *pStart, int *pNum)
 {
 	*pStart = 0;
@@ -382,14 +744,11 @@ void CDataFileReader::GetType(int Type, int *pStart, int *pNum)
 	if(!m_pDataFile)
 		return;
 
-	for(int i = 0; i < m_pDataFile->m_Header.m_NumItemTypes; i++)
+	int Index = m_pDataFile->m_pTypeHash[FindTypeSlot(Type)];
+	if(Index)
 	{
-		if(m_pDataFile->m_Info.m_pItemTypes[i].m_Type == Type)
-		{
-			*pStart = m_pDataFile->m_Info.m_pItemTypes[i].m_Start;
-			*pNum = m_pDataFile->m_Info.m_pItemTypes[i].m_Num;
-			return;
-		}
+		*pStart = m_pDataFile->m_Info.m_pItemTypes[Index-1].m_Start;
+		*pNum = m_pDataFile->m_Info.m_pItemTypes[Index-1].m_Num;
 	}
 }
 
@@ -397,16 +756,10 @@ void *CDataFileReader::FindItem(int Type, int ID)
 {
 	if(!m_pDataFile) return 0;
 
-	int Start, Num;
-	GetType(Type, &Start, &Num);
-	for(int i = 0; i < Num; i++)
-	{
-		int ItemID;
-		void *pItem = GetItem(Start+i,0, &ItemID);
-		if(ID == ItemID)
-			return pItem;
-	}
-	return 0;
+	CItemSlot *pSlot = FindItemSlot(Type, ID);
+	if(!pSlot->m_Index)
+		return 0;
+	return GetItem(pSlot->m_Index-1, 0, 0);
 }
 
 int CDataFileReader::NumItems()
@@ -421,16 +774,31 @@ bool CDataFileReader::Close()
 		return true;
 
 	// free the data that is loaded
-	int i;
-	for(i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
-		mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	if(m_pDataFile->m_pFileData)
+		ArenaDestroy(&m_pDataFile->m_Arena);
+	else
+	{
+		for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+			mem_free(m_pDataFile->m_ppDataPtrs[i]);
+	}
 
-	io_close(m_pDataFile->m_File);
+	mem_free(m_pDataFile->m_pTypeHash);
+	if(m_pDataFile->m_File)
+		io_close(m_pDataFile->m_File);
 	mem_free(m_pDataFile);
 	m_pDataFile = 0;
 	return true;
 }
 
+void CDataFileReader::MoveFrom(CDataFileReader *pOther)
+{
+	if(pOther == this)
+		return;
+	Close();
+	m_pDataFile = pOther->m_pDataFile;
+	pOther->m_pDataFile = 0;
+}
+
 unsigned CDataFileReader::Crc()
 {
 	if(!m_pDataFile) return 0xFFFFFFFF;
@@ -441,6 +809,8 @@ unsigned CDataFileReader::Crc()
 CDataFileWriter::CDataFileWriter()
 {
 	m_File = 0;
+	m_pJobPool = 0;
+	m_NumDatas = 0;
 	m_pItemTypes = static_cast<CItemTypeInfo *>(mem_alloc(sizeof(CItemTypeInfo) * MAX_ITEM_TYPES, 1));
 	m_pItems = static_cast<CItemInfo *>(mem_alloc(sizeof(CItemInfo) * MAX_ITEMS, 1));
 	m_pDatas = static_cast<CDataInfo *>(mem_alloc(sizeof(CDataInfo) * MAX_DATAS, 1));
@@ -448,6 +818,7 @@ CDataFileWriter::CDataFileWriter()
 
 CDataFileWriter::~CDataFileWriter()
 {
+	WaitForData();
 	mem_free(m_pItemTypes);
 	m_pItemTypes = 0;
 	mem_free(m_pItems);
@@ -518,26 +889,45 @@ int CDataFileWriter::AddItem(int Type, int ID, int Size, void *pData)
 	return m_NumItems-1;
 }
 
-int CDataFileWriter::AddData(int Size, void *pData)
+int CDataFileWriter::CompressJob(void *pUser)
 {
-	dbg_assert(m_NumDatas < 1024, "too much data");
-
-	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
-	unsigned long s = compressBound(Size);
+	CDataInfo *pInfo = (CDataInfo *)pUser;
+	unsigned long s = compressBound(pInfo->m_UncompressedSize);
 	void *pCompData = mem_alloc(s, 1); // temporary buffer that we use during compression
 
-	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pData, Size); // ignore_convention
+	int Result = compress((Bytef*)pCompData, &s, (Bytef*)pInfo->m_pUncompressedData, pInfo->m_UncompressedSize); // ignore_convention
 	if(Result != Z_OK)
 	{
 		dbg_msg("datafile", "compression error %d", Result);
 		dbg_assert(0, "zlib error");
 	}
 
-	pInfo->m_UncompressedSize = Size;
 	pInfo->m_CompressedSize = (int)s;
 	pInfo->m_pCompressedData = mem_alloc(pInfo->m_CompressedSize, 1);
 	mem_copy(pInfo->m_pCompressedData, pCompData, pInfo->m_CompressedSize);
 	mem_free(pCompData);
+	return 0;
+}
+
+int CDataFileWriter::AddData(int Size, void *pData)
+{
+	dbg_assert(m_NumDatas < 1024, "too much data");
+
+	CDataInfo *pInfo = &m_pDatas[m_NumDatas];
+	pInfo->m_UncompressedSize = Size;
+	if(m_pJobPool)
+	{
+		// the caller may free its data right away, keep a copy until the job is done
+		pInfo->m_pUncompressedData = mem_alloc(max(Size, 1), 1);
+		mem_copy(pInfo->m_pUncompressedData, pData, Size);
+		m_pJobPool->Add(&pInfo->m_Job, CompressJob, pInfo, &m_CompressJobs);
+	}
+	else
+	{
+		pInfo->m_pUncompressedData = pData;
+		CompressJob(pInfo);
+		pInfo->m_pUncompressedData = 0;
+	}
 
 	m_NumDatas++;
 	return m_NumDatas-1;
@@ -560,8 +950,23 @@ int CDataFileWriter::AddDataSwapped(int Size, void *pData)
 }
 
 
+void CDataFileWriter::WaitForData()
+{
+	m_CompressJobs.Wait();
+	for(int i = 0; i < m_NumDatas; i++)
+	{
+		if(!m_pDatas[i].m_pUncompressedData)
+			continue;
+		mem_free(m_pDatas[i].m_pUncompressedData);
+		m_pDatas[i].m_pUncompressedData = 0;
+	}
+}
+
 int CDataFileWriter::Finish()
 {
+	// gather the compressed data
+	WaitForData();
+
 	if(!m_File) return 1;
 
 	int ItemSize = 0;
@@ -3,11 +3,19 @@
 #ifndef ENGINE_SHARED_DATAFILE_H
 #define ENGINE_SHARED_DATAFILE_H
 
+#include <base/system.h>
+
+#include "jobs.h"
+
 // raw datafile access
 class CDataFileReader
 {
 	struct CDatafile *m_pDataFile;
 	void *GetDataImpl(int Index, int Swap);
+	bool OpenImpl(IOHANDLE File, unsigned char *pFileData, unsigned FileSize, unsigned Crc);
+	void BuildIndex();
+	unsigned FindTypeSlot(int Type);
+	struct CItemSlot *FindItemSlot(int Type, int ID);
 public:
 	CDataFileReader() : m_pDataFile(0) {}
 	~CDataFileReader() { Close(); }
@@ -15,7 +23,11 @@ public:
 	bool IsOpen() const { return m_pDataFile != 0; }
 
 	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// reads from a complete map file in memory, the memory has to outlive the reader
+	bool OpenMem(const void *pData, unsigned Size, unsigned Crc);
 	bool Close();
+	// takes over the datafile opened by pOther
+	void MoveFrom(CDataFileReader *pOther);
 
 	static bool GetCrcSize(class IStorage *pStorage, const char *pFilename, int StorageType, unsigned *pCrc, unsigned *pSize);
 
@@ -43,6 +55,10 @@ class CDataFileWriter
 		int m_UncompressedSize;
 		int m_CompressedSize;
 		void *m_pCompressedData;
+
+		// pending compression when a job pool is set
+		void *m_pUncompressedData;
+		CJob m_Job;
 	};
 
 	struct CItemInfo
@@ -76,6 +92,11 @@ class CDataFileWriter
 	CItemTypeInfo *m_pItemTypes;
 	CItemInfo *m_pItems;
 	CDataInfo *m_pDatas;
+	CJobPool *m_pJobPool;
+	CJobGroup m_CompressJobs;
+
+	static int CompressJob(void *pUser);
+	void WaitForData();
 
 public:
 	CDataFileWriter();
@@ -83,6 +104,8 @@ public:
 	void Init();
 	bool OpenFile(class IStorage *pStorage, const char *pFilename);
 	bool Open(class IStorage *pStorage, const char *Filename);
+	// compress data blocks on the pool, Finish waits for them and keeps the order
+	void SetJobPool(CJobPool *pPool) { m_pJobPool = pPool; }
 	int AddData(int Size, void *pData);
 	int AddDataSwapped(int Size, void *pData);
 	int AddItem(int Type, int ID, int Size, void *pData);
@@ -2,6 +2,7 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -20,14 +21,30 @@ static const unsigned char gs_OldVersion = 3;
 static const unsigned char gs_VersionTickCompression = 5; // demo files with this version or higher will use `CHUNKTICKFLAG_TICK_COMPRESSED`
 static const int gs_LengthOffset = 152;
 static const int gs_NumMarkersOffset = 176;
+static const int gs_IndexMagic = ('T'<<24)|('W'<<16)|('I'<<8)|'X';
+static const int gs_IndexVersion = 1;
 
 
 CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool DelayedMapData)
+{
+	Init(pSnapshotDelta, DelayedMapData);
+}
+
+void CDemoRecorder::Init(class CSnapshotDelta *pSnapshotDelta, bool DelayedMapData)
 {
 	m_File = 0;
 	m_LastTickMarker = -1;
+	m_FirstRecordedTick = -1;
+	m_LastRecordedTick = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
+	m_pfnSnapshotFilter = 0;
 	m_DelayedMapData = DelayedMapData;
+	m_pKeyFrames = 0;
+	m_NumKeyFrames = 0;
+	m_KeyFrameCapacity = 0;
+	m_pJobPool = 0;
+	m_pQueue = 0;
+	m_QueueSize = 0;
 }
 
 // Record
@@ -127,7 +144,24 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
 	m_FirstTick = -1;
+	m_FirstRecordedTick = -1;
+	m_LastRecordedTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_NumKeyFrames = 0;
+
+	if(m_pJobPool && g_Config.m_DemoWriteBuffer)
+	{
+		// a power of two that holds at least two full snapshots
+		m_QueueSize = 4*CSnapshot::MAX_SIZE;
+		while(m_QueueSize < (unsigned)g_Config.m_DemoWriteBuffer*1024)
+			m_QueueSize <<= 1;
+		m_pQueue = (unsigned char *)mem_alloc(m_QueueSize, 1);
+		m_QueueWrite = 0;
+		m_QueueRead = 0;
+		m_QueuePeak = 0;
+		m_NumDroppedSnapshots = 0;
+		m_NumQueueStalls = 0;
+	}
 
 	char aBuf[256];
 	str_format(aBuf, sizeof(aBuf), "Recording to '%s'", pFilename);
@@ -160,11 +194,19 @@ enum
 	CHUNKMASK_TYPE = 0x60,
 	CHUNKMASK_SIZE = 0x1f,
 
+	CHUNKTYPE_INDEX = 0, // only as last chunk of the file, older players ignore it
 	CHUNKTYPE_SNAPSHOT = 1,
 	CHUNKTYPE_MESSAGE = 2,
 	CHUNKTYPE_DELTA = 3,
 
-	CHUNKFLAG_BIGSIZE = 0x10
+	CHUNKFLAG_BIGSIZE = 0x10,
+
+	// the keyframe index: magic, version, first tick, last tick, number of keyframes
+	// and then tick and file position of every keyframe relative to the one before
+	INDEX_HEADER_SIZE = 5,
+	MAX_INDEX_SIZE = 32*1024,
+	MAX_INDEX_KEYFRAMES = (MAX_INDEX_SIZE/sizeof(int)-INDEX_HEADER_SIZE)/2,
+	MAX_INDEX_CHUNK_SIZE = 0xffff,
 };
 
 void CDemoRecorder::WriteTickMarker(int Tick, int Keyframe)
@@ -242,11 +284,229 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	io_write(m_File, aBuffer2, Size);
 }
 
-void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+void CDemoRecorder::AddKeyFrame(int Tick)
+{
+	if(m_NumKeyFrames < 0)
+		return;
+
+	if(m_NumKeyFrames == MAX_INDEX_KEYFRAMES)
+	{
+		// the player has to scan this demo
+		m_NumKeyFrames = -1;
+		return;
+	}
+
+	if(m_NumKeyFrames == m_KeyFrameCapacity)
+	{
+		int NewCapacity = min(max(m_KeyFrameCapacity*2, 64), (int)MAX_INDEX_KEYFRAMES);
+		CKeyFrame *pNewKeyFrames = (CKeyFrame *)mem_alloc(NewCapacity*sizeof(CKeyFrame), 1);
+		if(m_pKeyFrames)
+		{
+			mem_copy(pNewKeyFrames, m_pKeyFrames, m_NumKeyFrames*sizeof(CKeyFrame));
+			mem_free(m_pKeyFrames);
+		}
+		m_pKeyFrames = pNewKeyFrames;
+		m_KeyFrameCapacity = NewCapacity;
+	}
+
+	m_pKeyFrames[m_NumKeyFrames].m_Filepos = io_tell(m_File);
+	m_pKeyFrames[m_NumKeyFrames].m_Tick = Tick;
+	m_NumKeyFrames++;
+}
+
+void CDemoRecorder::WriteIndex()
+{
+	if(m_NumKeyFrames <= 0)
+		return;
+
+	int aIndex[MAX_INDEX_SIZE/sizeof(int)];
+	unsigned char aPacked[MAX_INDEX_SIZE/sizeof(int)*5];
+	unsigned char aCompressed[MAX_INDEX_CHUNK_SIZE];
+	int Num = 0;
+
+	aIndex[Num++] = gs_IndexMagic;
+	aIndex[Num++] = gs_IndexVersion;
+	aIndex[Num++] = m_FirstTick;
+	aIndex[Num++] = m_LastTickMarker;
+	aIndex[Num++] = m_NumKeyFrames;
+
+	long LastFilepos = 0;
+	int LastTick = 0;
+	for(int i = 0; i < m_NumKeyFrames; i++)
+	{
+		aIndex[Num++] = m_pKeyFrames[i].m_Tick-LastTick;
+		aIndex[Num++] = (int)(m_pKeyFrames[i].m_Filepos-LastFilepos);
+		LastTick = m_pKeyFrames[i].m_Tick;
+		LastFilepos = m_pKeyFrames[i].m_Filepos;
+	}
+
+	int Size = CVariableInt::Compress(aIndex, Num*sizeof(int), aPacked);
+	Size = CNetBase::Compress(aPacked, Size, aCompressed, sizeof(aCompressed));
+	if(Size <= 0)
+		return;
+
+	// always use the long size so the player can find the chunk from the end of the file
+	unsigned char aChunk[3];
+	aChunk[0] = ((CHUNKTYPE_INDEX&0x3)<<5) | 31;
+	aChunk[1] = Size&0xff;
+	aChunk[2] = Size>>8;
+	io_write(m_File, aChunk, sizeof(aChunk));
+	io_write(m_File, aCompressed, Size);
+}
+
+bool CDemoRecorder::Queue(int Type, int Tick, const void *pData, int Size, const void *pIndex, int IndexSize, bool Wait)
+{
+	unsigned EntrySize = sizeof(CQueueEntry) + ((Size+3)&~3) + IndexSize;
+	unsigned Write = m_QueueWrite;
+	unsigned Offset;
+	unsigned Pad;
+	bool Stalled = false;
+
+	while(1)
+	{
+		unsigned Read = m_QueueRead;
+		Offset = Write&(m_QueueSize-1);
+
+		// entries are never split, the rest of the buffer is skipped instead
+		Pad = m_QueueSize-Offset < EntrySize ? m_QueueSize-Offset : 0;
+		if(Write-Read+Pad+EntrySize <= m_QueueSize)
+			break;
+
+		if(!Wait)
+			return false;
+
+		if(!Stalled)
+		{
+			m_NumQueueStalls++;
+			Stalled = true;
+		}
+		KickWriter();
+		thread_yield();
+	}
+
+	if(Pad)
+	{
+		// the writer skips rests that are too small for an entry on its own
+		if(Pad >= sizeof(CQueueEntry))
+			((CQueueEntry *)(m_pQueue+Offset))->m_Type = QUEUE_WRAP;
+		Write += Pad;
+		Offset = 0;
+	}
+
+	CQueueEntry *pEntry = (CQueueEntry *)(m_pQueue+Offset);
+	pEntry->m_Type = Type;
+	pEntry->m_Tick = Tick;
+	pEntry->m_Size = Size;
+	pEntry->m_IndexSize = IndexSize;
+	mem_copy(pEntry+1, pData, Size);
+	if(IndexSize)
+		mem_copy((char *)(pEntry+1) + ((Size+3)&~3), pIndex, IndexSize);
+
+	// publish the entry only after its data is in place
+	sync_barrier();
+	m_QueueWrite = Write+EntrySize;
+
+	m_QueuePeak = max(m_QueuePeak, m_QueueWrite-m_QueueRead);
+	KickWriter();
+	return true;
+}
+
+void CDemoRecorder::ProcessQueue()
 {
-	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*5)
+	while(1)
+	{
+		unsigned Read = m_QueueRead;
+		if(Read == m_QueueWrite)
+			break;
+		sync_barrier();
+
+		unsigned Offset = Read&(m_QueueSize-1);
+		CQueueEntry *pEntry = (CQueueEntry *)(m_pQueue+Offset);
+		if(m_QueueSize-Offset < sizeof(CQueueEntry) || pEntry->m_Type == QUEUE_WRAP)
+		{
+			m_QueueRead = Read + m_QueueSize-Offset;
+			continue;
+		}
+
+		int DataSize = (pEntry->m_Size+3)&~3;
+		if(pEntry->m_Type == QUEUE_SNAPSHOT)
+		{
+			const CSnapshotKeyIndex *pIndex = pEntry->m_IndexSize ? (const CSnapshotKeyIndex *)((char *)(pEntry+1) + DataSize) : 0;
+			DoRecordSnapshot(pEntry->m_Tick, pEntry+1, pEntry->m_Size, pIndex);
+		}
+		else
+			Write(CHUNKTYPE_MESSAGE, pEntry+1, pEntry->m_Size);
+
+		// hand the space back only after the data is used
+		sync_barrier();
+		m_QueueRead = Read + sizeof(CQueueEntry) + DataSize + pEntry->m_IndexSize;
+	}
+}
+
+void CDemoRecorder::KickWriter()
+{
+	// a running writer might miss the newest entry, it is picked up with the next one or on stop
+	if(m_WriterJob.Status() == CJob::STATE_DONE)
+		m_pJobPool->Add(&m_WriterJob, WriterJob, this, &m_WriterGroup);
+}
+
+int CDemoRecorder::WriterJob(void *pUser)
+{
+	CDemoRecorder *pThis = (CDemoRecorder *)pUser;
+	pThis->ProcessQueue();
+	return 0;
+}
+
+void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size, const CSnapshotKeyIndex *pIndex)
+{
+	if(!m_File)
+		return;
+
+	if(m_pQueue)
+	{
+		// drop the snapshot if the writer is too far behind, the next one is
+		// stored against the last written one so the demo stays valid
+		int IndexSize = pIndex ? CSnapshotKeyIndex::MemSize(((const CSnapshot *)pData)->NumItems()) : 0;
+		if(!Queue(QUEUE_SNAPSHOT, Tick, pData, Size, pIndex, IndexSize, false))
+		{
+			m_NumDroppedSnapshots++;
+			return;
+		}
+	}
+	else if(m_pfnSnapshotFilter)
+	{
+		// the filter works in place
+		unsigned char aData[CSnapshot::MAX_SIZE];
+		mem_copy(aData, pData, Size);
+		DoRecordSnapshot(Tick, aData, Size, pIndex);
+	}
+	else
+		DoRecordSnapshot(Tick, (void *)pData, Size, pIndex);
+
+	m_LastRecordedTick = Tick;
+	if(m_FirstRecordedTick < 0)
+		m_FirstRecordedTick = Tick;
+}
+
+void CDemoRecorder::DoRecordSnapshot(int Tick, void *pData, int Size, const CSnapshotKeyIndex *pIndex)
+{
+	if(m_pfnSnapshotFilter)
+		m_pfnSnapshotFilter((unsigned char *)pData);
+
+	// the filter keeps the item keys, so the index of the unfiltered snapshot still fits.
+	// the index of the last recorded snapshot is kept, so every snapshot is indexed only once
+	int aIndexData[CSnapshotKeyIndex::MAX_MEMSIZE/sizeof(int)];
+	if(!pIndex)
+	{
+		((CSnapshotKeyIndex *)aIndexData)->Build((CSnapshot *)pData);
+		pIndex = (CSnapshotKeyIndex *)aIndexData;
+	}
+	int IndexSize = CSnapshotKeyIndex::MemSize(((CSnapshot *)pData)->NumItems());
+
+	if(m_LastKeyFrame == -1 || (Tick-m_LastKeyFrame) > SERVER_TICK_SPEED*g_Config.m_DemoKeyframeInterval)
 	{
 		// write full tickmarker
+		AddKeyFrame(Tick);
 		WriteTickMarker(Tick, 1);
 
 		// write snapshot
@@ -254,6 +514,7 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 
 		m_LastKeyFrame = Tick;
 		mem_copy(m_aLastSnapshotData, pData, Size);
+		mem_copy(m_aLastSnapshotIndex, pIndex, IndexSize);
 	}
 	else
 	{
@@ -264,19 +525,28 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 		// write tickmarker
 		WriteTickMarker(Tick, 0);
 
-		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData);
+		DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot*)m_aLastSnapshotData, (CSnapshot*)pData, &aDeltaData,
+			(CSnapshotKeyIndex *)m_aLastSnapshotIndex, pIndex);
 		if(DeltaSize)
 		{
 			// record delta
 			Write(CHUNKTYPE_DELTA, aDeltaData, DeltaSize);
 			mem_copy(m_aLastSnapshotData, pData, Size);
+			mem_copy(m_aLastSnapshotIndex, pIndex, IndexSize);
 		}
 	}
 }
 
 void CDemoRecorder::RecordMessage(const void *pData, int Size)
 {
-	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	if(!m_File)
+		return;
+
+	// messages are never dropped, wait for the writer instead
+	if(m_pQueue)
+		Queue(QUEUE_MESSAGE, m_LastRecordedTick, pData, Size, 0, 0, true);
+	else
+		Write(CHUNKTYPE_MESSAGE, pData, Size);
 }
 
 int CDemoRecorder::Stop(bool Finalize)
@@ -284,6 +554,28 @@ int CDemoRecorder::Stop(bool Finalize)
 	if(!m_File)
 		return -1;
 
+	if(m_pQueue)
+	{
+		// let the writer finish and write what it might have missed
+		m_WriterGroup.Wait();
+		ProcessQueue();
+
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "write buffer peak %d/%d KB, %d snapshots dropped, %d waits for the writer",
+			m_QueuePeak/1024, m_QueueSize/1024, m_NumDroppedSnapshots, m_NumQueueStalls);
+		m_pConsole->Print(m_NumDroppedSnapshots ? IConsole::OUTPUT_LEVEL_STANDARD : IConsole::OUTPUT_LEVEL_ADDINFO, "demo_recorder", aBuf);
+
+		mem_free(m_pQueue);
+		m_pQueue = 0;
+	}
+
+	// append the keyframe index
+	WriteIndex();
+	mem_free(m_pKeyFrames);
+	m_pKeyFrames = 0;
+	m_NumKeyFrames = 0;
+	m_KeyFrameCapacity = 0;
+
 	// add the demo length to the header
 	io_seek(m_File, gs_LengthOffset, IOSEEK_START);
 	int DemoLength = Length();
@@ -328,18 +620,18 @@ int CDemoRecorder::Stop(bool Finalize)
 
 void CDemoRecorder::AddDemoMarker()
 {
-	if(m_LastTickMarker < 0 || m_NumTimelineMarkers >= MAX_TIMELINE_MARKERS)
+	if(m_LastRecordedTick < 0 || m_NumTimelineMarkers >= MAX_TIMELINE_MARKERS)
 		return;
 
 	// not more than 1 marker in a second
 	if(m_NumTimelineMarkers > 0)
 	{
-		int Diff = m_LastTickMarker - m_aTimelineMarkers[m_NumTimelineMarkers-1];
+		int Diff = m_LastRecordedTick - m_aTimelineMarkers[m_NumTimelineMarkers-1];
 		if(Diff < SERVER_TICK_SPEED*1.0f)
 			return;
 	}
 
-	m_aTimelineMarkers[m_NumTimelineMarkers++] = m_LastTickMarker;
+	m_aTimelineMarkers[m_NumTimelineMarkers++] = m_LastRecordedTick;
 
 	m_pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "demo_recorder", "Added timeline marker");
 }
@@ -350,6 +642,7 @@ CDemoPlayer::CDemoPlayer(class CSnapshotDelta *pSnapshotDelta)
 {
 	m_File = 0;
 	m_pKeyFrames = 0;
+	m_SeekTick = -1;
 
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_LastSnapshotDataSize = -1;
@@ -424,6 +717,85 @@ int CDemoPlayer::ReadChunkHeader(int *pType, int *pSize, int *pTick)
 	return 0;
 }
 
+bool CDemoPlayer::LoadIndex()
+{
+	long StartPos = io_tell(m_File);
+	io_seek(m_File, 0, IOSEEK_END);
+	long EndPos = io_tell(m_File);
+	int TailSize = (int)min(EndPos-StartPos, (long)MAX_INDEX_CHUNK_SIZE+3);
+	if(TailSize <= 3)
+	{
+		io_seek(m_File, StartPos, IOSEEK_START);
+		return false;
+	}
+
+	unsigned char *pTail = (unsigned char *)mem_alloc(TailSize, 1);
+	io_seek(m_File, EndPos-TailSize, IOSEEK_START);
+	bool Found = io_read(m_File, pTail, TailSize) == (unsigned)TailSize;
+	io_seek(m_File, StartPos, IOSEEK_START);
+
+	// the index is the last chunk, look for a header whose size ends exactly at the end of the file
+	int *pIndex = 0;
+	int NumInts = 0;
+	for(int p = 0; Found && p < TailSize-3; p++)
+	{
+		int Size = pTail[p+1] | (pTail[p+2]<<8);
+		if(pTail[p] != (((CHUNKTYPE_INDEX&0x3)<<5) | 31) || Size != TailSize-p-3)
+			continue;
+
+		static unsigned char aPacked[MAX_INDEX_SIZE/sizeof(int)*5];
+		int PackedSize = CNetBase::Decompress(pTail+p+3, Size, aPacked, sizeof(aPacked));
+		if(PackedSize < (int)INDEX_HEADER_SIZE)
+			continue;
+
+		pIndex = (int *)mem_alloc(PackedSize*sizeof(int), 1);
+		NumInts = CVariableInt::Decompress(aPacked, PackedSize, pIndex)/sizeof(int);
+		if(NumInts >= INDEX_HEADER_SIZE && pIndex[0] == gs_IndexMagic && pIndex[1] == gs_IndexVersion &&
+			pIndex[4] > 0 && pIndex[4] <= MAX_INDEX_KEYFRAMES && NumInts == INDEX_HEADER_SIZE+pIndex[4]*2)
+			break;
+
+		mem_free(pIndex);
+		pIndex = 0;
+	}
+	mem_free(pTail);
+
+	if(!pIndex)
+		return false;
+
+	int Num = pIndex[4];
+	CKeyFrame *pKeyFrames = (CKeyFrame*)mem_alloc(Num*sizeof(CKeyFrame), 1);
+	long Filepos = 0;
+	int Tick = 0;
+	bool Valid = true;
+	for(int i = 0; i < Num; i++)
+	{
+		int TickDelta = pIndex[INDEX_HEADER_SIZE+i*2];
+		int FileposDelta = pIndex[INDEX_HEADER_SIZE+i*2+1];
+		Tick += TickDelta;
+		Filepos += FileposDelta;
+		if((i > 0 && (TickDelta <= 0 || FileposDelta <= 0)) || Filepos < StartPos || Filepos >= EndPos)
+		{
+			Valid = false;
+			break;
+		}
+		pKeyFrames[i].m_Filepos = Filepos;
+		pKeyFrames[i].m_Tick = Tick;
+	}
+
+	if(Valid)
+	{
+		m_pKeyFrames = pKeyFrames;
+		m_Info.m_SeekablePoints = Num;
+		m_Info.m_Info.m_FirstTick = pIndex[2];
+		m_Info.m_Info.m_LastTick = pIndex[3];
+	}
+	else
+		mem_free(pKeyFrames);
+
+	mem_free(pIndex);
+	return Valid;
+}
+
 void CDemoPlayer::ScanFile()
 {
 	long StartPos;
@@ -496,6 +868,10 @@ void CDemoPlayer::DoTick()
 	m_Info.m_Info.m_CurrentTick = m_Info.m_NextTick;
 	ChunkTick = m_Info.m_Info.m_CurrentTick;
 
+	// while seeking only the snapshots are needed to keep the delta chain intact
+	bool Seeking = m_SeekTick != -1 && m_Info.m_Info.m_CurrentTick < m_SeekTick;
+	IListner *pListner = Seeking ? 0 : m_pListner;
+
 	while(1)
 	{
 		if(ReadChunkHeader(&ChunkType, &ChunkSize, &ChunkTick))
@@ -512,6 +888,14 @@ void CDemoPlayer::DoTick()
 			break;
 		}
 
+		// skip chunks that are not needed without decompressing them
+		if(ChunkSize && !(ChunkType&CHUNKTYPEFLAG_TICKMARKER) &&
+			(ChunkType == CHUNKTYPE_INDEX || (Seeking && ChunkType == CHUNKTYPE_MESSAGE)))
+		{
+			io_skip(m_File, ChunkSize);
+			continue;
+		}
+
 		// read the chunk
 		if(ChunkSize)
 		{
@@ -553,8 +937,8 @@ void CDemoPlayer::DoTick()
 
 			if(DataSize >= 0)
 			{
-				if(m_pListner)
-					m_pListner->OnDemoPlayerSnapshot(aNewsnap, DataSize);
+				if(pListner)
+					pListner->OnDemoPlayerSnapshot(aNewsnap, DataSize);
 
 				m_LastSnapshotDataSize = DataSize;
 				mem_copy(m_aLastSnapshotData, aNewsnap, DataSize);
@@ -573,16 +957,16 @@ void CDemoPlayer::DoTick()
 
 			m_LastSnapshotDataSize = DataSize;
 			mem_copy(m_aLastSnapshotData, aData, DataSize);
-			if(m_pListner)
-				m_pListner->OnDemoPlayerSnapshot(aData, DataSize);
+			if(pListner)
+				pListner->OnDemoPlayerSnapshot(aData, DataSize);
 		}
 		else
 		{
 			// if there were no snapshots in this tick, replay the last one
-			if(!GotSnapshot && m_pListner && m_LastSnapshotDataSize != -1)
+			if(!GotSnapshot && pListner && m_LastSnapshotDataSize != -1)
 			{
 				GotSnapshot = 1;
-				m_pListner->OnDemoPlayerSnapshot(m_aLastSnapshotData, m_LastSnapshotDataSize);
+				pListner->OnDemoPlayerSnapshot(m_aLastSnapshotData, m_LastSnapshotDataSize);
 			}
 
 			// check the remaining types
@@ -593,8 +977,8 @@ void CDemoPlayer::DoTick()
 			}
 			else if(ChunkType == CHUNKTYPE_MESSAGE)
 			{
-				if(m_pListner)
-					m_pListner->OnDemoPlayerMessage(aData, DataSize);
+				if(pListner)
+					pListner->OnDemoPlayerMessage(aData, DataSize);
 			}
 		}
 	}
@@ -640,6 +1024,7 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 	m_Info.m_Info.m_Speed = 1;
 
 	m_LastSnapshotDataSize = -1;
+	m_SeekTick = -1;
 
 	// read the header
 	io_read(m_File, &m_Info.m_Header, sizeof(m_Info.m_Header));
@@ -723,8 +1108,9 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interessting points
-	ScanFile();
+	// get the interessting points from the index or scan the file for them
+	if(!LoadIndex())
+		ScanFile();
 
 	// reset slice markers
 	g_Config.m_ClDemoSliceBegin = -1;
@@ -764,18 +1150,21 @@ int CDemoPlayer::SetPos(float Percent)
 	// -5 because we have to have a current tick and previous tick when we do the playback
 	WantedTick = m_Info.m_Info.m_FirstTick + (int)((m_Info.m_Info.m_LastTick-m_Info.m_Info.m_FirstTick)*Percent) - 5;
 
-	Keyframe = (int)(m_Info.m_SeekablePoints*Percent);
-
-	if(Keyframe < 0 || Keyframe >= m_Info.m_SeekablePoints)
+	if(Percent < 0.0f || Percent > 1.0f || m_Info.m_SeekablePoints <= 0)
 		return -1;
 
-	// get correct key frame
-	if(m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-		while(Keyframe < m_Info.m_SeekablePoints-1 && m_pKeyFrames[Keyframe].m_Tick < WantedTick)
-			Keyframe++;
-
-	while(Keyframe && m_pKeyFrames[Keyframe].m_Tick > WantedTick)
-		Keyframe--;
+	// get the last key frame before the wanted tick
+	int Low = 0;
+	int High = m_Info.m_SeekablePoints-1;
+	while(Low < High)
+	{
+		int Mid = (Low+High+1)/2;
+		if(m_pKeyFrames[Mid].m_Tick <= WantedTick)
+			Low = Mid;
+		else
+			High = Mid-1;
+	}
+	Keyframe = Low;
 
 	// seek to the correct keyframe
 	io_seek(m_File, m_pKeyFrames[Keyframe].m_Filepos, IOSEEK_START);
@@ -785,9 +1174,11 @@ int CDemoPlayer::SetPos(float Percent)
 	m_Info.m_Info.m_CurrentTick = -1;
 	m_Info.m_PreviousTick = -1;
 
-	// playback everything until we hit our tick
+	// playback everything until we hit our tick, ticks before it are not handed out
+	m_SeekTick = WantedTick;
 	while(m_Info.m_PreviousTick < WantedTick && IsPlaying())
 		DoTick();
+	m_SeekTick = -1;
 
 	Play();
 
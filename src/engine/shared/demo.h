@@ -6,39 +6,101 @@
 #include <engine/demo.h>
 #include <engine/shared/protocol.h>
 
+#include "jobs.h"
 #include "snapshot.h"
 
 class CDemoRecorder : public IDemoRecorder
 {
+public:
+	typedef void (*FSnapshotFilter)(unsigned char *pSnapData);
+
+private:
+	struct CKeyFrame
+	{
+		long m_Filepos;
+		int m_Tick;
+	};
+
+	// with a job pool the recording thread only copies the data into a single
+	// producer, single consumer queue and a pool worker compresses and writes it
+	enum
+	{
+		QUEUE_SNAPSHOT=0,
+		QUEUE_MESSAGE,
+		QUEUE_WRAP,
+	};
+
+	struct CQueueEntry
+	{
+		int m_Type;
+		int m_Tick;
+		int m_Size;
+		int m_IndexSize; // key index of a snapshot, follows the data
+	};
+
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
+	int m_FirstRecordedTick;
+	int m_LastRecordedTick;
+
+	// only used by the writer
 	int m_LastTickMarker;
 	int m_LastKeyFrame;
 	int m_FirstTick;
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
+	int m_aLastSnapshotIndex[CSnapshotKeyIndex::MAX_MEMSIZE/sizeof(int)];
 	class CSnapshotDelta *m_pSnapshotDelta;
+	FSnapshotFilter m_pfnSnapshotFilter;
 	int m_NumTimelineMarkers;
 	int m_aTimelineMarkers[MAX_TIMELINE_MARKERS];
 	bool m_DelayedMapData;
 	unsigned int m_MapSize;
 	unsigned char *m_pMapData;
+	CKeyFrame *m_pKeyFrames;
+	int m_NumKeyFrames; // -1 if there are too many to index
+	int m_KeyFrameCapacity;
+
+	CJobPool *m_pJobPool;
+	CJob m_WriterJob;
+	CJobGroup m_WriterGroup;
+	unsigned char *m_pQueue;
+	unsigned m_QueueSize;
+	volatile unsigned m_QueueWrite; // only changed by the recording thread
+	volatile unsigned m_QueueRead; // only changed by the writer
+	unsigned m_QueuePeak;
+	int m_NumDroppedSnapshots;
+	int m_NumQueueStalls;
 
 	void WriteTickMarker(int Tick, int Keyframe);
 	void Write(int Type, const void *pData, int Size);
+	void AddKeyFrame(int Tick);
+	void WriteIndex();
+	void DoRecordSnapshot(int Tick, void *pData, int Size, const CSnapshotKeyIndex *pIndex);
+
+	bool Queue(int Type, int Tick, const void *pData, int Size, const void *pIndex, int IndexSize, bool Wait);
+	void ProcessQueue();
+	void KickWriter();
+	static int WriterJob(void *pUser);
 public:
 	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool DelayedMapData = false);
 	CDemoRecorder() {}
 
+	void Init(class CSnapshotDelta *pSnapshotDelta, bool DelayedMapData = false);
+
 	int Start(class IStorage *pStorage, class IConsole *pConsole, const char *pFilename, const char *pNetversion, const char *pMap, unsigned MapCrc, const char *pType, unsigned int MapSize = 0, unsigned char *pMapData = 0);
 	int Stop(bool Finalize = false);
 	void AddDemoMarker();
+	// without a pool, like on the client, the demo is written while recording
+	void SetJobPool(CJobPool *pPool) { m_pJobPool = pPool; }
+	void SetSnapshotFilter(FSnapshotFilter pfnFilter) { m_pfnSnapshotFilter = pfnFilter; }
 
-	void RecordSnapshot(int Tick, const void *pData, int Size);
+	// pIndex is an optional key index of the snapshot, it saves building one
+	void RecordSnapshot(int Tick, const void *pData, int Size, const CSnapshotKeyIndex *pIndex = 0);
 	void RecordMessage(const void *pData, int Size);
 
 	bool IsRecording() const { return m_File != 0; }
 
-	int Length() const { return (m_LastTickMarker - m_FirstTick)/SERVER_TICK_SPEED; }
+	int Length() const { return (m_LastRecordedTick - m_FirstRecordedTick)/SERVER_TICK_SPEED; }
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -107,8 +169,11 @@ private:
 	int m_LastSnapshotDataSize;
 	class CSnapshotDelta *m_pSnapshotDelta;
 
+	int m_SeekTick;
+
 	int ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
+	bool LoadIndex();
 	void ScanFile();
 	int NextFrame();
 
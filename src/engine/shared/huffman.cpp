@@ -1,8 +1,17 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdint.h>
+
+#include <base/math.h>
 #include <base/system.h>
 #include "huffman.h"
 
+enum
+{
+	// the decoder refills its bit buffer to at least this many bits while there are 8 input bytes left
+	HUFFMAN_REFILL_BITS = 56,
+};
+
 struct CHuffmanConstructNode
 {
 	unsigned short m_NodeId;
@@ -129,6 +138,48 @@ void CHuffman::Init(const unsigned *pFrequencies)
 			m_apDecodeLut[i] = pNode;
 	}
 
+	BuildDecodeTable();
+}
+
+void CHuffman::BuildDecodeTable()
+{
+	// the fast decoder needs a full table index and the longest code in its buffer
+	m_MinDecodeBits = HUFFMAN_TABLEBITS;
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		m_MinDecodeBits = max(m_MinDecodeBits, m_aNodes[i].m_NumBits);
+
+	// decode as many whole symbols as the table bits allow. eof and codes that
+	// don't fit leave the entry empty, the decoder falls back to the lut for those
+	for(int i = 0; i < HUFFMAN_TABLESIZE; i++)
+	{
+		unsigned Symbols = 0;
+		unsigned NumSymbols = 0;
+		unsigned UsedBits = 0;
+		bool AllZero = true;
+
+		while(1)
+		{
+			CNode *pNode = m_pStartNode;
+			unsigned Depth = UsedBits;
+			while(!pNode->m_NumBits && Depth < HUFFMAN_TABLEBITS)
+				pNode = &m_aNodes[pNode->m_aLeafs[(i>>Depth++)&1]];
+
+			if(!pNode->m_NumBits || pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
+				break;
+			if(NumSymbols >= HUFFMAN_TABLE_MAX_SYMBOLS && !(AllZero && pNode->m_Symbol == 0))
+				break;
+			if(NumSymbols == HUFFMAN_TABLE_MAX_ZEROS)
+				break;
+
+			if(NumSymbols < HUFFMAN_TABLE_MAX_SYMBOLS)
+				Symbols |= pNode->m_Symbol << (NumSymbols*8);
+			AllZero = AllZero && pNode->m_Symbol == 0;
+			NumSymbols++;
+			UsedBits = Depth;
+		}
+
+		m_aDecodeTable[i] = Symbols | (NumSymbols<<HUFFMAN_TABLE_COUNT_SHIFT) | (UsedBits<<HUFFMAN_TABLE_BITS_SHIFT);
+	}
 }
 
 //***************************************************************
@@ -136,7 +187,7 @@ int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int Out
 {
 	// this macro loads a symbol for a byte into bits and bitcount
 #define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
+	Bits |= (uint64_t)m_aNodes[Sym].m_Bits << Bitcount; \
 	Bitcount += m_aNodes[Sym].m_NumBits;
 
 	// this macro writes the symbol stored in bits and bitcount to the dst pointer
@@ -157,28 +208,35 @@ int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int Out
 	unsigned char *pDstEnd = pDst + OutputSize;
 
 	// symbol variables
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	if(OutputSize <= 0)
+		return -1;
+
+	// {A} collect the codes in a 64 bit buffer and write them 32 bits at a time
+	// as long as the output can't run out, the bytes are the same as below
+	while(pSrc != pSrcEnd && pDstEnd - pDst > 4)
 	{
-		// {A} load the first symbol
 		int Symbol = *pSrc++;
-
-		while(pSrc != pSrcEnd)
+		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			pDst[0] = (unsigned char)Bits;
+			pDst[1] = (unsigned char)(Bits>>8);
+			pDst[2] = (unsigned char)(Bits>>16);
+			pDst[3] = (unsigned char)(Bits>>24);
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
+	}
 
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
+	// {B} byte by byte near the end of the output buffer
+	HUFFMAN_MACRO_WRITE()
+	while(pSrc != pSrcEnd)
+	{
+		int Symbol = *pSrc++;
 		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
 		HUFFMAN_MACRO_WRITE()
 	}
@@ -188,7 +246,7 @@ int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int Out
 	HUFFMAN_MACRO_WRITE()
 
 	// write out the last bits
-	*pDst++ = Bits;
+	*pDst++ = (unsigned char)Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
@@ -213,6 +271,77 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 	CNode *pNode = 0;
 
+	// {1} fast path: a 64 bit buffer refilled from 8 input bytes at once and
+	// several symbols per table lookup. it only runs while every code fits into
+	// the buffer and the output has room for the longest table entry, so it
+	// can't fail and leaves the end of the buffers to the exact path below
+	if(m_MinDecodeBits <= HUFFMAN_REFILL_BITS)
+	{
+		uint64_t FastBits = 0;
+		unsigned FastBitcount = 0;
+
+		while(pSrcEnd - pSrc >= 8 && pDstEnd - pDst >= HUFFMAN_TABLE_MAX_ZEROS)
+		{
+			// refill to 56 bits or more, the compiler turns this into a single load where it can
+			uint64_t Value = (uint64_t)pSrc[0] | ((uint64_t)pSrc[1]<<8) | ((uint64_t)pSrc[2]<<16) | ((uint64_t)pSrc[3]<<24) |
+				((uint64_t)pSrc[4]<<32) | ((uint64_t)pSrc[5]<<40) | ((uint64_t)pSrc[6]<<48) | ((uint64_t)pSrc[7]<<56);
+			FastBits |= Value << FastBitcount;
+			pSrc += (63-FastBitcount)>>3;
+			FastBitcount |= HUFFMAN_REFILL_BITS;
+
+			while(FastBitcount >= m_MinDecodeBits && pDstEnd - pDst >= HUFFMAN_TABLE_MAX_ZEROS)
+			{
+				unsigned Entry = m_aDecodeTable[FastBits&HUFFMAN_TABLEMASK];
+				if(Entry)
+				{
+					unsigned NumSymbols = (Entry>>HUFFMAN_TABLE_COUNT_SHIFT)&0xf;
+					unsigned NumBits = Entry>>HUFFMAN_TABLE_BITS_SHIFT;
+					pDst[0] = (unsigned char)Entry;
+					pDst[1] = (unsigned char)(Entry>>8);
+					pDst[2] = (unsigned char)(Entry>>16);
+					for(unsigned k = HUFFMAN_TABLE_MAX_SYMBOLS; k < NumSymbols; k++)
+						pDst[k] = 0;
+					pDst += NumSymbols;
+					FastBits >>= NumBits;
+					FastBitcount -= NumBits;
+					continue;
+				}
+
+				// eof or a long code, one symbol through the lut and the tree
+				pNode = m_apDecodeLut[FastBits&HUFFMAN_LUTMASK];
+				if(pNode->m_NumBits)
+				{
+					FastBits >>= pNode->m_NumBits;
+					FastBitcount -= pNode->m_NumBits;
+				}
+				else
+				{
+					FastBits >>= HUFFMAN_LUTBITS;
+					FastBitcount -= HUFFMAN_LUTBITS;
+					do
+					{
+						pNode = &m_aNodes[pNode->m_aLeafs[FastBits&1]];
+						FastBitcount--;
+						FastBits >>= 1;
+					}
+					while(!pNode->m_NumBits);
+				}
+
+				if(pNode == pEof)
+					return (int)(pDst - (const unsigned char *)pOutput);
+				*pDst++ = pNode->m_Symbol;
+			}
+		}
+
+		// hand the rest to the exact path, starting at the first unused bit
+		pSrc -= (FastBitcount+7)>>3;
+		if(FastBitcount&7)
+		{
+			Bitcount = FastBitcount&7;
+			Bits = (*pSrc++)>>(8-Bitcount);
+		}
+	}
+
 	while(1)
 	{
 		// {A} try to load a node now, this will reduce dependency at location {D}
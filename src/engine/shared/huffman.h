@@ -16,7 +16,18 @@ class CHuffman
 
 		HUFFMAN_LUTBITS = 10,
 		HUFFMAN_LUTSIZE = (1<<HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE-1),
+
+		// multi symbol decode table, 8kb so it stays in the l1 cache next to the lut.
+		// an entry holds up to 3 decoded bytes (or a run of up to 11 zero bytes) in
+		// the low 24 bits, the number of bytes above that and the bits they used on top
+		HUFFMAN_TABLEBITS = 11,
+		HUFFMAN_TABLESIZE = (1<<HUFFMAN_TABLEBITS),
+		HUFFMAN_TABLEMASK = (HUFFMAN_TABLESIZE-1),
+		HUFFMAN_TABLE_MAX_SYMBOLS = 3,
+		HUFFMAN_TABLE_MAX_ZEROS = HUFFMAN_TABLEBITS,
+		HUFFMAN_TABLE_COUNT_SHIFT = 24,
+		HUFFMAN_TABLE_BITS_SHIFT = 28,
 	};
 
 	struct CNode
@@ -34,11 +45,14 @@ class CHuffman
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
 	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	unsigned m_aDecodeTable[HUFFMAN_TABLESIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
+	unsigned m_MinDecodeBits;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
+	void BuildDecodeTable();
 
 public:
 	/*
@@ -1,74 +1,254 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 #include "jobs.h"
 
-CJobPool::CJobPool()
+void CJobGroup::Init()
 {
-	// empty the pool
 	m_Lock = lock_create();
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	semaphore_init(&m_Done);
+	m_NumPending = 0;
+	m_Waiting = false;
 }
 
-void CJobPool::WorkerThread(void *pUser)
+CJobGroup::~CJobGroup()
+{
+	semaphore_destroy(&m_Done);
+	lock_destroy(m_Lock);
+}
+
+int CJobGroup::NumPending() const
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	return m_NumPending;
+}
 
+void CJobGroup::Wait()
+{
+	lock_wait(m_Lock);
+	while(m_NumPending)
+	{
+		// a signal left over from an earlier wait only causes another round
+		m_Waiting = true;
+		lock_unlock(m_Lock);
+		semaphore_wait(&m_Done);
+		lock_wait(m_Lock);
+	}
+	m_Waiting = false;
+	lock_unlock(m_Lock);
+}
+
+void CJobGroup::Finish()
+{
+	// only the last job takes the lock, a waiter can't return before it is released
 	while(1)
 	{
+		unsigned NumPending = m_NumPending;
+		if(NumPending == 1)
+			break;
+		if(atomic_compswap(&m_NumPending, NumPending, NumPending-1) == NumPending)
+			return;
+	}
+
+	lock_wait(m_Lock);
+	if(!atomic_dec(&m_NumPending) && m_Waiting)
+	{
+		m_Waiting = false;
+		semaphore_signal(&m_Done);
+	}
+	lock_unlock(m_Lock);
+}
+
+CJobPool::CJobPool()
+{
+	// empty the pool
+	for(int i = 0; i < MAX_THREADS; i++)
+	{
+		m_aQueues[i].m_Lock = lock_create();
+		m_aQueues[i].m_pFirstJob = 0;
+		m_aQueues[i].m_pLastJob = 0;
+	}
+	m_NumThreads = 0;
+	m_NextQueue = 0;
+	semaphore_init(&m_Semaphore);
+	m_Shutdown = false;
+
+	m_DoneLock = lock_create();
+	m_pFirstDone = 0;
+	m_pLastDone = 0;
+}
+
+CJobPool::~CJobPool()
+{
+	// wake every worker once more, they leave when there is nothing left to do
+	m_Shutdown = true;
+	sync_barrier();
+	for(int i = 0; i < m_NumThreads; i++)
+		semaphore_signal(&m_Semaphore);
+	for(int i = 0; i < m_NumThreads; i++)
+		thread_wait(m_aWorkers[i].m_pThread);
+
+	for(int i = 0; i < MAX_THREADS; i++)
+		lock_destroy(m_aQueues[i].m_Lock);
+	semaphore_destroy(&m_Semaphore);
+	lock_destroy(m_DoneLock);
+}
+
+CJob *CJobPool::PopJob(int Index)
+{
+	// take the oldest job of the own queue, or steal the newest one of another
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		CQueue *pQueue = &m_aQueues[(Index+i)%m_NumThreads];
 		CJob *pJob = 0;
 
-		// fetch job from queue
-		lock_wait(pPool->m_Lock);
-		if(pPool->m_pFirstJob)
+		lock_wait(pQueue->m_Lock);
+		if(i == 0 && pQueue->m_pFirstJob)
 		{
-			pJob = pPool->m_pFirstJob;
-			pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-			if(pPool->m_pFirstJob)
-				pPool->m_pFirstJob->m_pPrev = 0;
+			pJob = pQueue->m_pFirstJob;
+			pQueue->m_pFirstJob = pJob->m_pNext;
+			if(pQueue->m_pFirstJob)
+				pQueue->m_pFirstJob->m_pPrev = 0;
 			else
-				pPool->m_pLastJob = 0;
+				pQueue->m_pLastJob = 0;
 		}
-		lock_unlock(pPool->m_Lock);
-
-		// do the job if we have one
-		if(pJob)
+		else if(i != 0 && pQueue->m_pLastJob)
 		{
-			pJob->m_Status = CJob::STATE_RUNNING;
-			pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
-			pJob->m_Status = CJob::STATE_DONE;
+			pJob = pQueue->m_pLastJob;
+			pQueue->m_pLastJob = pJob->m_pPrev;
+			if(pQueue->m_pLastJob)
+				pQueue->m_pLastJob->m_pNext = 0;
+			else
+				pQueue->m_pFirstJob = 0;
 		}
+		lock_unlock(pQueue->m_Lock);
+
+		if(pJob)
+			return pJob;
+	}
+	return 0;
+}
+
+void CJobPool::FinishJob(CJob *pJob)
+{
+	// the job may be added again as soon as it is done, don't touch it after that
+	CJobGroup *pGroup = pJob->m_pGroup;
+	if(pJob->m_pfnDone)
+	{
+		pJob->m_pNext = 0;
+		lock_wait(m_DoneLock);
+		if(m_pLastDone)
+			m_pLastDone->m_pNext = pJob;
 		else
-			thread_sleep(10);
+			m_pFirstDone = pJob;
+		m_pLastDone = pJob;
+		lock_unlock(m_DoneLock);
+
+		// finish the group last, RunCallbacks after a Wait sees every job of the group
+		if(pGroup)
+			pGroup->Finish();
 	}
+	else
+	{
+		sync_barrier();
+		pJob->m_Status = CJob::STATE_DONE;
+		if(pGroup)
+			pGroup->Finish();
+	}
+}
 
+void CJobPool::WorkerThread(void *pUser)
+{
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
+
+	while(1)
+	{
+		// the semaphore counts the queued jobs, plus one per worker on shutdown
+		semaphore_wait(&pPool->m_Semaphore);
+
+		// there is a job for this worker, but another one may have taken it from
+		// a queue that was already checked and left its own job behind. look again
+		CJob *pJob = pPool->PopJob(pWorker->m_Index);
+		while(!pJob && !pPool->m_Shutdown)
+			pJob = pPool->PopJob(pWorker->m_Index);
+		if(!pJob)
+			break;
+
+		pJob->m_Status = CJob::STATE_RUNNING;
+		pJob->m_Result = pJob->m_pfnFunc(pJob->m_pFuncData);
+		pPool->FinishJob(pJob);
+	}
 }
 
 int CJobPool::Init(int NumThreads)
 {
+	dbg_assert(m_NumThreads == 0, "job pool already started");
+
+	// the workers need the final count to find every queue
+	m_NumThreads = clamp(NumThreads, 0, (int)MAX_THREADS);
+	sync_barrier();
+
 	// start threads
-	for(int i = 0; i < NumThreads; i++)
-		thread_init(WorkerThread, this);
+	for(int i = 0; i < m_NumThreads; i++)
+	{
+		m_aWorkers[i].m_pPool = this;
+		m_aWorkers[i].m_Index = i;
+		m_aWorkers[i].m_pThread = thread_init(WorkerThread, &m_aWorkers[i]);
+	}
 	return 0;
 }
 
-int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData)
+int CJobPool::Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup, JOBDONEFUNC pfnDone)
 {
 	mem_zero(pJob, sizeof(CJob));
 	pJob->m_pfnFunc = pfnFunc;
 	pJob->m_pFuncData = pData;
+	pJob->m_pGroup = pGroup;
+	pJob->m_pfnDone = pfnDone;
 
-	lock_wait(m_Lock);
+	if(pGroup)
+		atomic_inc(&pGroup->m_NumPending);
+
+	// spread the jobs over the worker queues, without workers they wait in the first one
+	CQueue *pQueue = &m_aQueues[m_NumThreads ? atomic_inc(&m_NextQueue)%m_NumThreads : 0];
+	lock_wait(pQueue->m_Lock);
 
 	// add job to queue
-	pJob->m_pPrev = m_pLastJob;
-	if(m_pLastJob)
-		m_pLastJob->m_pNext = pJob;
-	m_pLastJob = pJob;
-	if(!m_pFirstJob)
-		m_pFirstJob = pJob;
+	pJob->m_pPrev = pQueue->m_pLastJob;
+	if(pQueue->m_pLastJob)
+		pQueue->m_pLastJob->m_pNext = pJob;
+	pQueue->m_pLastJob = pJob;
+	if(!pQueue->m_pFirstJob)
+		pQueue->m_pFirstJob = pJob;
 
-	lock_unlock(m_Lock);
+	lock_unlock(pQueue->m_Lock);
+
+	semaphore_signal(&m_Semaphore);
 	return 0;
 }
+
+int CJobPool::RunCallbacks()
+{
+	lock_wait(m_DoneLock);
+	CJob *pJob = m_pFirstDone;
+	m_pFirstDone = 0;
+	m_pLastDone = 0;
+	lock_unlock(m_DoneLock);
+
+	int Num = 0;
+	while(pJob)
+	{
+		// the callback may add the job again
+		CJob *pNext = pJob->m_pNext;
+		JOBDONEFUNC pfnDone = pJob->m_pfnDone;
+		void *pData = pJob->m_pFuncData;
+		sync_barrier();
+		pJob->m_Status = CJob::STATE_DONE;
+		pfnDone(pJob, pData);
+		pJob = pNext;
+		Num++;
+	}
+	return Num;
+}
@@ -2,10 +2,42 @@
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #ifndef ENGINE_SHARED_JOBS_H
 #define ENGINE_SHARED_JOBS_H
+#include <base/system.h>
+
 typedef int (*JOBFUNC)(void *pData);
 
+class CJob;
 class CJobPool;
 
+// called by CJobPool::RunCallbacks in the thread that owns the pool
+typedef void (*JOBDONEFUNC)(CJob *pJob, void *pData);
+
+// counts the jobs added with it, Wait blocks until all of them are done.
+// only one thread may wait on a group at a time
+class CJobGroup
+{
+	friend class CJobPool;
+
+	LOCK m_Lock;
+	SEMAPHORE m_Done;
+	volatile unsigned m_NumPending;
+	bool m_Waiting;
+
+	void Init();
+	void Finish();
+
+	// not copyable, the jobs added with it point to it
+	CJobGroup(const CJobGroup &Other);
+	CJobGroup &operator=(const CJobGroup &Other);
+
+public:
+	CJobGroup() { Init(); }
+	~CJobGroup();
+
+	int NumPending() const;
+	void Wait();
+};
+
 class CJob
 {
 	friend class CJobPool;
@@ -18,6 +50,8 @@ class CJob
 
 	JOBFUNC m_pfnFunc;
 	void *m_pFuncData;
+	CJobGroup *m_pGroup;
+	JOBDONEFUNC m_pfnDone;
 public:
 	CJob()
 	{
@@ -36,18 +70,61 @@ public:
 	int Result() const {return m_Result; }
 };
 
+/*
+	Class: CJobPool
+		Runs jobs on a fixed number of worker threads. Idle workers sleep on a
+		semaphore until a job is added. Every worker has its own queue, jobs are
+		spread over them and a worker without work steals from the others.
+
+		A job with a done callback stays with the pool after it ran and must stay
+		valid until RunCallbacks hands it back, its status turns STATE_DONE right
+		before the callback.
+*/
 class CJobPool
 {
-	LOCK m_Lock;
-	CJob *m_pFirstJob;
-	CJob *m_pLastJob;
+	enum
+	{
+		MAX_THREADS=16,
+	};
+
+	struct CQueue
+	{
+		LOCK m_Lock;
+		CJob *m_pFirstJob;
+		CJob *m_pLastJob;
+	};
 
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		int m_Index;
+		void *m_pThread;
+	};
+
+	CQueue m_aQueues[MAX_THREADS];
+	CWorker m_aWorkers[MAX_THREADS];
+	int m_NumThreads;
+	volatile unsigned m_NextQueue;
+	SEMAPHORE m_Semaphore;
+	volatile bool m_Shutdown;
+
+	// jobs that ran and wait for their done callback
+	LOCK m_DoneLock;
+	CJob *m_pFirstDone;
+	CJob *m_pLastDone;
+
+	CJob *PopJob(int Index);
+	void FinishJob(CJob *pJob);
 	static void WorkerThread(void *pUser);
 
 public:
 	CJobPool();
+	~CJobPool();
 
 	int Init(int NumThreads);
-	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData);
+	int Add(CJob *pJob, JOBFUNC pfnFunc, void *pData, CJobGroup *pGroup = 0, JOBDONEFUNC pfnDone = 0);
+
+	// runs the done callbacks of finished jobs, returns how many
+	int RunCallbacks();
 };
 #endif
@@ -34,6 +34,11 @@ public:
 		return m_DataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL);
 	}
 
+	virtual void LoadOpened(CDataFileReader *pReader)
+	{
+		m_DataFile.MoveFrom(pReader);
+	}
+
 	virtual bool IsLoaded()
 	{
 		return m_DataFile.IsOpen();
@@ -63,15 +63,8 @@ bool CMapChecker::IsMapValid(const char *pMapName, unsigned MapCrc, unsigned Map
 	return StandardMap?false:true;
 }
 
-bool CMapChecker::ReadAndValidateMap(IStorage *pStorage, const char *pFilename, int StorageType)
+bool CMapChecker::ExtractMapName(const char *pFilename, char *pMapName)
 {
-	bool LoadedMapInfo = false;
-	bool StandardMap = false;
-	unsigned MapCrc = 0;
-	unsigned MapSize = 0;
-
-	// extract map name
-	char aMapName[MAX_MAP_LENGTH];
 	const char *pExtractedName = pFilename;
 	const char *pEnd = 0;
 	for(const char *pSrc = pFilename; *pSrc; ++pSrc)
@@ -83,8 +76,30 @@ bool CMapChecker::ReadAndValidateMap(IStorage *pStorage, const char *pFilename,
 	}
 	int Length = (int)(pEnd - pExtractedName);
 	if(Length <= 0 || Length >= MAX_MAP_LENGTH)
+		return false;
+	str_copy(pMapName, pExtractedName, min((int)MAX_MAP_LENGTH, (int)(pEnd-pExtractedName+1)));
+	return true;
+}
+
+bool CMapChecker::ValidateMap(const char *pFilename, unsigned MapCrc, unsigned MapSize)
+{
+	char aMapName[MAX_MAP_LENGTH];
+	if(!ExtractMapName(pFilename, aMapName))
+		return true;
+	return IsMapValid(aMapName, MapCrc, MapSize);
+}
+
+bool CMapChecker::ReadAndValidateMap(IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	bool LoadedMapInfo = false;
+	bool StandardMap = false;
+	unsigned MapCrc = 0;
+	unsigned MapSize = 0;
+
+	// extract map name
+	char aMapName[MAX_MAP_LENGTH];
+	if(!ExtractMapName(pFilename, aMapName))
 		return true;
-	str_copy(aMapName, pExtractedName, min((int)MAX_MAP_LENGTH, (int)(pEnd-pExtractedName+1)));
 
 	// check for valid map
 	for(CWhitelistEntry *pCurrent = m_pFirst; pCurrent; pCurrent = pCurrent->m_pNext)
@@ -27,12 +27,15 @@ class CMapChecker
 
 	void Init();
 	void SetDefaults();
+	static bool ExtractMapName(const char *pFilename, char *pMapName);
 
 public:
 	CMapChecker();
 	void AddMaplist(struct CMapVersion *pMaplist, int Num);
 	bool IsMapValid(const char *pMapName, unsigned MapCrc, unsigned MapSize);
 	bool ReadAndValidateMap(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// same as ReadAndValidateMap for a file that was already read
+	bool ValidateMap(const char *pFilename, unsigned MapCrc, unsigned MapSize);
 };
 
 #endif
@@ -90,6 +90,48 @@ int CNetRecvUnpacker::FetchChunk(CNetChunk *pChunk)
 	}
 }
 
+void CNetBase::SendRaw(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize)
+{
+	if(!ms_SendBatchActive)
+	{
+		net_udp_send(Socket, pAddr, pData, DataSize);
+		return;
+	}
+
+	// one batch only targets one socket
+	if(ms_SendBatchNum == SEND_BATCH_SIZE || (ms_SendBatchNum &&
+		(ms_SendBatchSocket.ipv4sock != Socket.ipv4sock || ms_SendBatchSocket.ipv6sock != Socket.ipv6sock)))
+		FlushSendBatch();
+
+	ms_SendBatchSocket = Socket;
+	NETUDPPACKET *pPacket = &ms_aSendBatch[ms_SendBatchNum];
+	pPacket->addr = *pAddr;
+	pPacket->data = ms_paaSendBatchData[ms_SendBatchNum];
+	pPacket->size = DataSize;
+	mem_copy(pPacket->data, pData, DataSize);
+	ms_SendBatchNum++;
+}
+
+void CNetBase::FlushSendBatch()
+{
+	if(ms_SendBatchNum)
+		net_udp_send_batch(ms_SendBatchSocket, ms_aSendBatch, ms_SendBatchNum);
+	ms_SendBatchNum = 0;
+}
+
+void CNetBase::BeginSendBatch()
+{
+	if(!ms_paaSendBatchData)
+		ms_paaSendBatchData = (unsigned char (*)[NET_MAX_PACKETSIZE])mem_alloc(SEND_BATCH_SIZE*NET_MAX_PACKETSIZE, 1);
+	ms_SendBatchActive = true;
+}
+
+void CNetBase::EndSendBatch()
+{
+	FlushSendBatch();
+	ms_SendBatchActive = false;
+}
+
 // packs the data tight and sends it
 void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize)
 {
@@ -101,7 +143,7 @@ void CNetBase::SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *
 	aBuffer[4] = 0xff;
 	aBuffer[5] = 0xff;
 	mem_copy(&aBuffer[6], pData, DataSize);
-	net_udp_send(Socket, pAddr, aBuffer, 6+DataSize);
+	SendRaw(Socket, pAddr, aBuffer, 6+DataSize);
 }
 
 void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken)
@@ -154,7 +196,7 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		aBuffer[0] = ((pPacket->m_Flags<<4)&0xf0)|((pPacket->m_Ack>>8)&0xf);
 		aBuffer[1] = pPacket->m_Ack&0xff;
 		aBuffer[2] = pPacket->m_NumChunks;
-		net_udp_send(Socket, pAddr, aBuffer, FinalSize);
+		SendRaw(Socket, pAddr, aBuffer, FinalSize);
 
 		// log raw socket data
 		if(ms_DataLogSent)
@@ -304,6 +346,11 @@ int CNetBase::IsSeqInBackroom(int Seq, int Ack)
 IOHANDLE CNetBase::ms_DataLogSent = 0;
 IOHANDLE CNetBase::ms_DataLogRecv = 0;
 CHuffman CNetBase::ms_Huffman;
+unsigned char (*CNetBase::ms_paaSendBatchData)[NET_MAX_PACKETSIZE] = 0;
+NETUDPPACKET CNetBase::ms_aSendBatch[CNetBase::SEND_BATCH_SIZE];
+NETSOCKET CNetBase::ms_SendBatchSocket;
+int CNetBase::ms_SendBatchNum = 0;
+bool CNetBase::ms_SendBatchActive = false;
 
 
 void CNetBase::OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv)
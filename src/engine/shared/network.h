@@ -289,6 +289,21 @@ class CNetServer
 	int m_MaxClients;
 	int m_MaxClientsPerIP;
 
+	// peer address -> slot lookup, chained per bucket. A slot is linked under
+	// the address it got in TryAcceptClient/SetTimedOut, lookups still check
+	// the connection state and address.
+	enum
+	{
+		SLOT_HASH_SIZE=256,
+	};
+	int m_aSlotHash[SLOT_HASH_SIZE];
+	int m_aSlotHashNext[NET_MAX_CLIENTS];
+	int m_aSlotHashBucket[NET_MAX_CLIENTS];
+
+	static int SlotHashKey(const NETADDR &Addr);
+	void SlotHashLink(int Slot);
+	void SlotHashUnlink(int Slot);
+
 	NETFUNC_NEWCLIENT m_pfnNewClient;
 	NETFUNC_NEWCLIENT_NOAUTH m_pfnNewClientNoAuth;
 	NETFUNC_DELCLIENT m_pfnDelClient;
@@ -307,6 +322,16 @@ class CNetServer
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
+	// packets read by one net_udp_recv_batch call, handed out one by one
+	enum
+	{
+		RECV_BATCH_SIZE=16,
+	};
+	unsigned char m_aaRecvBatchData[RECV_BATCH_SIZE][NET_MAX_PACKETSIZE];
+	NETUDPPACKET m_aRecvBatch[RECV_BATCH_SIZE];
+	int m_RecvBatchNum;
+	int m_RecvBatchPos;
+
 	void OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketConstruct &Packet);
 	void OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet);
 	void OnConnCtrlMsg(NETADDR &Addr, int ClientID, int ControlMsg, const CNetPacketConstruct &Packet);
@@ -438,6 +463,20 @@ class CNetBase
 	static IOHANDLE ms_DataLogSent;
 	static IOHANDLE ms_DataLogRecv;
 	static CHuffman ms_Huffman;
+
+	// packets queued between BeginSendBatch and EndSendBatch
+	enum
+	{
+		SEND_BATCH_SIZE=64,
+	};
+	static unsigned char (*ms_paaSendBatchData)[NET_MAX_PACKETSIZE];
+	static NETUDPPACKET ms_aSendBatch[SEND_BATCH_SIZE];
+	static NETSOCKET ms_SendBatchSocket;
+	static int ms_SendBatchNum;
+	static bool ms_SendBatchActive;
+
+	static void SendRaw(NETSOCKET Socket, const NETADDR *pAddr, const void *pData, int DataSize);
+	static void FlushSendBatch();
 public:
 	static void OpenLog(IOHANDLE DataLogSent, IOHANDLE DataLogRecv);
 	static void CloseLog();
@@ -449,6 +488,9 @@ public:
 	static void SendPacketConnless(NETSOCKET Socket, NETADDR *pAddr, const void *pData, int DataSize);
 	static void SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct *pPacket, SECURITY_TOKEN SecurityToken);
 
+	// queue the packets sent in between and pass them to net_udp_send_batch
+	static void BeginSendBatch();
+	static void EndSendBatch();
 
 	static int UnpackPacket(unsigned char *pBuffer, int Size, CNetPacketConstruct *pPacket);
 
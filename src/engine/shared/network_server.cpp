@@ -53,9 +53,52 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 	for(int i = 0; i < NET_MAX_CLIENTS; i++)
 		m_aSlots[i].m_Connection.Init(m_Socket, true);
 
+	for(int i = 0; i < SLOT_HASH_SIZE; i++)
+		m_aSlotHash[i] = -1;
+	for(int i = 0; i < NET_MAX_CLIENTS; i++)
+	{
+		m_aSlotHashNext[i] = -1;
+		m_aSlotHashBucket[i] = -1;
+	}
+
 	return true;
 }
 
+int CNetServer::SlotHashKey(const NETADDR &Addr)
+{
+	// FNV-1a over the same bytes net_addr_comp compares
+	const unsigned char *pData = (const unsigned char *)&Addr;
+	unsigned Hash = 2166136261u;
+	for(unsigned i = 0; i < sizeof(NETADDR); i++)
+		Hash = (Hash^pData[i])*16777619u;
+	return (Hash^(Hash>>16))&(SLOT_HASH_SIZE-1);
+}
+
+void CNetServer::SlotHashLink(int Slot)
+{
+	SlotHashUnlink(Slot);
+
+	int Bucket = SlotHashKey(*m_aSlots[Slot].m_Connection.PeerAddress());
+	m_aSlotHashNext[Slot] = m_aSlotHash[Bucket];
+	m_aSlotHash[Bucket] = Slot;
+	m_aSlotHashBucket[Slot] = Bucket;
+}
+
+void CNetServer::SlotHashUnlink(int Slot)
+{
+	int Bucket = m_aSlotHashBucket[Slot];
+	if(Bucket < 0)
+		return;
+
+	int *pLink = &m_aSlotHash[Bucket];
+	while(*pLink != Slot)
+		pLink = &m_aSlotHashNext[*pLink];
+	*pLink = m_aSlotHashNext[Slot];
+
+	m_aSlotHashNext[Slot] = -1;
+	m_aSlotHashBucket[Slot] = -1;
+}
+
 int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser)
 {
 	m_pfnNewClient = pfnNewClient;
@@ -94,6 +137,7 @@ int CNetServer::Drop(int ClientID, const char *pReason)
 		m_pfnDelClient(ClientID, pReason, m_UserPtr);
 
 	m_aSlots[ClientID].m_Connection.Disconnect(pReason);
+	SlotHashUnlink(ClientID);
 
 	return 0;
 }
@@ -195,6 +239,7 @@ int CNetServer::TryAcceptClient(NETADDR &Addr, SECURITY_TOKEN SecurityToken, boo
 
 	// init connection slot
 	m_aSlots[Slot].m_Connection.DirectInit(Addr, SecurityToken);
+	SlotHashLink(Slot);
 
 	if (VanillaAuth)
 	{
@@ -496,19 +541,32 @@ void CNetServer::OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketC
 
 int CNetServer::GetClientSlot(const NETADDR &Addr)
 {
+	// take the highest matching slot like the old linear scan did
 	int Slot = -1;
 
-	for(int i = 0; i < MaxClients(); i++)
+	for(int i = m_aSlotHash[SlotHashKey(Addr)]; i >= 0; i = m_aSlotHashNext[i])
 	{
-		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
+		if(i > Slot && i < MaxClients() &&
+			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
 			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
 			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
-
 		{
 			Slot = i;
 		}
 	}
 
+#ifdef CONF_DEBUG
+	int ScanSlot = -1;
+	for(int i = 0; i < MaxClients(); i++)
+	{
+		if(m_aSlots[i].m_Connection.State() != NET_CONNSTATE_OFFLINE &&
+			m_aSlots[i].m_Connection.State() != NET_CONNSTATE_ERROR &&
+			net_addr_comp(m_aSlots[i].m_Connection.PeerAddress(), &Addr) == 0)
+			ScanSlot = i;
+	}
+	dbg_assert(ScanSlot == Slot, "client slot hash out of sync");
+#endif
+
 	return Slot;
 }
 
@@ -525,12 +583,28 @@ int CNetServer::Recv(CNetChunk *pChunk)
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
-		// TODO: empty the recvinfo
-		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE);
+		// read the next few packets at once
+		if(m_RecvBatchPos >= m_RecvBatchNum)
+		{
+			for(int i = 0; i < RECV_BATCH_SIZE; i++)
+			{
+				m_aRecvBatch[i].data = m_aaRecvBatchData[i];
+				m_aRecvBatch[i].size = NET_MAX_PACKETSIZE;
+			}
+			m_RecvBatchPos = 0;
+			m_RecvBatchNum = net_udp_recv_batch(m_Socket, m_aRecvBatch, RECV_BATCH_SIZE);
 
-		// no more packets for now
-		if(Bytes <= 0)
-			break;
+			// no more packets for now
+			if(m_RecvBatchNum <= 0)
+			{
+				m_RecvBatchNum = 0;
+				break;
+			}
+		}
+
+		const NETUDPPACKET *pPacket = &m_aRecvBatch[m_RecvBatchPos++];
+		Addr = pPacket->addr;
+		int Bytes = pPacket->size;
 
 		// check if we just should drop the packet
 		char aBuf[128];
@@ -541,7 +615,7 @@ int CNetServer::Recv(CNetChunk *pChunk)
 			continue;
 		}
 
-		if(CNetBase::UnpackPacket(m_RecvUnpacker.m_aBuffer, Bytes, &m_RecvUnpacker.m_Data) == 0)
+		if(CNetBase::UnpackPacket((unsigned char *)pPacket->data, Bytes, &m_RecvUnpacker.m_Data) == 0)
 		{
 			if(m_RecvUnpacker.m_Data.m_Flags&NET_PACKETFLAG_CONNLESS)
 			{
@@ -647,6 +721,8 @@ bool CNetServer::SetTimedOut(int ClientID, int OrigID)
 
 	m_aSlots[ClientID].m_Connection.SetTimedOut(ClientAddr(OrigID), m_aSlots[OrigID].m_Connection.SeqSequence(), m_aSlots[OrigID].m_Connection.AckSequence(), m_aSlots[OrigID].m_Connection.SecurityToken());
 	m_aSlots[OrigID].m_Connection.Reset();
+	SlotHashLink(ClientID);
+	SlotHashUnlink(OrigID);
 	return true;
 }
 
@@ -455,7 +455,7 @@ void CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPoss
 
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask)
 		{
@@ -780,6 +780,7 @@ CConsole::CConsole(int FlagMask)
 	m_paStrokeStr[1] = "1";
 	m_ExecutionQueue.Reset();
 	m_pFirstCommand = 0;
+	mem_zero(m_apCommandHash, sizeof(m_apCommandHash));
 	m_pFirstExec = 0;
 	mem_zero(m_aPrintCB, sizeof(m_aPrintCB));
 	m_NumPrintCB = 0;
@@ -845,8 +846,41 @@ void CConsole::ParseArguments(int NumArgs, const char **ppArguments)
 	}
 }
 
+unsigned CConsole::CommandHash(const char *pName)
+{
+	// str_quickhash on the lower case name, the lookup ignores the case
+	unsigned Hash = 5381;
+	for(; *pName; pName++)
+		Hash = ((Hash << 5) + Hash) + (*pName >= 'A' && *pName <= 'Z' ? *pName - 'A' + 'a' : *pName);
+	return Hash&(COMMAND_HASH_SIZE-1);
+}
+
+void CConsole::AddCommandHash(CCommand *pCommand)
+{
+	// keep the order of the sorted list, FindCommand returns the same command as a walk over it
+	CCommand **ppSlot = &m_apCommandHash[CommandHash(pCommand->m_pName)];
+	while(*ppSlot && str_comp(pCommand->m_pName, (*ppSlot)->m_pName) > 0)
+		ppSlot = &(*ppSlot)->m_pNextHash;
+	pCommand->m_pNextHash = *ppSlot;
+	*ppSlot = pCommand;
+}
+
+void CConsole::RemoveCommandHash(CCommand *pCommand)
+{
+	for(CCommand **ppSlot = &m_apCommandHash[CommandHash(pCommand->m_pName)]; *ppSlot; ppSlot = &(*ppSlot)->m_pNextHash)
+	{
+		if(*ppSlot == pCommand)
+		{
+			*ppSlot = pCommand->m_pNextHash;
+			break;
+		}
+	}
+}
+
 void CConsole::AddCommandSorted(CCommand *pCommand)
 {
+	AddCommandHash(pCommand);
+
 	if(!m_pFirstCommand || str_comp(pCommand->m_pName, m_pFirstCommand->m_pName) <= 0)
 	{
 		if(m_pFirstCommand && m_pFirstCommand->m_pNext)
@@ -957,6 +991,7 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		RemoveCommandHash(pRemoved);
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -978,6 +1013,18 @@ void CConsole::DeregisterTempAll()
 		}
 	}
 
+	// remove temp entries from the hash chains
+	for(int i = 0; i < COMMAND_HASH_SIZE; i++)
+	{
+		for(CCommand **ppSlot = &m_apCommandHash[i]; *ppSlot;)
+		{
+			if((*ppSlot)->m_Temp)
+				*ppSlot = (*ppSlot)->m_pNextHash;
+			else
+				ppSlot = &(*ppSlot)->m_pNextHash;
+		}
+	}
+
 	m_TempCommands.Reset();
 	m_pRecycleList = 0;
 }
@@ -1027,7 +1074,7 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	for(CCommand *pCommand = m_apCommandHash[CommandHash(pName)]; pCommand; pCommand = pCommand->m_pNextHash)
 	{
 		if(pCommand->m_Flags&FlagMask && pCommand->m_Temp == Temp)
 		{
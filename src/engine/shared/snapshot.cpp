@@ -1,5 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+
 #include "snapshot.h"
 #include "compression.h"
 
@@ -19,7 +21,7 @@ int CSnapshot::GetItemSize(int Index)
 
 int CSnapshot::GetItemIndex(int Key)
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	// linear search, use a CSnapshotKeyIndex for repeated lookups
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -57,50 +59,76 @@ void CSnapshot::DebugDump()
 }
 
 
-// CSnapshotDelta
+// CSnapshotKeyIndex
 
-struct CItemList
+int CSnapshotKeyIndex::NumSlots(int NumItems)
 {
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
+	if(NumItems > MAX_ITEMS)
+		return 0;
+
+	// keep the load factor at or below one half
+	int Num = 16;
+	while(Num < NumItems*2)
+		Num <<= 1;
+	return Num;
+}
 
-enum
+int CSnapshotKeyIndex::MemSize(int NumItems)
 {
-	HASHLIST_SIZE = 256,
-};
+	return sizeof(CSnapshotKeyIndex) + NumSlots(NumItems)*2*sizeof(int);
+}
 
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
+void CSnapshotKeyIndex::Build(CSnapshot *pSnap)
 {
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
+	int Num = NumSlots(pSnap->NumItems());
+	if(!Num)
+	{
+		m_SlotMask = -1;
+		return;
+	}
 
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	m_SlotMask = Num-1;
+	int *pSlots = Slots();
+	mem_zero(pSlots, Num*2*sizeof(int));
+
+	for(int i = 0; i < pSnap->NumItems(); i++)
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		int Key = pSnap->GetItem(i)->Key();
+		unsigned Slot = Hash(Key)&m_SlotMask;
+		while(pSlots[Slot*2+1])
+		{
+			// keep the first item on duplicate keys, like the linear search does
+			if(pSlots[Slot*2] == Key)
+				break;
+			Slot = (Slot+1)&m_SlotMask;
+		}
+		if(!pSlots[Slot*2+1])
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			pSlots[Slot*2] = Key;
+			pSlots[Slot*2+1] = i+1;
 		}
 	}
 }
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
+int CSnapshotKeyIndex::GetItemIndex(CSnapshot *pSnap, int Key) const
 {
-		int HashID = ((Key>>12)&0xf0) | (Key&0xf);
-		for(int i = 0; i < pHashlist[HashID].m_Num; i++)
-		{
-			if(pHashlist[HashID].m_aKeys[i] == Key)
-				return pHashlist[HashID].m_aIndex[i];
-	}
+	if(m_SlotMask < 0)
+		return pSnap->GetItemIndex(Key);
 
+	const int *pSlots = Slots();
+	unsigned Slot = Hash(Key)&m_SlotMask;
+	while(pSlots[Slot*2+1])
+	{
+		if(pSlots[Slot*2] == Key)
+			return pSlots[Slot*2+1]-1;
+		Slot = (Slot+1)&m_SlotMask;
+	}
 	return -1;
 }
 
+
+// CSnapshotDelta
+
 static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
@@ -159,7 +187,7 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 }
 
 // TODO: OPT: this should be made much faster
-int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
+int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData, const CSnapshotKeyIndex *pFromIndex, const CSnapshotKeyIndex *pToIndex)
 {
 	CData *pDelta = (CData *)pDstData;
 	int *pData = (int *)pDelta->m_pData;
@@ -174,14 +202,20 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList Hashlist[HASHLIST_SIZE];
-	GenerateHash(Hashlist, pTo);
+	// build the key indices the caller does not have already
+	int aIndexData[CSnapshotKeyIndex::MAX_MEMSIZE/sizeof(int)];
+	CSnapshotKeyIndex *pIndex = (CSnapshotKeyIndex *)aIndexData;
+	if(!pToIndex)
+	{
+		pIndex->Build(pTo);
+		pToIndex = pIndex;
+	}
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), Hashlist) == -1)
+		if(pToIndex->GetItemIndex(pTo, pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -190,8 +224,12 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(Hashlist, pFrom);
-	int aPastIndecies[1024];
+	if(!pFromIndex)
+	{
+		pIndex->Build(pFrom);
+		pFromIndex = pIndex;
+	}
+	int aPastIndecies[CSnapshotKeyIndex::MAX_ITEMS];
 
 	// fetch previous indices
 	// we do this as a separate pass because it helps the cache
@@ -199,7 +237,7 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	for(i = 0; i < NumItems; i++)
 	{
 		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndecies[i] = GetItemIndexHashed(pCurItem->Key(), Hashlist); // O(n) .. O(n^n)
+		aPastIndecies[i] = pFromIndex->GetItemIndex(pFrom, pCurItem->Key()); // O(1)
 	}
 
 	for(i = 0; i < NumItems; i++)
@@ -292,25 +330,49 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	Builder.Init();
 
+	int aIndexData[CSnapshotKeyIndex::MAX_MEMSIZE/sizeof(int)];
+	CSnapshotKeyIndex *pFromIndex = (CSnapshotKeyIndex *)aIndexData;
+	pFromIndex->Build(pFrom);
+
 	// unpack deleted stuff
 	pDeleted = pData;
 	pData += pDelta->m_NumDeletedItems;
 	if(pData > pEnd)
 		return -1;
 
+	// mark the deleted items
+	char aKeep[CSnapshotKeyIndex::MAX_ITEMS];
+	const bool Indexed = pFrom->NumItems() <= CSnapshotKeyIndex::MAX_ITEMS;
+	if(Indexed)
+	{
+		for(int i = 0; i < pFrom->NumItems(); i++)
+			aKeep[i] = 1;
+		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+		{
+			FromIndex = pFromIndex->GetItemIndex(pFrom, pDeleted[d]);
+			if(FromIndex != -1)
+				aKeep[FromIndex] = 0;
+		}
+	}
+
 	// copy all non deleted stuff
 	for(int i = 0; i < pFrom->NumItems(); i++)
 	{
 		// dbg_assert(0, "fail!");
 		pFromItem = pFrom->GetItem(i);
 		ItemSize = pFrom->GetItemSize(i);
-		Keep = 1;
-		for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
+		if(Indexed)
+			Keep = aKeep[i];
+		else
 		{
-			if(pDeleted[d] == pFromItem->Key())
+			Keep = 1;
+			for(int d = 0; d < pDelta->m_NumDeletedItems; d++)
 			{
-				Keep = 0;
-				break;
+				if(pDeleted[d] == pFromItem->Key())
+				{
+					Keep = 0;
+					break;
+				}
 			}
 		}
 
@@ -353,7 +415,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 		//if(range_check(pEnd, pNewData, ItemSize)) return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
+		FromIndex = pFromIndex->GetItemIndex(pFrom, Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need pTo apply the diff
@@ -377,10 +439,90 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 // CSnapshotStorage
 
-void CSnapshotStorage::Init()
+void CSnapshotStorage::Init(int WindowSnapshots)
 {
 	m_pFirst = 0;
 	m_pLast = 0;
+
+	m_WindowSnapshots = WindowSnapshots;
+	m_pArena = 0;
+	m_ArenaSize = 0;
+	m_ArenaHead = 0;
+	m_ArenaTail = 0;
+	m_ArenaNumLive = 0;
+	m_LiveSize = 0;
+	m_WantedArenaSize = 0;
+	mem_zero(&m_Stats, sizeof(m_Stats));
+}
+
+void *CSnapshotStorage::AllocHolder(int Size, bool *pInArena)
+{
+	Size = (Size+7)&~7;
+	m_LiveSize += Size;
+	if(m_LiveSize > m_Stats.m_PeakLiveSize)
+		m_Stats.m_PeakLiveSize = m_LiveSize;
+
+	// size the arena for the whole window when the first snapshot arrives
+	if(!m_WantedArenaSize)
+		m_WantedArenaSize = clamp(Size*m_WindowSnapshots, (int)ARENA_MIN_SIZE, (int)ARENA_MAX_SIZE);
+
+	// the arena can only be replaced while nothing lives in it
+	if(!m_ArenaNumLive && m_WantedArenaSize > m_ArenaSize)
+	{
+		if(m_pArena)
+			mem_free(m_pArena);
+		m_ArenaSize = m_WantedArenaSize;
+		m_pArena = (char *)mem_alloc(m_ArenaSize, 8);
+		m_ArenaHead = m_ArenaTail = 0;
+		m_Stats.m_ArenaResizes++;
+		m_Stats.m_ArenaSize = m_ArenaSize;
+	}
+
+	// once the arena is too small, let it drain so it can be replaced
+	int Offset = -1;
+	if(m_ArenaSize && m_WantedArenaSize <= m_ArenaSize)
+	{
+		// never let the tail catch up with the head, the live count tells empty and full apart
+		if(m_ArenaTail >= m_ArenaHead)
+		{
+			if(m_ArenaTail+Size <= m_ArenaSize)
+				Offset = m_ArenaTail;
+			else if(Size < m_ArenaHead)
+				Offset = 0; // wrap around
+		}
+		else if(m_ArenaTail+Size < m_ArenaHead)
+			Offset = m_ArenaTail;
+	}
+
+	if(Offset == -1)
+	{
+		// remember to grow the arena the next time it is empty
+		m_WantedArenaSize = min(max(m_WantedArenaSize, m_LiveSize+m_LiveSize/4), (int)ARENA_MAX_SIZE);
+		m_Stats.m_HeapAllocs++;
+		*pInArena = false;
+		return mem_alloc(Size, 8);
+	}
+
+	m_ArenaTail = Offset+Size;
+	m_ArenaNumLive++;
+	m_Stats.m_ArenaAllocs++;
+	*pInArena = true;
+	return m_pArena+Offset;
+}
+
+void CSnapshotStorage::FreeHolder(CHolder *pHolder)
+{
+	m_LiveSize -= pHolder->m_AllocSize;
+	if(!pHolder->m_InArena)
+	{
+		mem_free(pHolder);
+		return;
+	}
+
+	// holders are freed in the order they were added
+	m_ArenaHead = (int)((char *)pHolder-m_pArena)+pHolder->m_AllocSize;
+	if(--m_ArenaNumLive == 0)
+		m_ArenaHead = m_ArenaTail = 0;
 }
 
 void CSnapshotStorage::PurgeAll()
@@ -391,13 +533,23 @@ void CSnapshotStorage::PurgeAll()
 	while(pHolder)
 	{
 		pNext = pHolder->m_pNext;
-		mem_free(pHolder);
+		FreeHolder(pHolder);
 		pHolder = pNext;
 	}
 
 	// no more snapshots in storage
 	m_pFirst = 0;
 	m_pLast = 0;
+
+	// the next snapshots may be from another map or client, size the arena for them
+	if(m_pArena)
+		mem_free(m_pArena);
+	m_pArena = 0;
+	m_ArenaSize = 0;
+	m_ArenaHead = 0;
+	m_ArenaTail = 0;
+	m_WantedArenaSize = 0;
+	m_Stats.m_ArenaSize = 0;
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
@@ -410,7 +562,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 		pNext = pHolder->m_pNext;
 		if(pHolder->m_Tick >= Tick)
 			return; // no more to remove
-		mem_free(pHolder);
+		FreeHolder(pHolder);
 
 		// did we come to the end of the list?
 		if (!pNext)
@@ -429,13 +581,19 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 
 void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
 {
-	// allocate memory for holder + snapshot_data
+	// allocate memory for holder + snapshot_data + key index
 	int TotalSize = sizeof(CHolder)+DataSize;
 
 	if(CreateAlt)
 		TotalSize += DataSize;
 
-	CHolder *pHolder = (CHolder *)mem_alloc(TotalSize, 1);
+	int IndexOffset = TotalSize;
+	TotalSize += CSnapshotKeyIndex::MemSize(((CSnapshot *)pData)->NumItems());
+
+	bool InArena;
+	CHolder *pHolder = (CHolder *)AllocHolder(TotalSize, &InArena);
+	pHolder->m_AllocSize = (TotalSize+7)&~7;
+	pHolder->m_InArena = InArena;
 
 	// set data
 	pHolder->m_Tick = Tick;
@@ -452,6 +610,8 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 	else
 		pHolder->m_pAltSnap = 0;
 
+	pHolder->m_pIndex = (CSnapshotKeyIndex *)((char *)pHolder + IndexOffset);
+	pHolder->m_pIndex->Build(pHolder->m_pSnap);
 
 	// link
 	pHolder->m_pNext = 0;
@@ -465,25 +625,25 @@ void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, i
 
 int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
-	{
-		if(pHolder->m_Tick == Tick)
-		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
-		}
+	CHolder *pHolder = GetHolder(Tick);
+	if(!pHolder)
+		return -1;
 
-		pHolder = pHolder->m_pNext;
-	}
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->m_pSnap;
+	if(ppAltData)
+		*ppAltData = pHolder->m_pAltSnap;
+	return pHolder->m_SnapSize;
+}
 
-	return -1;
+CSnapshotStorage::CHolder *CSnapshotStorage::GetHolder(int Tick)
+{
+	for(CHolder *pHolder = m_pFirst; pHolder; pHolder = pHolder->m_pNext)
+		if(pHolder->m_Tick == Tick)
+			return pHolder;
+	return 0;
 }
 
 // CSnapshotBuilder
@@ -492,6 +652,7 @@ void CSnapshotBuilder::Init()
 {
 	m_DataSize = 0;
 	m_NumItems = 0;
+	mem_zero(m_aKeySlots, sizeof(m_aKeySlots));
 }
 
 CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
@@ -501,11 +662,14 @@ CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
 
 int *CSnapshotBuilder::GetItemData(int Key)
 {
-	int i;
-	for(i = 0; i < m_NumItems; i++)
+	const int Mask = MAX_ITEMS*2-1;
+	int Slot = CSnapshotKeyIndex::Hash(Key)&Mask;
+	while(m_aKeySlots[Slot])
 	{
-		if(GetItem(i)->Key() == Key)
-			return (int *)GetItem(i)->Data();
+		CSnapshotItem *pItem = GetItem(m_aKeySlots[Slot]-1);
+		if(pItem->Key() == Key)
+			return (int *)pItem->Data();
+		Slot = (Slot+1)&Mask;
 	}
 	return 0;
 }
@@ -540,5 +704,14 @@ void *CSnapshotBuilder::NewItem(int Type, int ID, int Size)
 	m_DataSize += sizeof(CSnapshotItem) + Size;
 	m_NumItems++;
 
+	// index the key, the first item wins on duplicates
+	const int Mask = MAX_ITEMS*2-1;
+	int Key = pObj->m_TypeAndID;
+	int Slot = CSnapshotKeyIndex::Hash(Key)&Mask;
+	while(m_aKeySlots[Slot] && GetItem(m_aKeySlots[Slot]-1)->Key() != Key)
+		Slot = (Slot+1)&Mask;
+	if(!m_aKeySlots[Slot])
+		m_aKeySlots[Slot] = m_NumItems;
+
 	return pObj->Data();
 }
@@ -45,6 +45,50 @@ public:
 };
 
 
+// CSnapshotKeyIndex
+
+/*
+	Open addressing table from item key to item index of a snapshot.
+	The slots follow the object in memory, so the index can be stored
+	right behind the snapshot it belongs to.
+*/
+class CSnapshotKeyIndex
+{
+public:
+	enum
+	{
+		MAX_ITEMS=1024,
+		MAX_SLOTS=MAX_ITEMS*2,
+	};
+
+private:
+	int m_SlotMask; // -1 if the snapshot had too many items to be indexed
+
+	int *Slots() const { return (int *)(this+1); } // pairs of key and item index+1
+
+	static int NumSlots(int NumItems);
+
+public:
+	static unsigned Hash(int Key)
+	{
+		unsigned h = (unsigned)Key;
+		h ^= h>>16;
+		h *= 0x45d9f3b;
+		h ^= h>>16;
+		return h;
+	}
+
+	enum
+	{
+		MAX_MEMSIZE=sizeof(int)+MAX_SLOTS*2*sizeof(int),
+	};
+
+	static int MemSize(int NumItems);
+	void Build(CSnapshot *pSnap);
+	int GetItemIndex(CSnapshot *pSnap, int Key) const;
+};
+
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -75,7 +119,7 @@ public:
 	int GetDataUpdates(int Index) { return m_aSnapshotDataUpdates[Index]; }
 	void SetStaticsize(int ItemType, int Size);
 	CData *EmptyDelta();
-	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData);
+	int CreateDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, const CSnapshotKeyIndex *pFromIndex = 0, const CSnapshotKeyIndex *pToIndex = 0);
 	int UnpackDelta(class CSnapshot *pFrom, class CSnapshot *pTo, void *pData, int DataSize);
 };
 
@@ -97,17 +141,63 @@ public:
 		int m_SnapSize;
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+		CSnapshotKeyIndex *m_pIndex;
+
+		int GetItemIndex(int Key) const { return m_pIndex ? m_pIndex->GetItemIndex(m_pSnap, Key) : m_pSnap->GetItemIndex(Key); }
+
+		int m_AllocSize;
+		bool m_InArena;
+	};
+
+	class CStats
+	{
+	public:
+		int m_ArenaAllocs; // holders placed in the arena
+		int m_HeapAllocs; // holders that did not fit and went to the heap
+		int m_ArenaResizes;
+		int m_ArenaSize;
+		int m_PeakLiveSize; // most bytes held at once
+	};
+
+private:
+	/*
+		Holders are always purged oldest first, so they are placed in a
+		ring arena: adding bumps the tail, purging bumps the head. The
+		arena is first sized for the window the owner keeps, it grows to
+		the snapshot window the storage saw and is freed by PurgeAll.
+	*/
+	enum
+	{
+		ARENA_MIN_SIZE=4*1024,
+		ARENA_MAX_SIZE=16*1024*1024,
 	};
 
+	int m_WindowSnapshots;
+	char *m_pArena;
+	int m_ArenaSize;
+	int m_ArenaHead;
+	int m_ArenaTail;
+	int m_ArenaNumLive;
+	int m_LiveSize;
+	int m_WantedArenaSize;
+	CStats m_Stats;
+
+	void *AllocHolder(int Size, bool *pInArena);
+	void FreeHolder(CHolder *pHolder);
 
+public:
 	CHolder *m_pFirst;
 	CHolder *m_pLast;
 
-	void Init();
+	const CStats *Stats() const { return &m_Stats; }
+
+	// WindowSnapshots is how many snapshots the owner usually keeps at once
+	void Init(int WindowSnapshots);
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
 	int Get(int Tick, int64 *Tagtime, CSnapshot **pData, CSnapshot **ppAltData);
+	CHolder *GetHolder(int Tick);
 };
 
 class CSnapshotBuilder
@@ -123,6 +213,9 @@ class CSnapshotBuilder
 	int m_aOffsets[MAX_ITEMS];
 	int m_NumItems;
 
+	// open addressing table from key to item index+1
+	short m_aKeySlots[MAX_ITEMS*2];
+
 public:
 	void Init();
 
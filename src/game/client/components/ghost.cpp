@@ -66,13 +66,19 @@ void CGhost::OnRender()
 	// Check if the race line is crossed then start the render of the ghost if one
 	bool start = false;
 
-	std::list < int > Indices = m_pClient->Collision()->GetMapIndices(m_pClient->m_PredictedPrevChar.m_Pos, m_pClient->m_LocalCharacterPos);
-	if(!Indices.empty())
+	int aIndices[CCollision::MAX_MAPINDICES];
+	int NextSample = 0;
+	int TotalIndices = 0;
+	do
 	{
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
-			if(m_pClient->Collision()->GetTileIndex(*i) == TILE_BEGIN) start = true;
+		int NumIndices = m_pClient->Collision()->GetMapIndices(m_pClient->m_PredictedPrevChar.m_Pos, m_pClient->m_LocalCharacterPos, aIndices, CCollision::MAX_MAPINDICES, &NextSample);
+		for(int i = 0; i < NumIndices; i++)
+			if(m_pClient->Collision()->GetTileIndex(aIndices[i]) == TILE_BEGIN) start = true;
+		TotalIndices += NumIndices;
 	}
-	else
+	while(NextSample > 0);
+
+	if(!TotalIndices)
 	{
 		start = m_pClient->Collision()->GetTileIndex(m_pClient->Collision()->GetPureMapIndex(m_pClient->m_LocalCharacterPos)) == TILE_BEGIN;
 	}
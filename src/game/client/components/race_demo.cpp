@@ -48,14 +48,22 @@ void CRaceDemo::OnRender()
 	if(m_DemoStartTick < Client()->GameTick())
 	{
 		bool start = false;
-		std::list < int > Indices = m_pClient->Collision()->GetMapIndices(m_pClient->m_PredictedPrevChar.m_Pos, m_pClient->m_LocalCharacterPos);
-		if(!Indices.empty())
-			for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+		int aIndices[CCollision::MAX_MAPINDICES];
+		int NextSample = 0;
+		int TotalIndices = 0;
+		do
+		{
+			int NumIndices = m_pClient->Collision()->GetMapIndices(m_pClient->m_PredictedPrevChar.m_Pos, m_pClient->m_LocalCharacterPos, aIndices, CCollision::MAX_MAPINDICES, &NextSample);
+			for(int i = 0; i < NumIndices; i++)
 			{
-				if(m_pClient->Collision()->GetTileIndex(*i) == TILE_BEGIN) start = true;
-				if(m_pClient->Collision()->GetFTileIndex(*i) == TILE_BEGIN) start = true;
+				if(m_pClient->Collision()->GetTileIndex(aIndices[i]) == TILE_BEGIN) start = true;
+				if(m_pClient->Collision()->GetFTileIndex(aIndices[i]) == TILE_BEGIN) start = true;
 			}
-		else
+			TotalIndices += NumIndices;
+		}
+		while(NextSample > 0);
+
+		if(!TotalIndices)
 		{
 			if(m_pClient->Collision()->GetTileIndex(m_pClient->Collision()->GetPureMapIndex(m_pClient->m_LocalCharacterPos)) == TILE_BEGIN) start = true;
 			if(m_pClient->Collision()->GetFTileIndex(m_pClient->Collision()->GetPureMapIndex(m_pClient->m_LocalCharacterPos)) == TILE_BEGIN) start = true;
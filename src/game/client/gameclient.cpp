@@ -1338,6 +1338,7 @@ void CGameClient::OnPredict()
 		g_GameClient.m_aClients[i].m_Predicted.Read(&m_Snap.m_aCharacters[i].m_Cur);
 		g_GameClient.m_aClients[i].m_Predicted.m_ActiveWeapon = m_Snap.m_aCharacters[i].m_Cur.m_Weapon;
 	}
+	World.UpdateCharacters();
 
 	CServerInfo Info;
 	Client()->GetServerInfo(&Info);
@@ -2234,6 +2235,7 @@ void CGameClient::FindWeaker(bool IsWeaker[2][MAX_CLIENTS])
 			LocalChar.Init(&World, Collision(), &m_Teams);
 			World.m_apCharacters[m_Snap.m_LocalClientID] = &LocalChar;
 			LocalChar.Read(&m_Snap.m_aCharacters[m_Snap.m_LocalClientID].m_Prev);
+			World.UpdateCharacters();
 
 			for(int Tick = Client()->PrevGameTick(); Tick < Client()->GameTick(); Tick++)
 			{
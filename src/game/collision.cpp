@@ -28,6 +28,7 @@ CCollision::CCollision()
 	m_pDoor = 0;
 	m_pSwitchers = 0;
 	m_pTune = 0;
+	m_pTileFlags = 0;
 }
 
 void CCollision::Init(class CLayers *pLayers)
@@ -161,6 +162,11 @@ void CCollision::Init(class CLayers *pLayers)
 				m_pTiles[i].m_Index = Index;
 		}
 	}
+
+	m_pTileFlags = new unsigned short[m_Width*m_Height];
+	for(int i = 0; i < m_Width*m_Height; i++)
+		UpdateTileFlags(i);
+
 	if(m_NumSwitchers)
 	{
 		m_pSwitchers = new SSwitchers[m_NumSwitchers+1];
@@ -178,22 +184,101 @@ void CCollision::Init(class CLayers *pLayers)
 	}
 }
 
-int CCollision::GetTile(int x, int y)
+void CCollision::UpdateTileFlags(int Index)
 {
-	if(!m_pTiles)
-		return 0;
+	int Flags = 0;
+
+	int Tile = m_pTiles[Index].m_Index;
+	if(Tile == COLFLAG_SOLID || Tile == (COLFLAG_SOLID|COLFLAG_NOHOOK))
+		Flags |= TFLAG_SOLID;
+	if(Tile == (COLFLAG_SOLID|COLFLAG_NOHOOK))
+		Flags |= TFLAG_NOHOOK;
+	if(Tile == COLFLAG_DEATH)
+		Flags |= TFLAG_DEATH;
+	if(Tile == TILE_NOLASER)
+		Flags |= TFLAG_NOLASER;
+	if(Tile == TILE_THROUGH)
+		Flags |= TFLAG_THROUGH;
 
-	int Nx = clamp(x/32, 0, m_Width-1);
-	int Ny = clamp(y/32, 0, m_Height-1);
-	int pos = Ny * m_Width + Nx;
+	if(m_pFront)
+	{
+		int Front = m_pFront[Index].m_Index;
+		if(Front == COLFLAG_DEATH)
+			Flags |= TFLAG_FDEATH;
+		if(Front == TILE_NOLASER)
+			Flags |= TFLAG_FNOLASER;
+		if(Front == TILE_THROUGH)
+			Flags |= TFLAG_THROUGH;
+	}
+
+	if(m_pTele)
+	{
+		if(m_pTele[Index].m_Type == TILE_TELEIN)
+			Flags |= TFLAG_TELEIN;
+		if(m_pTele[Index].m_Type == TILE_TELEINWEAPON)
+			Flags |= TFLAG_TELEINWEAPON;
+		if(m_pTele[Index].m_Type == TILE_TELEINHOOK)
+			Flags |= TFLAG_TELEINHOOK;
+	}
+	if(m_pSpeedup && m_pSpeedup[Index].m_Force > 0)
+		Flags |= TFLAG_SPEEDUP;
+	if(m_pSwitch && m_pSwitch[Index].m_Type > 0)
+		Flags |= TFLAG_SWITCH;
+	if(m_pTune && m_pTune[Index].m_Type)
+		Flags |= TFLAG_TUNE;
+
+	m_pTileFlags[Index] = Flags;
+}
 
-	if(m_pTiles[pos].m_Index == COLFLAG_SOLID
-		|| m_pTiles[pos].m_Index == (COLFLAG_SOLID|COLFLAG_NOHOOK)
-		|| m_pTiles[pos].m_Index == COLFLAG_DEATH
-		|| m_pTiles[pos].m_Index == TILE_NOLASER)
-		return m_pTiles[pos].m_Index;
+int CCollision::GetTile(int x, int y)
+{
+	int Flags = TileFlags(x, y);
+	if(Flags&TFLAG_SOLID)
+		return Flags&TFLAG_NOHOOK ? COLFLAG_SOLID|COLFLAG_NOHOOK : COLFLAG_SOLID;
+	if(Flags&TFLAG_DEATH)
+		return COLFLAG_DEATH;
+	if(Flags&TFLAG_NOLASER)
+		return TILE_NOLASER;
 	return 0;
 }
+int CCollision::SampleTile(vec2 Pos, bool Round)
+{
+	int Nx = clamp((Round ? round_to_int(Pos.x) : (int)Pos.x)/32, 0, m_Width-1);
+	int Ny = clamp((Round ? round_to_int(Pos.y) : (int)Pos.y)/32, 0, m_Height-1);
+	return Ny*m_Width+Nx;
+}
+
+static int SamplesToBorder(float Pos, float Step, int Tile, int NumTiles)
+{
+	// a sample stays in the tile while its rounded coordinate does, the outermost tiles
+	// extend to infinity because of the clamping
+	if(Step > 0.0f && Tile < NumTiles-1)
+		return (int)min((Tile*32+31.5f-Pos)/Step, 1e9f);
+	if(Step < 0.0f && Tile > 0)
+		return (int)min((Tile*32-0.5f-Pos)/Step, 1e9f);
+	return 1000000000;
+}
+
+/*
+	Returns how many samples after sample Index (up to sample Last) lie in the same
+	tile as it. Sample i is mix(Pos0, Pos1, i/Div), so its coordinates are monotonic
+	in i and every sample between two samples of the same tile is in that tile too.
+	The guess from the step size is only trusted after checking the sample it lands on.
+	Round selects whether the samples are rounded or truncated to pixels.
+*/
+int CCollision::SkipSamples(vec2 Pos0, vec2 Pos1, float Div, int Index, int Last, bool Round)
+{
+	vec2 Pos = mix(Pos0, Pos1, Index/Div);
+	int Tile = SampleTile(Pos, Round);
+	vec2 Step = (Pos1-Pos0)*(1.0f/Div);
+
+	int Skip = min(SamplesToBorder(Pos.x, Step.x, Tile%m_Width, m_Width), SamplesToBorder(Pos.y, Step.y, Tile/m_Width, m_Height));
+	Skip = clamp(Skip, 0, Last-Index);
+	while(Skip > 0 && SampleTile(mix(Pos0, Pos1, (Index+Skip)/Div), Round) != Tile)
+		Skip = Skip > 8 ? Skip-Skip/8-1 : Skip-1;
+	return Skip;
+}
+
 /*
 bool CCollision::IsTileSolid(int x, int y)
 {
@@ -228,6 +313,17 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			return GetCollisionAt(ix, iy);
 		}
 
+		if(!CheckPoint(ix, iy))
+		{
+			// nothing else in this tile can stop the line
+			int Skip = SkipSamples(Pos0, Pos1, (float)End, i, End);
+			if(Skip)
+			{
+				i += Skip;
+				Pos = mix(Pos0, Pos1, i/(float)End);
+			}
+		}
+
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -279,6 +375,17 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			return GetCollisionAt(ix, iy);
 		}
 
+		if(!CheckPoint(ix, iy) && !*pTeleNr)
+		{
+			// nothing else in this tile can stop the line
+			int Skip = SkipSamples(Pos0, Pos1, (float)End, i, End);
+			if(Skip)
+			{
+				i += Skip;
+				Pos = mix(Pos0, Pos1, i/(float)End);
+			}
+		}
+
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -330,6 +437,17 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			return GetCollisionAt(ix, iy);
 		}
 
+		if(!CheckPoint(ix, iy) && !*pTeleNr)
+		{
+			// nothing else in this tile can stop the line
+			int Skip = SkipSamples(Pos0, Pos1, (float)End, i, End);
+			if(Skip)
+			{
+				i += Skip;
+				Pos = mix(Pos0, Pos1, i/(float)End);
+			}
+		}
+
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -469,26 +587,19 @@ void CCollision::Dest()
 	m_pTune = 0;
 	m_pDoor = 0;
 	m_pSwitchers = 0;
+	if(m_pTileFlags)
+		delete[] m_pTileFlags;
+	m_pTileFlags = 0;
 }
 
 int CCollision::IsSolid(int x, int y)
 {
-	return (GetTile(x,y)&COLFLAG_SOLID);
+	return TileFlags(x, y)&TFLAG_SOLID ? COLFLAG_SOLID : 0;
 }
 
 int CCollision::IsThrough(int x, int y)
 {
-	int Nx = clamp(x/32, 0, m_Width-1);
-	int Ny = clamp(y/32, 0, m_Height-1);
-	int Index = m_pTiles[Ny*m_Width+Nx].m_Index;
-	int Findex = 0;
-	if (m_pFront)
-		Findex = m_pFront[Ny*m_Width+Nx].m_Index;
-	if (Index == TILE_THROUGH)
-		return Index;
-	if (Findex == TILE_THROUGH)
-		return Findex;
-	return 0;
+	return TileFlags(x, y)&TFLAG_THROUGH ? TILE_THROUGH : 0;
 }
 
 int CCollision::IsWallJump(int Index)
@@ -501,17 +612,17 @@ int CCollision::IsWallJump(int Index)
 
 int CCollision::IsNoLaser(int x, int y)
 {
-	return (CCollision::GetTile(x,y) == TILE_NOLASER);
+	return (TileFlags(x, y)&TFLAG_NOLASER) != 0;
 }
 
 int CCollision::IsFNoLaser(int x, int y)
 {
-	return (CCollision::GetFTile(x,y) == TILE_NOLASER);
+	return (TileFlags(x, y)&TFLAG_FNOLASER) != 0;
 }
 
 int CCollision::IsTeleport(int Index)
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !(m_pTileFlags[Index]&TFLAG_TELEIN))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEIN)
@@ -575,7 +686,7 @@ int CCollision::IsTCheckpoint(int Index)
 
 int CCollision::IsTeleportWeapon(int Index)
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !(m_pTileFlags[Index]&TFLAG_TELEINWEAPON))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINWEAPON)
@@ -586,7 +697,7 @@ int CCollision::IsTeleportWeapon(int Index)
 
 int CCollision::IsTeleportHook(int Index)
 {
-	if(Index < 0 || !m_pTele)
+	if(Index < 0 || !m_pTele || !(m_pTileFlags[Index]&TFLAG_TELEINHOOK))
 		return 0;
 
 	if(m_pTele[Index].m_Type == TILE_TELEINHOOK)
@@ -601,7 +712,7 @@ int CCollision::IsSpeedup(int Index)
 	if(Index < 0 || !m_pSpeedup)
 		return 0;
 
-	if(m_pSpeedup[Index].m_Force > 0)
+	if(m_pTileFlags[Index]&TFLAG_SPEEDUP)
 		return Index;
 
 	return 0;
@@ -612,7 +723,7 @@ int CCollision::IsTune(int Index)
 	if(Index < 0 || !m_pTune)
 		return 0;
 
-	if(m_pTune[Index].m_Type)
+	if(m_pTileFlags[Index]&TFLAG_TUNE)
 		return m_pTune[Index].m_Number;
 
 	return 0;
@@ -632,7 +743,7 @@ void CCollision::GetSpeedup(int Index, vec2 *Dir, int *Force, int *MaxSpeed)
 int CCollision::IsSwitch(int Index)
 {
 	//dbg_msg("IsSwitch","Index %d, pSwitch %d, m_Type %d, m_Number %d", Index, m_pSwitch, (m_pSwitch)?m_pSwitch[Index].m_Type:0, (m_pSwitch)?m_pSwitch[Index].m_Number:0);
-	if(Index < 0 || !m_pSwitch)
+	if(Index < 0 || !m_pSwitch || !(m_pTileFlags[Index]&TFLAG_SWITCH))
 		return 0;
 
 	if(m_pSwitch[Index].m_Type > 0)
@@ -798,9 +909,11 @@ int CCollision::GetMapIndex(vec2 Pos)
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices)
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, int *pNextSample)
 {
-	std::list< int > Indices;
+	int Num = 0;
+	int Start = *pNextSample;
+	*pNextSample = -1;
 	float d = distance(PrevPos, Pos);
 	int End(d + 1);
 	if(!d)
@@ -812,13 +925,9 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 		else if (m_pTele && m_pTele[Index].m_Type==TILE_TELEOUT) dbg_msg("TELEOUT","Index %d",Index);
 		else dbg_msg("GetMapIndex(","Index %d",Index);//REMOVE */
 
-		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
+		if(TileExists(Index) && MaxIndices > 0)
+			pIndices[Num++] = Index;
+		return Num;
 	}
 	else
 	{
@@ -826,8 +935,9 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 		vec2 Tmp = vec2(0, 0);
 		int Nx = 0;
 		int Ny = 0;
-		int Index,LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		// a continued walk stopped at an index that did not fit anymore
+		int Index,LastIndex = Start > 0 ? -1 : 0;
+		for(int i = max(Start, 0); i < End; i++)
 		{
 			a = i/d;
 			Tmp = mix(PrevPos, Pos, a);
@@ -838,15 +948,21 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 			//dbg_msg("index","%d",Index);
 			if(TileExists(Index) && LastIndex != Index)
 			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
+				if(Num == MaxIndices)
+				{
+					*pNextSample = i;
+					return Num;
+				}
+				pIndices[Num++] = Index;
 				LastIndex = Index;
 				//dbg_msg("pushed","%d",Index);
 			}
+
+			// the other samples in this tile would give the same index
+			i += SkipSamples(PrevPos, Pos, d, i, End-1, false);
 		}
 
-		return Indices;
+		return Num;
 	}
 }
 
@@ -954,14 +1070,12 @@ int CCollision::GetFTile(int x, int y)
 {
 	if(!m_pFront)
 	return 0;
-	int Nx = clamp(x/32, 0, m_Width-1);
-	int Ny = clamp(y/32, 0, m_Height-1);
-	/*dbg_msg("GetFTile","m_Index %d",m_pFront[Ny*m_Width+Nx].m_Index);//Remove */
-	if(m_pFront[Ny*m_Width+Nx].m_Index == COLFLAG_DEATH
-		|| m_pFront[Ny*m_Width+Nx].m_Index == TILE_NOLASER)
-		return m_pFront[Ny*m_Width+Nx].m_Index;
-	else
-		return 0;
+	int Flags = TileFlags(x, y);
+	if(Flags&TFLAG_FDEATH)
+		return COLFLAG_DEATH;
+	if(Flags&TFLAG_FNOLASER)
+		return TILE_NOLASER;
+	return 0;
 }
 
 int CCollision::Entity(int x, int y, int Layer)
@@ -1021,6 +1135,7 @@ void CCollision::SetCollisionAt(float x, float y, int flag)
 	int Ny = clamp(round_to_int(y)/32, 0, m_Height-1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = flag;
+	UpdateTileFlags(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1092,6 +1207,7 @@ void ThroughOffset(vec2 Pos0, vec2 Pos1, int *Ox, int *Oy)
 int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
+	int LastSample = (int)ceilf(d)-1;
 	vec2 Last = Pos0;
 
 	for(float f = 0; f < d; f++)
@@ -1113,6 +1229,9 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 			else return GetCollisionAt(Pos.x, Pos.y);
 
 		}
+		// nothing else in this tile can stop the line
+		f += SkipSamples(Pos0, Pos1, d, (int)f, LastSample);
+		Pos = mix(Pos0, Pos1, f/d);
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -1125,6 +1244,7 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
+	int LastSample = (int)ceilf(d)-1;
 	vec2 Last = Pos0;
 
 	for(float f = 0; f < d; f++)
@@ -1140,6 +1260,9 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 			if(IsNoLaser(round_to_int(Pos.x), round_to_int(Pos.y))) return GetCollisionAt(Pos.x, Pos.y);
 			else return  GetFCollisionAt(Pos.x, Pos.y);
 		}
+		// nothing else in this tile can stop the line
+		f += SkipSamples(Pos0, Pos1, d, (int)f, LastSample);
+		Pos = mix(Pos0, Pos1, f/d);
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -1152,6 +1275,7 @@ int CCollision::IntersectNoLaserNW(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, ve
 int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
 {
 	float d = distance(Pos0, Pos1);
+	int LastSample = (int)ceilf(d)-1;
 	vec2 Last = Pos0;
 
 	for(float f = 0; f < d; f++)
@@ -1170,6 +1294,9 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 				if (!GetTile(round_to_int(Pos.x), round_to_int(Pos.y))) return GetTile(round_to_int(Pos.x), round_to_int(Pos.y));
 				else return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
+		// nothing else in this tile can stop the line
+		f += SkipSamples(Pos0, Pos1, d, (int)f, LastSample);
+		Pos = mix(Pos0, Pos1, f/d);
 		Last = Pos;
 	}
 	if(pOutCollision)
@@ -15,6 +15,34 @@ class CCollision
 	int m_Height;
 	class CLayers *m_pLayers;
 
+	// per tile summary of all layers, built in Init so the hot checks touch one small array
+	enum
+	{
+		TFLAG_SOLID=1<<0,
+		TFLAG_NOHOOK=1<<1,
+		TFLAG_DEATH=1<<2,
+		TFLAG_NOLASER=1<<3,
+		TFLAG_THROUGH=1<<4,
+		TFLAG_FDEATH=1<<5,
+		TFLAG_FNOLASER=1<<6,
+		TFLAG_TELEIN=1<<7,
+		TFLAG_TELEINWEAPON=1<<8,
+		TFLAG_TELEINHOOK=1<<9,
+		TFLAG_SPEEDUP=1<<10,
+		TFLAG_SWITCH=1<<11,
+		TFLAG_TUNE=1<<12,
+	};
+	unsigned short *m_pTileFlags;
+	void UpdateTileFlags(int Index);
+	int TileFlags(int x, int y)
+	{
+		if(!m_pTileFlags)
+			return 0;
+		int Nx = clamp(x/32, 0, m_Width-1);
+		int Ny = clamp(y/32, 0, m_Height-1);
+		return m_pTileFlags[Ny*m_Width+Nx];
+	}
+
 	//bool IsTileSolid(int x, int y);
 	//int GetTile(int x, int y);
 
@@ -30,6 +58,11 @@ public:
 		COLFLAG_TELE=32
 	};
 
+	enum
+	{
+		MAX_MAPINDICES=256,
+	};
+
 	CCollision();
 	void Init(class CLayers *pLayers);
 	bool CheckPoint(float x, float y) { return IsSolid(round_to_int(x), round_to_int(y)); }
@@ -66,7 +99,8 @@ public:
 	int GetFTile(int x, int y);
 	int Entity(int x, int y, int Layer);
 	int GetPureMapIndex(vec2 Pos);
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0);
+	// a full buffer does not end the walk, *pNextSample is where the next call continues (0 to start, -1 when done)
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices, int *pNextSample);
 	int GetMapIndex(vec2 Pos);
 	bool TileExists(int Index);
 	bool TileExistsNext(int Index);
@@ -111,6 +145,11 @@ public:
 
 private:
 
+	// the intersection functions sample the line at fixed steps and test the tile under
+	// each sample. These let them jump over the samples that fall into a tile already tested.
+	int SampleTile(vec2 Pos, bool Round);
+	int SkipSamples(vec2 Pos0, vec2 Pos1, float Div, int Index, int Last, bool Round = true);
+
 	class CTeleTile *m_pTele;
 	class CSpeedupTile *m_pSpeedup;
 	class CTile *m_pFront;
@@ -12,6 +12,126 @@ const char *CTuningParams::m_apNames[] =
 };
 
 
+int CWorldCore::BucketCoord(float Value)
+{
+	// far off (or NaN) positions share the outermost cells
+	if(!(Value > -1000000.0f))
+		return -1000000/BUCKET_CELLSIZE;
+	if(Value > 1000000.0f)
+		return 1000000/BUCKET_CELLSIZE;
+	return (int)floorf(Value/BUCKET_CELLSIZE);
+}
+
+void CWorldCore::UnlinkCharacter(int ClientID)
+{
+	int Bucket = m_aCharacterBucket[ClientID];
+	if(Bucket < 0)
+		return;
+
+	if(m_aPrevInBucket[ClientID] >= 0)
+		m_aNextInBucket[m_aPrevInBucket[ClientID]] = m_aNextInBucket[ClientID];
+	else
+		m_aFirstInBucket[Bucket] = m_aNextInBucket[ClientID];
+	if(m_aNextInBucket[ClientID] >= 0)
+		m_aPrevInBucket[m_aNextInBucket[ClientID]] = m_aPrevInBucket[ClientID];
+	m_aCharacterBucket[ClientID] = -1;
+}
+
+void CWorldCore::UpdateCharacter(int ClientID)
+{
+	if(ClientID < 0 || ClientID >= MAX_CLIENTS)
+		return;
+
+	CCharacterCore *pCharCore = m_apCharacters[ClientID];
+	int Bucket = -1;
+	if(pCharCore)
+	{
+		pCharCore->m_WorldID = ClientID;
+		Bucket = CellBucket(BucketCoord(pCharCore->m_Pos.x), BucketCoord(pCharCore->m_Pos.y));
+	}
+	if(Bucket == m_aCharacterBucket[ClientID])
+		return;
+
+	UnlinkCharacter(ClientID);
+	if(Bucket < 0)
+		return;
+	m_aCharacterBucket[ClientID] = Bucket;
+	m_aPrevInBucket[ClientID] = -1;
+	m_aNextInBucket[ClientID] = m_aFirstInBucket[Bucket];
+	if(m_aFirstInBucket[Bucket] >= 0)
+		m_aPrevInBucket[m_aFirstInBucket[Bucket]] = ClientID;
+	m_aFirstInBucket[Bucket] = ClientID;
+}
+
+void CWorldCore::UpdateCharacters()
+{
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		UpdateCharacter(i);
+}
+
+int CWorldCore::FindCharacters(vec2 Min, vec2 Max, int *pIDs, int Extra) const
+{
+	int Num = FindCharactersImpl(Min, Max, pIDs, Extra, true);
+
+	if(g_Config.m_DbgSpatialIndex)
+	{
+		int aCheck[MAX_CLIENTS];
+		int CheckNum = FindCharactersImpl(Min, Max, aCheck, Extra, false);
+		if(CheckNum != Num || mem_comp(aCheck, pIDs, Num*sizeof(int)) != 0)
+			dbg_msg("gamecore", "character buckets mismatch min=%.1f,%.1f max=%.1f,%.1f num=%d expected=%d", Min.x, Min.y, Max.x, Max.y, Num, CheckNum);
+	}
+
+	return Num;
+}
+
+int CWorldCore::FindCharactersImpl(vec2 Min, vec2 Max, int *pIDs, int Extra, bool UseIndex) const
+{
+	// widen the box a bit, the narrow-phase works on rounded float distances
+	Min -= vec2(1.0f, 1.0f);
+	Max += vec2(1.0f, 1.0f);
+
+	int X0 = BucketCoord(Min.x), Y0 = BucketCoord(Min.y);
+	int X1 = BucketCoord(Max.x), Y1 = BucketCoord(Max.y);
+	if(X1-X0 >= MAX_BUCKET_CELLS || Y1-Y0 >= MAX_BUCKET_CELLS || (X1-X0+1)*(Y1-Y0+1) > MAX_BUCKET_CELLS)
+		UseIndex = false;
+
+	// mark the hits, hashed cells can share a bucket and the ids have to come out sorted
+	unsigned aFound[(MAX_CLIENTS+31)/32] = {0};
+	if(UseIndex)
+	{
+		for(int y = Y0; y <= Y1; y++)
+			for(int x = X0; x <= X1; x++)
+				for(int i = m_aFirstInBucket[CellBucket(x, y)]; i >= 0; i = m_aNextInBucket[i])
+				{
+					const CCharacterCore *pCharCore = m_apCharacters[i];
+					if(pCharCore && pCharCore->m_Pos.x >= Min.x && pCharCore->m_Pos.x <= Max.x && pCharCore->m_Pos.y >= Min.y && pCharCore->m_Pos.y <= Max.y)
+						aFound[i/32] |= 1u<<(i%32);
+				}
+	}
+	else
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			const CCharacterCore *pCharCore = m_apCharacters[i];
+			if(pCharCore && pCharCore->m_Pos.x >= Min.x && pCharCore->m_Pos.x <= Max.x && pCharCore->m_Pos.y >= Min.y && pCharCore->m_Pos.y <= Max.y)
+				aFound[i/32] |= 1u<<(i%32);
+		}
+	}
+	if(Extra >= 0 && Extra < MAX_CLIENTS && m_apCharacters[Extra])
+		aFound[Extra/32] |= 1u<<(Extra%32);
+
+	int Num = 0;
+	for(int w = 0; w < (MAX_CLIENTS+31)/32; w++)
+		for(unsigned Bits = aFound[w]; Bits; Bits &= Bits-1)
+		{
+			int Bit = 0;
+			while(!(Bits&(1u<<Bit)))
+				Bit++;
+			pIDs[Num++] = w*32+Bit;
+		}
+	return Num;
+}
+
 bool CTuningParams::Set(int Index, float Value)
 {
 	if(Index < 0 || Index >= Num())
@@ -65,6 +185,7 @@ void CCharacterCore::Init(CWorldCore *pWorld, CCollision *pCollision, CTeamsCore
 
 	m_pTeams = pTeams;
 	m_Id = -1;
+	m_WorldID = -1;
 	m_Hook = true;
 	m_Collision = true;
 	m_JumpedTotal = 0;
@@ -79,6 +200,7 @@ void CCharacterCore::Init(CWorldCore *pWorld, CCollision *pCollision, CTeamsCore
 
 	m_pTeams = pTeams;
 	m_Id = -1;
+	m_WorldID = -1;
 	m_Hook = true;
 	m_Collision = true;
 	m_JumpedTotal = 0;
@@ -292,8 +414,14 @@ void CCharacterCore::Tick(bool UseInput, bool IsClient)
 		if(this->m_Hook && m_pWorld && m_pWorld->m_Tuning[g_Config.m_ClDummy].m_PlayerHooking)
 		{
 			float Distance = 0.0f;
-			for(int i = 0; i < MAX_CLIENTS; i++)
+			float Reach = PhysSize+2.0f;
+			int aIDs[MAX_CLIENTS];
+			int Num = m_pWorld->FindCharacters(
+				vec2(min(m_HookPos.x, NewPos.x)-Reach, min(m_HookPos.y, NewPos.y)-Reach),
+				vec2(max(m_HookPos.x, NewPos.x)+Reach, max(m_HookPos.y, NewPos.y)+Reach), aIDs);
+			for(int n = 0; n < Num; n++)
 			{
+				int i = aIDs[n];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 				if(!pCharCore || pCharCore == this || !m_pTeams->CanCollide(i, m_Id))
 					continue;
@@ -400,8 +528,13 @@ void CCharacterCore::Tick(bool UseInput, bool IsClient)
 
 	if(m_pWorld)
 	{
-		for(int i = 0; i < MAX_CLIENTS; i++)
+		// only close characters collide, the hooked one is dragged from any distance
+		float Reach = PhysSize*1.25f;
+		int aIDs[MAX_CLIENTS];
+		int Num = m_pWorld->FindCharacters(m_Pos-vec2(Reach, Reach), m_Pos+vec2(Reach, Reach), aIDs, m_HookedPlayer);
+		for(int n = 0; n < Num; n++)
 		{
+			int i = aIDs[n];
 			CCharacterCore *pCharCore = m_pWorld->m_apCharacters[i];
 			if(!pCharCore)
 				continue;
@@ -587,6 +720,8 @@ void CCharacterCore::Tick(bool UseInput, bool IsClient)
 	// clamp the velocity to something sane
 	if(length(m_Vel) > 6000)
 		m_Vel = normalize(m_Vel) * 6000;
+
+	UpdateWorldBucket();
 }
 
 void CCharacterCore::Move()
@@ -619,12 +754,20 @@ void CCharacterCore::Move()
 		float Distance = distance(m_Pos, NewPos);
 		int End = Distance+1;
 		vec2 LastPos = m_Pos;
+
+		// only characters near the swept path can block it
+		int aIDs[MAX_CLIENTS];
+		int Num = m_pWorld->FindCharacters(
+			vec2(min(m_Pos.x, NewPos.x)-28.0f, min(m_Pos.y, NewPos.y)-28.0f),
+			vec2(max(m_Pos.x, NewPos.x)+28.0f, max(m_Pos.y, NewPos.y)+28.0f), aIDs);
+
 		for(int i = 0; i < End; i++)
 		{
 			float a = i/Distance;
 			vec2 Pos = mix(m_Pos, NewPos, a);
-			for(int p = 0; p < MAX_CLIENTS; p++)
+			for(int n = 0; n < Num; n++)
 			{
+				int p = aIDs[n];
 				CCharacterCore *pCharCore = m_pWorld->m_apCharacters[p];
 				if(!pCharCore || pCharCore == this || !pCharCore->m_Collision || (m_Id != -1 && !m_pTeams->CanCollide(m_Id, p)))
 					continue;
@@ -635,6 +778,7 @@ void CCharacterCore::Move()
 						m_Pos = LastPos;
 					else if(distance(NewPos, pCharCore->m_Pos) > D)
 						m_Pos = NewPos;
+					UpdateWorldBucket();
 					return;
 				}
 				else if(D <= 0.001f && D >= -0.001f)
@@ -643,6 +787,7 @@ void CCharacterCore::Move()
 						m_Pos = LastPos;
 					else if(distance(NewPos, pCharCore->m_Pos) > D)
 						m_Pos = NewPos;
+					UpdateWorldBucket();
 					return;
 				}
 			}
@@ -651,6 +796,7 @@ void CCharacterCore::Move()
 	}
 
 	m_Pos = NewPos;
+	UpdateWorldBucket();
 }
 
 void CCharacterCore::Write(CNetObj_CharacterCore *pObjCore)
@@ -695,6 +841,14 @@ void CCharacterCore::Quantize()
 	CNetObj_CharacterCore Core;
 	Write(&Core);
 	Read(&Core);
+	UpdateWorldBucket();
+}
+
+void CCharacterCore::UpdateWorldBucket()
+{
+	// copies of a core (send core, reckoning core) aren't in the world
+	if(m_pWorld && m_WorldID >= 0 && m_WorldID < MAX_CLIENTS && m_pWorld->m_apCharacters[m_WorldID] == this)
+		m_pWorld->UpdateCharacter(m_WorldID);
 }
 
 // DDRace
@@ -173,10 +173,44 @@ public:
 	CWorldCore()
 	{
 		mem_zero(m_apCharacters, sizeof(m_apCharacters));
+		for(int i = 0; i < NUM_CHARACTER_BUCKETS; i++)
+			m_aFirstInBucket[i] = -1;
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			m_aCharacterBucket[i] = -1;
 	}
 
+	enum
+	{
+		BUCKET_CELLSIZE = 128,
+		NUM_CHARACTER_BUCKETS = 128, // power of two, cells are hashed into them
+		MAX_BUCKET_CELLS = 32, // larger boxes walk all characters
+	};
+
 	CTuningParams m_Tuning[2];
 	class CCharacterCore *m_apCharacters[MAX_CLIENTS];
+
+	// broad-phase: collects the ids of the characters whose position lies
+	// within the box (bounds included), in ascending id order so the narrow-phase
+	// visits them exactly like a loop over all characters. Extra is always added
+	// if that character exists. Returns the number of ids written to pIDs.
+	int FindCharacters(vec2 Min, vec2 Max, int *pIDs, int Extra = -1) const;
+
+	// the broad-phase buckets characters by cell. the cores keep their own
+	// bucket up to date in Tick, Move and Quantize, anything else that sets
+	// m_apCharacters or moves a character has to call one of these
+	void UpdateCharacters();
+	void UpdateCharacter(int ClientID);
+
+private:
+	int m_aFirstInBucket[NUM_CHARACTER_BUCKETS];
+	int m_aNextInBucket[MAX_CLIENTS];
+	int m_aPrevInBucket[MAX_CLIENTS];
+	int m_aCharacterBucket[MAX_CLIENTS]; // -1 if not bucketed
+
+	static int BucketCoord(float Value);
+	static int CellBucket(int x, int y) { return ((unsigned)x*73856093u ^ (unsigned)y*19349663u)&(NUM_CHARACTER_BUCKETS-1); }
+	void UnlinkCharacter(int ClientID);
+	int FindCharactersImpl(vec2 Min, vec2 Max, int *pIDs, int Extra, bool UseIndex) const;
 };
 
 class CCharacterCore
@@ -224,6 +258,7 @@ public:
 	// DDRace
 
 	int m_Id;
+	int m_WorldID; // slot in m_pWorld->m_apCharacters, set by the world
 	bool m_pReset;
 	class CCollision *Collision() { return m_pCollision; }
 
@@ -235,6 +270,7 @@ public:
 	void ApplyForce(vec2 Force);
 
 private:
+	void UpdateWorldBucket();
 
 	CTeamsCore* m_pTeams;
 	int m_TileIndex;
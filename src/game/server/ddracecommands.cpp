@@ -282,6 +282,8 @@ void CGameContext::ConToTeleporter(IConsole::IResult *pResult, void *pUserData)
 		{
 			pChr->Core()->m_Pos = TelePos;
 			pChr->m_Pos = TelePos;
+			pSelf->m_World.UpdateEntityPos(pChr);
+			pSelf->m_World.m_Core.UpdateCharacter(pChr->GetPlayer()->GetCID());
 			pChr->m_PrevPos = TelePos;
 			pChr->m_DDRaceState = DDRACE_CHEAT;
 		}
@@ -302,6 +304,8 @@ void CGameContext::ConToCheckTeleporter(IConsole::IResult *pResult, void *pUserD
 		{
 			pChr->Core()->m_Pos = TelePos;
 			pChr->m_Pos = TelePos;
+			pSelf->m_World.UpdateEntityPos(pChr);
+			pSelf->m_World.m_Core.UpdateCharacter(pChr->GetPlayer()->GetCID());
 			pChr->m_PrevPos = TelePos;
 			pChr->m_DDRaceState = DDRACE_CHEAT;
 			pChr->m_TeleCheckpoint = TeleTo;
@@ -324,6 +328,8 @@ void CGameContext::ConTeleport(IConsole::IResult *pResult, void *pUserData)
 		{
 			pChr->Core()->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
 			pChr->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
+			pSelf->m_World.UpdateEntityPos(pChr);
+			pSelf->m_World.m_Core.UpdateCharacter(pChr->GetPlayer()->GetCID());
 			pChr->m_PrevPos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
 			pChr->m_DDRaceState = DDRACE_CHEAT;
 		}
@@ -51,6 +51,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 	m_Core.m_ActiveWeapon = WEAPON_GUN;
 	m_Core.m_Pos = m_Pos;
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = &m_Core;
+	GameServer()->m_World.m_Core.UpdateCharacter(m_pPlayer->GetCID());
 
 	m_ReckoningTick = 0;
 	mem_zero(&m_SendCore, sizeof(m_SendCore));
@@ -79,6 +80,7 @@ bool CCharacter::Spawn(CPlayer *pPlayer, vec2 Pos)
 void CCharacter::Destroy()
 {
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+	GameServer()->m_World.m_Core.UpdateCharacter(m_pPlayer->GetCID());
 	m_Alive = false;
 }
 
@@ -760,6 +762,9 @@ void CCharacter::Tick()
 	// Previnput
 	m_PrevInput = m_Input;
 
+	// the tiles may have teleported the core
+	GameWorld()->m_Core.UpdateCharacter(m_pPlayer->GetCID());
+
 	m_PrevPos = m_Core.m_Pos;
 	return;
 }
@@ -830,6 +835,9 @@ void CCharacter::TickDefered()
 		m_Pos.y = m_Input.m_TargetY;
 	}
 
+	// m_Pos is final for this tick
+	GameWorld()->UpdateEntityPos(this);
+
 	// update the m_SendCore if needed
 	{
 		CNetObj_Character Predicted;
@@ -910,6 +918,7 @@ void CCharacter::Die(int Killer, int Weapon)
 	m_Alive = false;
 	GameServer()->m_World.RemoveEntity(this);
 	GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+	GameServer()->m_World.m_Core.UpdateCharacter(m_pPlayer->GetCID());
 	GameServer()->CreateDeath(m_Pos, m_pPlayer->GetCID(), Teams()->TeamMask(Team(), -1, m_pPlayer->GetCID()));
 	Teams()->OnCharacterDeath(GetPlayer()->GetCID(), Weapon);
 }
@@ -2073,15 +2082,26 @@ void CCharacter::DDRacePostCoreTick()
 	int CurrentIndex = GameServer()->Collision()->GetMapIndex(m_Pos);
 	HandleSkippableTiles(CurrentIndex);
 
-	// handle Anti-Skip tiles
-	std::list < int > Indices = GameServer()->Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-		for(std::list < int >::iterator i = Indices.begin(); i != Indices.end(); i++)
+	// handle Anti-Skip tiles, long moves come in several chunks
+	// the tiles can teleport, the whole walk uses the positions from before
+	vec2 PrevPos = m_PrevPos;
+	vec2 Pos = m_Pos;
+	int aIndices[CCollision::MAX_MAPINDICES];
+	int NextSample = 0;
+	int TotalIndices = 0;
+	do
+	{
+		int NumIndices = GameServer()->Collision()->GetMapIndices(PrevPos, Pos, aIndices, CCollision::MAX_MAPINDICES, &NextSample);
+		for(int i = 0; i < NumIndices; i++)
 		{
-			HandleTiles(*i);
-			//dbg_msg("Running","%d", *i);
+			HandleTiles(aIndices[i]);
+			//dbg_msg("Running","%d", aIndices[i]);
 		}
-	else
+		TotalIndices += NumIndices;
+	}
+	while(NextSample > 0);
+
+	if(!TotalIndices)
 	{
 		HandleTiles(CurrentIndex);
 		//dbg_msg("Running","%d", CurrentIndex);
@@ -2150,6 +2170,7 @@ void CCharacter::Pause(bool Pause)
 	if(Pause)
 	{
 		GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = 0;
+		GameServer()->m_World.m_Core.UpdateCharacter(m_pPlayer->GetCID());
 		GameServer()->m_World.RemoveEntity(this);
 
 		if (m_Core.m_HookedPlayer != -1) // Keeping hook would allow cheats
@@ -2163,6 +2184,7 @@ void CCharacter::Pause(bool Pause)
 	{
 		m_Core.m_Vel = vec2(0,0);
 		GameServer()->m_World.m_Core.m_apCharacters[m_pPlayer->GetCID()] = &m_Core;
+		GameServer()->m_World.m_Core.UpdateCharacter(m_pPlayer->GetCID());
 		GameServer()->m_World.InsertEntity(this);
 	}
 }
@@ -2225,6 +2247,8 @@ void CCharacter::Rescue()
 			m_LastRescue = Server()->Tick();
 			m_Core.m_Pos = m_PrevSavePos;
 			m_Pos = m_PrevSavePos;
+			GameWorld()->UpdateEntityPos(this);
+			GameWorld()->m_Core.UpdateCharacter(m_pPlayer->GetCID());
 			m_PrevPos = m_PrevSavePos;
 			m_Core.m_Vel = vec2(0, 0);
 			m_Core.m_HookedPlayer = -1;
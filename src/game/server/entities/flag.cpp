@@ -31,6 +31,19 @@ void CFlag::TickPaused()
 		++m_GrabTick;
 }
 
+bool CFlag::SnapShared()
+{
+	CNetObj_Flag *pFlag = (CNetObj_Flag *)GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_FLAG, m_Team, sizeof(CNetObj_Flag),
+		CSharedSnap::FLAG_CLIP, m_Pos);
+	if(!pFlag)
+		return false;
+
+	pFlag->m_X = (int)m_Pos.x;
+	pFlag->m_Y = (int)m_Pos.y;
+	pFlag->m_Team = m_Team;
+	return true;
+}
+
 void CFlag::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
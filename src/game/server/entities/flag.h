@@ -24,6 +24,7 @@ public:
 	virtual void Reset();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapShared();
 };
 
 #endif
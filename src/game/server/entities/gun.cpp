@@ -110,6 +110,25 @@ void CGun::Tick()
 
 }
 
+bool CGun::SnapShared()
+{
+	// switch layer turrets blink depending on the team of the snapping client
+	if(m_Layer == LAYER_SWITCH)
+		return false;
+
+	CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_LASER, m_ID, sizeof(CNetObj_Laser),
+		CSharedSnap::FLAG_CLIP, m_Pos));
+	if(!pObj)
+		return false;
+
+	pObj->m_X = (int)m_Pos.x;
+	pObj->m_Y = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_Pos.x;
+	pObj->m_FromY = (int)m_Pos.y;
+	pObj->m_StartTick = m_EvalTick;
+	return true;
+}
+
 void CGun::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
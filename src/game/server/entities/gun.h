@@ -25,6 +25,7 @@ public:
 	virtual void Reset();
 	virtual void Tick();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapShared();
 };
 
 
@@ -187,6 +187,31 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
+bool CLaser::SnapShared()
+{
+	CCharacter *pOwnerChar = 0;
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+	if(!pOwnerChar)
+		return true;
+
+	int64_t TeamMask = -1LL;
+	if(pOwnerChar->IsAlive())
+		TeamMask = pOwnerChar->Teams()->TeamMask(pOwnerChar->Team(), -1, m_Owner);
+
+	CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_LASER, m_ID, sizeof(CNetObj_Laser),
+		CSharedSnap::FLAG_CLIP|CSharedSnap::FLAG_TEAMMASK, m_Pos, TeamMask));
+	if(!pObj)
+		return false;
+
+	pObj->m_X = (int)m_Pos.x;
+	pObj->m_Y = (int)m_Pos.y;
+	pObj->m_FromX = (int)m_From.x;
+	pObj->m_FromY = (int)m_From.y;
+	pObj->m_StartTick = m_EvalTick;
+	return true;
+}
+
 void CLaser::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
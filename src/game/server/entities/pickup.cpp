@@ -146,6 +146,23 @@ void CPickup::TickPaused()
 		++m_SpawnTick;*/
 }
 
+bool CPickup::SnapShared()
+{
+	// switch layer pickups blink depending on the team of the snapping client
+	if(m_Layer == LAYER_SWITCH)
+		return false;
+
+	CNetObj_Pickup *pP = static_cast<CNetObj_Pickup *>(GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_PICKUP, m_ID, sizeof(CNetObj_Pickup)));
+	if(!pP)
+		return false;
+
+	pP->m_X = (int)m_Pos.x;
+	pP->m_Y = (int)m_Pos.y;
+	pP->m_Type = m_Type;
+	pP->m_Subtype = m_Subtype;
+	return true;
+}
+
 void CPickup::Snap(int SnappingClient)
 {
 	/*if(m_SpawnTick != -1 || NetworkClipped(SnappingClient))
@@ -232,6 +232,41 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+bool CProjectile::SnapShared()
+{
+	// switch layer projectiles blink depending on the team of the snapping client
+	if(m_Layer == LAYER_SWITCH)
+		return false;
+
+	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
+
+	CCharacter *pOwnerChar = 0;
+	int64_t TeamMask = -1LL;
+
+	if(m_Owner >= 0)
+		pOwnerChar = GameServer()->GetPlayerChar(m_Owner);
+
+	if (pOwnerChar && pOwnerChar->IsAlive())
+			TeamMask = pOwnerChar->Teams()->TeamMask(pOwnerChar->Team(), -1, m_Owner);
+
+	int Flags = CSharedSnap::FLAG_CLIP;
+	if(m_Owner != -1)
+		Flags |= CSharedSnap::FLAG_TEAMMASK;
+
+	CNetObj_Projectile *pProj = static_cast<CNetObj_Projectile *>(GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_PROJECTILE, m_ID, sizeof(CNetObj_Projectile),
+		Flags|CSharedSnap::FLAG_NOANTIPING, GetPos(Ct), TeamMask));
+	if(!pProj)
+		return false;
+	FillInfo(pProj);
+
+	pProj = static_cast<CNetObj_Projectile *>(GameWorld()->m_SharedSnap.Create(this, NETOBJTYPE_PROJECTILE, m_ID, sizeof(CNetObj_Projectile),
+		Flags|CSharedSnap::FLAG_ANTIPING, GetPos(Ct), TeamMask));
+	if(!pProj)
+		return false;
+	FillExtraInfo(pProj);
+	return true;
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick()-m_StartTick)/(float)Server()->TickSpeed();
@@ -20,6 +20,14 @@ CEntity::CEntity(CGameWorld *pGameWorld, int ObjType)
 
 	m_pPrevTypeEntity = 0;
 	m_pNextTypeEntity = 0;
+
+	m_SharedSnapFirst = -1;
+	m_SharedSnapNum = 0;
+
+	m_pPrevCellEntity = 0;
+	m_pNextCellEntity = 0;
+	m_Cell = -1;
+	m_InsertSeq = 0;
 }
 
 CEntity::~CEntity()
@@ -62,6 +62,16 @@ class CEntity
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	// range of this entity's items in the shared snap, -1 if it has to be snapped per client
+	int m_SharedSnapFirst;
+	int m_SharedSnapNum;
+
+	// spatial index links, m_Cell is -1 if the entity isn't in the index
+	CEntity *m_pPrevCellEntity;
+	CEntity *m_pNextCellEntity;
+	int m_Cell;
+	unsigned m_InsertSeq;
+
 protected:
 	class CGameWorld *m_pGameWorld;
 	bool m_MarkedForDestroy;
@@ -124,6 +134,21 @@ public:
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: SnapShared
+			Called once per snapshot tick before the per client
+			snapshots are built. Entities whose snapshot items only
+			depend on network clipping, a team mask and the client
+			version can add them to GameWorld()->m_SharedSnap here
+			and return true. Snap() is then not called for them and
+			the shared items get filtered for every client instead.
+
+		Returns:
+			True if the entity was completely described by shared
+			items, false to fall back to Snap().
+	*/
+	virtual bool SnapShared() { return false; }
+
 	/*
 		Function: networkclipped(int snapping_client)
 			Performs a series of test to see if a client can see the
@@ -59,7 +59,6 @@ void CGameContext::Construct(int Resetting)
 		m_NumMutes = 0;
 	}
 	m_ChatResponseTargetID = -1;
-	m_aDeleteTempfile[0] = 0;
 }
 
 CGameContext::CGameContext(int Resetting)
@@ -597,6 +596,9 @@ void CGameContext::OnTick()
 	//if(world.paused) // make sure that the game object always updates
 	m_pController->Tick();
 
+	// results of score queries that finished since the last tick
+	m_pScore->OnTick();
+
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		if(m_apPlayers[i])
@@ -1907,6 +1909,31 @@ void CGameContext::ConRandomUnfinishedMap(IConsole::IResult *pResult, void *pUse
 	pSelf->m_pScore->RandomUnfinishedMap(pSelf->m_VoteCreator, stars);
 }
 
+#if defined(CONF_SQL)
+void CGameContext::ConSqlStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(!g_Config.m_SvUseSQL)
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", "SQL is not in use");
+		return;
+	}
+	pSelf->m_pScore->PrintStats(pSelf->Console());
+}
+#endif
+
+void CGameContext::ConScoreImport(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	pSelf->m_pScore->ImportRecords(pSelf->Console());
+}
+
+void CGameContext::ConScoreExport(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	pSelf->m_pScore->ExportRecords(pSelf->Console());
+}
+
 void CGameContext::ConRestart(IConsole::IResult *pResult, void *pUserData)
 {
 	CGameContext *pSelf = (CGameContext *)pUserData;
@@ -2321,6 +2348,11 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("change_map", "?r[map]", CFGFLAG_SERVER|CFGFLAG_STORE, ConChangeMap, this, "Change map");
 	Console()->Register("random_map", "?i[stars]", CFGFLAG_SERVER, ConRandomMap, this, "Random map");
 	Console()->Register("random_unfinished_map", "?i[stars]", CFGFLAG_SERVER, ConRandomUnfinishedMap, this, "Random unfinished map");
+#if defined(CONF_SQL)
+	Console()->Register("sql_stats", "", CFGFLAG_SERVER, ConSqlStats, this, "Show the SQL queue depth and latency");
+#endif
+	Console()->Register("score_import", "", CFGFLAG_SERVER, ConScoreImport, this, "Merge the map's text record file into the records");
+	Console()->Register("score_export", "", CFGFLAG_SERVER, ConScoreExport, this, "Write the map's records to its text record file");
 	Console()->Register("restart", "?i[seconds]", CFGFLAG_SERVER|CFGFLAG_STORE, ConRestart, this, "Restart in x seconds (0 = abort)");
 	Console()->Register("broadcast", "r[message]", CFGFLAG_SERVER, ConBroadcast, this, "Broadcast message");
 	Console()->Register("say", "r[message]", CFGFLAG_SERVER, ConSay, this, "Say in chat");
@@ -2351,8 +2383,6 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 	m_World.SetGameServer(this);
 	m_Events.SetGameServer(this);
 
-	DeleteTempfile();
-
 	//if(!data) // only load once
 		//data = load_data_from_memory(internal_data);
 
@@ -2361,6 +2391,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 
 	m_Layers.Init(Kernel());
 	m_Collision.Init(&m_Layers);
+	m_World.InitSpatialIndex(m_Collision.GetWidth(), m_Collision.GetHeight());
 
 	// reset everything here
 	//world = new GAMEWORLD;
@@ -2570,23 +2601,13 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 #endif
 }
 
-void CGameContext::DeleteTempfile()
-{
-	if(m_aDeleteTempfile[0] != 0)
-	{
-		IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
-		pStorage->RemoveFile(m_aDeleteTempfile, IStorage::TYPE_SAVE);
-		m_aDeleteTempfile[0] = 0;
-	}
-}
-
-void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
+void CGameContext::OnMapChange(const char *pMapName, char *pNewMapName, int MapNameSize)
 {
 	IStorage *pStorage = Kernel()->RequestInterface<IStorage>();
 
 	char aConfig[128];
 	char aTemp[128];
-	str_format(aConfig, sizeof(aConfig), "maps/%s.cfg", g_Config.m_SvMap);
+	str_format(aConfig, sizeof(aConfig), "maps/%s.cfg", pMapName);
 	str_format(aTemp, sizeof(aTemp), "%s.temp.%d", pNewMapName, pid());
 
 	IOHANDLE File = pStorage->OpenFile(aConfig, IOFLAG_READ, IStorage::TYPE_ALL);
@@ -2704,12 +2725,10 @@ void CGameContext::OnMapChange(char *pNewMapName, int MapNameSize)
 	Writer.Finish();
 
 	str_copy(pNewMapName, aTemp, MapNameSize);
-	str_copy(m_aDeleteTempfile, aTemp, sizeof(m_aDeleteTempfile));
 }
 
 void CGameContext::OnShutdown()
 {
-	DeleteTempfile();
 	Console()->ResetServerGameSettings();
 	Layers()->Dest();
 	Collision()->Dest();
@@ -2781,7 +2800,10 @@ void CGameContext::OnSnap(int ClientID)
 		m_apPlayers[ClientID]->FakeSnap(ClientID);
 
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_World.PreSnap();
+}
 void CGameContext::OnPostSnap()
 {
 	m_Events.Clear();
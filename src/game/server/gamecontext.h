@@ -74,6 +74,11 @@ class CGameContext : public IGameServer
 	static void ConChangeMap(IConsole::IResult *pResult, void *pUserData);
 	static void ConRandomMap(IConsole::IResult *pResult, void *pUserData);
 	static void ConRandomUnfinishedMap(IConsole::IResult *pResult, void *pUserData);
+#if defined(CONF_SQL)
+	static void ConSqlStats(IConsole::IResult *pResult, void *pUserData);
+#endif
+	static void ConScoreImport(IConsole::IResult *pResult, void *pUserData);
+	static void ConScoreExport(IConsole::IResult *pResult, void *pUserData);
 	static void ConSaveTeam(IConsole::IResult *pResult, void *pUserData);
 	static void ConLoadTeam(IConsole::IResult *pResult, void *pUserData);
 	static void ConRestart(IConsole::IResult *pResult, void *pUserData);
@@ -137,9 +142,6 @@ public:
 	char m_ZoneEnterMsg[NUM_TUNINGZONES][256]; // 0 is used for switching from or to area without tunings
 	char m_ZoneLeaveMsg[NUM_TUNINGZONES][256];
 
-	char m_aDeleteTempfile[128];
-	void DeleteTempfile();
-
 	enum
 	{
 		VOTE_ENFORCE_UNKNOWN=0,
@@ -196,7 +198,7 @@ public:
 	// engine events
 	virtual void OnInit();
 	virtual void OnConsoleInit();
-	virtual void OnMapChange(char *pNewMapName, int MapNameSize);
+	virtual void OnMapChange(const char *pMapName, char *pNewMapName, int MapNameSize);
 	virtual void OnShutdown();
 
 	virtual void OnTick();
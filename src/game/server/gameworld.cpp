@@ -20,6 +20,12 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		m_apFirstEntityTypes[i] = 0;
+
+	m_apGridCells = 0;
+	m_GridWidth = 0;
+	m_GridHeight = 0;
+	m_GridMaxRadius = 0.0f;
+	m_NextInsertSeq = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -28,12 +34,15 @@ CGameWorld::~CGameWorld()
 	for(int i = 0; i < NUM_ENTTYPES; i++)
 		while(m_apFirstEntityTypes[i])
 			delete m_apFirstEntityTypes[i];
+
+	mem_free(m_apGridCells);
 }
 
 void CGameWorld::SetGameServer(CGameContext *pGameServer)
 {
 	m_pGameServer = pGameServer;
 	m_pServer = m_pGameServer->Server();
+	m_SharedSnap.SetGameServer(pGameServer);
 }
 
 CEntity *CGameWorld::FindFirst(int Type)
@@ -41,13 +50,158 @@ CEntity *CGameWorld::FindFirst(int Type)
 	return Type < 0 || Type >= NUM_ENTTYPES ? 0 : m_apFirstEntityTypes[Type];
 }
 
+void CGameWorld::InitSpatialIndex(int Width, int Height)
+{
+	mem_free(m_apGridCells);
+
+	m_GridWidth = max(1, (Width*32+GRID_CELLSIZE-1)/GRID_CELLSIZE);
+	m_GridHeight = max(1, (Height*32+GRID_CELLSIZE-1)/GRID_CELLSIZE);
+	m_apGridCells = (CEntity **)mem_alloc(m_GridWidth*m_GridHeight*sizeof(CEntity *), 1);
+	mem_zero(m_apGridCells, m_GridWidth*m_GridHeight*sizeof(CEntity *));
+	m_GridMaxRadius = 0.0f;
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			pEnt->m_Cell = -1;
+			GridLink(pEnt);
+		}
+}
+
+static int GridCoord(float Value, int Size)
+{
+	// positions outside of the map (or NaN) end up in the border cells
+	if(!(Value > 0.0f))
+		return 0;
+	if(Value >= (float)Size)
+		return Size-1;
+	return (int)Value;
+}
+
+int CGameWorld::GridCell(vec2 Pos) const
+{
+	return GridCoord(Pos.y/GRID_CELLSIZE, m_GridHeight)*m_GridWidth + GridCoord(Pos.x/GRID_CELLSIZE, m_GridWidth);
+}
+
+void CGameWorld::GridLink(CEntity *pEnt)
+{
+	if(!m_apGridCells || !IsIndexedType(pEnt->m_ObjType))
+		return;
+
+	int Cell = GridCell(pEnt->m_Pos);
+	pEnt->m_Cell = Cell;
+	pEnt->m_pPrevCellEntity = 0;
+	pEnt->m_pNextCellEntity = m_apGridCells[Cell];
+	if(m_apGridCells[Cell])
+		m_apGridCells[Cell]->m_pPrevCellEntity = pEnt;
+	m_apGridCells[Cell] = pEnt;
+
+	m_GridMaxRadius = max(m_GridMaxRadius, pEnt->m_ProximityRadius);
+}
+
+void CGameWorld::GridUnlink(CEntity *pEnt)
+{
+	if(pEnt->m_Cell < 0)
+		return;
+
+	if(pEnt->m_pPrevCellEntity)
+		pEnt->m_pPrevCellEntity->m_pNextCellEntity = pEnt->m_pNextCellEntity;
+	else
+		m_apGridCells[pEnt->m_Cell] = pEnt->m_pNextCellEntity;
+	if(pEnt->m_pNextCellEntity)
+		pEnt->m_pNextCellEntity->m_pPrevCellEntity = pEnt->m_pPrevCellEntity;
+
+	pEnt->m_pPrevCellEntity = 0;
+	pEnt->m_pNextCellEntity = 0;
+	pEnt->m_Cell = -1;
+}
+
+void CGameWorld::UpdateEntityPos(CEntity *pEnt)
+{
+	if(pEnt->m_Cell < 0)
+		return;
+
+	m_GridMaxRadius = max(m_GridMaxRadius, pEnt->m_ProximityRadius);
+	if(GridCell(pEnt->m_Pos) != pEnt->m_Cell)
+	{
+		GridUnlink(pEnt);
+		GridLink(pEnt);
+	}
+}
+
+CEntity *CGameWorld::FirstCandidate(CCandidates *pCands, int Type, vec2 Min, vec2 Max, bool UseIndex)
+{
+	pCands->m_Num = -1;
+	pCands->m_Index = 0;
+	pCands->m_pCur = m_apFirstEntityTypes[Type];
+
+	if(!UseIndex || !m_apGridCells || !IsIndexedType(Type))
+		return pCands->m_pCur;
+
+	// grow the box by the largest entity and a little slack for float rounding
+	float Grow = m_GridMaxRadius + 1.0f;
+	int X0 = GridCoord((Min.x-Grow)/GRID_CELLSIZE, m_GridWidth);
+	int Y0 = GridCoord((Min.y-Grow)/GRID_CELLSIZE, m_GridHeight);
+	int X1 = GridCoord((Max.x+Grow)/GRID_CELLSIZE, m_GridWidth);
+	int Y1 = GridCoord((Max.y+Grow)/GRID_CELLSIZE, m_GridHeight);
+
+	int Num = 0;
+	for(int y = Y0; y <= Y1; y++)
+		for(int x = X0; x <= X1; x++)
+			for(CEntity *pEnt = m_apGridCells[y*m_GridWidth+x]; pEnt; pEnt = pEnt->m_pNextCellEntity)
+			{
+				if(pEnt->m_ObjType != Type)
+					continue;
+				if(Num == MAX_GRID_CANDIDATES)
+					return pCands->m_pCur; // too crowded, walk the list instead
+
+				// newer entities come first in the type list, keep that order
+				int i = Num++;
+				for(; i > 0 && (int)(pEnt->m_InsertSeq - pCands->m_apEnts[i-1]->m_InsertSeq) > 0; i--)
+					pCands->m_apEnts[i] = pCands->m_apEnts[i-1];
+				pCands->m_apEnts[i] = pEnt;
+			}
+
+	pCands->m_Num = Num;
+	pCands->m_pCur = Num ? pCands->m_apEnts[0] : 0;
+	return pCands->m_pCur;
+}
+
+CEntity *CGameWorld::NextCandidate(CCandidates *pCands)
+{
+	if(pCands->m_Num < 0)
+		pCands->m_pCur = pCands->m_pCur->m_pNextTypeEntity;
+	else
+		pCands->m_pCur = ++pCands->m_Index < pCands->m_Num ? pCands->m_apEnts[pCands->m_Index] : 0;
+	return pCands->m_pCur;
+}
+
 int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
+{
+	int Num = FindEntitiesImpl(Pos, Radius, ppEnts, Max, Type, true);
+
+	if(g_Config.m_DbgSpatialIndex && (!ppEnts || Max <= MAX_GRID_CANDIDATES))
+	{
+		CEntity *apCheck[MAX_GRID_CANDIDATES];
+		int CheckNum = FindEntitiesImpl(Pos, Radius, ppEnts ? apCheck : 0, Max, Type, false);
+		bool Match = CheckNum == Num;
+		for(int i = 0; Match && ppEnts && i < Num; i++)
+			Match = apCheck[i] == ppEnts[i];
+		if(!Match)
+			dbg_msg("gameworld", "spatial index mismatch in FindEntities type=%d pos=%.1f,%.1f radius=%.1f num=%d expected=%d", Type, Pos.x, Pos.y, Radius, Num, CheckNum);
+	}
+
+	return Num;
+}
+
+int CGameWorld::FindEntitiesImpl(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type, bool UseIndex)
 {
 	if(Type < 0 || Type >= NUM_ENTTYPES)
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type];	pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	CCandidates Cands;
+	for(CEntity *pEnt = FirstCandidate(&Cands, Type, Pos-vec2(Radius, Radius), Pos+vec2(Radius, Radius), UseIndex); pEnt; pEnt = NextCandidate(&Cands))
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius+pEnt->m_ProximityRadius)
 		{
@@ -75,6 +229,9 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	pEnt->m_InsertSeq = m_NextInsertSeq++;
+	GridLink(pEnt);
 }
 
 void CGameWorld::DestroyEntity(CEntity *pEnt)
@@ -102,6 +259,30 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 
 	pEnt->m_pNextTypeEntity = 0;
 	pEnt->m_pPrevTypeEntity = 0;
+
+	GridUnlink(pEnt);
+}
+
+void CGameWorld::PreSnap()
+{
+	m_SharedSnap.Clear();
+
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			int First = m_SharedSnap.NumItems();
+			if(g_Config.m_SvSharedSnap && pEnt->SnapShared())
+			{
+				pEnt->m_SharedSnapFirst = First;
+				pEnt->m_SharedSnapNum = m_SharedSnap.NumItems()-First;
+			}
+			else
+			{
+				m_SharedSnap.Truncate(First);
+				pEnt->m_SharedSnapFirst = -1;
+				pEnt->m_SharedSnapNum = 0;
+			}
+		}
 }
 
 //
@@ -111,7 +292,11 @@ void CGameWorld::Snap(int SnappingClient)
 		for(CEntity *pEnt = m_apFirstEntityTypes[i]; pEnt; )
 		{
 			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
+			// keep the item order of the entity list so the snapshot stays the same
+			if(g_Config.m_SvSharedSnap && pEnt->m_SharedSnapFirst >= 0)
+				m_SharedSnap.Snap(SnappingClient, pEnt->m_SharedSnapFirst, pEnt->m_SharedSnapNum);
+			else
+				pEnt->Snap(SnappingClient);
 			pEnt = m_pNextTraverseEntity;
 		}
 }
@@ -285,13 +470,31 @@ void CGameWorld::Tick()
 // TODO: should be more general
 //CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CEntity *pNotThis)
 CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CCharacter *pNotThis, int CollideWith, class CCharacter *pThisOnly)
+{
+	vec2 CheckPos = NewPos;
+	CCharacter *pClosest = IntersectCharacterImpl(Pos0, Pos1, Radius, NewPos, pNotThis, CollideWith, pThisOnly, true);
+
+	if(g_Config.m_DbgSpatialIndex)
+	{
+		CCharacter *pCheck = IntersectCharacterImpl(Pos0, Pos1, Radius, CheckPos, pNotThis, CollideWith, pThisOnly, false);
+		if(pCheck != pClosest || (pClosest && !(CheckPos == NewPos)))
+			dbg_msg("gameworld", "spatial index mismatch in IntersectCharacter from=%.1f,%.1f to=%.1f,%.1f radius=%.1f", Pos0.x, Pos0.y, Pos1.x, Pos1.y, Radius);
+	}
+
+	return pClosest;
+}
+
+CCharacter *CGameWorld::IntersectCharacterImpl(vec2 Pos0, vec2 Pos1, float Radius, vec2& NewPos, CCharacter *pNotThis, int CollideWith, class CCharacter *pThisOnly, bool UseIndex)
 {
 	// Find other players
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CCandidates Cands;
+	vec2 Min = vec2(min(Pos0.x, Pos1.x)-Radius, min(Pos0.y, Pos1.y)-Radius);
+	vec2 Max = vec2(max(Pos0.x, Pos1.x)+Radius, max(Pos0.y, Pos1.y)+Radius);
+	CCharacter *p = (CCharacter *)FirstCandidate(&Cands, ENTTYPE_CHARACTER, Min, Max, UseIndex);
+	for(; p; p = (CCharacter *)NextCandidate(&Cands))
 	{
 		if(p == pNotThis)
 			continue;
@@ -318,13 +521,24 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 
 
 CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotThis)
+{
+	CCharacter *pClosest = ClosestCharacterImpl(Pos, Radius, pNotThis, true);
+
+	if(g_Config.m_DbgSpatialIndex && ClosestCharacterImpl(Pos, Radius, pNotThis, false) != pClosest)
+		dbg_msg("gameworld", "spatial index mismatch in ClosestCharacter pos=%.1f,%.1f radius=%.1f", Pos.x, Pos.y, Radius);
+
+	return pClosest;
+}
+
+CCharacter *CGameWorld::ClosestCharacterImpl(vec2 Pos, float Radius, CEntity *pNotThis, bool UseIndex)
 {
 	// Find other players
 	float ClosestRange = Radius*2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	CCandidates Cands;
+	CCharacter *p = (CCharacter *)FirstCandidate(&Cands, ENTTYPE_CHARACTER, Pos-vec2(Radius, Radius), Pos+vec2(Radius, Radius), UseIndex);
+	for(; p; p = (CCharacter *)NextCandidate(&Cands))
 	{
 		if(p == pNotThis)
 			continue;
@@ -346,9 +560,26 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis)
 {
 	std::list< CCharacter * > listOfChars;
+	IntersectedCharactersImpl(Pos0, Pos1, Radius, pNotThis, &listOfChars, true);
+
+	if(g_Config.m_DbgSpatialIndex)
+	{
+		std::list< CCharacter * > CheckList;
+		IntersectedCharactersImpl(Pos0, Pos1, Radius, pNotThis, &CheckList, false);
+		if(CheckList != listOfChars)
+			dbg_msg("gameworld", "spatial index mismatch in IntersectedCharacters from=%.1f,%.1f to=%.1f,%.1f radius=%.1f", Pos0.x, Pos0.y, Pos1.x, Pos1.y, Radius);
+	}
+
+	return listOfChars;
+}
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+void CGameWorld::IntersectedCharactersImpl(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis, std::list<class CCharacter *> *pList, bool UseIndex)
+{
+	CCandidates Cands;
+	vec2 Min = vec2(min(Pos0.x, Pos1.x)-Radius, min(Pos0.y, Pos1.y)-Radius);
+	vec2 Max = vec2(max(Pos0.x, Pos1.x)+Radius, max(Pos0.y, Pos1.y)+Radius);
+	CCharacter *pChr = (CCharacter *)FirstCandidate(&Cands, CGameWorld::ENTTYPE_CHARACTER, Min, Max, UseIndex);
+	for(; pChr; pChr = (CCharacter *)NextCandidate(&Cands))
 	{
 		if(pChr == pNotThis)
 			continue;
@@ -358,10 +589,9 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 		if(Len < pChr->m_ProximityRadius+Radius)
 		{
 			pChr->m_Intersection = IntersectPos;
-			listOfChars.push_back(pChr);
+			pList->push_back(pChr);
 		}
 	}
-	return listOfChars;
 }
 
 void CGameWorld::ReleaseHooked(int ClientID)
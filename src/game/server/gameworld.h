@@ -5,6 +5,8 @@
 
 #include <game/gamecore.h>
 
+#include "sharedsnap.h"
+
 #include <list>
 
 class CEntity;
@@ -28,6 +30,12 @@ public:
 		NUM_ENTTYPES
 	};
 
+	enum
+	{
+		GRID_CELLSIZE = 256,
+		MAX_GRID_CANDIDATES = 256,
+	};
+
 private:
 	void Reset();
 	void RemoveEntities();
@@ -35,6 +43,34 @@ private:
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index: uniform grid of the entities whose positions are kept up to date
+	CEntity **m_apGridCells;
+	int m_GridWidth;
+	int m_GridHeight;
+	float m_GridMaxRadius;
+	unsigned m_NextInsertSeq;
+
+	// entities of one type that may lie within a box, in entity list order
+	struct CCandidates
+	{
+		CEntity *m_apEnts[MAX_GRID_CANDIDATES];
+		int m_Num; // -1 walks the whole type list
+		int m_Index;
+		CEntity *m_pCur;
+	};
+
+	static bool IsIndexedType(int Type) { return Type == ENTTYPE_CHARACTER; }
+	int GridCell(vec2 Pos) const;
+	void GridLink(CEntity *pEnt);
+	void GridUnlink(CEntity *pEnt);
+	CEntity *FirstCandidate(CCandidates *pCands, int Type, vec2 Min, vec2 Max, bool UseIndex);
+	CEntity *NextCandidate(CCandidates *pCands);
+
+	int FindEntitiesImpl(vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type, bool UseIndex);
+	class CCharacter *IntersectCharacterImpl(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos, class CCharacter *pNotThis, int CollideWith, class CCharacter *pThisOnly, bool UseIndex);
+	class CCharacter *ClosestCharacterImpl(vec2 Pos, float Radius, CEntity *pNotThis, bool UseIndex);
+	void IntersectedCharactersImpl(vec2 Pos0, vec2 Pos1, float Radius, class CEntity *pNotThis, std::list<class CCharacter *> *pList, bool UseIndex);
+
 	class CGameContext *m_pGameServer;
 	class IServer *m_pServer;
 
@@ -47,12 +83,34 @@ public:
 	bool m_ResetRequested;
 	bool m_Paused;
 	CWorldCore m_Core;
+	CSharedSnap m_SharedSnap;
 
 	CGameWorld();
 	~CGameWorld();
 
 	void SetGameServer(CGameContext *pGameServer);
 
+	/*
+		Function: InitSpatialIndex
+			Sets up the spatial index for a map of the given size.
+			Entities already in the world are added to it.
+
+		Arguments:
+			Width - Map width in tiles.
+			Height - Map height in tiles.
+	*/
+	void InitSpatialIndex(int Width, int Height);
+
+	/*
+		Function: UpdateEntityPos
+			Moves an entity to its new cell in the spatial index.
+			Has to be called whenever m_Pos of a character changes.
+
+		Arguments:
+			pEnt - Entity that moved.
+	*/
+	void UpdateEntityPos(CEntity *pEnt);
+
 	CEntity *FindFirst(int Type);
 
 	/*
@@ -129,6 +187,13 @@ public:
 	*/
 	void DestroyEntity(CEntity *pEntity);
 
+	/*
+		Function: PreSnap
+			Builds the shared snapshot items of all entities once
+			before the per client snapshots are created.
+	*/
+	void PreSnap();
+
 	/*
 		Function: snap
 			Calls snap on all the entities in the world to create
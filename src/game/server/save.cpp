@@ -129,6 +129,7 @@ void CSaveTee::load(CCharacter* pchr, int Team)
 		pchr->m_StartTime = pchr->Server()->Tick() - m_Time;
 
 	pchr->m_Pos = m_Pos;
+	pchr->GameWorld()->UpdateEntityPos(pchr);
 	pchr->m_PrevPos = m_PrevPos;
 	pchr->m_TeleCheckpoint = m_TeleCheckpoint;
 	pchr->m_LastPenalty = m_LastPenalty;
@@ -144,6 +145,7 @@ void CSaveTee::load(CCharacter* pchr, int Team)
 
 	// Core
 	pchr->m_Core.m_Pos = m_CorePos;
+	pchr->GameWorld()->m_Core.UpdateCharacter(pchr->GetPlayer()->GetCID());
 	pchr->m_Core.m_Vel = m_Vel;
 	pchr->m_Core.m_Hook = m_Hook;
 	pchr->m_Core.m_Collision = m_Collision;
@@ -43,6 +43,14 @@ public:
 
 	CPlayerData *PlayerData(int ID) { return &m_aPlayerData[ID]; }
 
+	// called every tick, backends with worker threads deliver their results here
+	virtual void OnTick() {}
+	virtual void PrintStats(IConsole *pConsole) {}
+
+	// merge the <map>_record.dtb text file into the records / write them out to it
+	virtual void ImportRecords(IConsole *pConsole) { pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "score", "not supported by this score backend"); }
+	virtual void ExportRecords(IConsole *pConsole) { pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "score", "not supported by this score backend"); }
+
 	virtual void MapInfo(int ClientID, const char* MapName) = 0;
 	virtual void MapVote(int ClientID, const char* MapName) = 0;
 	virtual void CheckBirthday(int ClientID) = 0;
@@ -1,172 +1,466 @@
 /* (c) Shereef Marzouk. See "licence DDRace.txt" and the readme.txt in the root of the distribution for more information. */
 /* Based on Race mod stuff and tweaked by GreYFoX@GTi and others to fit our DDRace needs. */
 /* copyright (c) 2008 rajh and gregwar. Score stuff */
-#include <base/tl/sorted_array.h>
+#include <algorithm>
 
 #include <engine/shared/config.h>
-#include <sstream>
-#include <fstream>
-#include <string.h>
 #include "../gamemodes/DDRace.h"
 #include "file_score.h"
 #include <engine/shared/console.h>
 
-static LOCK gs_ScoreLock = 0;
+static const char s_aLogID[4] = {'D', 'D', 'S', 'L'};
 
-CFileScore::CPlayerScore::CPlayerScore(const char *pName, float Score,
-		float aCpTime[NUM_CHECKPOINTS])
+static void InsertName(int *pTable, int Size, const char *pName, int Index)
 {
-	str_copy(m_aName, pName, sizeof(m_aName));
-	m_Score = Score;
-	for (int i = 0; i < NUM_CHECKPOINTS; i++)
-		m_aCpTime[i] = aCpTime[i];
+	unsigned Slot = str_quickhash(pName)&(Size-1);
+	while(pTable[Slot] != -1)
+		Slot = (Slot+1)&(Size-1);
+	pTable[Slot] = Index;
+}
+
+// entries are little endian, without checkpoint saving the times are left out like in the text files
+static void ConvertEntry(void *pFloats, int *pAchieved)
+{
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(pFloats, sizeof(float), 1+NUM_CHECKPOINTS);
+	if(pAchieved)
+		swap_endian(pAchieved, sizeof(int), 1);
+#endif
 }
 
 CFileScore::CFileScore(CGameContext *pGameServer) :
 				m_pGameServer(pGameServer), m_pServer(pGameServer->Server())
 {
-	if (gs_ScoreLock == 0)
-		gs_ScoreLock = lock_create();
+	m_pNameIndex = 0;
+	m_NameIndexSize = 0;
+	m_LastAchieved = 0;
+	m_LogFile = 0;
+	m_NumLogEntries = 0;
 
 	Init();
 }
 
 CFileScore::~CFileScore()
 {
-	lock_wait(gs_ScoreLock);
+	if(m_LogFile)
+	{
+		io_close(m_LogFile);
+		if(NeedCompaction())
+			WriteLog();
+	}
 
-	// clear list
-	m_Top.clear();
+	mem_free(m_pNameIndex);
+}
 
-	lock_unlock(gs_ScoreLock);
+void CFileScore::MapInfo(int ClientID, const char* MapName)
+{
+	// TODO: implement
 }
 
-std::string SaveFile()
+void CFileScore::MapVote(int ClientID, const char* MapName)
 {
-	std::ostringstream oss;
-	char aBuf[256];
-	str_copy(aBuf, g_Config.m_SvMap, sizeof(aBuf));
-	for(int i = 0; i < 256; i++) if(aBuf[i] == '/') aBuf[i] = '-';
-	if (g_Config.m_SvScoreFolder[0])
-		oss << g_Config.m_SvScoreFolder << "/" << aBuf << "_record.dtb";
+	// TODO: implement
+}
+
+int CFileScore::FindScore(const char *pName) const
+{
+	if(!m_NameIndexSize)
+		return -1;
+
+	for(unsigned Slot = str_quickhash(pName)&(m_NameIndexSize-1); m_pNameIndex[Slot] != -1; Slot = (Slot+1)&(m_NameIndexSize-1))
+	{
+		if(str_comp(m_aScores[m_pNameIndex[Slot]].m_aName, pName) == 0)
+			return m_pNameIndex[Slot];
+	}
+	return -1;
+}
+
+void CFileScore::IndexName(int Index)
+{
+	// keep the table at most half full
+	if(m_aScores.size()*2 > m_NameIndexSize)
+	{
+		mem_free(m_pNameIndex);
+		m_NameIndexSize = max(m_NameIndexSize*2, 256);
+		m_pNameIndex = (int *)mem_alloc(m_NameIndexSize*sizeof(int), 1);
+		for(int i = 0; i < m_NameIndexSize; i++)
+			m_pNameIndex[i] = -1;
+		for(int i = 0; i < m_aScores.size(); i++)
+			InsertName(m_pNameIndex, m_NameIndexSize, m_aScores[i].m_aName, i);
+	}
 	else
-		oss << g_Config.m_SvMap << "_record.dtb";
-	return oss.str();
+		InsertName(m_pNameIndex, m_NameIndexSize, m_aScores[Index].m_aName, Index);
 }
 
-void CFileScore::MapInfo(int ClientID, const char* MapName)
+bool CFileScore::StoreScore(const CPlayerScore *pScore, bool OnlyBetter)
 {
-	// TODO: implement
+	// the ranks have to be rebuilt afterwards
+	m_LastAchieved = max(m_LastAchieved, pScore->m_Achieved);
+	int Index = FindScore(pScore->m_aName);
+	if(Index < 0)
+	{
+		IndexName(m_aScores.add(*pScore));
+		return true;
+	}
+	if(OnlyBetter && m_aScores[Index].m_Score <= pScore->m_Score)
+		return false;
+	m_aScores[Index] = *pScore;
+	return true;
 }
 
-void CFileScore::MapVote(int ClientID, const char* MapName)
+bool CFileScore::RankLess(int Index, float Score, int Other) const
 {
-	// TODO: implement
+	// ties are ordered by who set the time first
+	float IndexScore = m_aScores[Index].m_Score;
+	if(IndexScore != Score)
+		return IndexScore < Score;
+	int Achieved = m_aScores[Index].m_Achieved;
+	int OtherAchieved = m_aScores[Other].m_Achieved;
+	return Achieved < OtherAchieved || (Achieved == OtherAchieved && Index < Other);
 }
 
-void CFileScore::SaveScoreThread(void *pUser)
+int CFileScore::RankPosition(float Score, int Index) const
 {
-	CFileScore *pSelf = (CFileScore *) pUser;
-	lock_wait(gs_ScoreLock);
-	std::fstream f;
-	f.open(SaveFile().c_str(), std::ios::out);
-	if (!f.fail())
+	int Low = 0;
+	int High = m_aRanks.size();
+	while(Low < High)
 	{
-		int t = 0;
-		for (sorted_array<CPlayerScore>::range r = pSelf->m_Top.all();
-				!r.empty(); r.pop_front())
+		int Mid = (Low+High)/2;
+		if(RankLess(m_aRanks[Mid], Score, Index))
+			Low = Mid+1;
+		else
+			High = Mid;
+	}
+	return Low;
+}
+
+void CFileScore::RebuildRanks()
+{
+	m_aRanks.set_size(m_aScores.size());
+	for(int i = 0; i < m_aScores.size(); i++)
+		m_aRanks[i] = i;
+	std::sort(m_aRanks.base_ptr(), m_aRanks.base_ptr()+m_aRanks.size(), CRankCompare(this));
+}
+
+int CFileScore::SetScore(const char *pName, float Score, const float *pCpTime)
+{
+	int Index = FindScore(pName);
+	if(Index < 0)
+	{
+		CPlayerScore NewScore;
+		mem_zero(&NewScore, sizeof(NewScore));
+		str_copy(NewScore.m_aName, pName, sizeof(NewScore.m_aName));
+		Index = m_aScores.add(NewScore);
+		IndexName(Index);
+	}
+	else
+		m_aRanks.remove_index(RankPosition(m_aScores[Index].m_Score, Index));
+
+	CPlayerScore *pScore = &m_aScores[Index];
+	pScore->m_Score = Score;
+	pScore->m_Achieved = ++m_LastAchieved;
+	for(int c = 0; c < NUM_CHECKPOINTS; c++)
+		pScore->m_aCpTime[c] = pCpTime[c];
+
+	// move it to its new rank, the lookup stays a binary search
+	int Pos = RankPosition(Score, Index);
+	m_aRanks.add(Index);
+	for(int i = m_aRanks.size()-1; i > Pos; i--)
+		m_aRanks[i] = m_aRanks[i-1];
+	m_aRanks[Pos] = Index;
+	return Index;
+}
+
+void CFileScore::UpdateRecord()
+{
+	// save the current best score
+	if(m_aRanks.size())
+		((CGameControllerDDRace*) GameServer()->m_pController)->m_CurrentRecord =
+				m_aScores[m_aRanks[0]].m_Score;
+}
+
+bool CFileScore::ReadLog()
+{
+	IOHANDLE File = io_open(m_aLogFile, IOFLAG_READ);
+	if(!File)
+		return false;
+
+	CLogHeader Header;
+	bool Valid = io_read(File, &Header, sizeof(Header)) == sizeof(Header) && mem_comp(Header.m_aID, s_aLogID, sizeof(s_aLogID)) == 0;
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(&Header.m_Version, sizeof(int), 1);
+#endif
+	if(!Valid || (Header.m_Version != LOG_VERSION && Header.m_Version != LOG_VERSION_NO_ACHIEVED))
+	{
+		// keep it for a look, a new log is started
+		char aBuf[512];
+		str_format(aBuf, sizeof(aBuf), "%s.bad", m_aLogFile);
+		io_close(File);
+		fs_rename(m_aLogFile, aBuf);
+		dbg_msg("score", "'%s' is no score log, moved it to '%s'", m_aLogFile, aBuf);
+		return false;
+	}
+
+	// later entries of a tee replace the earlier ones, an old log is rewritten in the current format
+	bool Complete = Header.m_Version == LOG_VERSION;
+	unsigned EntrySize = Complete ? sizeof(CPlayerScore) : sizeof(CPlayerScore)-sizeof(int);
+	char aEntries[64*sizeof(CPlayerScore)];
+	while(1)
+	{
+		unsigned Bytes = io_read(File, aEntries, 64*EntrySize);
+		int Num = Bytes/EntrySize;
+		for(int i = 0; i < Num; i++)
 		{
-			f << r.front().m_aName << std::endl << r.front().m_Score
-					<< std::endl;
-			if (g_Config.m_SvCheckpointSave)
+			CPlayerScore Entry;
+			mem_copy(&Entry, aEntries+i*EntrySize, EntrySize);
+			Entry.m_aName[sizeof(Entry.m_aName)-1] = 0;
+			if(Header.m_Version == LOG_VERSION_NO_ACHIEVED)
 			{
-				for (int c = 0; c < NUM_CHECKPOINTS; c++)
-					f << r.front().m_aCpTime[c] << " ";
-				f << std::endl;
+				ConvertEntry(&Entry.m_Score, 0);
+				Entry.m_Achieved = m_LastAchieved+1;
 			}
-			t++;
-			if (t % 50 == 0)
-				thread_sleep(1);
+			else
+				ConvertEntry(&Entry.m_Score, &Entry.m_Achieved);
+			StoreScore(&Entry, false);
+		}
+		m_NumLogEntries += Num;
+
+		if(Bytes != 64*EntrySize)
+		{
+			// the server went down during a write, the log is rewritten
+			if(Bytes%EntrySize)
+				Complete = false;
+			break;
 		}
 	}
-	f.close();
-	lock_unlock(gs_ScoreLock);
+	io_close(File);
+	return Complete;
 }
 
-void CFileScore::Save()
+bool CFileScore::WriteLog()
 {
-	void *pSaveThread = thread_init(SaveScoreThread, this);
-	thread_detach(pSaveThread);
+	// write a new log next to the old one, an interrupted compaction loses nothing
+	char aTmpFile[512];
+	str_format(aTmpFile, sizeof(aTmpFile), "%s.tmp", m_aLogFile);
+	IOHANDLE File = io_open(aTmpFile, IOFLAG_WRITE);
+	if(!File)
+	{
+		dbg_msg("score", "failed to open '%s' for writing", aTmpFile);
+		return false;
+	}
+
+	CLogHeader Header;
+	mem_copy(Header.m_aID, s_aLogID, sizeof(Header.m_aID));
+	Header.m_Version = LOG_VERSION;
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	swap_endian(&Header.m_Version, sizeof(int), 1);
+#endif
+	io_write(File, &Header, sizeof(Header));
+
+	for(int i = 0; i < m_aScores.size(); i++)
+	{
+		CPlayerScore Entry = m_aScores[i];
+		if(!g_Config.m_SvCheckpointSave)
+			mem_zero(Entry.m_aCpTime, sizeof(Entry.m_aCpTime));
+		ConvertEntry(&Entry.m_Score, &Entry.m_Achieved);
+		io_write(File, &Entry, sizeof(Entry));
+	}
+	io_close(File);
+
+	if(fs_rename(aTmpFile, m_aLogFile))
+	{
+		dbg_msg("score", "failed to replace '%s'", m_aLogFile);
+		return false;
+	}
+	m_NumLogEntries = m_aScores.size();
+	return true;
 }
 
-void CFileScore::Init()
+void CFileScore::AppendLog(const CPlayerScore *pScore)
 {
-	lock_wait(gs_ScoreLock);
+	if(!m_LogFile)
+	{
+		// the new log holds this time already
+		if(WriteLog())
+			m_LogFile = io_open(m_aLogFile, IOFLAG_APPEND);
+		return;
+	}
 
-	// create folder if not exist
-	if (g_Config.m_SvScoreFolder[0])
-		fs_makedir(g_Config.m_SvScoreFolder);
+	CPlayerScore Entry = *pScore;
+	if(!g_Config.m_SvCheckpointSave)
+		mem_zero(Entry.m_aCpTime, sizeof(Entry.m_aCpTime));
+	ConvertEntry(&Entry.m_Score, &Entry.m_Achieved);
+	io_write(m_LogFile, &Entry, sizeof(Entry));
+	io_flush(m_LogFile);
+	m_NumLogEntries++;
+}
 
-	std::fstream f;
-	f.open(SaveFile().c_str(), std::ios::in);
+bool CFileScore::NeedCompaction() const
+{
+	return m_NumLogEntries >= COMPACT_MIN_ENTRIES && m_NumLogEntries >= m_aScores.size()*COMPACT_RATIO;
+}
 
-	while (!f.eof() && !f.fail())
+int CFileScore::ImportText(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+		return -1;
+	int Length = io_length(File);
+	char *pData = (char *)mem_alloc(Length+1, 1);
+	Length = io_read(File, pData, Length);
+	pData[Length] = 0;
+	io_close(File);
+
+	// a line with the name, one with the time and with sv_checkpoint_save one with the checkpoint times
+	int NumLines = g_Config.m_SvCheckpointSave ? 3 : 2;
+	int Num = 0;
+	char *pLine = pData;
+	while(*pLine)
 	{
-		std::string TmpName, TmpScore, TmpCpLine;
-		std::getline(f, TmpName);
-		if (!f.eof() && TmpName != "")
+		char *apLines[3];
+		for(int l = 0; l < NumLines; l++)
+		{
+			apLines[l] = pLine;
+			while(*pLine && *pLine != '\n')
+				pLine++;
+			char *pEnd = pLine;
+			if(*pLine)
+				*pLine++ = 0;
+			if(pEnd > apLines[l] && pEnd[-1] == '\r')
+				pEnd[-1] = 0;
+			// empty lines between the entries
+			if(l == 0 && !apLines[0][0])
+				break;
+		}
+		if(!apLines[0][0] || !apLines[1][0])
+			continue;
+
+		CPlayerScore Score;
+		mem_zero(&Score, sizeof(Score));
+		str_copy(Score.m_aName, apLines[0], sizeof(Score.m_aName));
+		Score.m_Score = str_tofloat(apLines[1]);
+		if(NumLines == 3)
 		{
-			std::getline(f, TmpScore);
-			float aTmpCpTime[NUM_CHECKPOINTS] =
-			{ 0 };
-			if (g_Config.m_SvCheckpointSave)
+			const char *pTime = apLines[2];
+			for(int c = 0; c < NUM_CHECKPOINTS; c++)
 			{
-				std::getline(f, TmpCpLine);
-				char *pTime = strtok((char*) TmpCpLine.c_str(), " ");
-				int i = 0;
-				while (pTime != NULL && i < NUM_CHECKPOINTS)
-				{
-					aTmpCpTime[i] = atof(pTime);
-					pTime = strtok(NULL, " ");
-					i++;
-				}
+				while(*pTime == ' ')
+					pTime++;
+				if(!*pTime)
+					break;
+				Score.m_aCpTime[c] = str_tofloat(pTime);
+				while(*pTime && *pTime != ' ')
+					pTime++;
 			}
-			m_Top.add(
-					*new CPlayerScore(TmpName.c_str(), atof(TmpScore.c_str()),
-							aTmpCpTime));
 		}
+
+		// the text files don't know when a time was set, their order is the best guess
+		Score.m_Achieved = m_LastAchieved+1;
+		if(StoreScore(&Score, true))
+			Num++;
 	}
-	f.close();
-	lock_unlock(gs_ScoreLock);
 
-	// save the current best score
-	if (m_Top.size())
-		((CGameControllerDDRace*) GameServer()->m_pController)->m_CurrentRecord =
-				m_Top[0].m_Score;
+	mem_free(pData);
+	return Num;
+}
+
+bool CFileScore::ExportText(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_WRITE);
+	if(!File)
+		return false;
+
+	// in rank order, like the text files were written before
+	char aBuf[512];
+	for(int i = 0; i < m_aRanks.size(); i++)
+	{
+		const CPlayerScore *pScore = &m_aScores[m_aRanks[i]];
+		io_write(File, pScore->m_aName, str_length(pScore->m_aName));
+		io_write_newline(File);
+		str_format(aBuf, sizeof(aBuf), "%g", pScore->m_Score);
+		io_write(File, aBuf, str_length(aBuf));
+		io_write_newline(File);
+		if(g_Config.m_SvCheckpointSave)
+		{
+			aBuf[0] = 0;
+			for(int c = 0; c < NUM_CHECKPOINTS; c++)
+			{
+				char aTime[32];
+				str_format(aTime, sizeof(aTime), "%g ", pScore->m_aCpTime[c]);
+				str_append(aBuf, aTime, sizeof(aBuf));
+			}
+			io_write(File, aBuf, str_length(aBuf));
+			io_write_newline(File);
+		}
+	}
+	io_close(File);
+	return true;
+}
+
+void CFileScore::Init()
+{
+	// create folder if not exist
+	char aBase[512];
+	if (g_Config.m_SvScoreFolder[0])
+	{
+		fs_makedir(g_Config.m_SvScoreFolder);
+		char aMap[256];
+		str_copy(aMap, g_Config.m_SvMap, sizeof(aMap));
+		for(int i = 0; aMap[i]; i++) if(aMap[i] == '/') aMap[i] = '-';
+		str_format(aBase, sizeof(aBase), "%s/%s", g_Config.m_SvScoreFolder, aMap);
+	}
+	else
+		str_copy(aBase, g_Config.m_SvMap, sizeof(aBase));
+	str_format(m_aLogFile, sizeof(m_aLogFile), "%s_record.dtl", aBase);
+	str_format(m_aTextFile, sizeof(m_aTextFile), "%s_record.dtb", aBase);
+
+	// the first start with a log takes over the text file
+	bool Rewrite = false;
+	if(!ReadLog())
+	{
+		if(!m_aScores.size() && ImportText(m_aTextFile) > 0)
+			dbg_msg("score", "imported %d records from '%s'", m_aScores.size(), m_aTextFile);
+		Rewrite = true;
+	}
+	RebuildRanks();
+
+	if(Rewrite && m_aScores.size())
+		Rewrite = !WriteLog();
+	else if(!Rewrite && NeedCompaction())
+		WriteLog();
+
+	// without a usable log the first new time starts one
+	if(!Rewrite)
+		m_LogFile = io_open(m_aLogFile, IOFLAG_APPEND);
+
+	UpdateRecord();
 }
 
 CFileScore::CPlayerScore *CFileScore::SearchName(const char *pName,
 		int *pPosition, bool NoCase)
 {
+	int Index = FindScore(pName);
+	if (Index >= 0)
+	{
+		if (pPosition)
+			*pPosition = RankPosition(m_aScores[Index].m_Score, Index) + 1;
+		return &m_aScores[Index];
+	}
+	if (!NoCase)
+		return 0;
+
+	// a part of the name is enough when only one tee matches, that has to look at all of them
 	CPlayerScore *pPlayer = 0;
-	int Pos = 1;
 	int Found = 0;
-	for (sorted_array<CPlayerScore>::range r = m_Top.all(); !r.empty();
-			r.pop_front())
+	for (int i = 0; i < m_aRanks.size(); i++)
 	{
-		if (str_find_nocase(r.front().m_aName, pName))
+		if (str_find_nocase(m_aScores[m_aRanks[i]].m_aName, pName))
 		{
 			if (pPosition)
-				*pPosition = Pos;
-			if (NoCase)
-			{
-				Found++;
-				pPlayer = &r.front();
-			}
-			if (!strcmp(r.front().m_aName, pName))
-				return &r.front();
+				*pPosition = i + 1;
+			pPlayer = &m_aScores[m_aRanks[i]];
+			Found++;
 		}
-		Pos++;
 	}
 	if (Found > 1)
 	{
@@ -180,26 +474,41 @@ CFileScore::CPlayerScore *CFileScore::SearchName(const char *pName,
 void CFileScore::UpdatePlayer(int ID, float Score,
 		float aCpTime[NUM_CHECKPOINTS])
 {
-	const char *pName = Server()->ClientName(ID);
-
-	lock_wait(gs_ScoreLock);
-	CPlayerScore *pPlayer = SearchScore(ID, 0);
+	int Index = SetScore(Server()->ClientName(ID), Score, aCpTime);
+	AppendLog(&m_aScores[Index]);
+}
 
-	if (pPlayer)
+void CFileScore::ImportRecords(IConsole *pConsole)
+{
+	char aBuf[512];
+	int Num = ImportText(m_aTextFile);
+	if (Num < 0)
+		str_format(aBuf, sizeof(aBuf), "could not open '%s'", m_aTextFile);
+	else
 	{
-		for (int c = 0; c < NUM_CHECKPOINTS; c++)
-			pPlayer->m_aCpTime[c] = aCpTime[c];
-
-		pPlayer->m_Score = Score;
-		str_copy(pPlayer->m_aName, pName, sizeof(pPlayer->m_aName));
-
-		sort(m_Top.all());
+		// the imported times go into the log with a compaction
+		if (Num)
+		{
+			RebuildRanks();
+			if (m_LogFile)
+				io_close(m_LogFile);
+			WriteLog();
+			m_LogFile = io_open(m_aLogFile, IOFLAG_APPEND);
+			UpdateRecord();
+		}
+		str_format(aBuf, sizeof(aBuf), "imported %d records from '%s'", Num, m_aTextFile);
 	}
-	else
-		m_Top.add(*new CPlayerScore(pName, Score, aCpTime));
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "score", aBuf);
+}
 
-	lock_unlock(gs_ScoreLock);
-	Save();
+void CFileScore::ExportRecords(IConsole *pConsole)
+{
+	char aBuf[512];
+	if (ExportText(m_aTextFile))
+		str_format(aBuf, sizeof(aBuf), "exported %d records to '%s'", m_aRanks.size(), m_aTextFile);
+	else
+		str_format(aBuf, sizeof(aBuf), "could not write '%s'", m_aTextFile);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "score", aBuf);
 }
 
 void CFileScore::CheckBirthday(int ClientID)
@@ -209,17 +518,10 @@ void CFileScore::CheckBirthday(int ClientID)
 
 void CFileScore::LoadScore(int ClientID)
 {
-	CPlayerScore *pPlayer = SearchScore(ClientID, 0);
-	if (pPlayer)
-	{
-		lock_wait(gs_ScoreLock);
-		lock_unlock(gs_ScoreLock);
-		Save();
-	}
-
 	// set score
-	if (pPlayer)
-		PlayerData(ClientID)->Set(pPlayer->m_Score, pPlayer->m_aCpTime);
+	int Index = FindScore(Server()->ClientName(ClientID));
+	if (Index >= 0)
+		PlayerData(ClientID)->Set(m_aScores[Index].m_Score, m_aScores[Index].m_aCpTime);
 }
 
 void CFileScore::SaveTeamScore(int* ClientIDs, unsigned int Size, float Time)
@@ -243,9 +545,9 @@ void CFileScore::ShowTop5(IConsole::IResult *pResult, int ClientID,
 	pSelf->SendChatTarget(ClientID, "----------- Top 5 -----------");
 	for (int i = 0; i < 5; i++)
 	{
-		if (i + Debut > m_Top.size())
+		if (i + Debut > m_aRanks.size())
 			break;
-		CPlayerScore *r = &m_Top[i + Debut - 1];
+		CPlayerScore *r = &m_aScores[m_aRanks[i + Debut - 1]];
 		str_format(aBuf, sizeof(aBuf),
 				"%d. %s Time: %d minute(s) %5.2f second(s)", i + Debut,
 				r->m_aName, (int) r->m_Score / 60,
@@ -258,7 +560,7 @@ void CFileScore::ShowTop5(IConsole::IResult *pResult, int ClientID,
 void CFileScore::ShowRank(int ClientID, const char* pName, bool Search)
 {
 	CPlayerScore *pScore;
-	int Pos;
+	int Pos = 0;
 	char aBuf[512];
 
 	if (!Search)
@@ -4,36 +4,70 @@
 #ifndef GAME_SERVER_FILESCORE_H
 #define GAME_SERVER_FILESCORE_H
 
-#include <base/tl/sorted_array.h>
+#include <base/tl/array.h>
 
 #include "../score.h"
 
+/*
+	Class: CFileScore
+		Keeps the best time of every tee in memory and appends every new
+		time to <map>_record.dtl, a binary log. The log is read back on
+		start and rewritten with only the live times once it has grown
+		to COMPACT_RATIO times their number. The old <map>_record.dtb text
+		files are imported when there is no log yet, and can be imported
+		and exported with score_import and score_export.
+*/
 class CFileScore: public IScore
 {
 	CGameContext *m_pGameServer;
 	IServer *m_pServer;
 
-	class CPlayerScore
+	// also the entry of the log file
+	struct CPlayerScore
 	{
-	public:
 		char m_aName[MAX_NAME_LENGTH];
 		float m_Score;
 		float m_aCpTime[NUM_CHECKPOINTS];
+		int m_Achieved; // order in which the times were set, the earlier one ranks first on a tie
+	};
+
+	struct CLogHeader
+	{
+		char m_aID[4];
+		int m_Version;
+	};
+
+	enum
+	{
+		LOG_VERSION=2,
+		LOG_VERSION_NO_ACHIEVED=1, // entries without m_Achieved, in the order the times were set
 
-		CPlayerScore()
-		{
-		}
-		;
-		CPlayerScore(const char *pName, float Score,
-				float aCpTime[NUM_CHECKPOINTS]);
-
-		bool operator<(const CPlayerScore& other)
-		{
-			return (this->m_Score < other.m_Score);
-		}
+		// the log is compacted when it holds this many entries per tee
+		COMPACT_RATIO=2,
+		COMPACT_MIN_ENTRIES=256,
 	};
 
-	sorted_array<CPlayerScore> m_Top;
+	// the best score of every tee, entries are never removed
+	array<CPlayerScore> m_aScores;
+	// indices into m_aScores ordered by time, the position is the rank
+	array<int> m_aRanks;
+	// name -> index into m_aScores, open addressing, -1 is a free slot
+	int *m_pNameIndex;
+	int m_NameIndexSize;
+	int m_LastAchieved;
+
+	class CRankCompare
+	{
+		const CFileScore *m_pThis;
+	public:
+		CRankCompare(const CFileScore *pThis) : m_pThis(pThis) {}
+		bool operator()(int a, int b) const { return m_pThis->RankLess(a, m_pThis->m_aScores[b].m_Score, b); }
+	};
+
+	IOHANDLE m_LogFile;
+	int m_NumLogEntries;
+	char m_aLogFile[512];
+	char m_aTextFile[512];
 
 	CGameContext *GameServer()
 	{
@@ -53,15 +87,31 @@ class CFileScore: public IScore
 	CPlayerScore *SearchName(const char *pName, int *pPosition, bool MatchCase);
 	void UpdatePlayer(int ID, float Score, float aCpTime[NUM_CHECKPOINTS]);
 
+	int FindScore(const char *pName) const;
+	void IndexName(int Index);
+	bool StoreScore(const CPlayerScore *pScore, bool OnlyBetter);
+	bool RankLess(int Index, float Score, int Other) const;
+	int RankPosition(float Score, int Index) const;
+	void RebuildRanks();
+	int SetScore(const char *pName, float Score, const float *pCpTime);
+	void UpdateRecord();
+
 	void Init();
-	void Save();
-	static void SaveScoreThread(void *pUser);
+	bool ReadLog();
+	bool WriteLog();
+	void AppendLog(const CPlayerScore *pScore);
+	bool NeedCompaction() const;
+	int ImportText(const char *pFilename);
+	bool ExportText(const char *pFilename);
 
 public:
 
 	CFileScore(CGameContext *pGameServer);
 	~CFileScore();
 
+	virtual void ImportRecords(IConsole *pConsole);
+	virtual void ExportRecords(IConsole *pConsole);
+
 	virtual void CheckBirthday(int ClientID);
 	virtual void LoadScore(int ClientID);
 	virtual void MapInfo(int ClientID, const char* MapName);
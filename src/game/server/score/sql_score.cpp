@@ -6,6 +6,8 @@
 #include <fstream>
 #include <algorithm>
 
+#include <base/math.h>
+#include <base/tl/threading.h>
 #include <engine/shared/config.h>
 #include "../entities/character.h"
 #include "../gamemodes/DDRace.h"
@@ -13,96 +15,100 @@
 #include <engine/shared/console.h>
 #include "../save.h"
 
-static LOCK gs_SqlLock = 0;
-
-CSqlScore::CSqlScore(CGameContext *pGameServer) : m_pGameServer(pGameServer),
-		m_pServer(pGameServer->Server()),
-		m_pDatabase(g_Config.m_SvSqlDatabase),
-		m_pPrefix(g_Config.m_SvSqlPrefix),
-		m_pUser(g_Config.m_SvSqlUser),
-		m_pPass(g_Config.m_SvSqlPw),
-		m_pIp(g_Config.m_SvSqlIp),
-		m_Port(g_Config.m_SvSqlPort)
+// prepared once per connection, every %s is the table prefix
+static const char *gs_apQueries[CSqlConnection::NUM_STATEMENTS] =
 {
-	m_pDriver = NULL;
-	str_copy(m_aMap, g_Config.m_SvMap, sizeof(m_aMap));
-	ClearString(m_aMap);
-
-	if(gs_SqlLock == 0)
-		gs_SqlLock = lock_create();
-
-	Init();
+	"SELECT Time FROM %s_race WHERE Map=? ORDER BY `Time` ASC LIMIT 0, 1;",
+	"SELECT * FROM %s_race WHERE Map=? AND Name=? ORDER BY time ASC LIMIT 1;",
+	"SELECT Points FROM %s_maps WHERE Map=?;",
+	"select year(Current) - year(Stamp) as YearsAgo from (select CURRENT_TIMESTAMP as Current, min(Timestamp) as Stamp from %s_race WHERE Name=?) as l where dayofmonth(Current) = dayofmonth(Stamp) and month(Current) = month(Stamp) and year(Current) > year(Stamp);",
+	"SELECT Rank, Name, Time FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = ? GROUP BY Name ORDER BY `Time` ASC) as a) as b WHERE Name = ?;",
+	"SELECT Name, Time, rank FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = ? GROUP BY Name ORDER BY `Time` ASC) as a) as b LIMIT ?, 5;",
+	"SELECT Name, Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = ? ORDER BY Ago ASC LIMIT ?, 5;",
+	"SELECT Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = ? AND Name = ? ORDER BY Ago ASC LIMIT ?, 5;",
+	"select Rank, Name, Points from (select (@pos := @pos+1) pos, (@rank := IF(@prev = Points,@rank,@pos)) Rank, Points, Name from (select (@prev := Points) Points, Name from %s_points order by Points desc) as ll) as l where Name = ?;",
+	"select Rank, Name, Points from (select (@pos := @pos+1) pos, (@rank := IF(@prev = Points,@rank,@pos)) Rank, Points, Name from (select (@prev := Points) Points, Name from %s_points order by Points desc) as ll) as l LIMIT ?, 5;",
+	"SELECT Name, l.ID, Time FROM ((SELECT ID FROM %s_teamrace WHERE Map = ? AND Name = ?) as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY ID;",
+	"UPDATE %s_teamrace SET Time=? WHERE ID = ?;",
+	"SELECT Rank, Name, Time FROM (SELECT Rank, l2.ID FROM ((SELECT ID, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank,@pos)) rank, (@prev := Time) Time FROM (SELECT ID, Time FROM %s_teamrace WHERE Map = ? GROUP BY ID ORDER BY Time) as ll) as l2) LEFT JOIN %s_teamrace as r2 ON l2.ID = r2.ID WHERE Map = ? AND Name = ? ORDER BY Rank LIMIT 1) as l LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY Name;",
+	"SELECT ID, Name, Time, rank FROM (SELECT r.ID, Name, rank, l.Time FROM ((SELECT ID, rank, Time FROM (SELECT ID, (@pos := IF(@previd = ID,@pos,@pos+1)) pos, (@previd := ID), (@rank := IF(@prev = Time,@rank,@pos)) rank, (@prev := Time) Time FROM (SELECT ID, MIN(Time) as Time FROM %s_teamrace WHERE Map = ? GROUP BY ID ORDER BY `Time` ASC) as all_top_times) as a LIMIT ?, 5) as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY Time ASC, r.ID, Name ASC) as a;",
+	"SELECT Map, Server FROM %s_maps WHERE Map LIKE ? COLLATE utf8_general_ci ORDER BY CASE WHEN Map = ? THEN 0 ELSE 1 END, CASE WHEN Map LIKE CONCAT(?, '%%') THEN 0 ELSE 1 END, LENGTH(Map), Map LIMIT 1;",
+	"SELECT l.Map, l.Server, Mapper, Points, Stars, (select count(Name) from %s_race where Map = l.Map) as Finishes, (select count(distinct Name) from %s_race where Map = l.Map) as Finishers, (select round(avg(Time)) from %s_race where Map = l.Map) as Average, UNIX_TIMESTAMP(l.Timestamp) as Stamp, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(l.Timestamp) as Ago FROM (SELECT * FROM %s_maps WHERE Map LIKE ? COLLATE utf8_general_ci ORDER BY CASE WHEN Map = ? THEN 0 ELSE 1 END, CASE WHEN Map LIKE CONCAT(?, '%%') THEN 0 ELSE 1 END, LENGTH(Map), Map LIMIT 1) as l;",
+	"select * from %s_maps where Server = ? order by RAND() limit 1;",
+	"select * from %s_maps where Server = ? and Stars = ? order by RAND() limit 1;",
+	"select * from %s_maps where Server = ? and not exists (select * from %s_race where Name = ? and %s_race.Map = %s_maps.Map) order by RAND() limit 1;",
+	"select * from %s_maps where Server = ? and Stars = ? and not exists (select * from %s_race where Name = ? and %s_race.Map = %s_maps.Map) order by RAND() limit 1;",
+	"select Savegame from %s_saves where Code = ? and Map = ?;",
+	"INSERT IGNORE INTO %s_saves(Savegame, Map, Code, Timestamp, Server) VALUES (?, ?, ?, CURRENT_TIMESTAMP(), ?);",
+	"select Savegame, Server, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago from %s_saves where Code = ? and Map = ?;",
+	"DELETE from %s_saves where Code = ? and Map = ?;",
+};
+
+// the row is repeated once per row, separated by commas
+static const struct
+{
+	const char *m_pHead;
+	const char *m_pRow;
+	const char *m_pTail;
+} gs_aBatchQueries[CSqlConnection::NUM_BATCHES] =
+{
+	{"SELECT DISTINCT Name FROM %s_race WHERE Map=? AND Name IN (", "?", ");"},
+	{"INSERT IGNORE INTO %s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25) VALUES ", "(?, ?, CURRENT_TIMESTAMP(), ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", ";"},
+	{"INSERT INTO %s_points(Name, Points) VALUES ", "(?, ?)", " ON duplicate key UPDATE Name=VALUES(Name), Points=Points+VALUES(Points);"},
+	{"INSERT IGNORE INTO %s_teamrace(Map, Name, Timestamp, Time, ID) VALUES ", "(?, ?, CURRENT_TIMESTAMP(), ?, @id)", ";"},
+};
+
+// times went into the queries as '%.2f' before, keep storing them like that
+static double RoundTime(float Time)
+{
+	return round_to_int(Time*100.0f)/100.0;
 }
 
-CSqlScore::~CSqlScore()
+CSqlConnection::CSqlConnection()
 {
-	lock_wait(gs_SqlLock);
-	lock_unlock(gs_SqlLock);
-
-	try
-	{
-		delete m_pStatement;
-		delete m_pConnection;
-		dbg_msg("SQL", "SQL connection disconnected");
-	}
-	catch (sql::SQLException &e)
-	{
-		dbg_msg("SQL", "ERROR: No SQL connection");
-	}
+	m_pConnection = 0;
+	m_pStatement = 0;
+	m_pPrefix = "";
+	for(int i = 0; i < NUM_STATEMENTS; i++)
+		m_apPrepared[i] = 0;
+	mem_zero(m_aapBatches, sizeof(m_aapBatches));
 }
 
-bool CSqlScore::Connect()
+bool CSqlConnection::Connect(const char *pIp, int Port, const char *pUser, const char *pPass, const char *pDatabase, const char *pPrefix, bool CreateDatabase)
 {
-	if (m_pDriver != NULL && m_pConnection != NULL)
-	{
-		try
-		{
-			// Connect to specific database
-			m_pConnection->setSchema(m_pDatabase);
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-
-			dbg_msg("SQL", "ERROR: SQL connection failed");
-			return false;
-		}
+	if(m_pConnection)
 		return true;
-	}
 
 	try
 	{
 		char aBuf[256];
 
-		m_pDriver = 0;
-		m_pConnection = 0;
-		m_pStatement = 0;
-
 		sql::ConnectOptionsMap connection_properties;
-		connection_properties["hostName"]      = sql::SQLString(m_pIp);
-		connection_properties["port"]          = m_Port;
-		connection_properties["userName"]      = sql::SQLString(m_pUser);
-		connection_properties["password"]      = sql::SQLString(m_pPass);
-		connection_properties["OPT_RECONNECT"] = true;
+		connection_properties["hostName"]      = sql::SQLString(pIp);
+		connection_properties["port"]          = Port;
+		connection_properties["userName"]      = sql::SQLString(pUser);
+		connection_properties["password"]      = sql::SQLString(pPass);
+		// a reconnect would lose the prepared statements, the pool connects again itself
+		connection_properties["OPT_RECONNECT"] = false;
+		// don't keep a worker, and with it the map change, waiting for a server that is gone
+		connection_properties["OPT_CONNECT_TIMEOUT"] = g_Config.m_SvSqlConnectTimeout;
 
 		// Create connection
-		m_pDriver = get_driver_instance();
-		m_pConnection = m_pDriver->connect(connection_properties);
+		m_pConnection = get_driver_instance()->connect(connection_properties);
 
 		// Create Statement
 		m_pStatement = m_pConnection->createStatement();
 
 		// Create database if not exists
-		if(g_Config.m_SvSqlCreateTables)
+		if(CreateDatabase)
 		{
-			str_format(aBuf, sizeof(aBuf), "CREATE DATABASE IF NOT EXISTS %s", m_pDatabase);
+			str_format(aBuf, sizeof(aBuf), "CREATE DATABASE IF NOT EXISTS %s", pDatabase);
 			m_pStatement->execute(aBuf);
 		}
 
 		// Connect to specific database
-		m_pConnection->setSchema(m_pDatabase);
+		m_pConnection->setSchema(pDatabase);
+		m_pPrefix = pPrefix;
 		dbg_msg("SQL", "SQL connection established");
 		return true;
 	}
@@ -111,365 +117,566 @@ bool CSqlScore::Connect()
 		char aBuf[256];
 		str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
 		dbg_msg("SQL", aBuf);
-
-		dbg_msg("SQL", "ERROR: SQL connection failed");
-		return false;
 	}
-	catch (const std::exception& ex)
+	catch (...)
 	{
-		// ...
-		dbg_msg("SQL", "1 %s",ex.what());
-
+		dbg_msg("SQL", "Unknown Error cause by the MySQL/C++ Connector, my advice compile server_debug and use it");
 	}
-	catch (const std::string& ex)
+
+	dbg_msg("SQL", "ERROR: SQL connection failed");
+	Disconnect();
+	return false;
+}
+
+void CSqlConnection::Disconnect()
+{
+	try
 	{
-		// ...
-		dbg_msg("SQL", "2 %s",ex.c_str());
+		for(int i = 0; i < NUM_STATEMENTS; i++)
+			delete m_apPrepared[i];
+		for(int i = 0; i < NUM_BATCHES; i++)
+			for(int j = 0; j < MAX_BATCH_ROWS; j++)
+				delete m_aapBatches[i][j];
+		delete m_pStatement;
+		delete m_pConnection;
 	}
-	catch( int )
+	catch (sql::SQLException &e)
 	{
-		dbg_msg("SQL", "3 %s");
+		dbg_msg("SQL", "ERROR: No SQL connection");
 	}
-	catch( float )
+
+	for(int i = 0; i < NUM_STATEMENTS; i++)
+		m_apPrepared[i] = 0;
+	mem_zero(m_aapBatches, sizeof(m_aapBatches));
+	m_pStatement = 0;
+	m_pConnection = 0;
+}
+
+sql::PreparedStatement *CSqlConnection::Prepared(int Index)
+{
+	if(!m_apPrepared[Index])
 	{
-		dbg_msg("SQL", "4 %s");
+		// no query uses the prefix more than four times
+		char aBuf[1024];
+		str_format(aBuf, sizeof(aBuf), gs_apQueries[Index], m_pPrefix, m_pPrefix, m_pPrefix, m_pPrefix);
+		m_apPrepared[Index] = m_pConnection->prepareStatement(aBuf);
 	}
+	return m_apPrepared[Index];
+}
 
-	catch( char[] )
+sql::PreparedStatement *CSqlConnection::PreparedBatch(int Index, int NumRows)
+{
+	dbg_assert(NumRows > 0 && NumRows <= MAX_BATCH_ROWS, "invalid sql batch size");
+	sql::PreparedStatement **ppStmt = &m_aapBatches[Index][NumRows-1];
+	if(!*ppStmt)
 	{
-		dbg_msg("SQL", "5 %s");
+		char aBuf[4096];
+		str_format(aBuf, sizeof(aBuf), gs_aBatchQueries[Index].m_pHead, m_pPrefix);
+		for(int i = 0; i < NumRows; i++)
+		{
+			if(i > 0)
+				str_append(aBuf, ", ", sizeof(aBuf));
+			str_append(aBuf, gs_aBatchQueries[Index].m_pRow, sizeof(aBuf));
+		}
+		str_append(aBuf, gs_aBatchQueries[Index].m_pTail, sizeof(aBuf));
+		*ppStmt = m_pConnection->prepareStatement(aBuf);
 	}
+	return *ppStmt;
+}
+
+void CSqlConnection::BeginTransaction()
+{
+	m_pConnection->setAutoCommit(false);
+}
+
+void CSqlConnection::Commit()
+{
+	m_pConnection->commit();
+	m_pConnection->setAutoCommit(true);
+}
 
-	catch( char )
+void CSqlConnection::Rollback()
+{
+	// the connection might be gone already, then the server drops the transaction itself
+	try
 	{
-		dbg_msg("SQL", "6 %s");
+		m_pConnection->rollback();
+		m_pConnection->setAutoCommit(true);
 	}
-	catch (...)
+	catch (sql::SQLException &e)
 	{
-		dbg_msg("SQL", "Unknown Error cause by the MySQL/C++ Connector, my advice compile server_debug and use it");
-
-		dbg_msg("SQL", "ERROR: SQL connection failed");
-		return false;
+		dbg_msg("SQL", "ERROR: Rollback failed");
 	}
-	return false;
 }
 
-void CSqlScore::Disconnect()
+void CSqlResult::AddLine(int Mode, int To, const char *pText)
 {
+	if(m_NumLines == MAX_LINES)
+	{
+		dbg_msg("SQL", "too many result lines, dropped '%s'", pText);
+		return;
+	}
+
+	m_aLines[m_NumLines].m_Mode = Mode;
+	m_aLines[m_NumLines].m_To = To;
+	str_copy(m_aLines[m_NumLines].m_aText, pText, sizeof(m_aLines[m_NumLines].m_aText));
+	m_NumLines++;
 }
 
-// create tables... should be done only once
-void CSqlScore::Init()
+void CSqlResult::Send(CGameContext *pGameServer, int SkipClientID) const
 {
-	// create connection
-	if(Connect())
+	for(int i = 0; i < m_NumLines; i++)
 	{
-		try
-		{
-			char aBuf[1024];
-			// create tables
-			if(g_Config.m_SvSqlCreateTables)
-			{
-				str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_race (Map VARCHAR(128) BINARY NOT NULL, Name VARCHAR(%d) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP , Time FLOAT DEFAULT 0, Server CHAR(4), cp1 FLOAT DEFAULT 0, cp2 FLOAT DEFAULT 0, cp3 FLOAT DEFAULT 0, cp4 FLOAT DEFAULT 0, cp5 FLOAT DEFAULT 0, cp6 FLOAT DEFAULT 0, cp7 FLOAT DEFAULT 0, cp8 FLOAT DEFAULT 0, cp9 FLOAT DEFAULT 0, cp10 FLOAT DEFAULT 0, cp11 FLOAT DEFAULT 0, cp12 FLOAT DEFAULT 0, cp13 FLOAT DEFAULT 0, cp14 FLOAT DEFAULT 0, cp15 FLOAT DEFAULT 0, cp16 FLOAT DEFAULT 0, cp17 FLOAT DEFAULT 0, cp18 FLOAT DEFAULT 0, cp19 FLOAT DEFAULT 0, cp20 FLOAT DEFAULT 0, cp21 FLOAT DEFAULT 0, cp22 FLOAT DEFAULT 0, cp23 FLOAT DEFAULT 0, cp24 FLOAT DEFAULT 0, cp25 FLOAT DEFAULT 0, KEY (Map, Name)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
-				m_pStatement->execute(aBuf);
+		const CLine *pLine = &m_aLines[i];
+		if(pLine->m_Mode == CHAT_TARGET && pLine->m_To == SkipClientID)
+			continue;
+		if(pLine->m_Mode == CHAT_ALL)
+			pGameServer->SendChat(-1, CGameContext::CHAT_ALL, pLine->m_aText, pLine->m_To);
+		else if(pLine->m_Mode == CHAT_TEAM)
+			pGameServer->SendChatTeam(pLine->m_To, pLine->m_aText);
+		else
+			pGameServer->SendChatTarget(pLine->m_To, pLine->m_aText);
+	}
 
-				str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_teamrace (Map VARCHAR(128) BINARY NOT NULL, Name VARCHAR(%d) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Time FLOAT DEFAULT 0, ID VARBINARY(16) NOT NULL, KEY Map (Map)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
-				m_pStatement->execute(aBuf);
+	if(m_aCommand[0])
+		pGameServer->Console()->ExecuteLine(m_aCommand);
+}
 
-				str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_maps (Map VARCHAR(128) BINARY NOT NULL, Server VARCHAR(32) BINARY NOT NULL, Mapper VARCHAR(128) BINARY NOT NULL, Points INT DEFAULT 0, Stars INT DEFAULT 0, Timestamp TIMESTAMP, UNIQUE KEY Map (Map)) CHARACTER SET utf8 ;", m_pPrefix);
-				m_pStatement->execute(aBuf);
+CSqlScore::CSqlScore(CGameContext *pGameServer) : m_pGameServer(pGameServer),
+		m_pServer(pGameServer->Server()),
+		m_pDatabase(g_Config.m_SvSqlDatabase),
+		m_pPrefix(g_Config.m_SvSqlPrefix),
+		m_pUser(g_Config.m_SvSqlUser),
+		m_pPass(g_Config.m_SvSqlPw),
+		m_pIp(g_Config.m_SvSqlIp),
+		m_Port(g_Config.m_SvSqlPort)
+{
+	str_copy(m_aMapName, g_Config.m_SvMap, 33);
+
+	m_NumConnections = clamp(g_Config.m_SvSqlConnections, 1, (int)MAX_CONNECTIONS);
+	for(int i = 0; i < m_NumConnections; i++)
+		m_aFreeConnections[i] = i;
+	m_NumFreeConnections = m_NumConnections;
+	m_ConnectionLock = lock_create();
+
+	m_Shutdown = false;
+	m_Unreachable = false;
+	m_StatsLock = lock_create();
+	m_NumRunning = 0;
+	m_NumDone = 0;
+	m_NumFailed = 0;
+	m_NumRejected = 0;
+	m_TotalWaitTime = 0;
+	m_MaxWaitTime = 0;
+	m_TotalRunTime = 0;
+	m_MaxRunTime = 0;
+	m_pWriteBatch = 0;
+	m_WriteBatchStart = 0;
+	m_LastWriteSeq = 0;
+	mem_zero(m_aaLoadingCodes, sizeof(m_aaLoadingCodes));
 
-				str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_saves (Savegame TEXT CHARACTER SET utf8 BINARY NOT NULL, Map VARCHAR(128) BINARY NOT NULL, Code VARCHAR(128) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Server CHAR(4), UNIQUE KEY (Map, Code)) CHARACTER SET utf8 ;", m_pPrefix);
-				m_pStatement->execute(aBuf);
+	Init();
 
-				str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_points (Name VARCHAR(%d) BINARY NOT NULL, Points INT DEFAULT 0, UNIQUE KEY Name (Name)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
-				m_pStatement->execute(aBuf);
+	// one worker per connection, so a worker always finds a free one
+	m_Pool.Init(m_NumConnections);
+}
 
-				dbg_msg("SQL", "Tables were created successfully");
-			}
+CSqlScore::~CSqlScore()
+{
+	// only the queued writes still go to the database, reads are skipped since their results
+	// go away with the game context. once a connect fails the rest is given up, so the wait
+	// takes about one sv_sql_connect_timeout per worker at most
+	m_Shutdown = true;
+	FlushWrites();
+	m_Requests.Wait();
+	m_Pool.RunCallbacks();
+	for(int i = 0; i < m_lpRejected.size(); i++)
+		RequestDone(&m_lpRejected[i]->m_Job, m_lpRejected[i]);
+	m_lpRejected.clear();
+	for(int i = 0; i < m_lpWaitingReads.size(); i++)
+		RequestDone(&m_lpWaitingReads[i]->m_Job, m_lpWaitingReads[i]);
+	m_lpWaitingReads.clear();
+
+	for(int i = 0; i < m_NumConnections; i++)
+		m_aConnections[i].Disconnect();
+	dbg_msg("SQL", "SQL connection disconnected");
+
+	lock_destroy(m_ConnectionLock);
+	lock_destroy(m_StatsLock);
+}
 
-			// get the best time
-			str_format(aBuf, sizeof(aBuf), "SELECT Time FROM %s_race WHERE Map='%s' ORDER BY `Time` ASC LIMIT 0, 1;", m_pPrefix, m_aMap);
-			m_pResults = m_pStatement->executeQuery(aBuf);
+CSqlConnection *CSqlScore::AcquireConnection()
+{
+	lock_wait(m_ConnectionLock);
+	dbg_assert(m_NumFreeConnections > 0, "no free sql connection");
+	CSqlConnection *pSql = &m_aConnections[m_aFreeConnections[--m_NumFreeConnections]];
+	lock_unlock(m_ConnectionLock);
+	return pSql;
+}
 
-			if(m_pResults->next())
-			{
-				((CGameControllerDDRace*)GameServer()->m_pController)->m_CurrentRecord = (float)m_pResults->getDouble("Time");
+void CSqlScore::ReleaseConnection(CSqlConnection *pSql)
+{
+	lock_wait(m_ConnectionLock);
+	m_aFreeConnections[m_NumFreeConnections++] = pSql-m_aConnections;
+	lock_unlock(m_ConnectionLock);
+}
 
-				dbg_msg("SQL", "Getting best time on server done");
-			}
+bool CSqlScore::ConnectDatabase(CSqlConnection *pSql)
+{
+	return pSql->Connect(m_pIp, m_Port, m_pUser, m_pPass, m_pDatabase, m_pPrefix, g_Config.m_SvSqlCreateTables);
+}
 
-			// delete statement
-			delete m_pResults;
-		}
-		catch (sql::SQLException &e)
+void CSqlScore::AddRequest(CSqlRequest *pRequest, SQLFUNC pfnFunc, SQLDONEFUNC pfnDone, bool Write)
+{
+	pRequest->m_pSqlData = this;
+	pRequest->m_pfnFunc = pfnFunc;
+	pRequest->m_pfnDone = pfnDone;
+	pRequest->m_QueueTime = time_get();
+	pRequest->m_Write = Write;
+	pRequest->m_Connected = false;
+	pRequest->m_Failed = false;
+	pRequest->m_Stale = false;
+	if(pRequest->m_ClientID >= 0)
+		str_copy(pRequest->m_aClientName, Server()->ClientName(pRequest->m_ClientID), sizeof(pRequest->m_aClientName));
+
+	// reads give up when the database can't keep up. writes are always queued, a dropped
+	// one would lose a time or leave a loaded savegame in place
+	if(!Write && m_Requests.NumPending()+m_lpWaitingReads.size() >= g_Config.m_SvSqlMaxQueue)
+	{
+		dbg_msg("SQL", "request queue is full, dropping a request");
+		pRequest->m_Failed = true;
+		m_lpRejected.add(pRequest);
+		m_NumRejected++;
+		return;
+	}
+
+	if(Write)
+	{
+		pRequest->m_WriteSeq = ++m_LastWriteSeq;
+		m_lPendingWrites.add(pRequest->m_WriteSeq);
+	}
+	else
+	{
+		// the finishes collected so far go out first
+		FlushWrites();
+		if(m_lPendingWrites.size())
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Tables were NOT created");
+			pRequest->m_WriteSeq = m_LastWriteSeq;
+			m_lpWaitingReads.add(pRequest);
+			return;
 		}
-
-		// disconnect from database
-		Disconnect();
 	}
+
+	m_Pool.Add(&pRequest->m_Job, RunRequest, pRequest, &m_Requests, RequestDone);
 }
 
-void CSqlScore::CheckBirthdayThread(void *pUser)
+void CSqlScore::QueueWaitingReads()
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+	int Queued = 0;
+	while(Queued < m_lpWaitingReads.size() && (!m_lPendingWrites.size() || m_lpWaitingReads[Queued]->m_WriteSeq < m_lPendingWrites[0]))
+	{
+		CSqlRequest *pRequest = m_lpWaitingReads[Queued++];
+		m_Pool.Add(&pRequest->m_Job, RunRequest, pRequest, &m_Requests, RequestDone);
+	}
+	for(int i = 0; i < Queued; i++)
+		m_lpWaitingReads.remove_index(0);
+}
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+CSqlWriteBatch *CSqlScore::WriteBatch(bool Team)
+{
+	if(m_pWriteBatch && (Team ? m_pWriteBatch->m_NumTeams == CSqlWriteBatch::MAX_TEAMS : m_pWriteBatch->m_NumScores == CSqlWriteBatch::MAX_SCORES))
+		FlushWrites();
+	if(!m_pWriteBatch)
 	{
-		try
-		{
-			// check strings
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
+		m_pWriteBatch = new CSqlWriteBatch();
+		m_WriteBatchStart = time_get();
+	}
+	return m_pWriteBatch;
+}
 
-			char aBuf[512];
+void CSqlScore::FlushWrites()
+{
+	if(!m_pWriteBatch)
+		return;
+	AddRequest(m_pWriteBatch, WriteBatchThread, WriteBatchDone, true);
+	m_pWriteBatch = 0;
+}
 
-			str_format(aBuf, sizeof(aBuf), "select year(Current) - year(Stamp) as YearsAgo from (select CURRENT_TIMESTAMP as Current, min(Timestamp) as Stamp from %s_race WHERE Name='%s') as l where dayofmonth(Current) = dayofmonth(Stamp) and month(Current) = month(Stamp) and year(Current) > year(Stamp);", pData->m_pSqlData->m_pPrefix, pData->m_aName);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-			if(pData->m_pSqlData->m_pResults->next())
-			{
-				int yearsAgo = (int)pData->m_pSqlData->m_pResults->getInt("YearsAgo");
-				str_format(aBuf, sizeof(aBuf), "Happy DDNet birthday to %s for finishing their first map %d year%s ago!", originalName, yearsAgo, yearsAgo > 1 ? "s" : "");
-				pData->m_pSqlData->GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, pData->m_ClientID);
-			}
+int CSqlScore::RunRequest(void *pUser)
+{
+	CSqlRequest *pRequest = (CSqlRequest *)pUser;
+	CSqlScore *pSelf = pRequest->m_pSqlData;
+	if(pSelf->m_Shutdown && (!pRequest->m_Write || pSelf->m_Unreachable))
+	{
+		pRequest->m_Failed = true;
+		return 0;
+	}
 
-			dbg_msg("SQL", "Checking birthday done");
+	int64 StartTime = time_get();
+	atomic_inc(&pSelf->m_NumRunning);
 
-			// delete statement and results
-			delete pData->m_pSqlData->m_pResults;
+	CSqlConnection *pSql = pSelf->AcquireConnection();
+	if(pSelf->ConnectDatabase(pSql))
+	{
+		pRequest->m_Connected = true;
+		try
+		{
+			pRequest->m_pfnFunc(pSql, pRequest);
 		}
 		catch (sql::SQLException &e)
 		{
 			char aBuf[256];
 			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
 			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not check birthday");
-		}
+			pRequest->m_Failed = true;
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+			// the state of the connection is unknown now, start over with a new one
+			pSql->Disconnect();
+		}
+	}
+	else
+	{
+		pRequest->m_Failed = true;
+		if(pSelf->m_Shutdown)
+			pSelf->m_Unreachable = true;
 	}
+	pSelf->ReleaseConnection(pSql);
+
+	int64 EndTime = time_get();
+	lock_wait(pSelf->m_StatsLock);
+	pSelf->m_NumDone++;
+	if(pRequest->m_Failed)
+		pSelf->m_NumFailed++;
+	pSelf->m_TotalWaitTime += StartTime-pRequest->m_QueueTime;
+	pSelf->m_MaxWaitTime = max(pSelf->m_MaxWaitTime, StartTime-pRequest->m_QueueTime);
+	pSelf->m_TotalRunTime += EndTime-StartTime;
+	pSelf->m_MaxRunTime = max(pSelf->m_MaxRunTime, EndTime-StartTime);
+	lock_unlock(pSelf->m_StatsLock);
+
+	atomic_dec(&pSelf->m_NumRunning);
+	return 0;
+}
+
+void CSqlScore::RequestDone(CJob *pJob, void *pUser)
+{
+	CSqlRequest *pRequest = (CSqlRequest *)pUser;
+	CSqlScore *pSelf = pRequest->m_pSqlData;
+
+	if(pRequest->m_Write)
+		pSelf->m_lPendingWrites.remove(pRequest->m_WriteSeq);
 
-	delete pData;
+	if(!pSelf->m_Shutdown)
+	{
+		// the player left and someone else got the slot, or they are known by another name now
+		if(pRequest->m_ClientID >= 0 && str_comp(pRequest->m_aClientName, pSelf->Server()->ClientName(pRequest->m_ClientID)) != 0)
+			pRequest->m_Stale = true;
 
-	lock_unlock(gs_SqlLock);
+		pRequest->m_Result.Send(pSelf->GameServer(), pRequest->m_Stale ? pRequest->m_ClientID : -1);
+		if(pRequest->m_pfnDone)
+			pRequest->m_pfnDone(pRequest);
+	}
+	else if(pRequest->m_pfnDone == WriteBatchDone)
+	{
+		// only its log is written then, times lost during shutdown still show up there
+		WriteBatchDone(pRequest);
+	}
+
+	delete pRequest;
 }
 
-void CSqlScore::CheckBirthday(int ClientID)
+void CSqlScore::OnTick()
 {
-	CSqlScoreData *Tmp = new CSqlScoreData();
-	Tmp->m_ClientID = ClientID;
-	str_copy(Tmp->m_aName, Server()->ClientName(ClientID), MAX_NAME_LENGTH);
-	Tmp->m_pSqlData = this;
+	if(m_pWriteBatch && time_get() >= m_WriteBatchStart + time_freq()*g_Config.m_SvSqlWriteDelay/1000)
+		FlushWrites();
+	m_Pool.RunCallbacks();
 
-	void *CheckThread = thread_init(CheckBirthdayThread, Tmp);
-	thread_detach(CheckThread);
-}
+	// done functions may queue more requests, those are handled here as well
+	for(int i = 0; i < m_lpRejected.size(); i++)
+		RequestDone(&m_lpRejected[i]->m_Job, m_lpRejected[i]);
+	m_lpRejected.clear();
 
+	QueueWaitingReads();
+}
 
-// update stuff
-void CSqlScore::LoadScoreThread(void *pUser)
+void CSqlScore::PrintStats(IConsole *pConsole)
 {
-	lock_wait(gs_SqlLock);
+	lock_wait(m_StatsLock);
+	int NumDone = m_NumDone;
+	int NumFailed = m_NumFailed;
+	int NumRejected = m_NumRejected;
+	double AvgWait = NumDone ? m_TotalWaitTime*1000.0/time_freq()/NumDone : 0.0;
+	double MaxWait = m_MaxWaitTime*1000.0/time_freq();
+	double AvgRun = NumDone ? m_TotalRunTime*1000.0/time_freq()/NumDone : 0.0;
+	double MaxRun = m_MaxRunTime*1000.0/time_freq();
+	lock_unlock(m_StatsLock);
+
+	// pending counts the running requests too
+	int NumRunning = m_NumRunning;
+	int NumQueued = max(m_Requests.NumPending()-NumRunning, 0)+m_lpWaitingReads.size();
+	int NumConnected = 0;
+	for(int i = 0; i < m_NumConnections; i++)
+		if(m_aConnections[i].Connected())
+			NumConnected++;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "connections: %d/%d, queued: %d, running: %d", NumConnected, m_NumConnections, NumQueued, NumRunning);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	str_format(aBuf, sizeof(aBuf), "requests: %d done, %d failed, %d dropped", NumDone, NumFailed, NumRejected);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	str_format(aBuf, sizeof(aBuf), "queue wait: %.2f ms average, %.2f ms max", AvgWait, MaxWait);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	str_format(aBuf, sizeof(aBuf), "execution: %.2f ms average, %.2f ms max", AvgRun, MaxRun);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+	str_format(aBuf, sizeof(aBuf), "unwritten: %d finishes, %d team finishes", m_pWriteBatch ? m_pWriteBatch->m_NumScores : 0, m_pWriteBatch ? m_pWriteBatch->m_NumTeams : 0);
+	pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", aBuf);
+}
 
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+// create tables... should be done only once
+void CSqlScore::Init()
+{
+	// runs before the workers start, on the first connection
+	CSqlConnection *pSql = &m_aConnections[0];
+	if(!ConnectDatabase(pSql))
+		return;
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	try
 	{
-		try
+		char aBuf[1024];
+		// create tables
+		if(g_Config.m_SvSqlCreateTables)
 		{
-			// check strings
-			pData->m_pSqlData->ClearString(pData->m_aName);
+			str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_race (Map VARCHAR(128) BINARY NOT NULL, Name VARCHAR(%d) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP , Time FLOAT DEFAULT 0, Server CHAR(4), cp1 FLOAT DEFAULT 0, cp2 FLOAT DEFAULT 0, cp3 FLOAT DEFAULT 0, cp4 FLOAT DEFAULT 0, cp5 FLOAT DEFAULT 0, cp6 FLOAT DEFAULT 0, cp7 FLOAT DEFAULT 0, cp8 FLOAT DEFAULT 0, cp9 FLOAT DEFAULT 0, cp10 FLOAT DEFAULT 0, cp11 FLOAT DEFAULT 0, cp12 FLOAT DEFAULT 0, cp13 FLOAT DEFAULT 0, cp14 FLOAT DEFAULT 0, cp15 FLOAT DEFAULT 0, cp16 FLOAT DEFAULT 0, cp17 FLOAT DEFAULT 0, cp18 FLOAT DEFAULT 0, cp19 FLOAT DEFAULT 0, cp20 FLOAT DEFAULT 0, cp21 FLOAT DEFAULT 0, cp22 FLOAT DEFAULT 0, cp23 FLOAT DEFAULT 0, cp24 FLOAT DEFAULT 0, cp25 FLOAT DEFAULT 0, KEY (Map, Name)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
+			pSql->Statement()->execute(aBuf);
 
-			char aBuf[512];
+			str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_teamrace (Map VARCHAR(128) BINARY NOT NULL, Name VARCHAR(%d) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Time FLOAT DEFAULT 0, ID VARBINARY(16) NOT NULL, KEY Map (Map)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
+			pSql->Statement()->execute(aBuf);
 
-			str_format(aBuf, sizeof(aBuf), "SELECT * FROM %s_race WHERE Map='%s' AND Name='%s' ORDER BY time ASC LIMIT 1;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-			if(pData->m_pSqlData->m_pResults->next())
-			{
-				// get the best time
-				float time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-				pData->m_pSqlData->PlayerData(pData->m_ClientID)->m_BestTime = time;
-				pData->m_pSqlData->PlayerData(pData->m_ClientID)->m_CurrentTime = time;
-				if(pData->m_pSqlData->m_pGameServer->m_apPlayers[pData->m_ClientID])
-					pData->m_pSqlData->m_pGameServer->m_apPlayers[pData->m_ClientID]->m_Score = -time;
-
-				char aColumn[8];
-				if(g_Config.m_SvCheckpointSave)
-				{
-					for(int i = 0; i < NUM_CHECKPOINTS; i++)
-					{
-						str_format(aColumn, sizeof(aColumn), "cp%d", i+1);
-						pData->m_pSqlData->PlayerData(pData->m_ClientID)->m_aBestCpTime[i] = (float)pData->m_pSqlData->m_pResults->getDouble(aColumn);
-					}
-				}
-			}
+			str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_maps (Map VARCHAR(128) BINARY NOT NULL, Server VARCHAR(32) BINARY NOT NULL, Mapper VARCHAR(128) BINARY NOT NULL, Points INT DEFAULT 0, Stars INT DEFAULT 0, Timestamp TIMESTAMP, UNIQUE KEY Map (Map)) CHARACTER SET utf8 ;", m_pPrefix);
+			pSql->Statement()->execute(aBuf);
+
+			str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_saves (Savegame TEXT CHARACTER SET utf8 BINARY NOT NULL, Map VARCHAR(128) BINARY NOT NULL, Code VARCHAR(128) BINARY NOT NULL, Timestamp TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP, Server CHAR(4), UNIQUE KEY (Map, Code)) CHARACTER SET utf8 ;", m_pPrefix);
+			pSql->Statement()->execute(aBuf);
 
-			dbg_msg("SQL", "Getting best time done");
+			str_format(aBuf, sizeof(aBuf), "CREATE TABLE IF NOT EXISTS %s_points (Name VARCHAR(%d) BINARY NOT NULL, Points INT DEFAULT 0, UNIQUE KEY Name (Name)) CHARACTER SET utf8 ;", m_pPrefix, MAX_NAME_LENGTH);
+			pSql->Statement()->execute(aBuf);
 
-			// delete statement and results
-			delete pData->m_pSqlData->m_pResults;
+			dbg_msg("SQL", "Tables were created successfully");
 		}
-		catch (sql::SQLException &e)
+
+		// get the best time
+		sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_BEST_TIME);
+		pStmt->setString(1, m_aMapName);
+		sql::ResultSet *pResults = pStmt->executeQuery();
+
+		if(pResults->next())
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not update account");
+			((CGameControllerDDRace*)GameServer()->m_pController)->m_CurrentRecord = (float)pResults->getDouble("Time");
+
+			dbg_msg("SQL", "Getting best time on server done");
 		}
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+		// delete statement
+		delete pResults;
+	}
+	catch (sql::SQLException &e)
+	{
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
+		dbg_msg("SQL", aBuf);
+		dbg_msg("SQL", "ERROR: Tables were NOT created");
+		pSql->Disconnect();
+	}
+}
+
+void CSqlScore::CheckBirthdayThread(CSqlConnection *pSql, CSqlRequest *pRequest)
+{
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
+
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_BIRTHDAY);
+	pStmt->setString(1, pData->m_aName);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+	if(pResults->next())
+	{
+		char aBuf[512];
+		int yearsAgo = (int)pResults->getInt("YearsAgo");
+		str_format(aBuf, sizeof(aBuf), "Happy DDNet birthday to %s for finishing their first map %d year%s ago!", pData->m_aName, yearsAgo, yearsAgo > 1 ? "s" : "");
+		pData->m_Result.AddLine(CSqlResult::CHAT_ALL, pData->m_ClientID, aBuf);
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Checking birthday done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
-void CSqlScore::LoadScore(int ClientID)
+void CSqlScore::CheckBirthday(int ClientID)
 {
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_aName, Server()->ClientName(ClientID), MAX_NAME_LENGTH);
-	Tmp->m_pSqlData = this;
 
-	void *LoadThread = thread_init(LoadScoreThread, Tmp);
-	thread_detach(LoadThread);
+	AddRequest(Tmp, CheckBirthdayThread);
 }
 
-void CSqlScore::SaveTeamScoreThread(void *pUser)
+// update stuff
+void CSqlScore::LoadScoreThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-	CSqlTeamScoreData *pData = (CSqlTeamScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_LOAD_SCORE);
+	pStmt->setString(1, pData->m_pSqlData->m_aMapName);
+	pStmt->setString(2, pData->m_aName);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+	if(pResults->next())
 	{
-		try
-		{
-			char aBuf[2300];
-			char aUpdateID[17];
-			aUpdateID[0] = 0;
-
-			for(unsigned int i = 0; i < pData->m_Size; i++)
-			{
-				pData->m_pSqlData->ClearString(pData->m_aNames[i]);
-			}
+		// get the best time
+		pData->m_Time = (float)pResults->getDouble("Time");
 
-			str_format(aBuf, sizeof(aBuf), "SELECT Name, l.ID, Time FROM ((SELECT ID FROM %s_teamrace WHERE Map = '%s' AND Name = '%s') as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY ID;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aNames[0], pData->m_pSqlData->m_pPrefix);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			if (pData->m_pSqlData->m_pResults->rowsCount() > 0)
+		char aColumn[8];
+		if(g_Config.m_SvCheckpointSave)
+		{
+			for(int i = 0; i < NUM_CHECKPOINTS; i++)
 			{
-				char aID[17];
-				char aID2[17];
-				char aName[64];
-				unsigned int Count = 0;
-				bool ValidNames = true;
-
-				pData->m_pSqlData->m_pResults->first();
-				float Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-				strcpy(aID, pData->m_pSqlData->m_pResults->getString("ID").c_str());
-
-				do
-				{
-					strcpy(aID2, pData->m_pSqlData->m_pResults->getString("ID").c_str());
-					strcpy(aName, pData->m_pSqlData->m_pResults->getString("Name").c_str());
-					pData->m_pSqlData->ClearString(aName);
-					if (str_comp(aID, aID2) != 0)
-					{
-						if (ValidNames && Count == pData->m_Size)
-						{
-							if (pData->m_Time < Time)
-								strcpy(aUpdateID, aID);
-							else
-								goto end;
-							break;
-						}
-
-						Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-						ValidNames = true;
-						Count = 0;
-						strcpy(aID, aID2);
-					}
-
-					if (!ValidNames)
-						continue;
-
-					ValidNames = false;
-
-					for(unsigned int i = 0; i < pData->m_Size; i++)
-					{
-						if (str_comp(aName, pData->m_aNames[i]) == 0)
-						{
-							ValidNames = true;
-							Count++;
-							break;
-						}
-					}
-				} while (pData->m_pSqlData->m_pResults->next());
-
-				if (ValidNames && Count == pData->m_Size)
-				{
-					if (pData->m_Time < Time)
-						strcpy(aUpdateID, aID);
-					else
-						goto end;
-				}
+				str_format(aColumn, sizeof(aColumn), "cp%d", i+1);
+				pData->m_aCpCurrent[i] = (float)pResults->getDouble(aColumn);
 			}
+		}
+	}
 
-			if (aUpdateID[0])
-			{
-				str_format(aBuf, sizeof(aBuf), "UPDATE %s_teamrace SET Time='%.2f' WHERE ID = '%s';", pData->m_pSqlData->m_pPrefix, pData->m_Time, aUpdateID);
-				dbg_msg("SQL", aBuf);
-				pData->m_pSqlData->m_pStatement->execute(aBuf);
-			}
-			else
-			{
-				pData->m_pSqlData->m_pStatement->execute("SET @id = UUID();");
+	dbg_msg("SQL", "Getting best time done");
 
-				for(unsigned int i = 0; i < pData->m_Size; i++)
-				{
-				// if no entry found... create a new one
-					str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_teamrace(Map, Name, Timestamp, Time, ID) VALUES ('%s', '%s', CURRENT_TIMESTAMP(), '%.2f', @id);", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aNames[i], pData->m_Time);
-					dbg_msg("SQL", aBuf);
-					pData->m_pSqlData->m_pStatement->execute(aBuf);
-				}
-			}
+	// delete results
+	delete pResults;
+}
 
-			end:
-			dbg_msg("SQL", "Updating team time done");
+void CSqlScore::LoadScoreDone(CSqlRequest *pRequest)
+{
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+	if(pData->m_Stale || pData->m_Time <= 0)
+		return;
 
-			// delete results statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not update time");
-		}
+	CPlayerData *pPlayerData = pSelf->PlayerData(pData->m_ClientID);
+	pPlayerData->m_BestTime = pData->m_Time;
+	pPlayerData->m_CurrentTime = pData->m_Time;
+	if(pSelf->m_pGameServer->m_apPlayers[pData->m_ClientID])
+		pSelf->m_pGameServer->m_apPlayers[pData->m_ClientID]->m_Score = -pData->m_Time;
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+	if(g_Config.m_SvCheckpointSave)
+	{
+		for(int i = 0; i < NUM_CHECKPOINTS; i++)
+			pPlayerData->m_aBestCpTime[i] = pData->m_aCpCurrent[i];
 	}
+}
 
-	delete pData;
+void CSqlScore::LoadScore(int ClientID)
+{
+	CSqlScoreData *Tmp = new CSqlScoreData();
+	Tmp->m_ClientID = ClientID;
+	str_copy(Tmp->m_aName, Server()->ClientName(ClientID), MAX_NAME_LENGTH);
+	Tmp->m_Time = 0;
 
-	lock_unlock(gs_SqlLock);
+	AddRequest(Tmp, LoadScoreThread, LoadScoreDone);
 }
 
 void CSqlScore::MapVote(int ClientID, const char* MapName)
@@ -477,266 +684,405 @@ void CSqlScore::MapVote(int ClientID, const char* MapName)
 	CSqlMapData *Tmp = new CSqlMapData();
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_aMap, MapName, 128);
-	Tmp->m_pSqlData = this;
 
-	void *VoteThread = thread_init(MapVoteThread, Tmp);
-	thread_detach(VoteThread);
+	AddRequest(Tmp, MapVoteThread, MapVoteDone);
 }
 
-void CSqlScore::MapVoteThread(void *pUser)
+void CSqlScore::MapVoteThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
+	CSqlMapData *pData = (CSqlMapData *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+
+	// the search is cut after 32 characters, FuzzyString doubles the length
+	char aMap[33];
+	str_copy(aMap, pData->m_aMap, sizeof(aMap));
+	char aFuzzyMap[128];
+	str_copy(aFuzzyMap, aMap, sizeof(aFuzzyMap));
+	pSelf->FuzzyString(aFuzzyMap);
+
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_MAP_VOTE);
+	pStmt->setString(1, aFuzzyMap);
+	pStmt->setString(2, aMap);
+	pStmt->setString(3, aMap);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+
+	if(pResults->rowsCount() == 1)
+	{
+		pResults->next();
+		str_copy(pData->m_aFoundMap, pResults->getString("Map").c_str(), sizeof(pData->m_aFoundMap));
+		str_copy(pData->m_aServer, pResults->getString("Server").c_str(), sizeof(pData->m_aServer));
 
-	CSqlMapData *pData = (CSqlMapData *)pUser;
+		for(char *p = pData->m_aServer; *p; p++)
+			*p = tolower(*p);
+		pData->m_Found = true;
+	}
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		char originalMap[128];
-		strcpy(originalMap,pData->m_aMap);
-		pData->m_pSqlData->ClearString(pData->m_aMap);
-		char clearMap[128];
-		strcpy(clearMap,pData->m_aMap);
-		pData->m_pSqlData->FuzzyString(pData->m_aMap);
+	delete pResults;
+}
 
-		try
-		{
-			char aBuf[768];
-			str_format(aBuf, sizeof(aBuf), "SELECT Map, Server FROM %s_maps WHERE Map LIKE '%s' COLLATE utf8_general_ci ORDER BY CASE WHEN Map = '%s' THEN 0 ELSE 1 END, CASE WHEN Map LIKE '%s%%' THEN 0 ELSE 1 END, LENGTH(Map), Map LIMIT 1;", pData->m_pSqlData->m_pPrefix, pData->m_aMap, clearMap, clearMap);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+void CSqlScore::MapVoteDone(CSqlRequest *pRequest)
+{
+	// the vote state belongs to the tick thread, check it only now
+	CSqlMapData *pData = (CSqlMapData *)pRequest;
+	CGameContext *pGameServer = pData->m_pSqlData->GameServer();
+	IServer *pServer = pData->m_pSqlData->Server();
+	CPlayer *pPlayer = pGameServer->m_apPlayers[pData->m_ClientID];
+	if(pData->m_Failed || pData->m_Stale || !pPlayer)
+		return;
 
-			CPlayer *pPlayer = pData->m_pSqlData->m_pGameServer->m_apPlayers[pData->m_ClientID];
+	int64 Now = pServer->Tick();
+	int Timeleft = pPlayer->m_LastVoteCall + pServer->TickSpeed()*g_Config.m_SvVoteDelay - Now;
 
-			int64 Now = pData->m_pSqlData->Server()->Tick();
-			int Timeleft = 0;
+	if(!pData->m_Found)
+	{
+		char aBuf[768];
+		str_format(aBuf, sizeof(aBuf), "No map like \"%s\" found. Try adding a '%%' at the start if you don't know the first character. Example: /map %%castle for \"Out of Castle\"", pData->m_aMap);
+		pGameServer->SendChatTarget(pData->m_ClientID, aBuf);
+	}
+	else if(pPlayer->m_LastVoteCall && Timeleft > 0)
+	{
+		char aChatmsg[512] = {0};
+		str_format(aChatmsg, sizeof(aChatmsg), "You must wait %d seconds before making another vote", (Timeleft/pServer->TickSpeed())+1);
+		pGameServer->SendChatTarget(pData->m_ClientID, aChatmsg);
+	}
+	else if(time_get() < pGameServer->m_LastMapVote + (time_freq() * g_Config.m_SvVoteMapTimeDelay))
+	{
+		char chatmsg[512] = {0};
+		str_format(chatmsg, sizeof(chatmsg), "There's a %d second delay between map-votes, please wait %d seconds.", g_Config.m_SvVoteMapTimeDelay,((pGameServer->m_LastMapVote+(g_Config.m_SvVoteMapTimeDelay * time_freq()))/time_freq())-(time_get()/time_freq()));
+		pGameServer->SendChatTarget(pData->m_ClientID, chatmsg);
+	}
+	else
+	{
+		char aCmd[256];
+		str_format(aCmd, sizeof(aCmd), "sv_reset_file types/%s/flexreset.cfg; change_map \"%s\"", pData->m_aServer, pData->m_aFoundMap);
+		char aChatmsg[512];
+		str_format(aChatmsg, sizeof(aChatmsg), "'%s' called vote to change server option '%s' (%s)", pServer->ClientName(pData->m_ClientID), pData->m_aFoundMap, "/map");
+
+		pGameServer->m_VoteKick = false;
+		pGameServer->m_VoteSpec = false;
+		pGameServer->m_LastMapVote = time_get();
+		pGameServer->CallVote(pData->m_ClientID, pData->m_aFoundMap, aCmd, "/map", aChatmsg);
+	}
+}
 
-			if(!pPlayer)
-				goto end;
+void CSqlScore::MapInfo(int ClientID, const char* MapName)
+{
+	CSqlMapData *Tmp = new CSqlMapData();
+	Tmp->m_ClientID = ClientID;
+	str_copy(Tmp->m_aMap, MapName, 128);
 
-			Timeleft = pPlayer->m_LastVoteCall + pData->m_pSqlData->Server()->TickSpeed()*g_Config.m_SvVoteDelay - Now;
+	AddRequest(Tmp, MapInfoThread);
+}
 
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				str_format(aBuf, sizeof(aBuf), "No map like \"%s\" found. Try adding a '%%' at the start if you don't know the first character. Example: /map %%castle for \"Out of Castle\"", originalMap);
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			else if(pPlayer->m_LastVoteCall && Timeleft > 0)
-			{
-				char aChatmsg[512] = {0};
-				str_format(aChatmsg, sizeof(aChatmsg), "You must wait %d seconds before making another vote", (Timeleft/pData->m_pSqlData->Server()->TickSpeed())+1);
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aChatmsg);
-			}
-			else if(time_get() < pData->m_pSqlData->GameServer()->m_LastMapVote + (time_freq() * g_Config.m_SvVoteMapTimeDelay))
-			{
-				char chatmsg[512] = {0};
-				str_format(chatmsg, sizeof(chatmsg), "There's a %d second delay between map-votes, please wait %d seconds.", g_Config.m_SvVoteMapTimeDelay,((pData->m_pSqlData->GameServer()->m_LastMapVote+(g_Config.m_SvVoteMapTimeDelay * time_freq()))/time_freq())-(time_get()/time_freq()));
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, chatmsg);
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->next();
-				char aMap[128];
-				strcpy(aMap, pData->m_pSqlData->m_pResults->getString("Map").c_str());
-				char aServer[32];
-				strcpy(aServer, pData->m_pSqlData->m_pResults->getString("Server").c_str());
-
-				for(char *p = aServer; *p; p++)
-					*p = tolower(*p);
-
-				char aCmd[256];
-				str_format(aCmd, sizeof(aCmd), "sv_reset_file types/%s/flexreset.cfg; change_map \"%s\"", aServer, aMap);
-				char aChatmsg[512];
-				str_format(aChatmsg, sizeof(aChatmsg), "'%s' called vote to change server option '%s' (%s)", pData->m_pSqlData->GameServer()->Server()->ClientName(pData->m_ClientID), aMap, "/map");
-
-				pData->m_pSqlData->GameServer()->m_VoteKick = false;
-				pData->m_pSqlData->GameServer()->m_VoteSpec = false;
-				pData->m_pSqlData->GameServer()->m_LastMapVote = time_get();
-				pData->m_pSqlData->GameServer()->CallVote(pData->m_ClientID, aMap, aCmd, "/map", aChatmsg);
-			}
+void CSqlScore::MapInfoThread(CSqlConnection *pSql, CSqlRequest *pRequest)
+{
+	CSqlMapData *pData = (CSqlMapData *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+
+	// the search is cut after 32 characters, FuzzyString doubles the length
+	char aMap[33];
+	str_copy(aMap, pData->m_aMap, sizeof(aMap));
+	char aFuzzyMap[128];
+	str_copy(aFuzzyMap, aMap, sizeof(aFuzzyMap));
+	pSelf->FuzzyString(aFuzzyMap);
+
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_MAP_INFO);
+	pStmt->setString(1, aFuzzyMap);
+	pStmt->setString(2, aMap);
+	pStmt->setString(3, aMap);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+
+	char aBuf[1024];
+	if(pResults->rowsCount() != 1)
+	{
+		str_format(aBuf, sizeof(aBuf), "No map like \"%s\" found.", pData->m_aMap);
+	}
+	else
+	{
+		pResults->next();
+		int points = (int)pResults->getInt("Points");
+		int stars = (int)pResults->getInt("Stars");
+		int finishes = (int)pResults->getInt("Finishes");
+		int finishers = (int)pResults->getInt("Finishers");
+		int average = (int)pResults->getInt("Average");
+		char aMap[128];
+		strcpy(aMap, pResults->getString("Map").c_str());
+		char aServer[32];
+		strcpy(aServer, pResults->getString("Server").c_str());
+		char aMapper[128];
+		strcpy(aMapper, pResults->getString("Mapper").c_str());
+		int stamp = (int)pResults->getInt("Stamp");
+		int ago = (int)pResults->getInt("Ago");
+
+		char pAgoString[40] = "\0";
+		char pReleasedString[60] = "\0";
+		if(stamp != 0)
+		{
+			agoTimeToString(ago, pAgoString);
+			str_format(pReleasedString, sizeof(pReleasedString), ", released %s ago", pAgoString);
+		}
 
-			end:
-			delete pData->m_pSqlData->m_pResults;
+		char pAverageString[60] = "\0";
+		if(average > 0)
+		{
+			str_format(pAverageString, sizeof(pAverageString), " in %d:%02d average", average / 60, average % 60);
 		}
-		catch (sql::SQLException &e)
+
+		char aStars[20];
+		switch(stars)
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not update time");
+			case 0: strcpy(aStars, "✰✰✰✰✰"); break;
+			case 1: strcpy(aStars, "★✰✰✰✰"); break;
+			case 2: strcpy(aStars, "★★✰✰✰"); break;
+			case 3: strcpy(aStars, "★★★✰✰"); break;
+			case 4: strcpy(aStars, "★★★★✰"); break;
+			case 5: strcpy(aStars, "★★★★★"); break;
+			default: aStars[0] = '\0';
 		}
 
-		pData->m_pSqlData->Disconnect();
+		str_format(aBuf, sizeof(aBuf), "\"%s\" by %s on %s (%s, %d %s, %d %s by %d %s%s%s)", aMap, aMapper, aServer, aStars, points, points == 1 ? "point" : "points", finishes, finishes == 1 ? "finish" : "finishes", finishers, finishers == 1 ? "tee" : "tees", pAverageString, pReleasedString);
 	}
 
-	delete pData;
-	lock_unlock(gs_SqlLock);
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+	delete pResults;
 }
 
-void CSqlScore::MapInfo(int ClientID, const char* MapName)
+void CSqlScore::WriteBatchThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	CSqlMapData *Tmp = new CSqlMapData();
-	Tmp->m_ClientID = ClientID;
-	str_copy(Tmp->m_aMap, MapName, 128);
-	Tmp->m_pSqlData = this;
+	CSqlWriteBatch *pData = (CSqlWriteBatch *)pRequest;
 
-	void *InfoThread = thread_init(MapInfoThread, Tmp);
-	thread_detach(InfoThread);
+	// one transaction for all of it, a failed batch leaves nothing behind
+	pSql->BeginTransaction();
+	try
+	{
+		if(pData->m_NumScores)
+			WriteScores(pSql, pData);
+		for(int i = 0; i < pData->m_NumTeams; i++)
+			WriteTeamScore(pSql, pData, &pData->m_aTeams[i]);
+		pSql->Commit();
+	}
+	catch (sql::SQLException &e)
+	{
+		// undo what made it in before RunRequest drops the connection
+		pSql->Rollback();
+		throw;
+	}
+
+	dbg_msg("SQL", "Updating %d time(s) and %d team time(s) done", pData->m_NumScores, pData->m_NumTeams);
 }
 
-void CSqlScore::MapInfoThread(void *pUser)
+void CSqlScore::WriteScores(CSqlConnection *pSql, CSqlWriteBatch *pData)
 {
-	lock_wait(gs_SqlLock);
+	CSqlScore *pSelf = pData->m_pSqlData;
+	int Num = pData->m_NumScores;
+
+	// tees that finished the map before don't get the points again
+	bool aFinished[CSqlWriteBatch::MAX_SCORES];
+	sql::PreparedStatement *pStmt = pSql->PreparedBatch(CSqlConnection::BATCH_FINISHED, Num);
+	pStmt->setString(1, pSelf->m_aMapName);
+	for(int i = 0; i < Num; i++)
+	{
+		pStmt->setString(2+i, pData->m_aScores[i].m_aName);
+		aFinished[i] = false;
+	}
+	sql::ResultSet *pResults = pStmt->executeQuery();
+	while(pResults->next())
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_copy(aName, pResults->getString("Name").c_str(), sizeof(aName));
+		for(int i = 0; i < Num; i++)
+			if(str_comp(aName, pData->m_aScores[i].m_aName) == 0)
+				aFinished[i] = true;
+	}
+	delete pResults;
 
-	CSqlMapData *pData = (CSqlMapData *)pUser;
+	// neither does a tee for its second finish in the same batch
+	int NumNew = 0;
+	for(int i = 0; i < Num; i++)
+	{
+		for(int j = 0; j < i && !aFinished[i]; j++)
+			if(str_comp(pData->m_aScores[i].m_aName, pData->m_aScores[j].m_aName) == 0)
+				aFinished[i] = true;
+		if(!aFinished[i])
+			NumNew++;
+	}
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	if(NumNew)
 	{
-		char originalMap[128];
-		strcpy(originalMap,pData->m_aMap);
-		pData->m_pSqlData->ClearString(pData->m_aMap);
-		char clearMap[128];
-		strcpy(clearMap,pData->m_aMap);
-		pData->m_pSqlData->FuzzyString(pData->m_aMap);
+		pStmt = pSql->Prepared(CSqlConnection::STMT_MAP_POINTS);
+		pStmt->setString(1, pSelf->m_aMapName);
+		pResults = pStmt->executeQuery();
 
-		try
+		if(pResults->rowsCount() == 1)
 		{
-			char aBuf[1024];
-			str_format(aBuf, sizeof(aBuf), "SELECT l.Map, l.Server, Mapper, Points, Stars, (select count(Name) from %s_race where Map = l.Map) as Finishes, (select count(distinct Name) from %s_race where Map = l.Map) as Finishers, (select round(avg(Time)) from %s_race where Map = l.Map) as Average, UNIX_TIMESTAMP(l.Timestamp) as Stamp, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(l.Timestamp) as Ago FROM (SELECT * FROM %s_maps WHERE Map LIKE '%s' COLLATE utf8_general_ci ORDER BY CASE WHEN Map = '%s' THEN 0 ELSE 1 END, CASE WHEN Map LIKE '%s%%' THEN 0 ELSE 1 END, LENGTH(Map), Map LIMIT 1) as l;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_pPrefix, pData->m_aMap, clearMap, clearMap);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+			pResults->next();
+			int points = (int)pResults->getInt("Points");
 
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				str_format(aBuf, sizeof(aBuf), "No map like \"%s\" found.", originalMap);
-			}
-			else
+			pStmt = pSql->PreparedBatch(CSqlConnection::BATCH_ADD_POINTS, NumNew);
+			int Row = 0;
+			for(int i = 0; i < Num; i++)
 			{
-				pData->m_pSqlData->m_pResults->next();
-				int points = (int)pData->m_pSqlData->m_pResults->getInt("Points");
-				int stars = (int)pData->m_pSqlData->m_pResults->getInt("Stars");
-				int finishes = (int)pData->m_pSqlData->m_pResults->getInt("Finishes");
-				int finishers = (int)pData->m_pSqlData->m_pResults->getInt("Finishers");
-				int average = (int)pData->m_pSqlData->m_pResults->getInt("Average");
-				char aMap[128];
-				strcpy(aMap, pData->m_pSqlData->m_pResults->getString("Map").c_str());
-				char aServer[32];
-				strcpy(aServer, pData->m_pSqlData->m_pResults->getString("Server").c_str());
-				char aMapper[128];
-				strcpy(aMapper, pData->m_pSqlData->m_pResults->getString("Mapper").c_str());
-				int stamp = (int)pData->m_pSqlData->m_pResults->getInt("Stamp");
-				int ago = (int)pData->m_pSqlData->m_pResults->getInt("Ago");
-
-				char pAgoString[40] = "\0";
-				char pReleasedString[60] = "\0";
-				if(stamp != 0)
-				{
-					agoTimeToString(ago, pAgoString);
-					str_format(pReleasedString, sizeof(pReleasedString), ", released %s ago", pAgoString);
-				}
+				if(aFinished[i])
+					continue;
 
-				char pAverageString[60] = "\0";
-				if(average > 0)
-				{
-					str_format(pAverageString, sizeof(pAverageString), " in %d:%02d average", average / 60, average % 60);
-				}
-
-				char aStars[20];
-				switch(stars)
-				{
-					case 0: strcpy(aStars, "✰✰✰✰✰"); break;
-					case 1: strcpy(aStars, "★✰✰✰✰"); break;
-					case 2: strcpy(aStars, "★★✰✰✰"); break;
-					case 3: strcpy(aStars, "★★★✰✰"); break;
-					case 4: strcpy(aStars, "★★★★✰"); break;
-					case 5: strcpy(aStars, "★★★★★"); break;
-					default: aStars[0] = '\0';
-				}
-
-				str_format(aBuf, sizeof(aBuf), "\"%s\" by %s on %s (%s, %d %s, %d %s by %d %s%s%s)", aMap, aMapper, aServer, aStars, points, points == 1 ? "point" : "points", finishes, finishes == 1 ? "finish" : "finishes", finishers, finishers == 1 ? "tee" : "tees", pAverageString, pReleasedString);
+				pData->m_aScores[i].m_Points = points;
+				pStmt->setString(Row*2+1, pData->m_aScores[i].m_aName);
+				pStmt->setInt(Row*2+2, points);
+				Row++;
 			}
-
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not update time");
+			pStmt->execute();
 		}
 
-		pData->m_pSqlData->Disconnect();
+		delete pResults;
 	}
 
-	delete pData;
-	lock_unlock(gs_SqlLock);
+	// if no entry found... create a new one
+	const int NumColumns = 4+NUM_CHECKPOINTS;
+	pStmt = pSql->PreparedBatch(CSqlConnection::BATCH_SAVE_SCORE, Num);
+	for(int i = 0; i < Num; i++)
+	{
+		const CSqlWriteBatch::CScore *pScore = &pData->m_aScores[i];
+		pStmt->setString(i*NumColumns+1, pSelf->m_aMapName);
+		pStmt->setString(i*NumColumns+2, pScore->m_aName);
+		pStmt->setDouble(i*NumColumns+3, RoundTime(pScore->m_Time));
+		pStmt->setString(i*NumColumns+4, g_Config.m_SvSqlServerName);
+		for(int c = 0; c < NUM_CHECKPOINTS; c++)
+			pStmt->setDouble(i*NumColumns+5+c, RoundTime(pScore->m_aCpTime[c]));
+	}
+	pStmt->execute();
 }
 
-void CSqlScore::SaveScoreThread(void *pUser)
+void CSqlScore::WriteTeamScore(CSqlConnection *pSql, CSqlWriteBatch *pData, const CSqlWriteBatch::CTeamScore *pTeam)
 {
-	lock_wait(gs_SqlLock);
+	CSqlScore *pSelf = pData->m_pSqlData;
 
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+	char aUpdateID[17];
+	aUpdateID[0] = 0;
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_TEAM_LOOKUP);
+	pStmt->setString(1, pSelf->m_aMapName);
+	pStmt->setString(2, pTeam->m_aaNames[0]);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+
+	// look for an earlier finish of exactly this team
+	bool Better = true;
+	if (pResults->rowsCount() > 0)
 	{
-		try
-		{
-			char aBuf[768];
+		char aID[17];
+		char aID2[17];
+		int Count = 0;
+		bool ValidNames = true;
+		bool Found = false;
 
-			// check strings
-			pData->m_pSqlData->ClearString(pData->m_aName);
+		pResults->first();
+		float Time = (float)pResults->getDouble("Time");
+		str_copy(aID, pResults->getString("ID").c_str(), sizeof(aID));
 
-			str_format(aBuf, sizeof(aBuf), "SELECT * FROM %s_race WHERE Map='%s' AND Name='%s' ORDER BY time ASC LIMIT 1;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-			if(!pData->m_pSqlData->m_pResults->next())
+		do
+		{
+			str_copy(aID2, pResults->getString("ID").c_str(), sizeof(aID2));
+			char aName[MAX_NAME_LENGTH];
+			str_copy(aName, pResults->getString("Name").c_str(), sizeof(aName));
+			if (str_comp(aID, aID2) != 0)
 			{
-				delete pData->m_pSqlData->m_pResults;
+				if (ValidNames && Count == pTeam->m_Size)
+				{
+					Found = true;
+					break;
+				}
+
+				Time = (float)pResults->getDouble("Time");
+				ValidNames = true;
+				Count = 0;
+				str_copy(aID, aID2, sizeof(aID));
+			}
+
+			if (!ValidNames)
+				continue;
 
-				str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map ='%s'", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap);
-				pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+			ValidNames = false;
 
-				if(pData->m_pSqlData->m_pResults->rowsCount() == 1)
+			for(int i = 0; i < pTeam->m_Size; i++)
+			{
+				if (str_comp(aName, pTeam->m_aaNames[i]) == 0)
 				{
-					pData->m_pSqlData->m_pResults->next();
-					int points = (int)pData->m_pSqlData->m_pResults->getInt("Points");
-					if (points == 1)
-						str_format(aBuf, sizeof(aBuf), "You earned %d point for finishing this map!", points);
-					else
-						str_format(aBuf, sizeof(aBuf), "You earned %d points for finishing this map!", points);
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-
-					str_format(aBuf, sizeof(aBuf), "INSERT INTO %s_points(Name, Points) VALUES ('%s', '%d') ON duplicate key UPDATE Name=VALUES(Name), Points=Points+VALUES(Points);", pData->m_pSqlData->m_pPrefix, pData->m_aName, points);
-					pData->m_pSqlData->m_pStatement->execute(aBuf);
+					ValidNames = true;
+					Count++;
+					break;
 				}
 			}
+		} while (pResults->next());
 
-			delete pData->m_pSqlData->m_pResults;
+		if (Found || (ValidNames && Count == pTeam->m_Size))
+		{
+			if (pTeam->m_Time < Time)
+				str_copy(aUpdateID, aID, sizeof(aUpdateID));
+			else
+				Better = false;
+		}
+	}
 
-			// if no entry found... create a new one
-			str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_race(Map, Name, Timestamp, Time, Server, cp1, cp2, cp3, cp4, cp5, cp6, cp7, cp8, cp9, cp10, cp11, cp12, cp13, cp14, cp15, cp16, cp17, cp18, cp19, cp20, cp21, cp22, cp23, cp24, cp25) VALUES ('%s', '%s', CURRENT_TIMESTAMP(), '%.2f', '%s', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f', '%.2f');", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName, pData->m_Time, g_Config.m_SvSqlServerName, pData->m_aCpCurrent[0], pData->m_aCpCurrent[1], pData->m_aCpCurrent[2], pData->m_aCpCurrent[3], pData->m_aCpCurrent[4], pData->m_aCpCurrent[5], pData->m_aCpCurrent[6], pData->m_aCpCurrent[7], pData->m_aCpCurrent[8], pData->m_aCpCurrent[9], pData->m_aCpCurrent[10], pData->m_aCpCurrent[11], pData->m_aCpCurrent[12], pData->m_aCpCurrent[13], pData->m_aCpCurrent[14], pData->m_aCpCurrent[15], pData->m_aCpCurrent[16], pData->m_aCpCurrent[17], pData->m_aCpCurrent[18], pData->m_aCpCurrent[19], pData->m_aCpCurrent[20], pData->m_aCpCurrent[21], pData->m_aCpCurrent[22], pData->m_aCpCurrent[23], pData->m_aCpCurrent[24]);
-			dbg_msg("SQL", aBuf);
-			pData->m_pSqlData->m_pStatement->execute(aBuf);
+	// delete results
+	delete pResults;
 
-			dbg_msg("SQL", "Updating time done");
-		}
-		catch (sql::SQLException &e)
+	if (!Better)
+		return;
+
+	if (aUpdateID[0])
+	{
+		pStmt = pSql->Prepared(CSqlConnection::STMT_TEAM_UPDATE);
+		pStmt->setDouble(1, RoundTime(pTeam->m_Time));
+		pStmt->setString(2, aUpdateID);
+		pStmt->execute();
+	}
+	else
+	{
+		pSql->Statement()->execute("SET @id = UUID();");
+
+		// if no entry found... create a new one, big teams take a few inserts
+		for(int First = 0; First < pTeam->m_Size; First += CSqlConnection::MAX_BATCH_ROWS)
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not update time");
+			int Num = min(pTeam->m_Size-First, (int)CSqlConnection::MAX_BATCH_ROWS);
+			pStmt = pSql->PreparedBatch(CSqlConnection::BATCH_TEAMRACE, Num);
+			for(int i = 0; i < Num; i++)
+			{
+				pStmt->setString(i*3+1, pSelf->m_aMapName);
+				pStmt->setString(i*3+2, pTeam->m_aaNames[First+i]);
+				pStmt->setDouble(i*3+3, RoundTime(pTeam->m_Time));
+			}
+			pStmt->execute();
 		}
-
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
 	}
+}
 
-	delete pData;
+void CSqlScore::WriteBatchDone(CSqlRequest *pRequest)
+{
+	CSqlWriteBatch *pData = (CSqlWriteBatch *)pRequest;
+	if(!pData->m_Failed)
+	{
+		// the batch has no single owner, every tee is checked on its own
+		CSqlScore *pSelf = pData->m_pSqlData;
+		for(int i = 0; i < pData->m_NumScores && !pSelf->m_Shutdown; i++)
+		{
+			const CSqlWriteBatch::CScore *pScore = &pData->m_aScores[i];
+			if(!pScore->m_Points || str_comp(pScore->m_aName, pSelf->Server()->ClientName(pScore->m_ClientID)) != 0)
+				continue;
+
+			char aBuf[128];
+			if (pScore->m_Points == 1)
+				str_format(aBuf, sizeof(aBuf), "You earned %d point for finishing this map!", pScore->m_Points);
+			else
+				str_format(aBuf, sizeof(aBuf), "You earned %d points for finishing this map!", pScore->m_Points);
+			pSelf->GameServer()->SendChatTarget(pScore->m_ClientID, aBuf);
+		}
+		return;
+	}
 
-	lock_unlock(gs_SqlLock);
+	// the transaction was rolled back, at least leave the times in the log
+	for(int i = 0; i < pData->m_NumScores; i++)
+		dbg_msg("SQL", "ERROR: Could not save the time %.2f of '%s'", pData->m_aScores[i].m_Time, pData->m_aScores[i].m_aName);
+	for(int i = 0; i < pData->m_NumTeams; i++)
+		dbg_msg("SQL", "ERROR: Could not save the team time %.2f of '%s' and %d others", pData->m_aTeams[i].m_Time, pData->m_aTeams[i].m_aaNames[0], pData->m_aTeams[i].m_Size-1);
 }
 
 void CSqlScore::SaveScore(int ClientID, float Time, float CpTime[NUM_CHECKPOINTS])
@@ -744,16 +1090,15 @@ void CSqlScore::SaveScore(int ClientID, float Time, float CpTime[NUM_CHECKPOINTS
 	CConsole* pCon = (CConsole*)GameServer()->Console();
 	if(pCon->m_Cheated)
 		return;
-	CSqlScoreData *Tmp = new CSqlScoreData();
-	Tmp->m_ClientID = ClientID;
-	str_copy(Tmp->m_aName, Server()->ClientName(ClientID), MAX_NAME_LENGTH);
-	Tmp->m_Time = Time;
-	for(int i = 0; i < NUM_CHECKPOINTS; i++)
-		Tmp->m_aCpCurrent[i] = CpTime[i];
-	Tmp->m_pSqlData = this;
 
-	void *SaveThread = thread_init(SaveScoreThread, Tmp);
-	thread_detach(SaveThread);
+	CSqlWriteBatch *pBatch = WriteBatch(false);
+	CSqlWriteBatch::CScore *pScore = &pBatch->m_aScores[pBatch->m_NumScores++];
+	pScore->m_ClientID = ClientID;
+	str_copy(pScore->m_aName, Server()->ClientName(ClientID), sizeof(pScore->m_aName));
+	pScore->m_Time = Time;
+	for(int i = 0; i < NUM_CHECKPOINTS; i++)
+		pScore->m_aCpTime[i] = CpTime[i];
+	pScore->m_Points = 0;
 }
 
 void CSqlScore::SaveTeamScore(int* aClientIDs, unsigned int Size, float Time)
@@ -761,280 +1106,204 @@ void CSqlScore::SaveTeamScore(int* aClientIDs, unsigned int Size, float Time)
 	CConsole* pCon = (CConsole*)GameServer()->Console();
 	if(pCon->m_Cheated)
 		return;
-	CSqlTeamScoreData *Tmp = new CSqlTeamScoreData();
-	for(unsigned int i = 0; i < Size; i++)
-	{
-		Tmp->m_aClientIDs[i] = aClientIDs[i];
-		str_copy(Tmp->m_aNames[i], Server()->ClientName(aClientIDs[i]), MAX_NAME_LENGTH);
-	}
-	Tmp->m_Size = Size;
-	Tmp->m_Time = Time;
-	Tmp->m_pSqlData = this;
 
-	void *SaveTeamThread = thread_init(SaveTeamScoreThread, Tmp);
-	thread_detach(SaveTeamThread);
+	CSqlWriteBatch *pBatch = WriteBatch(true);
+	CSqlWriteBatch::CTeamScore *pTeam = &pBatch->m_aTeams[pBatch->m_NumTeams++];
+	pTeam->m_Size = min(Size, (unsigned)MAX_CLIENTS);
+	for(int i = 0; i < pTeam->m_Size; i++)
+		str_copy(pTeam->m_aaNames[i], Server()->ClientName(aClientIDs[i]), sizeof(pTeam->m_aaNames[i]));
+	pTeam->m_Time = Time;
 }
 
-void CSqlScore::ShowTeamRankThread(void *pUser)
+void CSqlScore::ShowTeamRankThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+
+	// check sort methode
+	char aBuf[600];
+	char aNames[2300];
+	aNames[0] = '\0';
+
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_TEAM_RANK);
+	pStmt->setString(1, pSelf->m_aMapName);
+	pStmt->setString(2, pSelf->m_aMapName);
+	pStmt->setString(3, pData->m_aName);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+
+	int Rows = pResults->rowsCount();
+
+	if(Rows < 1)
 	{
-		try
-		{
-			// check strings
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
-
-			// check sort methode
-			char aBuf[600];
-			char aNames[2300];
-			aNames[0] = '\0';
-
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-			str_format(aBuf, sizeof(aBuf), "SELECT Rank, Name, Time FROM (SELECT Rank, l2.ID FROM ((SELECT ID, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank,@pos)) rank, (@prev := Time) Time FROM (SELECT ID, Time FROM %s_teamrace WHERE Map = '%s' GROUP BY ID ORDER BY Time) as ll) as l2) LEFT JOIN %s_teamrace as r2 ON l2.ID = r2.ID WHERE Map = '%s' AND Name = '%s' ORDER BY Rank LIMIT 1) as l LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY Name;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName, pData->m_pSqlData->m_pPrefix);
-
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			int Rows = pData->m_pSqlData->m_pResults->rowsCount();
-
-			if(Rows < 1)
-			{
-				str_format(aBuf, sizeof(aBuf), "%s has no team ranks", originalName);
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->first();
-
-				float Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-				int Rank = (int)pData->m_pSqlData->m_pResults->getInt("Rank");
-
-				for(int Row = 0; Row < Rows; Row++)
-				{
-					strcat(aNames, pData->m_pSqlData->m_pResults->getString("Name").c_str());
-					pData->m_pSqlData->m_pResults->next();
+		str_format(aBuf, sizeof(aBuf), "%s has no team ranks", pData->m_aName);
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+	}
+	else
+	{
+		pResults->first();
 
-					if (Row < Rows - 2)
-						strcat(aNames, ", ");
-					else if (Row < Rows - 1)
-						strcat(aNames, " & ");
-				}
+		float Time = (float)pResults->getDouble("Time");
+		int Rank = (int)pResults->getInt("Rank");
 
-				pData->m_pSqlData->m_pResults->first();
+		for(int Row = 0; Row < Rows; Row++)
+		{
+			strcat(aNames, pResults->getString("Name").c_str());
+			pResults->next();
 
-				if(g_Config.m_SvHideScore)
-				{
-					str_format(aBuf, sizeof(aBuf), "Your team time: %02d:%05.02f", (int)(Time/60), Time-((int)Time/60*60));
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-				}
-				else
-				{
-					str_format(aBuf, sizeof(aBuf), "%d. %s Team time: %02d:%05.02f, requested by %s", Rank, aNames, (int)(Time/60), Time-((int)Time/60*60), pData->m_aRequestingPlayer);
-					pData->m_pSqlData->GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, pData->m_ClientID);
-				}
-			}
+			if (Row < Rows - 2)
+				strcat(aNames, ", ");
+			else if (Row < Rows - 1)
+				strcat(aNames, " & ");
+		}
 
-			dbg_msg("SQL", "Showing teamrank done");
+		pResults->first();
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
+		if(g_Config.m_SvHideScore)
+		{
+			str_format(aBuf, sizeof(aBuf), "Your team time: %02d:%05.02f", (int)(Time/60), Time-((int)Time/60*60));
+			pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
 		}
-		catch (sql::SQLException &e)
+		else
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show team rank");
+			str_format(aBuf, sizeof(aBuf), "%d. %s Team time: %02d:%05.02f, requested by %s", Rank, aNames, (int)(Time/60), Time-((int)Time/60*60), pData->m_aRequestingPlayer);
+			pData->m_Result.AddLine(CSqlResult::CHAT_ALL, pData->m_ClientID, aBuf);
 		}
-
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Showing teamrank done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
-void CSqlScore::ShowTeamTop5Thread(void *pUser)
+void CSqlScore::ShowTeamTop5Thread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+
+	// check sort methode
+	char aBuf[512];
+
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @previd := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_TEAM_TOP5);
+	pStmt->setString(1, pSelf->m_aMapName);
+	pStmt->setInt(2, pData->m_Num-1);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+
+	// show teamtop5
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "------- Team Top 5 -------");
+
+	int Rows = pResults->rowsCount();
+
+	if (Rows >= 1) {
+		char aID[17];
+		char aID2[17];
+		char aNames[2300];
+		int Rank = 0;
+		float Time = 0;
+		int aCuts[320]; // 64 * 5
+		int CutPos = 0;
+
+		aNames[0] = '\0';
+		aCuts[0] = -1;
+
+		pResults->first();
+		strcpy(aID, pResults->getString("ID").c_str());
+		for(int Row = 0; Row < Rows; Row++)
 		{
-			// check sort methode
-			char aBuf[512];
-
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @previd := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-			str_format(aBuf, sizeof(aBuf), "SELECT ID, Name, Time, rank FROM (SELECT r.ID, Name, rank, l.Time FROM ((SELECT ID, rank, Time FROM (SELECT ID, (@pos := IF(@previd = ID,@pos,@pos+1)) pos, (@previd := ID), (@rank := IF(@prev = Time,@rank,@pos)) rank, (@prev := Time) Time FROM (SELECT ID, MIN(Time) as Time FROM %s_teamrace WHERE Map = '%s' GROUP BY ID ORDER BY `Time` ASC) as all_top_times) as a LIMIT %d, 5) as l) LEFT JOIN %s_teamrace as r ON l.ID = r.ID ORDER BY Time ASC, r.ID, Name ASC) as a;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_Num-1, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			// show teamtop5
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "------- Team Top 5 -------");
-
-			int Rows = pData->m_pSqlData->m_pResults->rowsCount();
-
-			if (Rows >= 1) {
-				char aID[17];
-				char aID2[17];
-				char aNames[2300];
-				int Rank = 0;
-				float Time = 0;
-				int aCuts[320]; // 64 * 5
-				int CutPos = 0;
-
-				aNames[0] = '\0';
-				aCuts[0] = -1;
-
-				pData->m_pSqlData->m_pResults->first();
-				strcpy(aID, pData->m_pSqlData->m_pResults->getString("ID").c_str());
-				for(int Row = 0; Row < Rows; Row++)
-				{
-					strcpy(aID2, pData->m_pSqlData->m_pResults->getString("ID").c_str());
-					if (str_comp(aID, aID2) != 0)
-					{
-						strcpy(aID, aID2);
-						aCuts[CutPos++] = Row - 1;
-					}
-					pData->m_pSqlData->m_pResults->next();
-				}
-				aCuts[CutPos] = Rows - 1;
-
-				CutPos = 0;
-				pData->m_pSqlData->m_pResults->first();
-				for(int Row = 0; Row < Rows; Row++)
-				{
-					strcat(aNames, pData->m_pSqlData->m_pResults->getString("Name").c_str());
+			strcpy(aID2, pResults->getString("ID").c_str());
+			if (str_comp(aID, aID2) != 0)
+			{
+				strcpy(aID, aID2);
+				aCuts[CutPos++] = Row - 1;
+			}
+			pResults->next();
+		}
+		aCuts[CutPos] = Rows - 1;
 
-					if (Row < aCuts[CutPos] - 1)
-						strcat(aNames, ", ");
-					else if (Row < aCuts[CutPos])
-						strcat(aNames, " & ");
+		CutPos = 0;
+		pResults->first();
+		for(int Row = 0; Row < Rows; Row++)
+		{
+			strcat(aNames, pResults->getString("Name").c_str());
 
-					Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-					Rank = (float)pData->m_pSqlData->m_pResults->getInt("rank");
+			if (Row < aCuts[CutPos] - 1)
+				strcat(aNames, ", ");
+			else if (Row < aCuts[CutPos])
+				strcat(aNames, " & ");
 
-					if (Row == aCuts[CutPos])
-					{
-						str_format(aBuf, sizeof(aBuf), "%d. %s Team Time: %02d:%05.2f", Rank, aNames, (int)(Time/60), Time-((int)Time/60*60));
-						pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-						CutPos++;
-						aNames[0] = '\0';
-					}
+			Time = (float)pResults->getDouble("Time");
+			Rank = (float)pResults->getInt("rank");
 
-					pData->m_pSqlData->m_pResults->next();
-				}
+			if (Row == aCuts[CutPos])
+			{
+				str_format(aBuf, sizeof(aBuf), "%d. %s Team Time: %02d:%05.2f", Rank, aNames, (int)(Time/60), Time-((int)Time/60*60));
+				pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+				CutPos++;
+				aNames[0] = '\0';
 			}
 
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "-------------------------------");
-
-			dbg_msg("SQL", "Showing teamtop5 done");
-
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show teamtop5");
+			pResults->next();
 		}
-
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
 	}
 
-	delete pData;
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "-------------------------------");
+
+	dbg_msg("SQL", "Showing teamtop5 done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
-void CSqlScore::ShowRankThread(void *pUser)
+void CSqlScore::ShowRankThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
-		{
-			// check strings
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-			// check sort methode
-			char aBuf[600];
+	// check sort methode
+	char aBuf[600];
 
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-			str_format(aBuf, sizeof(aBuf), "SELECT Rank, Name, Time FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = '%s' GROUP BY Name ORDER BY `Time` ASC) as a) as b WHERE Name = '%s';", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName);
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
 
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_RANK);
+	pStmt->setString(1, pData->m_pSqlData->m_aMapName);
+	pStmt->setString(2, pData->m_aName);
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				str_format(aBuf, sizeof(aBuf), "%s is not ranked", originalName);
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->next();
-
-				float Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-				int Rank = (int)pData->m_pSqlData->m_pResults->getInt("Rank");
-				if(g_Config.m_SvHideScore)
-				{
-					str_format(aBuf, sizeof(aBuf), "Your time: %02d:%05.2f", (int)(Time/60), Time-((int)Time/60*60));
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-				}
-				else
-				{
-					str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f, requested by %s", Rank, pData->m_pSqlData->m_pResults->getString("Name").c_str(), (int)(Time/60), Time-((int)Time/60*60), pData->m_aRequestingPlayer);
-					pData->m_pSqlData->GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, pData->m_ClientID);
-				}
-			}
-
-			dbg_msg("SQL", "Showing rank done");
+	if(pResults->rowsCount() != 1)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s is not ranked", pData->m_aName);
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+	}
+	else
+	{
+		pResults->next();
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
+		float Time = (float)pResults->getDouble("Time");
+		int Rank = (int)pResults->getInt("Rank");
+		if(g_Config.m_SvHideScore)
+		{
+			str_format(aBuf, sizeof(aBuf), "Your time: %02d:%05.2f", (int)(Time/60), Time-((int)Time/60*60));
+			pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
 		}
-		catch (sql::SQLException &e)
+		else
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show rank");
+			str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f, requested by %s", Rank, pResults->getString("Name").c_str(), (int)(Time/60), Time-((int)Time/60*60), pData->m_aRequestingPlayer);
+			pData->m_Result.AddLine(CSqlResult::CHAT_ALL, pData->m_ClientID, aBuf);
 		}
-
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Showing rank done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
 void CSqlScore::ShowTeamRank(int ClientID, const char* pName, bool Search)
@@ -1044,10 +1313,8 @@ void CSqlScore::ShowTeamRank(int ClientID, const char* pName, bool Search)
 	str_copy(Tmp->m_aName, pName, MAX_NAME_LENGTH);
 	Tmp->m_Search = Search;
 	str_format(Tmp->m_aRequestingPlayer, sizeof(Tmp->m_aRequestingPlayer), "%s", Server()->ClientName(ClientID));
-	Tmp->m_pSqlData = this;
 
-	void *TeamRankThread = thread_init(ShowTeamRankThread, Tmp);
-	thread_detach(TeamRankThread);
+	AddRequest(Tmp, ShowTeamRankThread);
 }
 
 void CSqlScore::ShowRank(int ClientID, const char* pName, bool Search)
@@ -1057,151 +1324,115 @@ void CSqlScore::ShowRank(int ClientID, const char* pName, bool Search)
 	str_copy(Tmp->m_aName, pName, MAX_NAME_LENGTH);
 	Tmp->m_Search = Search;
 	str_format(Tmp->m_aRequestingPlayer, sizeof(Tmp->m_aRequestingPlayer), "%s", Server()->ClientName(ClientID));
-	Tmp->m_pSqlData = this;
 
-	void *RankThread = thread_init(ShowRankThread, Tmp);
-	thread_detach(RankThread);
+	AddRequest(Tmp, ShowRankThread);
 }
 
-void CSqlScore::ShowTop5Thread(void *pUser)
+void CSqlScore::ShowTop5Thread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+	// check sort methode
+	char aBuf[512];
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
-		{
-			// check sort methode
-			char aBuf[512];
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-			str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, rank FROM (SELECT Name, (@pos := @pos+1) pos, (@rank := IF(@prev = Time,@rank, @pos)) rank, (@prev := Time) Time FROM (SELECT Name, min(Time) as Time FROM %s_race WHERE Map = '%s' GROUP BY Name ORDER BY `Time` ASC) as a) as b LIMIT %d, 5;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_Num-1);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			// show top5
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "----------- Top 5 -----------");
-
-			int Rank = 0;
-			float Time = 0;
-			while(pData->m_pSqlData->m_pResults->next())
-			{
-				Time = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
-				Rank = (float)pData->m_pSqlData->m_pResults->getInt("rank");
-				str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f", Rank, pData->m_pSqlData->m_pResults->getString("Name").c_str(), (int)(Time/60), Time-((int)Time/60*60));
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-				//Rank++;
-			}
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "-------------------------------");
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_TOP5);
+	pStmt->setString(1, pData->m_pSqlData->m_aMapName);
+	pStmt->setInt(2, pData->m_Num-1);
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			dbg_msg("SQL", "Showing top5 done");
-
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show top5");
-		}
+	// show top5
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "----------- Top 5 -----------");
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+	int Rank = 0;
+	float Time = 0;
+	while(pResults->next())
+	{
+		Time = (float)pResults->getDouble("Time");
+		Rank = (float)pResults->getInt("rank");
+		str_format(aBuf, sizeof(aBuf), "%d. %s Time: %02d:%05.2f", Rank, pResults->getString("Name").c_str(), (int)(Time/60), Time-((int)Time/60*60));
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+		//Rank++;
 	}
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "-------------------------------");
 
-	delete pData;
+	dbg_msg("SQL", "Showing top5 done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
-void CSqlScore::ShowTimesThread(void *pUser)
+void CSqlScore::ShowTimesThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
-		{
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
-
-			char aBuf[512];
-
-			if(pData->m_Search) // last 5 times of a player
-				str_format(aBuf, sizeof(aBuf), "SELECT Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = '%s' AND Name = '%s' ORDER BY Ago ASC LIMIT %d, 5;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_aName, pData->m_Num-1);
-			else// last 5 times of server
-				str_format(aBuf, sizeof(aBuf), "SELECT Name, Time, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago, UNIX_TIMESTAMP(Timestamp) as Stamp FROM %s_race WHERE Map = '%s' ORDER BY Ago ASC LIMIT %d, 5;", pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_aMap, pData->m_Num-1);
-
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			// show top5
-			if(pData->m_pSqlData->m_pResults->rowsCount() == 0)
-			{
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "There are no times in the specified range");
-				goto end;
-			}
+	char aBuf[512];
+	sql::PreparedStatement *pStmt;
 
-			str_format(aBuf, sizeof(aBuf), "------------ Last Times No %d - %d ------------",pData->m_Num,pData->m_Num + pData->m_pSqlData->m_pResults->rowsCount() - 1);
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
+	if(pData->m_Search) // last 5 times of a player
+	{
+		pStmt = pSql->Prepared(CSqlConnection::STMT_TIMES_PLAYER);
+		pStmt->setString(1, pData->m_pSqlData->m_aMapName);
+		pStmt->setString(2, pData->m_aName);
+		pStmt->setInt(3, pData->m_Num-1);
+	}
+	else // last 5 times of server
+	{
+		pStmt = pSql->Prepared(CSqlConnection::STMT_TIMES);
+		pStmt->setString(1, pData->m_pSqlData->m_aMapName);
+		pStmt->setInt(2, pData->m_Num-1);
+	}
 
-			float pTime = 0;
-			int pSince = 0;
-			int pStamp = 0;
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			while(pData->m_pSqlData->m_pResults->next())
-			{
-				char pAgoString[40] = "\0";
-				pSince = (int)pData->m_pSqlData->m_pResults->getInt("Ago");
-				pStamp = (int)pData->m_pSqlData->m_pResults->getInt("Stamp");
-				pTime = (float)pData->m_pSqlData->m_pResults->getDouble("Time");
+	// show top5
+	if(pResults->rowsCount() == 0)
+	{
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "There are no times in the specified range");
+		delete pResults;
+		return;
+	}
 
-				agoTimeToString(pSince,pAgoString);
+	str_format(aBuf, sizeof(aBuf), "------------ Last Times No %d - %d ------------",pData->m_Num,pData->m_Num + (int)pResults->rowsCount() - 1);
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
 
-				if(pData->m_Search) // last 5 times of a player
-				{
-					if(pStamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
-						str_format(aBuf, sizeof(aBuf), "%d min %.2f sec, don't know how long ago", (int)(pTime/60), pTime-((int)pTime/60*60));
-					else
-						str_format(aBuf, sizeof(aBuf), "%s ago, %d min %.2f sec", pAgoString,(int)(pTime/60), pTime-((int)pTime/60*60));
-				}
-				else // last 5 times of the server
-				{
-					if(pStamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
-						str_format(aBuf, sizeof(aBuf), "%s, %02d:%05.02f s, don't know when", pData->m_pSqlData->m_pResults->getString("Name").c_str(), (int)(pTime/60), pTime-((int)pTime/60*60));
-					else
-						str_format(aBuf, sizeof(aBuf), "%s, %s ago, %02d:%05.02f s", pData->m_pSqlData->m_pResults->getString("Name").c_str(), pAgoString, (int)(pTime/60), pTime-((int)pTime/60*60));
-				}
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "----------------------------------------------------");
+	float pTime = 0;
+	int pSince = 0;
+	int pStamp = 0;
+
+	while(pResults->next())
+	{
+		char pAgoString[40] = "\0";
+		pSince = (int)pResults->getInt("Ago");
+		pStamp = (int)pResults->getInt("Stamp");
+		pTime = (float)pResults->getDouble("Time");
 
-			dbg_msg("SQL", "Showing times done");
+		agoTimeToString(pSince,pAgoString);
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
+		if(pData->m_Search) // last 5 times of a player
+		{
+			if(pStamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
+				str_format(aBuf, sizeof(aBuf), "%d min %.2f sec, don't know how long ago", (int)(pTime/60), pTime-((int)pTime/60*60));
+			else
+				str_format(aBuf, sizeof(aBuf), "%s ago, %d min %.2f sec", pAgoString,(int)(pTime/60), pTime-((int)pTime/60*60));
 		}
-		catch (sql::SQLException &e)
+		else // last 5 times of the server
 		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show times");
+			if(pStamp == 0) // stamp is 00:00:00 cause it's an old entry from old times where there where no stamps yet
+				str_format(aBuf, sizeof(aBuf), "%s, %02d:%05.02f s, don't know when", pResults->getString("Name").c_str(), (int)(pTime/60), pTime-((int)pTime/60*60));
+			else
+				str_format(aBuf, sizeof(aBuf), "%s, %s ago, %02d:%05.02f s", pResults->getString("Name").c_str(), pAgoString, (int)(pTime/60), pTime-((int)pTime/60*60));
 		}
-		end:
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
 	}
-	delete pData;
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "----------------------------------------------------");
 
-	lock_unlock(gs_SqlLock);
+	dbg_msg("SQL", "Showing times done");
+
+	// delete results
+	delete pResults;
 }
 
 void CSqlScore::ShowTeamTop5(IConsole::IResult *pResult, int ClientID, void *pUserData, int Debut)
@@ -1209,10 +1440,8 @@ void CSqlScore::ShowTeamTop5(IConsole::IResult *pResult, int ClientID, void *pUs
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
-	Tmp->m_pSqlData = this;
 
-	void *TeamTop5Thread = thread_init(ShowTeamTop5Thread, Tmp);
-	thread_detach(TeamTop5Thread);
+	AddRequest(Tmp, ShowTeamTop5Thread);
 }
 
 void CSqlScore::ShowTop5(IConsole::IResult *pResult, int ClientID, void *pUserData, int Debut)
@@ -1220,10 +1449,8 @@ void CSqlScore::ShowTop5(IConsole::IResult *pResult, int ClientID, void *pUserDa
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
-	Tmp->m_pSqlData = this;
 
-	void *Top5Thread = thread_init(ShowTop5Thread, Tmp);
-	thread_detach(Top5Thread);
+	AddRequest(Tmp, ShowTop5Thread);
 }
 
 void CSqlScore::ShowTimes(int ClientID, int Debut)
@@ -1231,11 +1458,9 @@ void CSqlScore::ShowTimes(int ClientID, int Debut)
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
-	Tmp->m_pSqlData = this;
 	Tmp->m_Search = false;
 
-	void *TimesThread = thread_init(ShowTimesThread, Tmp);
-	thread_detach(TimesThread);
+	AddRequest(Tmp, ShowTimesThread);
 }
 
 void CSqlScore::ShowTimes(int ClientID, const char* pName, int Debut)
@@ -1244,11 +1469,9 @@ void CSqlScore::ShowTimes(int ClientID, const char* pName, int Debut)
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_aName, pName, MAX_NAME_LENGTH);
-	Tmp->m_pSqlData = this;
 	Tmp->m_Search = true;
 
-	void *TimesThread = thread_init(ShowTimesThread, Tmp);
-	thread_detach(TimesThread);
+	AddRequest(Tmp, ShowTimesThread);
 }
 
 void CSqlScore::FuzzyString(char *pString)
@@ -1270,41 +1493,6 @@ void CSqlScore::FuzzyString(char *pString)
 	strcpy(pString, newString);
 }
 
-// anti SQL injection
-void CSqlScore::ClearString(char *pString, int size)
-{
-	char *newString = (char *)malloc(size * 2 - 1);
-	int pos = 0;
-
-	for(int i=0;i<size;i++)
-	{
-		if(pString[i] == '\\')
-		{
-			newString[pos++] = '\\';
-			newString[pos++] = '\\';
-		}
-		else if(pString[i] == '\'')
-		{
-			newString[pos++] = '\\';
-			newString[pos++] = '\'';
-		}
-		else if(pString[i] == '"')
-		{
-			newString[pos++] = '\\';
-			newString[pos++] = '"';
-		}
-		else
-		{
-			newString[pos++] = pString[i];
-		}
-	}
-
-	newString[pos] = '\0';
-
-	strcpy(pString,newString);
-	free(newString);
-}
-
 void CSqlScore::agoTimeToString(int agoTime, char agoString[])
 {
 	char aBuf[20];
@@ -1382,64 +1570,38 @@ void CSqlScore::agoTimeToString(int agoTime, char agoString[])
 	}
 }
 
-void CSqlScore::ShowPointsThread(void *pUser)
-{
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
-		{
-			// check strings
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
-
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-
-			char aBuf[512];
-			str_format(aBuf, sizeof(aBuf), "select Rank, Name, Points from (select (@pos := @pos+1) pos, (@rank := IF(@prev = Points,@rank,@pos)) Rank, Points, Name from (select (@prev := Points) Points, Name from %s_points order by Points desc) as ll) as l where Name = '%s';", pData->m_pSqlData->m_pPrefix, pData->m_aName);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
 
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				str_format(aBuf, sizeof(aBuf), "%s has not collected any points so far", originalName);
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->next();
-				int count = (int)pData->m_pSqlData->m_pResults->getInt("Points");
-				int rank = (int)pData->m_pSqlData->m_pResults->getInt("rank");
-				str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d, requested by %s", rank, pData->m_pSqlData->m_pResults->getString("Name").c_str(), count, pData->m_aRequestingPlayer);
-				pData->m_pSqlData->GameServer()->SendChat(-1, CGameContext::CHAT_ALL, aBuf, pData->m_ClientID);
-			}
+void CSqlScore::ShowPointsThread(CSqlConnection *pSql, CSqlRequest *pRequest)
+{
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-			dbg_msg("SQL", "Showing points done");
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show points");
-		}
+	char aBuf[512];
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_POINTS);
+	pStmt->setString(1, pData->m_aName);
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+	if(pResults->rowsCount() != 1)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s has not collected any points so far", pData->m_aName);
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+	}
+	else
+	{
+		pResults->next();
+		int count = (int)pResults->getInt("Points");
+		int rank = (int)pResults->getInt("rank");
+		str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d, requested by %s", rank, pResults->getString("Name").c_str(), count, pData->m_aRequestingPlayer);
+		pData->m_Result.AddLine(CSqlResult::CHAT_ALL, pData->m_ClientID, aBuf);
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Showing points done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
 void CSqlScore::ShowPoints(int ClientID, const char* pName, bool Search)
@@ -1449,61 +1611,37 @@ void CSqlScore::ShowPoints(int ClientID, const char* pName, bool Search)
 	str_copy(Tmp->m_aName, pName, MAX_NAME_LENGTH);
 	Tmp->m_Search = Search;
 	str_format(Tmp->m_aRequestingPlayer, sizeof(Tmp->m_aRequestingPlayer), "%s", Server()->ClientName(ClientID));
-	Tmp->m_pSqlData = this;
 
-	void *PointsThread = thread_init(ShowPointsThread, Tmp);
-	thread_detach(PointsThread);
+	AddRequest(Tmp, ShowPointsThread);
 }
 
-void CSqlScore::ShowTopPointsThread(void *pUser)
+void CSqlScore::ShowTopPointsThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
-	{
-		try
-		{
-			char aBuf[512];
-			pData->m_pSqlData->m_pStatement->execute("SET @prev := NULL;");
-			pData->m_pSqlData->m_pStatement->execute("SET @rank := 1;");
-			pData->m_pSqlData->m_pStatement->execute("SET @pos := 0;");
-			str_format(aBuf, sizeof(aBuf), "select Rank, Name, Points from (select (@pos := @pos+1) pos, (@rank := IF(@prev = Points,@rank,@pos)) Rank, Points, Name from (select (@prev := Points) Points, Name from %s_points order by Points desc) as ll) as l LIMIT %d, 5;", pData->m_pSqlData->m_pPrefix, pData->m_Num-1);
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+	char aBuf[512];
+	pSql->Statement()->execute("SET @prev := NULL;");
+	pSql->Statement()->execute("SET @rank := 1;");
+	pSql->Statement()->execute("SET @pos := 0;");
 
-			// show top points
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "-------- Top Points --------");
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_TOP_POINTS);
+	pStmt->setInt(1, pData->m_Num-1);
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			while(pData->m_pSqlData->m_pResults->next())
-			{
-				str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d", pData->m_pSqlData->m_pResults->getInt("rank"), pData->m_pSqlData->m_pResults->getString("Name").c_str(), pData->m_pSqlData->m_pResults->getInt("Points"));
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-			}
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "-------------------------------");
-
-			dbg_msg("SQL", "Showing toppoints done");
-
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not show toppoints");
-		}
+	// show top points
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "-------- Top Points --------");
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+	while(pResults->next())
+	{
+		str_format(aBuf, sizeof(aBuf), "%d. %s Points: %d", pResults->getInt("rank"), pResults->getString("Name").c_str(), pResults->getInt("Points"));
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
 	}
+	pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "-------------------------------");
 
-	delete pData;
+	dbg_msg("SQL", "Showing toppoints done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
 void CSqlScore::ShowTopPoints(IConsole::IResult *pResult, int ClientID, void *pUserData, int Debut)
@@ -1511,122 +1649,84 @@ void CSqlScore::ShowTopPoints(IConsole::IResult *pResult, int ClientID, void *pU
 	CSqlScoreData *Tmp = new CSqlScoreData();
 	Tmp->m_Num = Debut;
 	Tmp->m_ClientID = ClientID;
-	Tmp->m_pSqlData = this;
 
-	void *TopPointsThread = thread_init(ShowTopPointsThread, Tmp);
-	thread_detach(TopPointsThread);
+	AddRequest(Tmp, ShowTopPointsThread);
 }
 
-void CSqlScore::RandomMapThread(void *pUser)
+void CSqlScore::RandomMapThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
-
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	sql::PreparedStatement *pStmt;
+	if(pData->m_Num)
 	{
-		try
-		{
-			char aBuf[512];
-			if(pData->m_Num)
-				str_format(aBuf, sizeof(aBuf), "select * from %s_maps where Server = \"%s\" and Stars = \"%d\" order by RAND() limit 1;", pData->m_pSqlData->m_pPrefix, g_Config.m_SvServerType, pData->m_Num);
-			else
-				str_format(aBuf, sizeof(aBuf), "select * from %s_maps where Server = \"%s\" order by RAND() limit 1;", pData->m_pSqlData->m_pPrefix, g_Config.m_SvServerType);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "No maps found on this server!");
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->next();
-				char aMap[128];
-				strcpy(aMap, pData->m_pSqlData->m_pResults->getString("Map").c_str());
-
-				str_format(aBuf, sizeof(aBuf), "change_map \"%s\"", aMap);
-				pData->m_pSqlData->GameServer()->Console()->ExecuteLine(aBuf);
-			}
-
-			dbg_msg("SQL", "Voting random map done");
+		pStmt = pSql->Prepared(CSqlConnection::STMT_RANDOM_MAP_STARS);
+		pStmt->setString(1, g_Config.m_SvServerType);
+		pStmt->setInt(2, pData->m_Num);
+	}
+	else
+	{
+		pStmt = pSql->Prepared(CSqlConnection::STMT_RANDOM_MAP);
+		pStmt->setString(1, g_Config.m_SvServerType);
+	}
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not vote random map");
-		}
+	if(pResults->rowsCount() != 1)
+	{
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "No maps found on this server!");
+	}
+	else
+	{
+		pResults->next();
+		char aMap[128];
+		strcpy(aMap, pResults->getString("Map").c_str());
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+		str_format(pData->m_Result.m_aCommand, sizeof(pData->m_Result.m_aCommand), "change_map \"%s\"", aMap);
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Voting random map done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
-void CSqlScore::RandomUnfinishedMapThread(void *pUser)
+void CSqlScore::RandomUnfinishedMapThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	lock_wait(gs_SqlLock);
-
-	CSqlScoreData *pData = (CSqlScoreData *)pUser;
+	CSqlScoreData *pData = (CSqlScoreData *)pRequest;
 
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	sql::PreparedStatement *pStmt;
+	if(pData->m_Num)
 	{
-		try
-		{
-			char originalName[MAX_NAME_LENGTH];
-			strcpy(originalName,pData->m_aName);
-			pData->m_pSqlData->ClearString(pData->m_aName);
-
-			char aBuf[512];
-			if(pData->m_Num)
-				str_format(aBuf, sizeof(aBuf), "select * from %s_maps where Server = \"%s\" and Stars = \"%d\" and not exists (select * from %s_race where Name = \"%s\" and %s_race.Map = %s_maps.Map) order by RAND() limit 1;", pData->m_pSqlData->m_pPrefix, g_Config.m_SvServerType, pData->m_Num, pData->m_pSqlData->m_pPrefix, pData->m_aName, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_pPrefix);
-			else
-				str_format(aBuf, sizeof(aBuf), "select * from %s_maps where Server = \"%s\" and not exists (select * from %s_race where Name = \"%s\" and %s_race.Map = %s_maps.Map) order by RAND() limit 1;", pData->m_pSqlData->m_pPrefix, g_Config.m_SvServerType, pData->m_pSqlData->m_pPrefix, pData->m_aName, pData->m_pSqlData->m_pPrefix, pData->m_pSqlData->m_pPrefix);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
-
-			if(pData->m_pSqlData->m_pResults->rowsCount() != 1)
-			{
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "You have no unfinished maps on this server!");
-			}
-			else
-			{
-				pData->m_pSqlData->m_pResults->next();
-				char aMap[128];
-				strcpy(aMap, pData->m_pSqlData->m_pResults->getString("Map").c_str());
-
-				str_format(aBuf, sizeof(aBuf), "change_map \"%s\"", aMap);
-				pData->m_pSqlData->GameServer()->Console()->ExecuteLine(aBuf);
-			}
-
-			dbg_msg("SQL", "Voting random unfinished map done");
+		pStmt = pSql->Prepared(CSqlConnection::STMT_RANDOM_UNFINISHED_STARS);
+		pStmt->setString(1, g_Config.m_SvServerType);
+		pStmt->setInt(2, pData->m_Num);
+		pStmt->setString(3, pData->m_aName);
+	}
+	else
+	{
+		pStmt = pSql->Prepared(CSqlConnection::STMT_RANDOM_UNFINISHED);
+		pStmt->setString(1, g_Config.m_SvServerType);
+		pStmt->setString(2, pData->m_aName);
+	}
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf[256];
-			str_format(aBuf, sizeof(aBuf), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf);
-			dbg_msg("SQL", "ERROR: Could not vote random unfinished map");
-		}
+	if(pResults->rowsCount() != 1)
+	{
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "You have no unfinished maps on this server!");
+	}
+	else
+	{
+		pResults->next();
+		char aMap[128];
+		strcpy(aMap, pResults->getString("Map").c_str());
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+		str_format(pData->m_Result.m_aCommand, sizeof(pData->m_Result.m_aCommand), "change_map \"%s\"", aMap);
 	}
 
-	delete pData;
+	dbg_msg("SQL", "Voting random unfinished map done");
 
-	lock_unlock(gs_SqlLock);
+	// delete results
+	delete pResults;
 }
 
 void CSqlScore::RandomMap(int ClientID, int stars)
@@ -1635,10 +1735,8 @@ void CSqlScore::RandomMap(int ClientID, int stars)
 	Tmp->m_Num = stars;
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_aName, GameServer()->Server()->ClientName(ClientID), MAX_NAME_LENGTH);
-	Tmp->m_pSqlData = this;
 
-	void *RandomThread = thread_init(RandomMapThread, Tmp);
-	thread_detach(RandomThread);
+	AddRequest(Tmp, RandomMapThread);
 }
 
 void CSqlScore::RandomUnfinishedMap(int ClientID, int stars)
@@ -1647,19 +1745,18 @@ void CSqlScore::RandomUnfinishedMap(int ClientID, int stars)
 	Tmp->m_Num = stars;
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_aName, GameServer()->Server()->ClientName(ClientID), MAX_NAME_LENGTH);
-	Tmp->m_pSqlData = this;
 
-	void *RandomUnfinishedThread = thread_init(RandomUnfinishedMapThread, Tmp);
-	thread_detach(RandomUnfinishedThread);
+	AddRequest(Tmp, RandomUnfinishedMapThread);
 }
 
 void CSqlScore::SaveTeam(int Team, const char* Code, int ClientID, const char* Server)
 {
-	if((g_Config.m_SvTeam == 3 || (Team > 0 && Team < MAX_CLIENTS)) && ((CGameControllerDDRace*)(GameServer()->m_pController))->m_Teams.Count(Team) > 0)
+	CGameControllerDDRace *pController = (CGameControllerDDRace*)GameServer()->m_pController;
+	if((g_Config.m_SvTeam == 3 || (Team > 0 && Team < MAX_CLIENTS)) && pController->m_Teams.Count(Team) > 0)
 	{
-		if(((CGameControllerDDRace*)(GameServer()->m_pController))->m_Teams.GetSaving(Team))
+		if(pController->m_Teams.GetSaving(Team))
 			return;
-		((CGameControllerDDRace*)(GameServer()->m_pController))->m_Teams.SetSaving(Team, true);
+		pController->m_Teams.SetSaving(Team, true);
 	}
 	else
 	{
@@ -1667,261 +1764,286 @@ void CSqlScore::SaveTeam(int Team, const char* Code, int ClientID, const char* S
 		return;
 	}
 
+	// the team is read here in the tick thread, the worker only stores the string
+	CSaveTeam* SavedTeam = new CSaveTeam(GameServer()->m_pController);
+	int Num = SavedTeam->save(Team);
+	switch (Num)
+	{
+		case 1:
+			GameServer()->SendChatTarget(ClientID, "You have to be in a Team (from 1-63)");
+			break;
+		case 2:
+			GameServer()->SendChatTarget(ClientID, "Could not find your Team");
+			break;
+		case 3:
+			GameServer()->SendChatTarget(ClientID, "Unable to find all Characters");
+			break;
+		case 4:
+			GameServer()->SendChatTarget(ClientID, "Your team is not started yet");
+			break;
+	}
+	if(Num)
+	{
+		pController->m_Teams.SetSaving(Team, false);
+		delete SavedTeam;
+		return;
+	}
+
 	CSqlTeamSave *Tmp = new CSqlTeamSave();
 	Tmp->m_Team = Team;
 	Tmp->m_ClientID = ClientID;
 	str_copy(Tmp->m_Code, Code, 32);
+	str_copy(Tmp->m_OriginalCode, Code, sizeof(Tmp->m_OriginalCode));
 	str_copy(Tmp->m_Server, Server, sizeof(Tmp->m_Server));
-	Tmp->m_pSqlData = this;
+	str_copy(Tmp->m_aMap, g_Config.m_SvMap, sizeof(Tmp->m_aMap));
+	str_copy(Tmp->m_TeamString, SavedTeam->GetString(), sizeof(Tmp->m_TeamString));
+	delete SavedTeam;
 
-	void *SaveThread = thread_init(SaveTeamThread, Tmp);
-	thread_detach(SaveThread);
+	AddRequest(Tmp, SaveTeamThread, SaveTeamDone, true);
 }
 
-void CSqlScore::SaveTeamThread(void *pUser)
+void CSqlScore::SaveTeamThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	CSaveTeam* SavedTeam = 0;
-	CSqlTeamSave *pData = (CSqlTeamSave *)pUser;
+	CSqlTeamSave *pData = (CSqlTeamSave *)pRequest;
 
-	char TeamString[65536];
-	int Team = pData->m_Team;
-	char OriginalCode[32];
-	str_copy(OriginalCode, pData->m_Code, sizeof(OriginalCode));
-	pData->m_pSqlData->ClearString(pData->m_Code, sizeof(pData->m_Code));
-	char Map[128];
-	str_copy(Map, g_Config.m_SvMap, 128);
-	pData->m_pSqlData->ClearString(Map, sizeof(Map));
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_SAVE_EXISTS);
+	pStmt->setString(1, pData->m_Code);
+	pStmt->setString(2, pData->m_aMap);
+	sql::ResultSet *pResults = pStmt->executeQuery();
+	int NumRows = pResults->rowsCount();
 
-	int Num = -1;
+	// delete results
+	delete pResults;
 
-	if((g_Config.m_SvTeam == 3 || (Team > 0 && Team < MAX_CLIENTS)) && ((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.Count(Team) > 0)
+	if (NumRows == 0)
 	{
-		SavedTeam = new CSaveTeam(pData->m_pSqlData->GameServer()->m_pController);
-		Num = SavedTeam->save(Team);
-		switch (Num)
-		{
-			case 1:
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "You have to be in a Team (from 1-63)");
-				break;
-			case 2:
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "Could not find your Team");
-				break;
-			case 3:
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "Unable to find all Characters");
-				break;
-			case 4:
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "Your team is not started yet");
-				break;
-		}
-		if(!Num)
-		{
-			str_copy(TeamString, SavedTeam->GetString(), sizeof(TeamString));
-			pData->m_pSqlData->ClearString(TeamString, sizeof(TeamString));
-		}
+		pStmt = pSql->Prepared(CSqlConnection::STMT_SAVE_INSERT);
+		pStmt->setString(1, pData->m_TeamString);
+		pStmt->setString(2, pData->m_aMap);
+		pStmt->setString(3, pData->m_Code);
+		pStmt->setString(4, pData->m_Server);
+		pStmt->execute();
+
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "Team successfully saved. Use '/load %s' to continue", pData->m_OriginalCode);
+		pData->m_Result.AddLine(CSqlResult::CHAT_TEAM, pData->m_Team, aBuf);
+		pData->m_Saved = true;
 	}
 	else
-		pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "You have to be in a Team (from 1-63)");
-
-	lock_wait(gs_SqlLock);
-	// Connect to database
-	if(!Num && pData->m_pSqlData->Connect())
 	{
-		try
-		{
-			char aBuf[512];
-			str_format(aBuf, sizeof(aBuf), "select Savegame from %s_saves where Code = '%s' and Map = '%s';",  pData->m_pSqlData->m_pPrefix, pData->m_Code, Map);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+		dbg_msg("SQL", "ERROR: This save-code already exists");
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "This save-code already exists");
+	}
+}
 
-			if (pData->m_pSqlData->m_pResults->rowsCount() == 0)
-			{
-				// delete results and statement
-				delete pData->m_pSqlData->m_pResults;
-
-				char aBuf[65536];
-				str_format(aBuf, sizeof(aBuf), "INSERT IGNORE INTO %s_saves(Savegame, Map, Code, Timestamp, Server) VALUES ('%s', '%s', '%s', CURRENT_TIMESTAMP(), '%s')",  pData->m_pSqlData->m_pPrefix, TeamString, Map, pData->m_Code, pData->m_Server);
-				dbg_msg("SQL", aBuf);
-				pData->m_pSqlData->m_pStatement->execute(aBuf);
-
-				char aBuf2[256];
-				str_format(aBuf2, sizeof(aBuf2), "Team successfully saved. Use '/load %s' to continue", OriginalCode);
-				pData->m_pSqlData->GameServer()->SendChatTeam(Team, aBuf2);
-				((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.KillSavedTeam(Team);
-			}
-			else
-			{
-				dbg_msg("SQL", "ERROR: This save-code already exists");
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "This save-code already exists");
-			}
-		}
-		catch (sql::SQLException &e)
-		{
-			char aBuf2[256];
-			str_format(aBuf2, sizeof(aBuf2), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf2);
-			dbg_msg("SQL", "ERROR: Could not save the team");
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "MySQL Error: Could not save the team");
-		}
+void CSqlScore::SaveTeamDone(CSqlRequest *pRequest)
+{
+	CSqlTeamSave *pData = (CSqlTeamSave *)pRequest;
+	CGameContext *pGameServer = pData->m_pSqlData->GameServer();
+	CGameControllerDDRace *pController = (CGameControllerDDRace*)pGameServer->m_pController;
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+	// the team is handled even if the one that saved it left, it got the code through the team chat
+	if(!pData->m_Connected)
+	{
+		if(!pData->m_Stale)
+			pGameServer->SendChatTarget(pData->m_ClientID, "ERROR: Unable to connect to SQL-Server");
 	}
-	else if(!Num)
+	else if(pData->m_Failed)
 	{
-		dbg_msg("SQL", "connection failed");
-		pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "ERROR: Unable to connect to SQL-Server");
+		dbg_msg("SQL", "ERROR: Could not save the team");
+		if(!pData->m_Stale)
+			pGameServer->SendChatTarget(pData->m_ClientID, "MySQL Error: Could not save the team");
 	}
+	else if(pData->m_Saved)
+		pController->m_Teams.KillSavedTeam(pData->m_Team);
 
-	((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.SetSaving(Team, false);
-
-	delete pData;
-	if(SavedTeam)
-		delete SavedTeam;
-
-	lock_unlock(gs_SqlLock);
+	pController->m_Teams.SetSaving(pData->m_Team, false);
 }
 
 void CSqlScore::LoadTeam(const char* Code, int ClientID)
 {
+	// a savegame is only deleted after it was loaded, don't hand it out twice meanwhile
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(m_aaLoadingCodes[i][0] && str_comp(m_aaLoadingCodes[i], Code) == 0)
+		{
+			GameServer()->SendChatTarget(ClientID, "This savegame is being loaded already");
+			return;
+		}
+	}
+	if(m_aaLoadingCodes[ClientID][0])
+		return;
+	str_copy(m_aaLoadingCodes[ClientID], Code, sizeof(m_aaLoadingCodes[ClientID]));
+
 	CSqlTeamLoad *Tmp = new CSqlTeamLoad();
 	str_copy(Tmp->m_Code, Code, 32);
+	str_copy(Tmp->m_aMap, g_Config.m_SvMap, sizeof(Tmp->m_aMap));
 	Tmp->m_ClientID = ClientID;
-	Tmp->m_pSqlData = this;
 
-	void *LoadThread = thread_init(LoadTeamThread, Tmp);
-	thread_detach(LoadThread);
+	AddRequest(Tmp, LoadTeamThread, LoadTeamDone);
 }
 
-void CSqlScore::LoadTeamThread(void *pUser)
+void CSqlScore::LoadTeamThread(CSqlConnection *pSql, CSqlRequest *pRequest)
 {
-	CSaveTeam* SavedTeam;
-	CSqlTeamLoad *pData = (CSqlTeamLoad *)pUser;
+	CSqlTeamLoad *pData = (CSqlTeamLoad *)pRequest;
 
-	SavedTeam = new CSaveTeam(pData->m_pSqlData->GameServer()->m_pController);
+	char aBuf[768];
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_SAVE_LOAD);
+	pStmt->setString(1, pData->m_Code);
+	pStmt->setString(2, pData->m_aMap);
+	sql::ResultSet *pResults = pStmt->executeQuery();
 
-	pData->m_pSqlData->ClearString(pData->m_Code, sizeof(pData->m_Code));
-	char Map[128];
-	str_copy(Map, g_Config.m_SvMap, 128);
-	pData->m_pSqlData->ClearString(Map, sizeof(Map));
-	int Num;
-
-	lock_wait(gs_SqlLock);
-	// Connect to database
-	if(pData->m_pSqlData->Connect())
+	if (pResults->rowsCount() > 0)
 	{
-		try
+		pResults->first();
+		char ServerName[5];
+		str_copy(ServerName, pResults->getString("Server").c_str(), sizeof(ServerName));
+		int since = (int)pResults->getInt("Ago");
+
+		if(str_comp(ServerName, g_Config.m_SvSqlServerName))
+		{
+			str_format(aBuf, sizeof(aBuf), "You have to be on the '%s' server to load this savegame", ServerName);
+			pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+		}
+		else if(since < g_Config.m_SvSaveGamesDelay)
+		{
+			str_format(aBuf, sizeof(aBuf), "You have to wait %d seconds until you can load this savegame", g_Config.m_SvSaveGamesDelay - since);
+			pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, aBuf);
+		}
+		else
 		{
-			char aBuf[768];
-			str_format(aBuf, sizeof(aBuf), "select Savegame, Server, UNIX_TIMESTAMP(CURRENT_TIMESTAMP)-UNIX_TIMESTAMP(Timestamp) as Ago from %s_saves where Code = '%s' and Map = '%s';",  pData->m_pSqlData->m_pPrefix, pData->m_Code, Map);
-			pData->m_pSqlData->m_pResults = pData->m_pSqlData->m_pStatement->executeQuery(aBuf);
+			// the team is loaded in the tick thread
+			str_copy(pData->m_Savegame, pResults->getString("Savegame").c_str(), sizeof(pData->m_Savegame));
+			pData->m_Found = true;
+		}
+	}
+	else
+		pData->m_Result.AddLine(CSqlResult::CHAT_TARGET, pData->m_ClientID, "No such savegame for this map");
 
-			if (pData->m_pSqlData->m_pResults->rowsCount() > 0)
-			{
-				pData->m_pSqlData->m_pResults->first();
-				char ServerName[5];
-				str_copy(ServerName, pData->m_pSqlData->m_pResults->getString("Server").c_str(), sizeof(ServerName));
-				if(str_comp(ServerName, g_Config.m_SvSqlServerName))
-				{
-					str_format(aBuf, sizeof(aBuf), "You have to be on the '%s' server to load this savegame", ServerName);
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-					goto end;
-				}
+	// delete results
+	delete pResults;
+}
+
+void CSqlScore::LoadTeamDone(CSqlRequest *pRequest)
+{
+	CSqlTeamLoad *pData = (CSqlTeamLoad *)pRequest;
+	CSqlScore *pSelf = pData->m_pSqlData;
+	CGameContext *pGameServer = pSelf->GameServer();
+	CGameControllerDDRace *pController = (CGameControllerDDRace*)pGameServer->m_pController;
 
-				pData->m_pSqlData->m_pResults->getInt("Ago");
-				int since = (int)pData->m_pSqlData->m_pResults->getInt("Ago");
+	// the savegame stays in place for its team when the one that asked is gone
+	if(pData->m_Stale)
+	{
+		pSelf->m_aaLoadingCodes[pData->m_ClientID][0] = 0;
+		return;
+	}
 
-				if(since < g_Config.m_SvSaveGamesDelay)
-				{
-					str_format(aBuf, sizeof(aBuf), "You have to wait %d seconds until you can load this savegame", g_Config.m_SvSaveGamesDelay - since);
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-					goto end;
-				}
+	if(!pData->m_Connected)
+	{
+		dbg_msg("SQL", "connection failed");
+		pGameServer->SendChatTarget(pData->m_ClientID, "ERROR: Unable to connect to SQL-Server");
+	}
+	else if(pData->m_Failed)
+	{
+		dbg_msg("SQL", "ERROR: Could not load the team");
+		pGameServer->SendChatTarget(pData->m_ClientID, "MySQL Error: Could not load the team");
+	}
+	if(!pData->m_Found)
+	{
+		pSelf->m_aaLoadingCodes[pData->m_ClientID][0] = 0;
+		return;
+	}
 
-				Num = SavedTeam->LoadString(pData->m_pSqlData->m_pResults->getString("Savegame").c_str());
+	bool Loaded = false;
+	CSaveTeam* SavedTeam = new CSaveTeam(pController);
+	int Num = SavedTeam->LoadString(pData->m_Savegame);
 
-				if(Num)
-					pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "Unable to load savegame: data corrupted");
-				else
-				{
+	if(Num)
+		pGameServer->SendChatTarget(pData->m_ClientID, "Unable to load savegame: data corrupted");
+	else
+	{
 
-					bool found = false;
-					for (int i = 0; i < SavedTeam->GetMembersCount(); i++)
-					{
-						if(str_comp(SavedTeam->SavedTees[i].GetName(), pData->m_pSqlData->Server()->ClientName(pData->m_ClientID)) == 0)
-						{ found = true; break; }
-					}
-					if (!found)
-						pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "You don't belong to this team");
-					else
-					{
-
-						int n;
-						for(n = 1; n<64; n++)
-						{
-							if(((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.Count(n) == 0)
-								break;
-						}
-
-						if(((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.Count(n) > 0)
-						{
-							n = ((CGameControllerDDRace*)(pData->m_pSqlData->GameServer()->m_pController))->m_Teams.m_Core.Team(pData->m_ClientID); // if all Teams are full your the only one in your team
-						}
-
-						Num = SavedTeam->load(n);
-
-						if(Num == 1)
-						{
-							pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "You have to be in a team (from 1-63)");
-						}
-						else if(Num >= 10 && Num < 100)
-						{
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "Unable to find player: '%s'", SavedTeam->SavedTees[Num-10].GetName());
-							pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-						}
-						else if(Num >= 100)
-						{
-							char aBuf[256];
-							str_format(aBuf, sizeof(aBuf), "%s is racing right now, Team can't be loaded if a Tee is racing already", SavedTeam->SavedTees[Num-100].GetName());
-							pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, aBuf);
-						}
-						else
-						{
-							pData->m_pSqlData->GameServer()->SendChatTeam(n, "Loading successfully done");
-							char aBuf[512];
-							str_format(aBuf, sizeof(aBuf), "DELETE from %s_saves where Code='%s' and Map='%s';", pData->m_pSqlData->m_pPrefix, pData->m_Code, Map);
-							pData->m_pSqlData->m_pStatement->execute(aBuf);
-						}
-					}
-				}
-			}
-			else
-				pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "No such savegame for this map");
-			end:
-			// delete results and statement
-			delete pData->m_pSqlData->m_pResults;
-		}
-		catch (sql::SQLException &e)
+		bool found = false;
+		for (int i = 0; i < SavedTeam->GetMembersCount(); i++)
 		{
-			char aBuf2[256];
-			str_format(aBuf2, sizeof(aBuf2), "MySQL Error: %s", e.what());
-			dbg_msg("SQL", aBuf2);
-			dbg_msg("SQL", "ERROR: Could not load the team");
-			pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "MySQL Error: Could not load the team");
+			if(str_comp(SavedTeam->SavedTees[i].GetName(), pSelf->Server()->ClientName(pData->m_ClientID)) == 0)
+			{ found = true; break; }
 		}
+		if (!found)
+			pGameServer->SendChatTarget(pData->m_ClientID, "You don't belong to this team");
+		else
+		{
 
-		// disconnect from database
-		pData->m_pSqlData->Disconnect();
+			int n;
+			for(n = 1; n<64; n++)
+			{
+				if(pController->m_Teams.Count(n) == 0)
+					break;
+			}
+
+			if(pController->m_Teams.Count(n) > 0)
+			{
+				n = pController->m_Teams.m_Core.Team(pData->m_ClientID); // if all Teams are full your the only one in your team
+			}
+
+			Num = SavedTeam->load(n);
+
+			if(Num == 1)
+			{
+				pGameServer->SendChatTarget(pData->m_ClientID, "You have to be in a team (from 1-63)");
+			}
+			else if(Num >= 10 && Num < 100)
+			{
+				char aBuf[256];
+				str_format(aBuf, sizeof(aBuf), "Unable to find player: '%s'", SavedTeam->SavedTees[Num-10].GetName());
+				pGameServer->SendChatTarget(pData->m_ClientID, aBuf);
+			}
+			else if(Num >= 100)
+			{
+				char aBuf[256];
+				str_format(aBuf, sizeof(aBuf), "%s is racing right now, Team can't be loaded if a Tee is racing already", SavedTeam->SavedTees[Num-100].GetName());
+				pGameServer->SendChatTarget(pData->m_ClientID, aBuf);
+			}
+			else
+			{
+				pGameServer->SendChatTeam(n, "Loading successfully done");
+				Loaded = true;
+			}
+		}
 	}
-	else
+
+	delete SavedTeam;
+
+	if(!Loaded)
 	{
-		dbg_msg("SQL", "connection failed");
-		pData->m_pSqlData->GameServer()->SendChatTarget(pData->m_ClientID, "ERROR: Unable to connect to SQL-Server");
+		pSelf->m_aaLoadingCodes[pData->m_ClientID][0] = 0;
+		return;
 	}
 
-	delete pData;
-	delete SavedTeam;
+	CSqlTeamLoad *Tmp = new CSqlTeamLoad();
+	str_copy(Tmp->m_Code, pData->m_Code, sizeof(Tmp->m_Code));
+	str_copy(Tmp->m_aMap, pData->m_aMap, sizeof(Tmp->m_aMap));
+	Tmp->m_ClientID = pData->m_ClientID;
+
+	pSelf->AddRequest(Tmp, DeleteSaveThread, DeleteSaveDone, true);
+}
+
+void CSqlScore::DeleteSaveThread(CSqlConnection *pSql, CSqlRequest *pRequest)
+{
+	CSqlTeamLoad *pData = (CSqlTeamLoad *)pRequest;
+
+	sql::PreparedStatement *pStmt = pSql->Prepared(CSqlConnection::STMT_SAVE_DELETE);
+	pStmt->setString(1, pData->m_Code);
+	pStmt->setString(2, pData->m_aMap);
+	pStmt->execute();
+}
 
-	lock_unlock(gs_SqlLock);
+void CSqlScore::DeleteSaveDone(CSqlRequest *pRequest)
+{
+	CSqlTeamLoad *pData = (CSqlTeamLoad *)pRequest;
+	if(pData->m_Failed)
+		dbg_msg("SQL", "ERROR: Could not delete the loaded savegame");
+	pData->m_pSqlData->m_aaLoadingCodes[pData->m_ClientID][0] = 0;
 }
 
 #endif
@@ -8,19 +8,192 @@
 
 #include <cppconn/driver.h>
 #include <cppconn/exception.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 
+#include <base/tl/array.h>
+
+#include <engine/shared/jobs.h>
+
 #include "../score.h"
 
-class CSqlScore: public IScore
+// one long lived database connection with its prepared statements,
+// only used by one worker at a time
+class CSqlConnection
 {
-	CGameContext *m_pGameServer;
-	IServer *m_pServer;
+public:
+	enum
+	{
+		STMT_BEST_TIME=0,
+		STMT_LOAD_SCORE,
+		STMT_MAP_POINTS,
+		STMT_BIRTHDAY,
+		STMT_RANK,
+		STMT_TOP5,
+		STMT_TIMES,
+		STMT_TIMES_PLAYER,
+		STMT_POINTS,
+		STMT_TOP_POINTS,
+		STMT_TEAM_LOOKUP,
+		STMT_TEAM_UPDATE,
+		STMT_TEAM_RANK,
+		STMT_TEAM_TOP5,
+		STMT_MAP_VOTE,
+		STMT_MAP_INFO,
+		STMT_RANDOM_MAP,
+		STMT_RANDOM_MAP_STARS,
+		STMT_RANDOM_UNFINISHED,
+		STMT_RANDOM_UNFINISHED_STARS,
+		STMT_SAVE_EXISTS,
+		STMT_SAVE_INSERT,
+		STMT_SAVE_LOAD,
+		STMT_SAVE_DELETE,
+		NUM_STATEMENTS
+	};
+
+	// statements with a variable number of rows, prepared once per row count
+	enum
+	{
+		BATCH_FINISHED=0,
+		BATCH_SAVE_SCORE,
+		BATCH_ADD_POINTS,
+		BATCH_TEAMRACE,
+		NUM_BATCHES,
 
-	sql::Driver *m_pDriver;
+		MAX_BATCH_ROWS=16,
+	};
+
+private:
 	sql::Connection *m_pConnection;
 	sql::Statement *m_pStatement;
-	sql::ResultSet *m_pResults;
+	sql::PreparedStatement *m_apPrepared[NUM_STATEMENTS];
+	sql::PreparedStatement *m_aapBatches[NUM_BATCHES][MAX_BATCH_ROWS];
+	const char *m_pPrefix;
+
+public:
+	CSqlConnection();
+
+	bool Connect(const char *pIp, int Port, const char *pUser, const char *pPass, const char *pDatabase, const char *pPrefix, bool CreateDatabase);
+	void Disconnect();
+	bool Connected() const { return m_pConnection != 0; }
+
+	sql::Statement *Statement() { return m_pStatement; }
+	// prepares the statement on first use
+	sql::PreparedStatement *Prepared(int Index);
+	sql::PreparedStatement *PreparedBatch(int Index, int NumRows);
+
+	void BeginTransaction();
+	void Commit();
+	void Rollback();
+};
+
+// what a request wants to tell the players, sent from the tick thread
+class CSqlResult
+{
+public:
+	enum
+	{
+		MAX_LINES=16,
+		MAX_LINE_LENGTH=512,
+
+		CHAT_TARGET=0,
+		CHAT_ALL,
+		CHAT_TEAM,
+	};
+
+	struct CLine
+	{
+		int m_Mode;
+		int m_To;
+		char m_aText[MAX_LINE_LENGTH];
+	};
+
+	int m_NumLines;
+	CLine m_aLines[MAX_LINES];
+	// console command to execute, e.g. a map change
+	char m_aCommand[256];
+
+	CSqlResult() { m_NumLines = 0; m_aCommand[0] = 0; }
+
+	void AddLine(int Mode, int To, const char *pText);
+	// lines only for SkipClientID are left out, -1 sends all of them
+	void Send(CGameContext *pGameServer, int SkipClientID) const;
+};
+
+class CSqlScore;
+struct CSqlRequest;
+
+typedef void (*SQLFUNC)(CSqlConnection *pSql, CSqlRequest *pRequest);
+typedef void (*SQLDONEFUNC)(CSqlRequest *pRequest);
+
+// a queued database request. the worker fills the result, the tick thread
+// sends it and calls the done function
+struct CSqlRequest
+{
+	CJob m_Job;
+	CSqlScore *m_pSqlData;
+	SQLFUNC m_pfnFunc;
+	SQLDONEFUNC m_pfnDone;
+	int64 m_QueueTime;
+	bool m_Write; // changes the database, never dropped
+	int m_WriteSeq; // writes count up, a read holds the last write queued before it
+	bool m_Connected;
+	bool m_Failed;
+	CSqlResult m_Result;
+
+	// the player that asked, -1 for none. a slot can change hands before the request
+	// is done, then m_Stale is set for the done function and its lines are not sent
+	int m_ClientID;
+	char m_aClientName[MAX_NAME_LENGTH];
+	bool m_Stale;
+
+	CSqlRequest() { m_ClientID = -1; m_aClientName[0] = 0; m_Stale = false; }
+	virtual ~CSqlRequest() {}
+};
+
+// finishes of several ticks, written by a single request
+struct CSqlWriteBatch : CSqlRequest
+{
+	enum
+	{
+		MAX_SCORES=CSqlConnection::MAX_BATCH_ROWS,
+		MAX_TEAMS=8,
+	};
+
+	struct CScore
+	{
+		int m_ClientID;
+		char m_aName[MAX_NAME_LENGTH];
+		float m_Time;
+		float m_aCpTime[NUM_CHECKPOINTS];
+		int m_Points; // earned for the first finish, told in the tick thread
+	};
+
+	struct CTeamScore
+	{
+		int m_Size;
+		char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+		float m_Time;
+	};
+
+	int m_NumScores;
+	CScore m_aScores[MAX_SCORES];
+	int m_NumTeams;
+	CTeamScore m_aTeams[MAX_TEAMS];
+
+	CSqlWriteBatch() { m_NumScores = 0; m_NumTeams = 0; }
+};
+
+class CSqlScore: public IScore
+{
+	enum
+	{
+		MAX_CONNECTIONS=8,
+	};
+
+	CGameContext *m_pGameServer;
+	IServer *m_pServer;
 
 	// copy of config vars
 	const char* m_pDatabase;
@@ -28,9 +201,49 @@ class CSqlScore: public IScore
 	const char* m_pUser;
 	const char* m_pPass;
 	const char* m_pIp;
-	char m_aMap[64];
+	// the records store the map name cut after 32 characters
+	char m_aMapName[64];
 	int m_Port;
 
+	// every worker holds one connection while it runs a request
+	CSqlConnection m_aConnections[MAX_CONNECTIONS];
+	int m_NumConnections;
+	int m_aFreeConnections[MAX_CONNECTIONS];
+	int m_NumFreeConnections;
+	LOCK m_ConnectionLock;
+
+	CJobGroup m_Requests;
+	CJobPool m_Pool;
+	volatile bool m_Shutdown;
+	// a connect failed during shutdown, the remaining writes only go to the log
+	volatile bool m_Unreachable;
+	// reads dropped because the queue was full, handed back in OnTick
+	array<CSqlRequest *> m_lpRejected;
+
+	// statistics for sql_stats, written by the workers
+	LOCK m_StatsLock;
+	volatile unsigned m_NumRunning;
+	int m_NumDone;
+	int m_NumFailed;
+	int m_NumRejected;
+	int64 m_TotalWaitTime;
+	int64 m_MaxWaitTime;
+	int64 m_TotalRunTime;
+	int64 m_MaxRunTime;
+
+	// finishes wait here until sv_sql_write_delay passed, the batch is full or a read comes
+	CSqlWriteBatch *m_pWriteBatch;
+	int64 m_WriteBatchStart;
+
+	// a read is only queued once the writes before it are done, so /rank sees a finish
+	// right away. the workers take jobs out of order, a read must not wait on one of them
+	int m_LastWriteSeq;
+	array<int> m_lPendingWrites; // in queue order
+	array<CSqlRequest *> m_lpWaitingReads;
+
+	// savegame codes that are loaded right now, per requesting client
+	char m_aaLoadingCodes[MAX_CLIENTS][128];
+
 	CGameContext *GameServer()
 	{
 		return m_pGameServer;
@@ -40,32 +253,46 @@ class CSqlScore: public IScore
 		return m_pServer;
 	}
 
-	static void MapInfoThread(void *pUser);
-	static void MapVoteThread(void *pUser);
-	static void CheckBirthdayThread(void *pUser);
-	static void LoadScoreThread(void *pUser);
-	static void SaveScoreThread(void *pUser);
-	static void SaveTeamScoreThread(void *pUser);
-	static void ShowRankThread(void *pUser);
-	static void ShowTop5Thread(void *pUser);
-	static void ShowTeamRankThread(void *pUser);
-	static void ShowTeamTop5Thread(void *pUser);
-	static void ShowTimesThread(void *pUser);
-	static void ShowPointsThread(void *pUser);
-	static void ShowTopPointsThread(void *pUser);
-	static void RandomMapThread(void *pUser);
-	static void RandomUnfinishedMapThread(void *pUser);
-	static void SaveTeamThread(void *pUser);
-	static void LoadTeamThread(void *pUser);
+	CSqlConnection *AcquireConnection();
+	void ReleaseConnection(CSqlConnection *pSql);
+	bool ConnectDatabase(CSqlConnection *pSql);
 
-	void Init();
+	void AddRequest(CSqlRequest *pRequest, SQLFUNC pfnFunc, SQLDONEFUNC pfnDone = 0, bool Write = false);
+	CSqlWriteBatch *WriteBatch(bool Team);
+	void FlushWrites();
+	void QueueWaitingReads();
+	static int RunRequest(void *pUser);
+	static void RequestDone(CJob *pJob, void *pUser);
 
-	bool Connect();
-	void Disconnect();
+	static void MapInfoThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void MapVoteThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void MapVoteDone(CSqlRequest *pRequest);
+	static void CheckBirthdayThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void LoadScoreThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void LoadScoreDone(CSqlRequest *pRequest);
+	static void WriteBatchThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void WriteBatchDone(CSqlRequest *pRequest);
+	static void WriteScores(CSqlConnection *pSql, CSqlWriteBatch *pData);
+	static void WriteTeamScore(CSqlConnection *pSql, CSqlWriteBatch *pData, const CSqlWriteBatch::CTeamScore *pTeam);
+	static void ShowRankThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowTop5Thread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowTeamRankThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowTeamTop5Thread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowTimesThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowPointsThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void ShowTopPointsThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void RandomMapThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void RandomUnfinishedMapThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void SaveTeamThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void SaveTeamDone(CSqlRequest *pRequest);
+	static void LoadTeamThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void LoadTeamDone(CSqlRequest *pRequest);
+	static void DeleteSaveThread(CSqlConnection *pSql, CSqlRequest *pRequest);
+	static void DeleteSaveDone(CSqlRequest *pRequest);
+
+	void Init();
 
 	void FuzzyString(char *pString);
-	// anti SQL injection
-	void ClearString(char *pString, int size = 32);
 
 	void NormalizeMapname(char *pString);
 
@@ -74,6 +301,9 @@ public:
 	CSqlScore(CGameContext *pGameServer);
 	~CSqlScore();
 
+	virtual void OnTick();
+	virtual void PrintStats(IConsole *pConsole);
+
 	virtual void CheckBirthday(int ClientID);
 	virtual void LoadScore(int ClientID);
 	virtual void MapInfo(int ClientID, const char* MapName);
@@ -99,17 +329,18 @@ public:
 	static void agoTimeToString(int agoTime, char agoString[]);
 };
 
-struct CSqlMapData
+struct CSqlMapData : CSqlRequest
 {
-	CSqlScore *m_pSqlData;
-	int m_ClientID;
 	char m_aMap[128];
+
+	// filled by the worker
+	bool m_Found;
+	char m_aFoundMap[128];
+	char m_aServer[32];
 };
 
-struct CSqlScoreData
+struct CSqlScoreData : CSqlRequest
 {
-	CSqlScore *m_pSqlData;
-	int m_ClientID;
 #if defined(CONF_FAMILY_WINDOWS)
 	char m_aName[16]; // Don't edit this, or all your teeth will fall http://bugs.mysql.com/bug.php?id=50046
 #else
@@ -123,38 +354,23 @@ struct CSqlScoreData
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
 };
 
-struct CSqlTeamScoreData
-{
-	CSqlScore *m_pSqlData;
-	unsigned int m_Size;
-	int m_aClientIDs[MAX_CLIENTS];
-#if defined(CONF_FAMILY_WINDOWS)
-	char m_aNames[16][MAX_CLIENTS]; // Don't edit this, or all your teeth will fall http://bugs.mysql.com/bug.php?id=50046
-#else
-	char m_aNames[MAX_NAME_LENGTH * 2 - 1][MAX_CLIENTS];
-#endif
-
-	float m_Time;
-	float m_aCpCurrent[NUM_CHECKPOINTS];
-	int m_Num;
-	bool m_Search;
-	char m_aRequestingPlayer[MAX_NAME_LENGTH];
-};
-
-struct CSqlTeamSave
+struct CSqlTeamSave : CSqlRequest
 {
 	int m_Team;
-	int m_ClientID;
 	char m_Code[128];
+	char m_OriginalCode[32];
 	char m_Server[5];
-	CSqlScore *m_pSqlData;
+	char m_aMap[128];
+	bool m_Saved;
+	char m_TeamString[65536];
 };
 
-struct CSqlTeamLoad
+struct CSqlTeamLoad : CSqlRequest
 {
 	char m_Code[128];
-	int m_ClientID;
-	CSqlScore *m_pSqlData;
+	char m_aMap[128];
+	bool m_Found;
+	char m_Savegame[65536];
 };
 
 #endif
@@ -0,0 +1,81 @@
+/* (c) Shereef Marzouk. See "licence DDRace.txt" and the readme.txt in the root of the distribution for more information. */
+#include "sharedsnap.h"
+#include "entity.h"
+#include "gamecontext.h"
+
+#include <engine/shared/protocol.h>
+
+//////////////////////////////////////////////////
+// Shared snap
+//////////////////////////////////////////////////
+CSharedSnap::CSharedSnap()
+{
+	m_pGameServer = 0;
+	Clear();
+}
+
+void CSharedSnap::SetGameServer(CGameContext *pGameServer)
+{
+	m_pGameServer = pGameServer;
+}
+
+void *CSharedSnap::Create(CEntity *pEntity, int Type, int ID, int Size, int Flags, vec2 ClipPos, int64_t TeamMask)
+{
+	if(m_NumItems == MAX_ITEMS)
+		return 0;
+	if(m_CurrentOffset+Size >= MAX_DATASIZE)
+		return 0;
+
+	CItem *pItem = &m_aItems[m_NumItems];
+	pItem->m_pEntity = pEntity;
+	pItem->m_Type = Type;
+	pItem->m_ID = ID;
+	pItem->m_Offset = m_CurrentOffset;
+	pItem->m_Size = Size;
+	pItem->m_Flags = Flags;
+	pItem->m_ClipPos = ClipPos;
+	pItem->m_TeamMask = TeamMask;
+
+	void *p = &m_aData[m_CurrentOffset];
+	mem_zero(p, Size);
+	m_CurrentOffset += Size;
+	m_NumItems++;
+	return p;
+}
+
+void CSharedSnap::Clear()
+{
+	m_NumItems = 0;
+	m_CurrentOffset = 0;
+}
+
+void CSharedSnap::Truncate(int NumItems)
+{
+	if(NumItems >= m_NumItems)
+		return;
+	m_NumItems = NumItems;
+	m_CurrentOffset = NumItems ? m_aItems[NumItems-1].m_Offset+m_aItems[NumItems-1].m_Size : 0;
+}
+
+void CSharedSnap::Snap(int SnappingClient, int First, int Num)
+{
+	bool AntiPing = SnappingClient > -1 && GameServer()->m_apPlayers[SnappingClient]
+		&& GameServer()->m_apPlayers[SnappingClient]->m_ClientVersion >= VERSION_DDNET_ANTIPING_PROJECTILE;
+
+	for(int i = First; i < First+Num; i++)
+	{
+		CItem *pItem = &m_aItems[i];
+		if((pItem->m_Flags&FLAG_ANTIPING) && !AntiPing)
+			continue;
+		if((pItem->m_Flags&FLAG_NOANTIPING) && AntiPing)
+			continue;
+		if((pItem->m_Flags&FLAG_CLIP) && pItem->m_pEntity->NetworkClipped(SnappingClient, pItem->m_ClipPos))
+			continue;
+		if((pItem->m_Flags&FLAG_TEAMMASK) && !CmaskIsSet(pItem->m_TeamMask, SnappingClient))
+			continue;
+
+		void *d = GameServer()->Server()->SnapNewItem(pItem->m_Type, pItem->m_ID, pItem->m_Size);
+		if(d)
+			mem_copy(d, &m_aData[pItem->m_Offset], pItem->m_Size);
+	}
+}
@@ -0,0 +1,75 @@
+/* (c) Shereef Marzouk. See "licence DDRace.txt" and the readme.txt in the root of the distribution for more information. */
+#ifndef GAME_SERVER_SHAREDSNAP_H
+#define GAME_SERVER_SHAREDSNAP_H
+
+#include <base/vmath.h>
+
+#ifdef _MSC_VER
+typedef __int32 int32_t;
+typedef unsigned __int32 uint32_t;
+typedef __int64 int64_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+/*
+	Class: Shared snap
+		Holds the snapshot items of entities whose content does not
+		depend on the snapping client. They are built once per tick
+		and then only filtered for each client by network clipping,
+		team mask and client version.
+*/
+class CSharedSnap
+{
+public:
+	enum
+	{
+		FLAG_CLIP=1, // skip the item if the entity is network clipped at m_ClipPos
+		FLAG_TEAMMASK=2, // skip the item if the client is not set in m_TeamMask
+		FLAG_ANTIPING=4, // only for clients that support VERSION_DDNET_ANTIPING_PROJECTILE
+		FLAG_NOANTIPING=8, // only for clients that don't (and demos)
+	};
+
+private:
+	static const int MAX_ITEMS = 1024;
+	static const int MAX_DATASIZE = 1024*32;
+
+	struct CItem
+	{
+		class CEntity *m_pEntity;
+		int m_Type;
+		int m_ID;
+		int m_Offset;
+		int m_Size;
+		int m_Flags;
+		vec2 m_ClipPos;
+		int64_t m_TeamMask;
+	};
+
+	CItem m_aItems[MAX_ITEMS];
+	char m_aData[MAX_DATASIZE];
+
+	class CGameContext *m_pGameServer;
+
+	int m_CurrentOffset;
+	int m_NumItems;
+public:
+	CGameContext *GameServer() const { return m_pGameServer; }
+	void SetGameServer(CGameContext *pGameServer);
+
+	CSharedSnap();
+	void *Create(class CEntity *pEntity, int Type, int ID, int Size, int Flags = 0, vec2 ClipPos = vec2(0, 0), int64_t TeamMask = -1LL);
+	void Clear();
+	void Truncate(int NumItems);
+	int NumItems() const { return m_NumItems; }
+
+	/*
+		Function: Snap
+			Adds the items [First, First+Num) which are visible for
+			the snapping client to its snapshot.
+	*/
+	void Snap(int SnappingClient, int First, int Num);
+};
+
+#endif
@@ -170,6 +170,8 @@ MACRO_CONFIG_INT(SvRescueDelay, sv_rescue_delay, 5, 0, 1000, CFGFLAG_SERVER, "Nu
 	MACRO_CONFIG_INT(DbgDummies, dbg_dummies, 0, 0, 15, CFGFLAG_SERVER, "")
 #endif
 
+MACRO_CONFIG_INT(DbgSpatialIndex, dbg_spatial_index, 0, 0, 1, CFGFLAG_SERVER, "Check the results of the spatial entity index and the character buckets against a walk over all entities (slow)")
+
 MACRO_CONFIG_INT(DbgFocus, dbg_focus, 0, 0, 1, CFGFLAG_CLIENT, "")
 MACRO_CONFIG_INT(DbgTuning, dbg_tuning, 0, 0, 1, CFGFLAG_CLIENT, "")
 #endif
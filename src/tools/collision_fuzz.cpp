@@ -0,0 +1,344 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdlib.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <base/vmath.h>
+
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <engine/shared/config.h>
+#include <engine/shared/datafile.h>
+
+#include <game/collision.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+// differential fuzz of the CCollision line intersections against the pixel stepping they replaced.
+// random maps with solid, death, nohook, nolaser, through and tele tiles are written to
+// collision_fuzz.map in the save directory, maps given on the command line are checked as well
+
+enum
+{
+	NUM_RANDOM_MAPS=200,
+	NUM_RAYS=3000,
+};
+
+static IStorage *s_pStorage;
+static IEngineMap *s_pEngineMap;
+static IKernel *s_pKernel;
+static long s_NumChecks;
+static long s_NumFailures;
+
+// the old implementations, one sample per pixel along the ray
+
+static int RefIntersectLine(CCollision *pCol, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr, int Tele, bool AllowThrough)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance+1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	if(AllowThrough)
+		ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i/(float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		if(Tele)
+		{
+			int Index = clamp(iy/32, 0, pCol->GetHeight()-1)*pCol->GetWidth()+clamp(ix/32, 0, pCol->GetWidth()-1);
+			if(Tele == 1)
+				*pTeleNr = g_Config.m_SvOldTeleportHook ? pCol->IsTeleport(Index) : pCol->IsTeleportHook(Index);
+			else
+				*pTeleNr = g_Config.m_SvOldTeleportWeapons ? pCol->IsTeleport(Index) : pCol->IsTeleportWeapon(Index);
+			if(*pTeleNr)
+			{
+				*pOutCollision = Pos;
+				*pOutBeforeCollision = Last;
+				return CCollision::COLFLAG_TELE;
+			}
+		}
+
+		if(pCol->CheckPoint(ix, iy) && !(AllowThrough && pCol->IsThrough(ix+dx, iy+dy)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return pCol->GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectNoLaser(CCollision *pCol, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(float f = 0; f < d; f++)
+	{
+		vec2 Pos = mix(Pos0, Pos1, f/d);
+		int Nx = clamp(round_to_int(Pos.x)/32, 0, pCol->GetWidth()-1);
+		int Ny = clamp(round_to_int(Pos.y)/32, 0, pCol->GetHeight()-1);
+		int Index = pCol->GetIndex(Nx, Ny);
+		if(Index == CCollision::COLFLAG_SOLID || Index == (CCollision::COLFLAG_SOLID|CCollision::COLFLAG_NOHOOK) || Index == TILE_NOLASER || pCol->GetFIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(pCol->GetFIndex(Nx, Ny) == TILE_NOLASER)
+				return pCol->GetFCollisionAt(Pos.x, Pos.y);
+			return pCol->GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectNoLaserNW(CCollision *pCol, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(float f = 0; f < d; f++)
+	{
+		vec2 Pos = mix(Pos0, Pos1, f/d);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(pCol->IsNoLaser(ix, iy) || pCol->IsFNoLaser(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(pCol->IsNoLaser(ix, iy))
+				return pCol->GetCollisionAt(Pos.x, Pos.y);
+			return pCol->GetFCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int RefIntersectAir(CCollision *pCol, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(float f = 0; f < d; f++)
+	{
+		vec2 Pos = mix(Pos0, Pos1, f/d);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(pCol->IsSolid(ix, iy) || (!pCol->GetTile(ix, iy) && !pCol->GetFTile(ix, iy)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(!pCol->GetTile(ix, iy) && !pCol->GetFTile(ix, iy))
+				return -1;
+			if(!pCol->GetTile(ix, iy))
+				return pCol->GetTile(ix, iy);
+			return pCol->GetFTile(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static float RandomFloat(float Min, float Max)
+{
+	return Min + (Max-Min)*(rand()/(float)RAND_MAX);
+}
+
+static void Check(const char *pName, const char *pMap, vec2 Pos0, vec2 Pos1, int Result, int RefResult, vec2 Col, vec2 RefCol, vec2 Before, vec2 RefBefore, int TeleNr, int RefTeleNr)
+{
+	s_NumChecks++;
+	if(Result == RefResult && Col == RefCol && Before == RefBefore && TeleNr == RefTeleNr)
+		return;
+	if(s_NumFailures++ < 10)
+		dbg_msg("collision_fuzz", "%s mismatch on '%s' (%f %f)-(%f %f): %d at (%f %f), expected %d at (%f %f)", pName, pMap,
+			Pos0.x, Pos0.y, Pos1.x, Pos1.y, Result, Col.x, Col.y, RefResult, RefCol.x, RefCol.y);
+}
+
+static void FuzzRays(CCollision *pCol, const char *pMap)
+{
+	float Width = pCol->GetWidth()*32.0f;
+	float Height = pCol->GetHeight()*32.0f;
+	for(int r = 0; r < NUM_RAYS; r++)
+	{
+		// long rays, short rays, straight rays and rays starting right at a tile corner
+		vec2 Pos0(RandomFloat(-100, Width+100), RandomFloat(-100, Height+100));
+		vec2 Pos1;
+		switch(rand()%4)
+		{
+		case 0: Pos1 = vec2(RandomFloat(-100, Width+100), RandomFloat(-100, Height+100)); break;
+		case 1: Pos1 = Pos0 + vec2(RandomFloat(-50, 50), RandomFloat(-50, 50)); break;
+		case 2: Pos1 = vec2(Pos0.x, RandomFloat(-100, Height+100)); break;
+		default: Pos1 = vec2(RandomFloat(-100, Width+100), Pos0.y);
+		}
+		if(rand()%20 == 0)
+			Pos0 = vec2(round_to_int(Pos0.x/32)*32-0.5f, round_to_int(Pos0.y/32)*32+31.5f);
+		bool Through = rand()%2;
+		g_Config.m_SvOldTeleportHook = rand()%2;
+		g_Config.m_SvOldTeleportWeapons = rand()%2;
+
+		vec2 Col, Before, RefCol, RefBefore;
+		int TeleNr = 0, RefTeleNr = 0;
+		int Result = pCol->IntersectLine(Pos0, Pos1, &Col, &Before, Through);
+		int RefResult = RefIntersectLine(pCol, Pos0, Pos1, &RefCol, &RefBefore, &RefTeleNr, 0, Through);
+		Check("IntersectLine", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+
+		Result = pCol->IntersectLineTeleHook(Pos0, Pos1, &Col, &Before, &TeleNr, Through);
+		RefResult = RefIntersectLine(pCol, Pos0, Pos1, &RefCol, &RefBefore, &RefTeleNr, 1, Through);
+		Check("IntersectLineTeleHook", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+
+		Result = pCol->IntersectLineTeleWeapon(Pos0, Pos1, &Col, &Before, &TeleNr, Through);
+		RefResult = RefIntersectLine(pCol, Pos0, Pos1, &RefCol, &RefBefore, &RefTeleNr, 2, Through);
+		Check("IntersectLineTeleWeapon", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+
+		TeleNr = RefTeleNr = 0;
+		Result = pCol->IntersectNoLaser(Pos0, Pos1, &Col, &Before);
+		RefResult = RefIntersectNoLaser(pCol, Pos0, Pos1, &RefCol, &RefBefore);
+		Check("IntersectNoLaser", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+
+		Result = pCol->IntersectNoLaserNW(Pos0, Pos1, &Col, &Before);
+		RefResult = RefIntersectNoLaserNW(pCol, Pos0, Pos1, &RefCol, &RefBefore);
+		Check("IntersectNoLaserNW", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+
+		Result = pCol->IntersectAir(Pos0, Pos1, &Col, &Before);
+		RefResult = RefIntersectAir(pCol, Pos0, Pos1, &RefCol, &RefBefore);
+		Check("IntersectAir", pMap, Pos0, Pos1, Result, RefResult, Col, RefCol, Before, RefBefore, TeleNr, RefTeleNr);
+	}
+}
+
+static void FuzzMap(const char *pFilename)
+{
+	if(!s_pEngineMap->Load(pFilename))
+	{
+		dbg_msg("collision_fuzz", "failed to load '%s'", pFilename);
+		return;
+	}
+
+	CLayers Layers;
+	CCollision Collision;
+	Layers.Init(s_pKernel);
+	Collision.Init(&Layers);
+	FuzzRays(&Collision, pFilename);
+	Collision.Dest();
+	s_pEngineMap->Unload();
+}
+
+static void AddTilemap(CDataFileWriter *pWriter, int ID, int Flags, int Width, int Height, void *pData, int DataSize)
+{
+	CMapItemLayerTilemap Item;
+	mem_zero(&Item, sizeof(Item));
+	Item.m_Layer.m_Type = LAYERTYPE_TILES;
+	Item.m_Version = 3;
+	Item.m_Width = Width;
+	Item.m_Height = Height;
+	Item.m_Flags = Flags;
+	Item.m_Image = -1;
+	Item.m_Data = pWriter->AddData(DataSize, pData);
+	Item.m_Tele = Flags&TILESLAYERFLAG_TELE ? Item.m_Data : -1;
+	Item.m_Speedup = -1;
+	Item.m_Front = Flags&TILESLAYERFLAG_FRONT ? Item.m_Data : -1;
+	Item.m_Switch = -1;
+	Item.m_Tune = -1;
+	pWriter->AddItem(MAPITEMTYPE_LAYER, ID, sizeof(Item), &Item);
+}
+
+static bool WriteRandomMap(const char *pFilename)
+{
+	int Width = 2+rand()%60;
+	int Height = 2+rand()%60;
+	bool Front = rand()%2;
+	bool Tele = rand()%2;
+	CTile *pTiles = new CTile[Width*Height];
+	CTile *pFront = new CTile[Width*Height];
+	CTeleTile *pTele = new CTeleTile[Width*Height];
+	mem_zero(pTiles, sizeof(CTile)*Width*Height);
+	mem_zero(pFront, sizeof(CTile)*Width*Height);
+	mem_zero(pTele, sizeof(CTeleTile)*Width*Height);
+
+	static const int s_aTiles[] = {TILE_AIR, TILE_SOLID, TILE_DEATH, TILE_NOHOOK, TILE_NOLASER, TILE_THROUGH, TILE_FREEZE, TILE_BEGIN, TILE_END};
+	static const int s_aTeleTypes[] = {TILE_TELEIN, TILE_TELEINWEAPON, TILE_TELEINHOOK};
+	int Density = rand()%40;
+	for(int i = 0; i < Width*Height; i++)
+	{
+		if(rand()%100 < Density)
+			pTiles[i].m_Index = s_aTiles[rand()%9];
+		if(rand()%100 < Density/3)
+			pFront[i].m_Index = s_aTiles[rand()%9];
+		if(rand()%100 < Density/4)
+		{
+			pTele[i].m_Type = s_aTeleTypes[rand()%3];
+			pTele[i].m_Number = 1+rand()%5;
+		}
+	}
+
+	CDataFileWriter Writer;
+	bool Ok = Writer.Open(s_pStorage, pFilename);
+	if(Ok)
+	{
+		int NumLayers = 1;
+		AddTilemap(&Writer, 0, TILESLAYERFLAG_GAME, Width, Height, pTiles, sizeof(CTile)*Width*Height);
+		if(Front)
+			AddTilemap(&Writer, NumLayers++, TILESLAYERFLAG_FRONT, Width, Height, pFront, sizeof(CTile)*Width*Height);
+		if(Tele)
+			AddTilemap(&Writer, NumLayers++, TILESLAYERFLAG_TELE, Width, Height, pTele, sizeof(CTeleTile)*Width*Height);
+
+		CMapItemGroup Group;
+		mem_zero(&Group, sizeof(Group));
+		Group.m_Version = CMapItemGroup::CURRENT_VERSION;
+		Group.m_ParallaxX = 100;
+		Group.m_ParallaxY = 100;
+		Group.m_NumLayers = NumLayers;
+		Writer.AddItem(MAPITEMTYPE_GROUP, 0, sizeof(Group), &Group);
+		Writer.Finish();
+	}
+
+	delete[] pTiles;
+	delete[] pFront;
+	delete[] pTele;
+	return Ok;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	s_pKernel = IKernel::Create();
+	s_pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	s_pEngineMap = CreateEngineMap();
+
+	bool RegisterFail = !s_pKernel->RegisterInterface(s_pStorage);
+	RegisterFail |= !s_pKernel->RegisterInterface(static_cast<IEngineMap*>(s_pEngineMap));
+	RegisterFail |= !s_pKernel->RegisterInterface(static_cast<IMap*>(s_pEngineMap));
+	if(RegisterFail)
+		return -1;
+
+	srand(1);
+	s_NumChecks = 0;
+	s_NumFailures = 0;
+	for(int i = 1; i < argc; i++)
+		FuzzMap(argv[i]);
+	for(int i = 0; i < NUM_RANDOM_MAPS; i++)
+	{
+		if(!WriteRandomMap("collision_fuzz.map"))
+		{
+			dbg_msg("collision_fuzz", "failed to write 'collision_fuzz.map'");
+			return -1;
+		}
+		FuzzMap("collision_fuzz.map");
+	}
+	s_pStorage->RemoveFile("collision_fuzz.map", IStorage::TYPE_SAVE);
+
+	dbg_msg("collision_fuzz", "%ld checks, %ld failures", s_NumChecks, s_NumFailures);
+	return s_NumFailures ? -1 : 0;
+}
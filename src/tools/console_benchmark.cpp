@@ -0,0 +1,115 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/shared/config.h>
+#include <engine/shared/linereader.h>
+
+// measures how long a server console takes to execute a config (autoexec_server.cfg, a vote list)
+// the commands of the config that aren't config variables are registered as dummies, filler
+// commands stand in for the game and rcon commands a real server registers next to them
+
+enum
+{
+	MAX_LINES=1<<16,
+	NUM_FILLER_COMMANDS=300,
+};
+
+static char *s_apLines[MAX_LINES];
+static int s_NumLines;
+static int s_NumExecuted;
+
+static void ConDummy(IConsole::IResult *pResult, void *pUserData)
+{
+	s_NumExecuted++;
+}
+
+static void LoadConfig(IConsole *pConsole, const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("console_benchmark", "failed to open '%s'", pFilename);
+		return;
+	}
+
+	CLineReader LineReader;
+	LineReader.Init(File);
+	char *pLine;
+	while((pLine = LineReader.Get()) && s_NumLines < MAX_LINES)
+	{
+		while(*pLine == ' ' || *pLine == '\t')
+			pLine++;
+		if(!*pLine || *pLine == '#')
+			continue;
+
+		// the command is the first word
+		int Length = 0;
+		while(pLine[Length] && pLine[Length] != ' ' && pLine[Length] != ';')
+			Length++;
+		char *pName = (char *)mem_alloc(Length+1, 1);
+		str_copy(pName, pLine, Length+1);
+		if(pConsole->GetCommandInfo(pName, CFGFLAG_SERVER, false))
+			mem_free(pName);
+		else
+			pConsole->Register(pName, "?r", CFGFLAG_SERVER, ConDummy, 0, "");
+
+		int Size = str_length(pLine)+1;
+		s_apLines[s_NumLines] = (char *)mem_alloc(Size, 1);
+		str_copy(s_apLines[s_NumLines], pLine, Size);
+		s_NumLines++;
+	}
+	io_close(File);
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	if(argc < 2)
+	{
+		dbg_msg("usage", "%s <config> [config ...]", argv[0]);
+		return -1;
+	}
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER);
+	for(int i = 0; i < NUM_FILLER_COMMANDS; i++)
+	{
+		char *pName = (char *)mem_alloc(32, 1);
+		str_format(pName, 32, "filler_command_%d", i);
+		pConsole->Register(pName, "?r", CFGFLAG_SERVER, ConDummy, 0, "");
+	}
+
+	s_NumLines = 0;
+	for(int i = 1; i < argc; i++)
+		LoadConfig(pConsole, argv[i]);
+	if(!s_NumLines)
+	{
+		dbg_msg("console_benchmark", "no commands found");
+		return -1;
+	}
+
+	int NumCommands = 0;
+	for(const IConsole::CCommandInfo *pInfo = pConsole->FirstCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER); pInfo; pInfo = pInfo->NextCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER))
+		NumCommands++;
+
+	// execute the config over and over, like rcon does with single lines
+	int Rounds = max(1, 1000000/s_NumLines);
+	s_NumExecuted = 0;
+	int64 Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < s_NumLines; i++)
+			pConsole->ExecuteLine(s_apLines[i]);
+	int64 Time = time_get()-Start;
+
+	double Seconds = (double)Time/time_freq();
+	dbg_msg("console_benchmark", "%d lines, %d commands registered, %d rounds, %d dummy calls",
+		s_NumLines, NumCommands, Rounds, s_NumExecuted);
+	dbg_msg("console_benchmark", "%.3f ms per config, %.2f us per line",
+		Seconds*1000.0/Rounds, Seconds*1000000.0/((double)Rounds*s_NumLines));
+
+	for(int i = 0; i < s_NumLines; i++)
+		mem_free(s_apLines[i]);
+	delete pConsole;
+	return 0;
+}
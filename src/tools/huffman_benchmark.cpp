@@ -0,0 +1,135 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/network.h>
+
+// measures huffman throughput on network dumps (dbg_dumpnetwork, dumps/network_*.txt)
+// and checks that every logged payload survives a compress/decompress round trip.
+// the dumps hold records of [type][size][data], type 1 is the unpacked chunk data
+
+enum
+{
+	MAX_PACKETS=1<<14,
+};
+
+struct CPacket
+{
+	int m_Size;
+	unsigned char m_aData[NET_MAX_PAYLOAD];
+	int m_CompressedSize;
+	unsigned char m_aCompressed[NET_MAX_PACKETSIZE];
+};
+
+static CPacket *s_pPackets;
+static int s_NumPackets;
+
+static void LoadDump(const char *pFilename)
+{
+	IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+	if(!File)
+	{
+		dbg_msg("huffman_benchmark", "failed to open '%s'", pFilename);
+		return;
+	}
+
+	int Type, Size;
+	unsigned char aBuf[NET_MAX_PACKETSIZE];
+	while(io_read(File, &Type, sizeof(Type)) == sizeof(Type) && io_read(File, &Size, sizeof(Size)) == sizeof(Size))
+	{
+		if(Size < 0 || Size > (int)sizeof(aBuf) || io_read(File, aBuf, Size) != (unsigned)Size)
+			break;
+		if(Type != 1 || Size > NET_MAX_PAYLOAD || s_NumPackets == MAX_PACKETS)
+			continue;
+		s_pPackets[s_NumPackets].m_Size = Size;
+		mem_copy(s_pPackets[s_NumPackets].m_aData, aBuf, Size);
+		s_NumPackets++;
+	}
+	io_close(File);
+}
+
+static bool CheckRoundTrip()
+{
+	unsigned char aCompressed[NET_MAX_PACKETSIZE];
+	unsigned char aDecompressed[NET_MAX_PAYLOAD];
+	int Failed = 0;
+	for(int i = 0; i < s_NumPackets; i++)
+	{
+		CPacket *pPacket = &s_pPackets[i];
+		int Size = CNetBase::Compress(pPacket->m_aData, pPacket->m_Size, aCompressed, sizeof(aCompressed));
+		if(Size < 0)
+			continue;
+
+		int Result = CNetBase::Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed));
+		if(Result != pPacket->m_Size || mem_comp(aDecompressed, pPacket->m_aData, Result) != 0)
+		{
+			dbg_msg("huffman_benchmark", "packet %d (%d bytes) doesn't survive the round trip", i, pPacket->m_Size);
+			Failed++;
+		}
+
+		// truncated and damaged streams must fail or decode within bounds
+		CNetBase::Decompress(aCompressed, Size/2, aDecompressed, sizeof(aDecompressed));
+		aCompressed[i%Size] ^= 1<<(i&7);
+		CNetBase::Decompress(aCompressed, Size, aDecompressed, pPacket->m_Size);
+	}
+	return Failed == 0;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	if(argc < 2)
+	{
+		dbg_msg("usage", "%s <network dump> [network dump ...]", argv[0]);
+		return -1;
+	}
+
+	CNetBase::Init();
+	s_pPackets = new CPacket[MAX_PACKETS];
+	s_NumPackets = 0;
+	for(int i = 1; i < argc; i++)
+		LoadDump(argv[i]);
+	if(!s_NumPackets)
+	{
+		dbg_msg("huffman_benchmark", "no payloads found");
+		delete[] s_pPackets;
+		return -1;
+	}
+
+	bool Ok = CheckRoundTrip();
+
+	// compress everything once, then time both directions over several rounds
+	int64 TotalSize = 0, TotalCompressed = 0;
+	for(int i = 0; i < s_NumPackets; i++)
+	{
+		CPacket *pPacket = &s_pPackets[i];
+		pPacket->m_CompressedSize = CNetBase::Compress(pPacket->m_aData, pPacket->m_Size, pPacket->m_aCompressed, sizeof(pPacket->m_aCompressed));
+		TotalSize += pPacket->m_Size;
+		TotalCompressed += max(pPacket->m_CompressedSize, 0);
+	}
+
+	int Rounds = max(1, (int)(64*1024*1024/max(TotalSize, (int64)1)));
+	unsigned char aOutput[NET_MAX_PACKETSIZE];
+
+	int64 Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < s_NumPackets; i++)
+			CNetBase::Compress(s_pPackets[i].m_aData, s_pPackets[i].m_Size, aOutput, sizeof(aOutput));
+	int64 CompressTime = time_get()-Start;
+
+	Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < s_NumPackets; i++)
+			if(s_pPackets[i].m_CompressedSize > 0)
+				CNetBase::Decompress(s_pPackets[i].m_aCompressed, s_pPackets[i].m_CompressedSize, aOutput, sizeof(aOutput));
+	int64 DecompressTime = time_get()-Start;
+
+	double MBytes = TotalSize*(double)Rounds/(1024*1024);
+	dbg_msg("huffman_benchmark", "%d payloads, %d bytes, %.1f%% after compression, round trip %s",
+		s_NumPackets, (int)TotalSize, TotalCompressed*100.0/TotalSize, Ok ? "ok" : "FAILED");
+	dbg_msg("huffman_benchmark", "compress %.1f MB/s, decompress %.1f MB/s",
+		MBytes/((double)CompressTime/time_freq()), MBytes/((double)DecompressTime/time_freq()));
+
+	delete[] s_pPackets;
+	return Ok ? 0 : -1;
+}
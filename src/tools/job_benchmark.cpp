@@ -0,0 +1,98 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+#include <engine/shared/jobs.h>
+
+// measures the job pool: how long an idle worker takes to pick up a job,
+// how many small jobs go through per second and the done callbacks
+
+enum
+{
+	NUM_LATENCY_SAMPLES=200,
+	NUM_THROUGHPUT_JOBS=100000,
+	NUM_CALLBACK_JOBS=1000,
+};
+
+struct CLatencyJob
+{
+	CJob m_Job;
+	volatile int64 m_StartTime;
+};
+
+static volatile unsigned s_Counter;
+static int s_NumCallbacks;
+
+static int LatencyJob(void *pUser)
+{
+	((CLatencyJob *)pUser)->m_StartTime = time_get();
+	return 0;
+}
+
+static int CountJob(void *pUser)
+{
+	// a bit of work, about what a small snapshot delta costs
+	unsigned Hash = (unsigned)(size_t)pUser;
+	for(int i = 0; i < 256; i++)
+		Hash = Hash*31+i;
+	atomic_inc(&s_Counter);
+	return Hash&1;
+}
+
+static void CountDone(CJob *pJob, void *pUser)
+{
+	s_NumCallbacks++;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	int NumThreads = argc > 1 ? max(str_toint(argv[1]), 1) : 2;
+
+	CJobGroup Group;
+	CJobPool Pool;
+	Pool.Init(NumThreads);
+
+	// latency: the workers are idle before every job
+	CLatencyJob LatencyJob_;
+	int64 TotalLatency = 0, MaxLatency = 0;
+	for(int i = 0; i < NUM_LATENCY_SAMPLES; i++)
+	{
+		thread_sleep(2);
+		int64 AddTime = time_get();
+		Pool.Add(&LatencyJob_.m_Job, LatencyJob, &LatencyJob_, &Group);
+		Group.Wait();
+		int64 Latency = LatencyJob_.m_StartTime-AddTime;
+		TotalLatency += Latency;
+		MaxLatency = max(MaxLatency, Latency);
+	}
+	dbg_msg("job_benchmark", "%d threads, pickup latency %.3f ms average, %.3f ms max", NumThreads,
+		TotalLatency*1000.0/time_freq()/NUM_LATENCY_SAMPLES, MaxLatency*1000.0/time_freq());
+
+	// throughput: many small jobs in one group
+	CJob *pJobs = new CJob[NUM_THROUGHPUT_JOBS];
+	s_Counter = 0;
+	int64 Start = time_get();
+	for(int i = 0; i < NUM_THROUGHPUT_JOBS; i++)
+		Pool.Add(&pJobs[i], CountJob, (void *)(size_t)i, &Group);
+	Group.Wait();
+	int64 Time = time_get()-Start;
+	dbg_msg("job_benchmark", "%d jobs in %.3f ms, %.0f jobs/s%s", NUM_THROUGHPUT_JOBS, Time*1000.0/time_freq(),
+		NUM_THROUGHPUT_JOBS/((double)Time/time_freq()), s_Counter == NUM_THROUGHPUT_JOBS ? "" : ", jobs MISSING");
+
+	// done callbacks come back in this thread
+	s_NumCallbacks = 0;
+	for(int i = 0; i < NUM_CALLBACK_JOBS; i++)
+		Pool.Add(&pJobs[i], CountJob, (void *)(size_t)i, &Group, CountDone);
+	Group.Wait();
+	Pool.RunCallbacks();
+	int NumDone = 0;
+	for(int i = 0; i < NUM_CALLBACK_JOBS; i++)
+		if(pJobs[i].Status() == CJob::STATE_DONE)
+			NumDone++;
+	dbg_msg("job_benchmark", "%d/%d callbacks, %d jobs done", s_NumCallbacks, NUM_CALLBACK_JOBS, NumDone);
+
+	delete[] pJobs;
+	return s_Counter == NUM_THROUGHPUT_JOBS+NUM_CALLBACK_JOBS && s_NumCallbacks == NUM_CALLBACK_JOBS ? 0 : -1;
+}
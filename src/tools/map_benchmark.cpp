@@ -0,0 +1,108 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/datafile.h>
+#include <engine/storage.h>
+#include <game/mapitems.h>
+
+// measures open-to-ready time of every map in a directory: open the datafile,
+// walk groups and layers like CLayers::Init, look up every item by type and
+// id and decompress the game layers
+
+static IStorage *s_pStorage;
+static const char *s_pDir;
+static int s_Rounds;
+static int64 s_TotalTime;
+static int64 s_TotalLookupTime;
+static int s_NumMaps;
+
+static bool LoadMap(const char *pFilename, int64 *pLookupTime)
+{
+	CDataFileReader Map;
+	if(!Map.Open(s_pStorage, pFilename, IStorage::TYPE_ALL))
+		return false;
+
+	int GroupStart, GroupNum, LayerStart, LayerNum;
+	Map.GetType(MAPITEMTYPE_GROUP, &GroupStart, &GroupNum);
+	Map.GetType(MAPITEMTYPE_LAYER, &LayerStart, &LayerNum);
+	for(int g = 0; g < GroupNum; g++)
+	{
+		CMapItemGroup *pGroup = (CMapItemGroup *)Map.GetItem(GroupStart+g, 0, 0);
+		for(int l = 0; l < pGroup->m_NumLayers; l++)
+		{
+			int Index = LayerStart+pGroup->m_StartLayer+l;
+			if(pGroup->m_StartLayer+l >= LayerNum)
+				break;
+			CMapItemLayer *pLayer = (CMapItemLayer *)Map.GetItem(Index, 0, 0);
+			if(pLayer->m_Type != LAYERTYPE_TILES)
+				continue;
+			CMapItemLayerTilemap *pTilemap = (CMapItemLayerTilemap *)pLayer;
+			if(pTilemap->m_Flags&TILESLAYERFLAG_GAME)
+				Map.GetData(pTilemap->m_Data);
+		}
+	}
+
+	// every item through FindItem, this is what envelope and info lookups do
+	int64 LookupStart = time_get();
+	for(int i = 0; i < Map.NumItems(); i++)
+	{
+		int Type, ID;
+		Map.GetItem(i, &Type, &ID);
+		void *pItem = Map.FindItem(Type, ID);
+		dbg_assert(pItem != 0, "item not found");
+	}
+	*pLookupTime += time_get()-LookupStart;
+
+	Map.Close();
+	return true;
+}
+
+static int ListMapCallback(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	int Length = str_length(pName);
+	if(IsDir || Length < 4 || str_comp(pName+Length-4, ".map") != 0)
+		return 0;
+
+	char aFilename[1024];
+	str_format(aFilename, sizeof(aFilename), "%s/%s", s_pDir, pName);
+
+	int64 LookupTime = 0;
+	int64 Start = time_get();
+	for(int i = 0; i < s_Rounds; i++)
+	{
+		if(!LoadMap(aFilename, &LookupTime))
+		{
+			dbg_msg("map_benchmark", "failed to load '%s'", aFilename);
+			return 0;
+		}
+	}
+	int64 Time = time_get()-Start;
+
+	dbg_msg("map_benchmark", "%s: %.3f ms to ready, %.3f ms in lookups", pName,
+		Time*1000.0/time_freq()/s_Rounds, LookupTime*1000.0/time_freq()/s_Rounds);
+	s_TotalTime += Time;
+	s_TotalLookupTime += LookupTime;
+	s_NumMaps++;
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	dbg_logger_stdout();
+	s_pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+	if(!s_pStorage || argc < 2 || argc > 3)
+	{
+		dbg_msg("usage", "%s <map directory> [rounds]", argv[0]);
+		return -1;
+	}
+
+	s_pDir = argv[1];
+	s_Rounds = argc == 3 ? max(str_toint(argv[2]), 1) : 20;
+	fs_listdir(s_pDir, ListMapCallback, 0, 0);
+
+	if(s_NumMaps)
+		dbg_msg("map_benchmark", "%d maps: %.3f ms to ready, %.3f ms in lookups on average", s_NumMaps,
+			s_TotalTime*1000.0/time_freq()/s_Rounds/s_NumMaps, s_TotalLookupTime*1000.0/time_freq()/s_Rounds/s_NumMaps);
+	return 0;
+}
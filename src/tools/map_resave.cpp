@@ -1,27 +1,32 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 #include <engine/shared/datafile.h>
+#include <engine/shared/jobs.h>
 #include <engine/storage.h>
 
-int main(int argc, const char **argv)
+enum
+{
+	NUM_THREADS=4,
+	MAX_MAPS=1024,
+};
+
+static IStorage *s_pStorage;
+static CJobPool s_CompressPool;
+
+static bool ResaveMap(const char *pSrc, const char *pDst)
 {
-	IStorage *pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
 	int Index, ID = 0, Type = 0, Size;
 	void *pPtr;
-	char aFileName[1024];
 	CDataFileReader DataFile;
 	CDataFileWriter df;
 
-	if(!pStorage || argc != 3)
-		return -1;
-
-	str_format(aFileName, sizeof(aFileName), "%s", argv[2]);
-
-	if(!DataFile.Open(pStorage, argv[1], IStorage::TYPE_ALL))
-		return -1;
-	if(!df.Open(pStorage, aFileName))
-		return -1;
+	if(!DataFile.Open(s_pStorage, pSrc, IStorage::TYPE_ALL))
+		return false;
+	if(!df.Open(s_pStorage, pDst))
+		return false;
+	df.SetJobPool(&s_CompressPool);
 
 	// add all items
 	for(Index = 0; Index < DataFile.NumItems(); Index++)
@@ -35,11 +40,95 @@ int main(int argc, const char **argv)
 	for(Index = 0; Index < DataFile.NumData(); Index++)
 	{
 		pPtr = DataFile.GetData(Index);
-		Size = DataFile.GetDataSize(Index);
+		Size = DataFile.GetUncompressedDataSize(Index);
 		df.AddData(Size, pPtr);
+		DataFile.UnloadData(Index);
 	}
 
 	DataFile.Close();
 	df.Finish();
+	return true;
+}
+
+// batch mode: every map of a directory is a job on its own
+struct CResaveJob
+{
+	char m_aSrc[1024];
+	char m_aDst[1024];
+	CJob m_Job;
+};
+
+static CResaveJob *s_pJobs;
+static int s_NumJobs;
+static const char *s_pSrcDir;
+static const char *s_pDstDir;
+
+static int ResaveJob(void *pUser)
+{
+	CResaveJob *pJob = (CResaveJob *)pUser;
+	if(!ResaveMap(pJob->m_aSrc, pJob->m_aDst))
+	{
+		dbg_msg("map_resave", "failed to resave '%s'", pJob->m_aSrc);
+		return -1;
+	}
 	return 0;
 }
+
+static int ListMapCallback(const char *pName, int IsDir, int DirType, void *pUser)
+{
+	int Length = str_length(pName);
+	if(IsDir || Length < 4 || str_comp(pName+Length-4, ".map") != 0)
+		return 0;
+	if(s_NumJobs == MAX_MAPS)
+	{
+		dbg_msg("map_resave", "too many maps, skipping '%s'", pName);
+		return 0;
+	}
+
+	CResaveJob *pJob = &s_pJobs[s_NumJobs++];
+	str_format(pJob->m_aSrc, sizeof(pJob->m_aSrc), "%s/%s", s_pSrcDir, pName);
+	str_format(pJob->m_aDst, sizeof(pJob->m_aDst), "%s/%s", s_pDstDir, pName);
+	return 0;
+}
+
+int main(int argc, const char **argv)
+{
+	s_pStorage = CreateStorage("Teeworlds", IStorage::STORAGETYPE_BASIC, argc, argv);
+
+	if(!s_pStorage || (argc != 3 && argc != 4))
+	{
+		dbg_msg("usage", "%s <source map> <destination map>", argv[0]);
+		dbg_msg("usage", "%s <source directory> <destination directory> [threads]", argv[0]);
+		return -1;
+	}
+
+	int NumThreads = argc == 4 ? max(str_toint(argv[3]), 1) : (int)NUM_THREADS;
+	s_CompressPool.Init(NumThreads);
+
+	if(!fs_is_dir(argv[1]))
+		return ResaveMap(argv[1], argv[2]) ? 0 : -1;
+
+	// resave all maps of the directory, several at once
+	s_pSrcDir = argv[1];
+	s_pDstDir = argv[2];
+	s_pJobs = new CResaveJob[MAX_MAPS];
+	s_NumJobs = 0;
+	fs_listdir(s_pSrcDir, ListMapCallback, 0, 0);
+	s_pStorage->CreateFolder(s_pDstDir, IStorage::TYPE_SAVE);
+
+	CJobGroup MapJobs;
+	CJobPool MapPool;
+	MapPool.Init(NumThreads);
+	for(int i = 0; i < s_NumJobs; i++)
+		MapPool.Add(&s_pJobs[i].m_Job, ResaveJob, &s_pJobs[i], &MapJobs);
+	MapJobs.Wait();
+
+	int Failed = 0;
+	for(int i = 0; i < s_NumJobs; i++)
+		if(s_pJobs[i].m_Job.Result() != 0)
+			Failed++;
+	dbg_msg("map_resave", "resaved %d maps, %d failed", s_NumJobs-Failed, Failed);
+
+	delete[] s_pJobs;
+	return Failed ? -1 : 0;
+}
@@ -0,0 +1,168 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/system.h>
+#include <engine/config.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+// measures how many packets per second CNetServer::Recv gets through with connected peers.
+// the peers are CNetClients on the loopback interface, each sends a few single chunk
+// packets per round and only the time spent in the server's Recv loop is counted
+
+enum
+{
+	NUM_ROUNDS=20000,
+	PACKETS_PER_PEER=2,
+	DEFAULT_PORT=8403,
+};
+
+static CNetServer s_Server;
+static CNetClient s_aPeers[NET_MAX_CLIENTS];
+static int s_NumAccepted;
+
+static int NewClientCallback(int ClientID, void *pUser)
+{
+	s_NumAccepted++;
+	return 0;
+}
+
+static int NewClientNoAuthCallback(int ClientID, bool Reset, void *pUser)
+{
+	s_NumAccepted++;
+	return 0;
+}
+
+static int ClientRejoinCallback(int ClientID, void *pUser)
+{
+	return 0;
+}
+
+static int DelClientCallback(int ClientID, const char *pReason, void *pUser)
+{
+	dbg_msg("netserver_benchmark", "peer %d dropped: %s", ClientID, pReason);
+	return 0;
+}
+
+static int DrainServer()
+{
+	CNetChunk Chunk;
+	int Num = 0;
+	while(s_Server.Recv(&Chunk))
+		Num++;
+	return Num;
+}
+
+static void DrainPeers(int NumPeers)
+{
+	CNetChunk Chunk;
+	for(int i = 0; i < NumPeers; i++)
+		while(s_aPeers[i].Recv(&Chunk))
+			;
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	int NumPeers = argc > 1 ? str_toint(argv[1]) : NET_MAX_CLIENTS;
+	if(NumPeers < 1 || NumPeers > NET_MAX_CLIENTS)
+	{
+		dbg_msg("usage", "%s [peers (1-%d)] [port]", argv[0], NET_MAX_CLIENTS);
+		return -1;
+	}
+
+	if(secure_random_init() != 0)
+	{
+		dbg_msg("secure", "could not initialize secure RNG");
+		return -1;
+	}
+
+	IConfig *pConfig = CreateConfig();
+	pConfig->Reset();
+	net_init();
+	CNetBase::Init();
+
+	NETADDR BindAddr;
+	mem_zero(&BindAddr, sizeof(BindAddr));
+	BindAddr.type = NETTYPE_IPV4;
+	BindAddr.ip[0] = 127;
+	BindAddr.ip[3] = 1;
+	BindAddr.port = argc > 2 ? str_toint(argv[2]) : DEFAULT_PORT;
+	NETADDR ServerAddr = BindAddr;
+	if(!s_Server.Open(BindAddr, 0, NumPeers, NumPeers, 0))
+	{
+		dbg_msg("netserver_benchmark", "couldn't open socket on port %d", BindAddr.port);
+		return -1;
+	}
+	s_Server.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, 0);
+
+	// connect the peers one after another, from their own ports
+	BindAddr.port = 0;
+	s_NumAccepted = 0;
+	for(int i = 0; i < NumPeers; i++)
+	{
+		if(!s_aPeers[i].Open(BindAddr, 0))
+		{
+			dbg_msg("netserver_benchmark", "couldn't open peer socket");
+			return -1;
+		}
+		s_aPeers[i].Connect(&ServerAddr);
+		int64 Timeout = time_get()+time_freq()*5;
+		while(s_aPeers[i].State() != NETSTATE_ONLINE || s_NumAccepted <= i)
+		{
+			if(time_get() > Timeout)
+			{
+				dbg_msg("netserver_benchmark", "peer %d failed to connect", i);
+				return -1;
+			}
+			s_aPeers[i].Update();
+			s_Server.Update();
+			DrainServer();
+			DrainPeers(i+1);
+			thread_sleep(1);
+		}
+	}
+	dbg_msg("netserver_benchmark", "%d peers connected", NumPeers);
+
+	char aPayload[32];
+	mem_zero(aPayload, sizeof(aPayload));
+	CNetChunk Chunk;
+	Chunk.m_ClientID = 0;
+	Chunk.m_Flags = NETSENDFLAG_FLUSH;
+	Chunk.m_DataSize = sizeof(aPayload);
+	Chunk.m_pData = aPayload;
+
+	int64 Sent = 0;
+	int64 Received = 0;
+	int64 RecvTime = 0;
+	for(int r = 0; r < NUM_ROUNDS; r++)
+	{
+		for(int p = 0; p < PACKETS_PER_PEER; p++)
+			for(int i = 0; i < NumPeers; i++)
+				s_aPeers[i].Send(&Chunk);
+		Sent += NumPeers*PACKETS_PER_PEER;
+
+		int64 Start = time_get();
+		Received += DrainServer();
+		RecvTime += time_get()-Start;
+
+		// keep the connections alive, outside of the measured time
+		if(r%256 == 0)
+		{
+			s_Server.Update();
+			for(int i = 0; i < NumPeers; i++)
+				s_aPeers[i].Update();
+			DrainPeers(NumPeers);
+		}
+	}
+
+	double Seconds = (double)RecvTime/time_freq();
+	dbg_msg("netserver_benchmark", "%d peers, %lld packets sent, %lld received", NumPeers, Sent, Received);
+	dbg_msg("netserver_benchmark", "%.3f s in Recv, %.0f packets/s, %.3f us per packet",
+		Seconds, Received/Seconds, Seconds*1000000.0/Received);
+
+	for(int i = 0; i < NumPeers; i++)
+		s_aPeers[i].Disconnect("benchmark done");
+	s_Server.Close();
+	delete pConfig;
+	return 0;
+}
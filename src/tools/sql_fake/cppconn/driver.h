@@ -0,0 +1,8 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef TOOLS_SQL_FAKE_CPPCONN_DRIVER_H
+#define TOOLS_SQL_FAKE_CPPCONN_DRIVER_H
+
+#include "../mysql_connection.h"
+
+#endif
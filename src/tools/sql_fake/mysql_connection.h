@@ -0,0 +1,123 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#ifndef TOOLS_SQL_FAKE_MYSQL_CONNECTION_H
+#define TOOLS_SQL_FAKE_MYSQL_CONNECTION_H
+
+// the part of MySQL Connector/C++ that CSqlScore uses, answered from memory by
+// sql_score_check. the cppconn headers all lead here
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace sql
+{
+
+class SQLString
+{
+	std::string m_Str;
+
+public:
+	SQLString() {}
+	SQLString(const char *pStr) : m_Str(pStr) {}
+	SQLString(const std::string &Str) : m_Str(Str) {}
+	const char *c_str() const { return m_Str.c_str(); }
+	const std::string &asStdString() const { return m_Str; }
+};
+
+class ConnectPropertyVal
+{
+public:
+	ConnectPropertyVal() {}
+	ConnectPropertyVal(int) {}
+	ConnectPropertyVal(bool) {}
+	ConnectPropertyVal(const SQLString &) {}
+};
+
+typedef std::map<std::string, ConnectPropertyVal> ConnectOptionsMap;
+
+class SQLException : public std::runtime_error
+{
+public:
+	SQLException(const std::string &Reason) : std::runtime_error(Reason) {}
+};
+
+class ResultSet
+{
+public:
+	typedef std::map<std::string, std::string> CRow;
+
+	std::vector<CRow> m_lRows;
+	int m_Row;
+
+	ResultSet() : m_Row(-1) {}
+	virtual ~ResultSet() {}
+
+	bool next() { if(m_Row < (int)m_lRows.size()) m_Row++; return m_Row < (int)m_lRows.size(); }
+	bool first() { m_Row = 0; return !m_lRows.empty(); }
+	size_t rowsCount() const { return m_lRows.size(); }
+
+	SQLString getString(const SQLString &Column) const;
+	int getInt(const SQLString &Column) const;
+	double getDouble(const SQLString &Column) const;
+};
+
+class Connection;
+
+class Statement
+{
+public:
+	Connection *m_pConnection;
+
+	Statement(Connection *pConnection) : m_pConnection(pConnection) {}
+	virtual ~Statement() {}
+
+	bool execute(const SQLString &Sql);
+};
+
+class PreparedStatement : public Statement
+{
+public:
+	std::string m_Sql;
+	std::vector<std::string> m_lParams;
+
+	PreparedStatement(Connection *pConnection, const std::string &Sql) : Statement(pConnection), m_Sql(Sql) {}
+
+	void setString(unsigned Index, const SQLString &Value);
+	void setInt(unsigned Index, int Value);
+	void setDouble(unsigned Index, double Value);
+
+	bool execute();
+	ResultSet *executeQuery();
+};
+
+class Connection
+{
+public:
+	// the changes of an open transaction, only visible to this connection until commit
+	void *m_pTransaction;
+	std::string m_ID; // @id
+
+	Connection() : m_pTransaction(0) {}
+	virtual ~Connection();
+
+	Statement *createStatement() { return new Statement(this); }
+	PreparedStatement *prepareStatement(const SQLString &Sql);
+	void setSchema(const SQLString &Schema);
+	void setAutoCommit(bool AutoCommit);
+	void commit();
+	void rollback();
+};
+
+class Driver
+{
+public:
+	Connection *connect(ConnectOptionsMap &Properties);
+};
+
+}
+
+sql::Driver *get_driver_instance();
+
+#endif
@@ -0,0 +1,781 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/config.h>
+#include <engine/shared/config.h>
+#include <engine/shared/console.h>
+
+#include <game/server/gamecontext.h>
+#include <game/server/gamemodes/DDRace.h>
+#include <game/server/save.h>
+#include <game/server/score/sql_score.h>
+
+// drives CSqlScore through the stand-in for MySQL Connector/C++ in tools/sql_fake, which answers
+// the queries from memory with transactions that only show once committed. it checks batched
+// finishes with points and team times, /rank and /times right after a finish, a batch failing
+// halfway, a full queue, results for a slot that changed hands and the shutdown with and without
+// a database. build it on the host with CONF_SQL and -Isrc/tools/sql_fake, together with
+// sql_score.cpp, engine/shared/config.cpp, engine/shared/jobs.cpp and base/system.c
+
+// the game context is never constructed and CSqlScore is watched from outside, their private
+// members are reached through explicit template instantiations, which may name them
+template<typename TTag, typename TTag::CType Member>
+struct CPrivate
+{
+	friend typename TTag::CType MemberOf(TTag) { return Member; }
+};
+
+#define PRIVATE_MEMBER(Tag, Class, Type, Member) \
+	struct Tag { typedef Type Class::*CType; friend CType MemberOf(Tag); }; \
+	template struct CPrivate<Tag, &Class::Member>;
+
+PRIVATE_MEMBER(CGameServerServer, CGameContext, IServer *, m_pServer)
+PRIVATE_MEMBER(CGameServerConsole, CGameContext, IConsole *, m_pConsole)
+PRIVATE_MEMBER(CScoreWriteBatch, CSqlScore, CSqlWriteBatch *, m_pWriteBatch)
+PRIVATE_MEMBER(CScoreRequests, CSqlScore, CJobGroup, m_Requests)
+PRIVATE_MEMBER(CScorePendingWrites, CSqlScore, array<int>, m_lPendingWrites)
+PRIVATE_MEMBER(CScoreWaitingReads, CSqlScore, array<CSqlRequest *>, m_lpWaitingReads)
+PRIVATE_MEMBER(CScoreNumRejected, CSqlScore, int, m_NumRejected)
+
+typedef sql::ResultSet::CRow CRow;
+
+struct CDatabase
+{
+	std::vector<CRow> m_lRace;
+	std::vector<CRow> m_lTeamRace;
+	std::map<std::string, int> m_Points;
+	std::map<std::string, int> m_MapPoints;
+};
+
+// the committed state, an open transaction works on a copy of it
+static CDatabase s_Database;
+static LOCK s_DatabaseLock;
+// one transaction at a time, like the locks on the points rows would make it
+static LOCK s_TransactionLock;
+static int s_Clock = 1000; // UNIX_TIMESTAMP of the next row
+static int s_NextID = 0;
+static int s_NumConnects = 0;
+
+// set from the main thread while no request runs
+static bool s_Gone = false; // connects and queries fail
+static std::string s_FailQuery; // the next query containing it throws
+static int s_QueryDelay = 0; // milliseconds every query takes
+
+static const char *s_pUnset = "\1unset";
+
+static bool Has(const std::string &Sql, const char *pPart)
+{
+	return Sql.find(pPart) != std::string::npos;
+}
+
+static std::string Str(double Value)
+{
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "%.6f", Value);
+	return aBuf;
+}
+
+static std::string Str(int Value)
+{
+	char aBuf[64];
+	str_format(aBuf, sizeof(aBuf), "%d", Value);
+	return aBuf;
+}
+
+static double Num(const CRow &Row, const char *pColumn)
+{
+	return atof(Row.find(pColumn)->second.c_str());
+}
+
+static bool EarlierStamp(const CRow &A, const CRow &B)
+{
+	return Num(A, "Stamp") > Num(B, "Stamp");
+}
+
+static bool LowerID(const CRow &A, const CRow &B)
+{
+	return A.find("ID")->second < B.find("ID")->second;
+}
+
+// best time per name on a map
+static std::map<std::string, double> BestTimes(const CDatabase *pDb, const std::string &Map)
+{
+	std::map<std::string, double> Best;
+	for(unsigned i = 0; i < pDb->m_lRace.size(); i++)
+	{
+		const CRow &Row = pDb->m_lRace[i];
+		if(Row.find("Map")->second != Map)
+			continue;
+		std::map<std::string, double>::iterator It = Best.find(Row.find("Name")->second);
+		if(It == Best.end() || Num(Row, "Time") < It->second)
+			Best[Row.find("Name")->second] = Num(Row, "Time");
+	}
+	return Best;
+}
+
+// answers the queries of sql_score.cpp by their text, anything else is an error
+static bool RunQuery(CDatabase *pDb, sql::Connection *pConn, const std::string &Sql, const std::vector<std::string> &P, sql::ResultSet *pResult)
+{
+	std::vector<CRow> &lRows = pResult->m_lRows;
+	if(Sql.compare(0, 7, "CREATE ") == 0 || Sql.compare(0, 5, "SET @") == 0)
+	{
+		if(Sql == "SET @id = UUID();")
+			pConn->m_ID = "id" + Str(s_NextID++);
+	}
+	else if(Has(Sql, "SELECT Time FROM") && Has(Sql, "_race WHERE Map=? ORDER BY"))
+	{
+		std::map<std::string, double> Best = BestTimes(pDb, P[0]);
+		for(std::map<std::string, double>::iterator It = Best.begin(); It != Best.end(); ++It)
+		{
+			if(lRows.empty())
+				lRows.push_back(CRow());
+			if(lRows[0].empty() || It->second < Num(lRows[0], "Time"))
+				lRows[0]["Time"] = Str(It->second);
+		}
+	}
+	else if(Has(Sql, "SELECT * FROM") && Has(Sql, "_race WHERE Map=? AND Name=?"))
+	{
+		for(unsigned i = 0; i < pDb->m_lRace.size(); i++)
+		{
+			const CRow &Row = pDb->m_lRace[i];
+			if(Row.find("Map")->second == P[0] && Row.find("Name")->second == P[1] && (lRows.empty() || Num(Row, "Time") < Num(lRows[0], "Time")))
+				lRows.assign(1, Row);
+		}
+	}
+	else if(Has(Sql, "SELECT Points FROM"))
+	{
+		if(pDb->m_MapPoints.count(P[0]))
+		{
+			lRows.push_back(CRow());
+			lRows[0]["Points"] = Str(pDb->m_MapPoints[P[0]]);
+		}
+	}
+	else if(Has(Sql, "YearsAgo"))
+	{
+		// nobody has a birthday today
+	}
+	else if(Has(Sql, "SELECT Rank, Name, Time FROM (SELECT Name,"))
+	{
+		std::map<std::string, double> Best = BestTimes(pDb, P[0]);
+		if(Best.count(P[1]))
+		{
+			int Rank = 1;
+			for(std::map<std::string, double>::iterator It = Best.begin(); It != Best.end(); ++It)
+				if(It->second < Best[P[1]])
+					Rank++;
+			CRow Row;
+			Row["Rank"] = Str(Rank);
+			Row["Name"] = P[1];
+			Row["Time"] = Str(Best[P[1]]);
+			lRows.push_back(Row);
+		}
+	}
+	else if(Has(Sql, "SELECT Time, UNIX_TIMESTAMP"))
+	{
+		std::vector<CRow> lTimes;
+		for(unsigned i = 0; i < pDb->m_lRace.size(); i++)
+			if(pDb->m_lRace[i].find("Map")->second == P[0] && pDb->m_lRace[i].find("Name")->second == P[1])
+				lTimes.push_back(pDb->m_lRace[i]);
+		std::stable_sort(lTimes.begin(), lTimes.end(), EarlierStamp);
+		for(int i = atoi(P[2].c_str()); i < (int)lTimes.size() && (int)lRows.size() < 5; i++)
+		{
+			CRow Row;
+			Row["Time"] = lTimes[i]["Time"];
+			Row["Stamp"] = lTimes[i]["Stamp"];
+			Row["Ago"] = Str(s_Clock-atoi(lTimes[i]["Stamp"].c_str()));
+			lRows.push_back(Row);
+		}
+	}
+	else if(Has(Sql, "SELECT DISTINCT Name FROM"))
+	{
+		std::map<std::string, double> Best = BestTimes(pDb, P[0]);
+		for(unsigned i = 1; i < P.size(); i++)
+		{
+			if(!Best.count(P[i]))
+				continue;
+			CRow Row;
+			Row["Name"] = P[i];
+			lRows.push_back(Row);
+			Best.erase(P[i]);
+		}
+	}
+	else if(Has(Sql, "INSERT INTO") && Has(Sql, "_points("))
+	{
+		for(unsigned i = 0; i+1 < P.size(); i += 2)
+			pDb->m_Points[P[i]] += atoi(P[i+1].c_str());
+	}
+	else if(Has(Sql, "INSERT IGNORE INTO") && Has(Sql, "_race("))
+	{
+		const int NumColumns = 4+NUM_CHECKPOINTS;
+		for(unsigned i = 0; i+NumColumns <= P.size(); i += NumColumns)
+		{
+			CRow Row;
+			Row["Map"] = P[i];
+			Row["Name"] = P[i+1];
+			Row["Time"] = P[i+2];
+			Row["Server"] = P[i+3];
+			for(int c = 0; c < NUM_CHECKPOINTS; c++)
+				Row["cp"+Str(c+1)] = P[i+4+c];
+			Row["Stamp"] = Str(s_Clock++);
+			pDb->m_lRace.push_back(Row);
+		}
+	}
+	else if(Has(Sql, "SELECT Name, l.ID, Time FROM"))
+	{
+		std::map<std::string, bool> IDs;
+		for(unsigned i = 0; i < pDb->m_lTeamRace.size(); i++)
+			if(pDb->m_lTeamRace[i]["Map"] == P[0] && pDb->m_lTeamRace[i]["Name"] == P[1])
+				IDs[pDb->m_lTeamRace[i]["ID"]] = true;
+		for(unsigned i = 0; i < pDb->m_lTeamRace.size(); i++)
+		{
+			if(!IDs.count(pDb->m_lTeamRace[i]["ID"]))
+				continue;
+			CRow Row;
+			Row["Name"] = pDb->m_lTeamRace[i]["Name"];
+			Row["ID"] = pDb->m_lTeamRace[i]["ID"];
+			Row["Time"] = pDb->m_lTeamRace[i]["Time"];
+			lRows.push_back(Row);
+		}
+		std::stable_sort(lRows.begin(), lRows.end(), LowerID);
+	}
+	else if(Has(Sql, "UPDATE") && Has(Sql, "_teamrace SET Time"))
+	{
+		for(unsigned i = 0; i < pDb->m_lTeamRace.size(); i++)
+			if(pDb->m_lTeamRace[i]["ID"] == P[1])
+				pDb->m_lTeamRace[i]["Time"] = P[0];
+	}
+	else if(Has(Sql, "INSERT IGNORE INTO") && Has(Sql, "_teamrace("))
+	{
+		if(pConn->m_ID.empty())
+			throw sql::SQLException("@id is NULL");
+		for(unsigned i = 0; i+3 <= P.size(); i += 3)
+		{
+			CRow Row;
+			Row["Map"] = P[i];
+			Row["Name"] = P[i+1];
+			Row["Time"] = P[i+2];
+			Row["ID"] = pConn->m_ID;
+			pDb->m_lTeamRace.push_back(Row);
+		}
+	}
+	else
+		return false;
+	return true;
+}
+
+static sql::ResultSet *Execute(sql::Connection *pConn, const std::string &Sql, const std::vector<std::string> &lParams)
+{
+	for(unsigned i = 0; i < lParams.size(); i++)
+		if(lParams[i] == s_pUnset)
+			throw sql::SQLException("No value specified for parameter " + Str((int)i+1) + " of " + Sql);
+	if(s_QueryDelay)
+		thread_sleep(s_QueryDelay);
+
+	sql::ResultSet *pResult = new sql::ResultSet();
+	lock_wait(s_DatabaseLock);
+	std::string Error;
+	if(s_Gone)
+		Error = "MySQL server has gone away";
+	else if(!s_FailQuery.empty() && Has(Sql, s_FailQuery.c_str()))
+	{
+		s_FailQuery.clear();
+		Error = "Lock wait timeout exceeded";
+	}
+	else
+	{
+		CDatabase *pDb = pConn->m_pTransaction ? (CDatabase *)pConn->m_pTransaction : &s_Database;
+		try
+		{
+			if(!RunQuery(pDb, pConn, Sql, lParams, pResult))
+				Error = "You have an error in your SQL syntax near '" + Sql + "'";
+		}
+		catch(sql::SQLException &e)
+		{
+			Error = e.what();
+		}
+	}
+	lock_unlock(s_DatabaseLock);
+
+	if(!Error.empty())
+	{
+		delete pResult;
+		throw sql::SQLException(Error);
+	}
+	return pResult;
+}
+
+namespace sql
+{
+
+SQLString ResultSet::getString(const SQLString &Column) const
+{
+	if(m_Row < 0 || m_Row >= (int)m_lRows.size())
+		throw SQLException("ResultSet is not on a row");
+	CRow::const_iterator It = m_lRows[m_Row].find(Column.asStdString());
+	if(It == m_lRows[m_Row].end())
+		throw SQLException("Unknown column '" + Column.asStdString() + "'");
+	return It->second;
+}
+
+int ResultSet::getInt(const SQLString &Column) const
+{
+	return atoi(getString(Column).c_str());
+}
+
+double ResultSet::getDouble(const SQLString &Column) const
+{
+	return atof(getString(Column).c_str());
+}
+
+bool Statement::execute(const SQLString &Sql)
+{
+	delete Execute(m_pConnection, Sql.asStdString(), std::vector<std::string>());
+	return false;
+}
+
+void PreparedStatement::setString(unsigned Index, const SQLString &Value)
+{
+	if(Index < 1 || Index > m_lParams.size())
+		throw SQLException("Invalid parameter index " + Str((int)Index) + " of " + m_Sql);
+	m_lParams[Index-1] = Value.asStdString();
+}
+
+void PreparedStatement::setInt(unsigned Index, int Value)
+{
+	setString(Index, Str(Value));
+}
+
+void PreparedStatement::setDouble(unsigned Index, double Value)
+{
+	setString(Index, Str(Value));
+}
+
+bool PreparedStatement::execute()
+{
+	delete Execute(m_pConnection, m_Sql, m_lParams);
+	return false;
+}
+
+ResultSet *PreparedStatement::executeQuery()
+{
+	return Execute(m_pConnection, m_Sql, m_lParams);
+}
+
+Connection::~Connection()
+{
+	rollback();
+}
+
+PreparedStatement *Connection::prepareStatement(const SQLString &Sql)
+{
+	PreparedStatement *pStmt = new PreparedStatement(this, Sql.asStdString());
+	pStmt->m_lParams.assign(std::count(Sql.asStdString().begin(), Sql.asStdString().end(), '?'), s_pUnset);
+	return pStmt;
+}
+
+void Connection::setSchema(const SQLString &Schema)
+{
+}
+
+void Connection::setAutoCommit(bool AutoCommit)
+{
+	if(AutoCommit)
+	{
+		commit();
+		return;
+	}
+	if(m_pTransaction)
+		return;
+
+	lock_wait(s_TransactionLock);
+	lock_wait(s_DatabaseLock);
+	m_pTransaction = new CDatabase(s_Database);
+	lock_unlock(s_DatabaseLock);
+}
+
+void Connection::commit()
+{
+	if(!m_pTransaction)
+		return;
+
+	lock_wait(s_DatabaseLock);
+	s_Database = *(CDatabase *)m_pTransaction;
+	lock_unlock(s_DatabaseLock);
+	delete (CDatabase *)m_pTransaction;
+	m_pTransaction = 0;
+	lock_unlock(s_TransactionLock);
+}
+
+void Connection::rollback()
+{
+	if(!m_pTransaction)
+		return;
+
+	delete (CDatabase *)m_pTransaction;
+	m_pTransaction = 0;
+	lock_unlock(s_TransactionLock);
+}
+
+Connection *Driver::connect(ConnectOptionsMap &Properties)
+{
+	lock_wait(s_DatabaseLock);
+	bool Gone = s_Gone;
+	if(!Gone)
+		s_NumConnects++;
+	lock_unlock(s_DatabaseLock);
+	if(Gone)
+		throw SQLException("Can't connect to MySQL server");
+	return new Connection();
+}
+
+}
+
+sql::Driver *get_driver_instance()
+{
+	static sql::Driver s_Driver;
+	return &s_Driver;
+}
+
+// the few game functions sql_score.cpp calls, chat is recorded to be checked
+struct CChatLine
+{
+	int m_To; // -1 for everyone
+	std::string m_Text;
+};
+
+static std::vector<CChatLine> s_lChat;
+
+void CGameContext::SendChatTarget(int To, const char *pText)
+{
+	CChatLine Line = {To, pText};
+	s_lChat.push_back(Line);
+}
+
+void CGameContext::SendChatTeam(int Team, const char *pText)
+{
+	CChatLine Line = {-1, pText};
+	s_lChat.push_back(Line);
+}
+
+void CGameContext::SendChat(int ChatterClientID, int Team, const char *pText, int SpamProtectionClientID)
+{
+	CChatLine Line = {-1, pText};
+	s_lChat.push_back(Line);
+}
+
+void CGameContext::CallVote(int ClientID, const char *aDesc, const char *aCmd, const char *pReason, const char *aChatmsg) {}
+int CGameTeams::Count(int Team) const { return 0; }
+void CGameTeams::KillSavedTeam(int Team) {}
+int CTeamsCore::Team(int ClientID) { return 0; }
+CSaveTeam::CSaveTeam(IGameController *Controller) {}
+CSaveTeam::~CSaveTeam() {}
+char *CSaveTeam::GetString() { return (char *)""; }
+int CSaveTeam::LoadString(const char *String) { return 1; }
+int CSaveTeam::save(int Team) { return 1; }
+int CSaveTeam::load(int Team) { return 1; }
+
+class CFakeServer : public IServer
+{
+public:
+	char m_aaNames[MAX_CLIENTS][MAX_NAME_LENGTH];
+
+	CFakeServer()
+	{
+		m_CurrentGameTick = 0;
+		m_TickSpeed = SERVER_TICK_SPEED;
+		mem_zero(m_aaNames, sizeof(m_aaNames));
+	}
+
+	void SetName(int ClientID, const char *pName) { str_copy(m_aaNames[ClientID], pName, sizeof(m_aaNames[ClientID])); }
+
+	virtual int MaxClients() const { return MAX_CLIENTS; }
+	virtual const char *ClientName(int ClientID) { return m_aaNames[ClientID][0] ? m_aaNames[ClientID] : "(invalid)"; }
+	virtual const char *ClientClan(int ClientID) { return ""; }
+	virtual int ClientCountry(int ClientID) { return -1; }
+	virtual bool ClientIngame(int ClientID) { return m_aaNames[ClientID][0] != 0; }
+	virtual int GetClientInfo(int ClientID, CClientInfo *pInfo) { return 0; }
+	virtual void GetClientAddr(int ClientID, char *pAddrStr, int Size) { str_copy(pAddrStr, "0.0.0.0", Size); }
+	virtual void RestrictRconOutput(int ClientID) {}
+	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) { return 0; }
+	virtual void SetClientName(int ClientID, char const *pName) { SetName(ClientID, pName); }
+	virtual void SetClientClan(int ClientID, char const *pClan) {}
+	virtual void SetClientCountry(int ClientID, int Country) {}
+	virtual void SetClientScore(int ClientID, int Score) {}
+	virtual int SnapNewID() { return 0; }
+	virtual void SnapFreeID(int ID) {}
+	virtual void *SnapNewItem(int Type, int ID, int Size) { return 0; }
+	virtual void SnapSetStaticsize(int ItemType, int Size) {}
+	virtual void SetRconCID(int ClientID) {}
+	virtual bool IsAuthed(int ClientID) { return false; }
+	virtual void Kick(int ClientID, const char *pReason) {}
+	virtual void DemoRecorder_HandleAutoStart() {}
+	virtual bool DemoRecorder_IsRecording() { return false; }
+	virtual void SaveDemo(int ClientID, float Time) {}
+	virtual void StartRecord(int ClientID) {}
+	virtual void StopRecord(int ClientID) {}
+	virtual bool IsRecording(int ClientID) { return false; }
+	virtual void GetClientAddr(int ClientID, NETADDR *pAddr) {}
+	virtual int *GetIdMap(int ClientID) { return 0; }
+};
+
+static int s_NumChecks = 0;
+static int s_NumFailures = 0;
+
+static void Check(bool Ok, const char *pWhat)
+{
+	s_NumChecks++;
+	if(!Ok)
+	{
+		s_NumFailures++;
+		dbg_msg("sql_score_check", "FAILED: %s", pWhat);
+	}
+}
+
+static int NumSaid(int To, const char *pText)
+{
+	int Num = 0;
+	for(unsigned i = 0; i < s_lChat.size(); i++)
+		if(s_lChat[i].m_To == To && Has(s_lChat[i].m_Text, pText))
+			Num++;
+	return Num;
+}
+
+static int NumSaidTo(int To)
+{
+	int Num = 0;
+	for(unsigned i = 0; i < s_lChat.size(); i++)
+		if(s_lChat[i].m_To == To)
+			Num++;
+	return Num;
+}
+
+static std::vector<CRow> RaceRows(const char *pName)
+{
+	std::vector<CRow> lRows;
+	lock_wait(s_DatabaseLock);
+	for(unsigned i = 0; i < s_Database.m_lRace.size(); i++)
+		if(s_Database.m_lRace[i]["Name"] == pName)
+			lRows.push_back(s_Database.m_lRace[i]);
+	lock_unlock(s_DatabaseLock);
+	return lRows;
+}
+
+static int Points(const char *pName)
+{
+	lock_wait(s_DatabaseLock);
+	int Points = s_Database.m_Points.count(pName) ? s_Database.m_Points[pName] : -1;
+	lock_unlock(s_DatabaseLock);
+	return Points;
+}
+
+static std::vector<CRow> TeamRows(const char *pName)
+{
+	std::vector<CRow> lRows;
+	lock_wait(s_DatabaseLock);
+	for(unsigned i = 0; i < s_Database.m_lTeamRace.size(); i++)
+		if(s_Database.m_lTeamRace[i]["Name"] == pName)
+			lRows.push_back(s_Database.m_lTeamRace[i]);
+	lock_unlock(s_DatabaseLock);
+	return lRows;
+}
+
+static void AddRecord(const char *pName, double Time)
+{
+	CRow Row;
+	Row["Map"] = g_Config.m_SvMap;
+	Row["Name"] = pName;
+	Row["Time"] = Str(Time);
+	Row["Server"] = "UNK";
+	for(int c = 0; c < NUM_CHECKPOINTS; c++)
+		Row["cp"+Str(c+1)] = Str(0.0);
+	Row["Stamp"] = Str(s_Clock++);
+	s_Database.m_lRace.push_back(Row);
+}
+
+static bool Idle(CSqlScore *pScore)
+{
+	return !(pScore->*MemberOf(CScoreWriteBatch())) && !(pScore->*MemberOf(CScoreRequests())).NumPending() && !(pScore->*MemberOf(CScorePendingWrites())).size() && !(pScore->*MemberOf(CScoreWaitingReads())).size();
+}
+
+// ticks until every request is done and handed back, the write delay included
+static void WaitIdle(CSqlScore *pScore)
+{
+	int64 Start = time_get();
+	while(time_get() < Start+time_freq()*10)
+	{
+		pScore->OnTick();
+		if(Idle(pScore))
+		{
+			thread_sleep(2);
+			pScore->OnTick();
+			if(Idle(pScore))
+				return;
+		}
+		thread_sleep(1);
+	}
+	Check(false, "requests done within 10 seconds");
+}
+
+static void Finish(CSqlScore *pScore, int ClientID, float Time)
+{
+	float aCpTime[NUM_CHECKPOINTS];
+	for(int c = 0; c < NUM_CHECKPOINTS; c++)
+		aCpTime[c] = Time*(c+1)/(NUM_CHECKPOINTS+1);
+	pScore->SaveScore(ClientID, Time, aCpTime);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	IConfig *pConfig = CreateConfig();
+	pConfig->Reset();
+	str_copy(g_Config.m_SvMap, "Sunny Side Up", sizeof(g_Config.m_SvMap));
+	g_Config.m_SvSqlConnections = 2;
+	g_Config.m_SvSqlWriteDelay = 1000;
+	s_DatabaseLock = lock_create();
+	s_TransactionLock = lock_create();
+
+	static const char *s_apNames[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel", "india", "juliett", "kilo", "mike"};
+	CFakeServer Server;
+	for(unsigned i = 0; i < sizeof(s_apNames)/sizeof(s_apNames[0]); i++)
+		Server.SetName(i, s_apNames[i]);
+
+	s_Database.m_MapPoints[g_Config.m_SvMap] = 5;
+	AddRecord("bravo", 12.0);
+	AddRecord("juliett", 30.0);
+	AddRecord("kilo", 40.0);
+
+	// never constructed, zeroed memory with the members CSqlScore uses
+	static int64 s_aGameContext[sizeof(CGameContext)/sizeof(int64)+1];
+	static int64 s_aConsole[sizeof(CConsole)/sizeof(int64)+1];
+	static int64 s_aController[sizeof(CGameControllerDDRace)/sizeof(int64)+1];
+	CGameContext *pGameServer = (CGameContext *)s_aGameContext;
+	pGameServer->*MemberOf(CGameServerServer()) = &Server;
+	pGameServer->*MemberOf(CGameServerConsole()) = (IConsole *)s_aConsole;
+	pGameServer->m_pController = (IGameController *)s_aController;
+	CGameControllerDDRace *pController = (CGameControllerDDRace *)s_aController;
+
+	CSqlScore *pScore = new CSqlScore(pGameServer);
+	Check(pController->m_CurrentRecord > 11.99f && pController->m_CurrentRecord < 12.01f, "the record is loaded");
+
+	// one batch: two new tees, an old one, a second finish and a team
+	Finish(pScore, 0, 10.0f);
+	Finish(pScore, 1, 11.5f);
+	Finish(pScore, 2, 9.87f);
+	Finish(pScore, 0, 9.5f);
+	int aTeam[] = {3, 4};
+	pScore->SaveTeamScore(aTeam, 2, 20.0f);
+	Check((pScore->*MemberOf(CScoreWriteBatch())) != 0, "finishes wait for the write delay");
+	WaitIdle(pScore);
+	std::vector<CRow> lAlpha = RaceRows("alpha");
+	Check(lAlpha.size() == 2 && RaceRows("bravo").size() == 2 && RaceRows("charlie").size() == 1, "every finish is stored");
+	Check(lAlpha.size() == 2 && Num(lAlpha[1], "Time") == 9.5 && Num(lAlpha[1], "cp1") == 0.37 && Num(lAlpha[1], "cp25") == 9.13, "times and checkpoints are in their columns");
+	Check(Points("alpha") == 5 && Points("charlie") == 5 && Points("bravo") == -1, "only first finishes earn points");
+	Check(NumSaid(0, "You earned 5 points") == 1 && NumSaid(2, "You earned 5 points") == 1 && NumSaidTo(1) == 0, "points are told once");
+	std::vector<CRow> lDelta = TeamRows("delta"), lEcho = TeamRows("echo");
+	Check(lDelta.size() == 1 && lEcho.size() == 1 && lDelta[0]["ID"] == lEcho[0]["ID"] && Num(lDelta[0], "Time") == 20.0, "the team time is stored");
+
+	// the same team again, faster and then slower
+	int aTeam2[] = {4, 3};
+	pScore->SaveTeamScore(aTeam2, 2, 19.0f);
+	WaitIdle(pScore);
+	pScore->SaveTeamScore(aTeam, 2, 25.0f);
+	WaitIdle(pScore);
+	lDelta = TeamRows("delta");
+	lEcho = TeamRows("echo");
+	Check(lDelta.size() == 1 && lEcho.size() == 1 && Num(lDelta[0], "Time") == 19.0 && Num(lEcho[0], "Time") == 19.0, "a team only improves its time");
+
+	// /rank and /times right after a finish, while the batch is still slow to write
+	s_lChat.clear();
+	s_QueryDelay = 30;
+	Finish(pScore, 5, 8.0f);
+	pScore->ShowRank(5, "foxtrot");
+	pScore->ShowTimes(5, "foxtrot");
+	Check((pScore->*MemberOf(CScoreWaitingReads())).size() == 2, "reads wait for the finish before them");
+	WaitIdle(pScore);
+	s_QueryDelay = 0;
+	Check(NumSaid(-1, "1. foxtrot Time: 00:08.00") == 1, "/rank sees the finish");
+	Check(NumSaid(5, "0 min 8.00 sec") == 1, "/times sees the finish");
+	pScore->ShowRank(1, "bravo");
+	Check((pScore->*MemberOf(CScoreWaitingReads())).size() == 0, "reads without writes go out right away");
+	WaitIdle(pScore);
+	Check(NumSaid(-1, "4. bravo Time: 00:11.50") == 1, "/rank uses the best time");
+
+	// a batch failing halfway leaves nothing behind, the next one reconnects
+	s_lChat.clear();
+	int NumConnects = s_NumConnects;
+	s_FailQuery = "_teamrace(";
+	Finish(pScore, 6, 7.0f);
+	int aTeam3[] = {6, 7};
+	pScore->SaveTeamScore(aTeam3, 2, 21.0f);
+	WaitIdle(pScore);
+	Check(s_FailQuery.empty(), "the team insert failed");
+	Check(RaceRows("golf").empty() && Points("golf") == -1 && TeamRows("golf").empty() && NumSaidTo(6) == 0, "a failed batch is rolled back");
+	Finish(pScore, 6, 7.5f);
+	WaitIdle(pScore);
+	Check(RaceRows("golf").size() == 1 && Points("golf") == 5 && NumSaid(6, "You earned 5 points") == 1, "the next batch is written");
+	Check(s_NumConnects == NumConnects+1, "the failed connection is replaced");
+
+	// results for a slot someone else took in the meantime
+	s_lChat.clear();
+	Finish(pScore, 11, 50.0f);
+	pScore->LoadScore(9);
+	pScore->ShowTimes(9, "juliett");
+	pScore->LoadScore(10);
+	Server.SetName(9, "lima");
+	Server.SetName(11, "november");
+	WaitIdle(pScore);
+	Check(pScore->PlayerData(9)->m_BestTime == 0.0f && NumSaidTo(9) == 0, "a stale load is dropped");
+	Check(pScore->PlayerData(10)->m_BestTime == 40.0f, "a current load is applied");
+	Check(RaceRows("mike").size() == 1 && Points("mike") == 5 && NumSaidTo(11) == 0, "a stale finish is stored but not told");
+
+	// a flood of reads, a finish in the middle of it
+	s_lChat.clear();
+	g_Config.m_SvSqlMaxQueue = 16;
+	s_QueryDelay = 5;
+	int NumRejected = (pScore->*MemberOf(CScoreNumRejected()));
+	for(int i = 0; i < 40; i++)
+	{
+		if(i == 20)
+			Finish(pScore, 8, 33.0f);
+		pScore->ShowRank(0, "alpha");
+	}
+	WaitIdle(pScore);
+	s_QueryDelay = 0;
+	int Dropped = (pScore->*MemberOf(CScoreNumRejected()))-NumRejected;
+	Check(Dropped > 0 && NumSaid(-1, "alpha Time: 00:09.50") == 40-Dropped, "reads over sv_sql_max_queue are dropped");
+	Check(RaceRows("india").size() == 1, "a finish is never dropped");
+
+	// shutdown: the last finishes are written, reads are skipped
+	s_lChat.clear();
+	Finish(pScore, 2, 9.0f);
+	pScore->ShowRank(2, "charlie");
+	delete pScore;
+	Check(RaceRows("charlie").size() == 2 && s_lChat.empty(), "shutdown writes the finishes only");
+
+	// shutdown with the database gone does not wait for it
+	pScore = new CSqlScore(pGameServer);
+	Finish(pScore, 3, 60.0f);
+	pScore->ShowRank(3, "delta");
+	WaitIdle(pScore);
+	s_Gone = true;
+	Finish(pScore, 3, 59.0f);
+	int64 Start = time_get();
+	delete pScore;
+	Check(time_get()-Start < time_freq(), "shutdown without a database is quick");
+	Check(RaceRows("delta").size() == 1, "the finish is lost, not half written");
+
+	delete pConfig;
+	dbg_msg("sql_score_check", "%d checks, %d failures", s_NumChecks, s_NumFailures);
+	return s_NumFailures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+/* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
+/* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <math.h>
+#include <stdlib.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+#include <game/generated/protocol.h>
+
+// checks CVariableInt::Compress/Decompress against the plain one int at a time loops and
+// measures both on snapshot deltas. the deltas come from a simulated round: characters
+// running and hooking, player infos, projectiles coming and going, like a server sends them
+
+enum
+{
+	NUM_FUZZ_ROUNDS=300000,
+	NUM_DELTAS=2000,
+	NUM_CHARACTERS=16,
+	MAX_INTS=256,
+};
+
+// the scalar loops CVariableInt used before it handled four one byte ints at once
+static long RefCompress(const void *pSrc_, int Size, void *pDst_)
+{
+	const int *pSrc = (const int *)pSrc_;
+	unsigned char *pDst = (unsigned char *)pDst_;
+	for(int i = 0; i < Size/4; i++)
+		pDst = CVariableInt::Pack(pDst, pSrc[i]);
+	return (long)(pDst-(unsigned char *)pDst_);
+}
+
+static long RefDecompress(const void *pSrc_, int Size, void *pDst_)
+{
+	const unsigned char *pSrc = (const unsigned char *)pSrc_;
+	const unsigned char *pEnd = pSrc + Size;
+	int *pDst = (int *)pDst_;
+	while(pSrc < pEnd)
+		pSrc = CVariableInt::Unpack(pSrc, pDst++);
+	return (long)((unsigned char *)pDst-(unsigned char *)pDst_);
+}
+
+static int RandomInt()
+{
+	static const int s_aEdges[] = {0, -1, 63, 64, -64, -65, 8191, 8192, -8192, -8193, 0x7fffffff, (int)0x80000000};
+	switch(rand()%6)
+	{
+	case 0: return 0;
+	case 1: return rand()%128-64;
+	case 2: return rand()%4096-2048;
+	case 3: return (int)(((unsigned)rand()<<16)^rand());
+	case 4: return s_aEdges[rand()%(sizeof(s_aEdges)/sizeof(s_aEdges[0]))];
+	default: return rand()%64;
+	}
+}
+
+static bool Fuzz()
+{
+	int aInts[MAX_INTS], aOut[MAX_INTS+4], aRefOut[MAX_INTS+4];
+	unsigned char aPacked[MAX_INTS*5+8], aRefPacked[MAX_INTS*5+8];
+	int Failed = 0;
+	for(int r = 0; r < NUM_FUZZ_ROUNDS && Failed < 10; r++)
+	{
+		// runs of one byte ints with a few larger ones in between, like deltas
+		int Num = rand()%MAX_INTS;
+		int Mode = rand()%3;
+		for(int i = 0; i < Num; i++)
+			aInts[i] = Mode == 0 || (Mode == 2 && rand()%8 == 0) ? RandomInt() : rand()%128-64;
+
+		long Size = CVariableInt::Compress(aInts, Num*4, aPacked);
+		long RefSize = RefCompress(aInts, Num*4, aRefPacked);
+		if(Size != RefSize || mem_comp(aPacked, aRefPacked, Size) != 0)
+		{
+			dbg_msg("varint_benchmark", "compress of %d ints differs from the reference", Num);
+			Failed++;
+			continue;
+		}
+
+		long OutSize = CVariableInt::Decompress(aPacked, Size, aOut);
+		if(OutSize != Num*4 || mem_comp(aOut, aInts, OutSize) != 0)
+		{
+			dbg_msg("varint_benchmark", "%d ints don't survive the round trip", Num);
+			Failed++;
+			continue;
+		}
+
+		// random bytes, zero padded since an unpacked int may read past the end
+		int NumBytes = rand()%MAX_INTS;
+		for(int i = 0; i < NumBytes; i++)
+			aPacked[i] = rand()%3 ? rand() : rand()%128;
+		mem_zero(aPacked+NumBytes, 8);
+		OutSize = CVariableInt::Decompress(aPacked, NumBytes, aOut);
+		long RefOutSize = RefDecompress(aPacked, NumBytes, aRefOut);
+		if(OutSize != RefOutSize || mem_comp(aOut, aRefOut, OutSize) != 0)
+		{
+			dbg_msg("varint_benchmark", "decompress of %d random bytes differs from the reference", NumBytes);
+			Failed++;
+		}
+	}
+	return Failed == 0;
+}
+
+static int BuildSnapshot(int Tick, void *pData)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		CNetObj_Character *pChar = (CNetObj_Character *)Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+		mem_zero(pChar, sizeof(*pChar));
+		float a = Tick*0.02f+i;
+		pChar->m_Tick = Tick - Tick%(1+i%3);
+		pChar->m_X = (int)(1000+400*cosf(a)+i*50);
+		pChar->m_Y = (int)(800+200*sinf(a*1.3f));
+		pChar->m_VelX = (int)(2560*sinf(a));
+		pChar->m_VelY = (int)(2560*cosf(a));
+		pChar->m_Angle = (int)(a*40)%256;
+		pChar->m_Direction = i%3 ? 0 : 1;
+		pChar->m_Jumped = (Tick/50)%2;
+		pChar->m_HookedPlayer = -1;
+		pChar->m_HookState = (Tick/30+i)%4 == 0 ? 3 : 0;
+		pChar->m_HookX = pChar->m_HookState ? pChar->m_X+100 : pChar->m_X;
+		pChar->m_HookY = pChar->m_HookState ? pChar->m_Y-80 : pChar->m_Y;
+		pChar->m_Health = 10;
+		pChar->m_Armor = (Tick/10+i)%10;
+		pChar->m_AmmoCount = 10;
+		pChar->m_Weapon = i%4;
+		pChar->m_AttackTick = Tick-Tick%40;
+
+		CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+		pInfo->m_Local = i == 0;
+		pInfo->m_ClientID = i;
+		pInfo->m_Team = 0;
+		pInfo->m_Score = (Tick/25+i)%100;
+		pInfo->m_Latency = 50+i;
+	}
+
+	for(int i = 0; i < 8; i++)
+	{
+		int ID = (Tick/20+i)%64;
+		CNetObj_Projectile *pProj = (CNetObj_Projectile *)Builder.NewItem(NETOBJTYPE_PROJECTILE, ID, sizeof(CNetObj_Projectile));
+		pProj->m_X = 100+ID*37;
+		pProj->m_Y = 200+ID*11;
+		pProj->m_VelX = 3*ID-90;
+		pProj->m_VelY = -5;
+		pProj->m_Type = ID%4;
+		pProj->m_StartTick = Tick-Tick%20;
+	}
+
+	CNetObj_GameInfo *pGameInfo = (CNetObj_GameInfo *)Builder.NewItem(NETOBJTYPE_GAMEINFO, 0, sizeof(CNetObj_GameInfo));
+	mem_zero(pGameInfo, sizeof(*pGameInfo));
+	pGameInfo->m_RoundCurrent = 1;
+	return Builder.Finish(pData);
+}
+
+int main(int argc, const char **argv) // ignore_convention
+{
+	dbg_logger_stdout();
+	srand(1);
+	bool Ok = Fuzz();
+
+	// deltas between consecutive snapshots, packed once up front
+	static char s_aaSnapshots[2][CSnapshot::MAX_SIZE];
+	static char s_aaDeltas[NUM_DELTAS][CSnapshot::MAX_SIZE];
+	static unsigned char s_aaPacked[NUM_DELTAS][CSnapshot::MAX_SIZE*2];
+	static int s_aDeltaSize[NUM_DELTAS], s_aPackedSize[NUM_DELTAS];
+	static int s_aOutput[CSnapshot::MAX_SIZE/4+4];
+	static unsigned char s_aPackedOutput[CSnapshot::MAX_SIZE*2];
+	CSnapshotDelta Delta;
+	int64 TotalSize = 0, TotalPacked = 0;
+	BuildSnapshot(0, s_aaSnapshots[0]);
+	for(int i = 0; i < NUM_DELTAS; i++)
+	{
+		BuildSnapshot(i+1, s_aaSnapshots[(i+1)&1]);
+		s_aDeltaSize[i] = Delta.CreateDelta((CSnapshot *)s_aaSnapshots[i&1], (CSnapshot *)s_aaSnapshots[(i+1)&1], s_aaDeltas[i]);
+		s_aPackedSize[i] = CVariableInt::Compress(s_aaDeltas[i], s_aDeltaSize[i], s_aaPacked[i]);
+		long RefSize = RefCompress(s_aaDeltas[i], s_aDeltaSize[i], s_aPackedOutput);
+		if(RefSize != s_aPackedSize[i] || mem_comp(s_aPackedOutput, s_aaPacked[i], RefSize) != 0)
+		{
+			dbg_msg("varint_benchmark", "delta %d packs differently from the reference", i);
+			Ok = false;
+		}
+		TotalSize += s_aDeltaSize[i];
+		TotalPacked += s_aPackedSize[i];
+	}
+
+	int Rounds = max(1, (int)(256*1024*1024/max(TotalSize, (int64)1)));
+	int64 aTime[4];
+	int64 Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < NUM_DELTAS; i++)
+			RefCompress(s_aaDeltas[i], s_aDeltaSize[i], s_aPackedOutput);
+	aTime[0] = time_get()-Start;
+
+	Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < NUM_DELTAS; i++)
+			CVariableInt::Compress(s_aaDeltas[i], s_aDeltaSize[i], s_aPackedOutput);
+	aTime[1] = time_get()-Start;
+
+	Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < NUM_DELTAS; i++)
+			RefDecompress(s_aaPacked[i], s_aPackedSize[i], s_aOutput);
+	aTime[2] = time_get()-Start;
+
+	Start = time_get();
+	for(int r = 0; r < Rounds; r++)
+		for(int i = 0; i < NUM_DELTAS; i++)
+			CVariableInt::Decompress(s_aaPacked[i], s_aPackedSize[i], s_aOutput);
+	aTime[3] = time_get()-Start;
+
+	double MBytes = TotalSize*(double)Rounds/(1024*1024);
+	double aSpeed[4];
+	for(int i = 0; i < 4; i++)
+		aSpeed[i] = MBytes/((double)max(aTime[i], (int64)1)/time_freq());
+	dbg_msg("varint_benchmark", "%d deltas, %d bytes on average, %d packed, fuzz %s",
+		NUM_DELTAS, (int)(TotalSize/NUM_DELTAS), (int)(TotalPacked/NUM_DELTAS), Ok ? "ok" : "FAILED");
+	dbg_msg("varint_benchmark", "compress %.1f MB/s (reference %.1f MB/s), decompress %.1f MB/s (reference %.1f MB/s)",
+		aSpeed[1], aSpeed[0], aSpeed[3], aSpeed[2]);
+	return Ok ? 0 : -1;
+}